@@ -0,0 +1,415 @@
+﻿#include "AssetBaker.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <unordered_set>
+
+#include "CookedMesh.h"
+#include "CookedShader.h"
+#include "Hash.h"
+#include "Lz4.h"
+#include "MappedFile.h"
+#include "MeshImporter.h"
+#include "MeshOptimizer.h"
+#include "MipmapGenerator.h"
+#include "ObjLoader.h"
+#include "SpirvReflector.h"
+#include "TextureCache.h"
+#include "TextureDecoder.h"
+#include "WorkerPool.h"
+
+namespace detail
+{
+	// Bump whenever a cooked format or a bake step changes, every asset is rebaked
+	static constexpr uint32_t s_BakerVersion = 1;
+
+	static constexpr uint32_t s_CookedFileMagic = 0x444B4356; // "VCKD"
+
+	// Header of the cooked files in the intermediate directory, the data is stored as it goes in the archive
+	struct CookedFileHeader
+	{
+		uint32_t magic;
+		uint32_t compression;
+		uint64_t uncompressedSize;
+	};
+
+	static void mapSource(const std::string& path, MappedFile& file)
+	{
+		if (!file.open(path))
+		{
+			throw std::runtime_error("Failed to open file: " + path + "!");
+		}
+	}
+
+	static std::vector<uint8_t> readFile(const std::string& path)
+	{
+		std::ifstream file(path, std::ios::ate | std::ios::binary);
+		if (!file.is_open())
+		{
+			throw std::runtime_error("Failed to open file: " + path + "!");
+		}
+
+		std::vector<uint8_t> data(static_cast<size_t>(file.tellg()));
+		file.seekg(0);
+		file.read(reinterpret_cast<char*>(data.data()), data.size());
+		return data;
+	}
+}
+
+bool AssetBaker::bake(const AssetBakerOptions& options)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	m_Options = options;
+	m_Baked = m_UpToDate = m_Failed = 0;
+
+	std::filesystem::create_directories(m_Options.intermediateDirectory);
+	std::string databasePath = (std::filesystem::path(m_Options.intermediateDirectory) / "bake.db").string();
+	m_Database.load(databasePath);
+
+	// Gather the sources, named relative to the root like the runtime names its assets
+	std::vector<std::string> inputDirectories = m_Options.inputDirectories;
+	if (inputDirectories.empty())
+	{
+		inputDirectories.push_back(".");
+	}
+
+	std::filesystem::path root(m_Options.rootDirectory);
+	std::vector<std::string> sources;
+	for (const std::string& inputDirectory : inputDirectories)
+	{
+		std::filesystem::path directory = root / inputDirectory;
+		if (!std::filesystem::is_directory(directory))
+		{
+			throw std::runtime_error("Input directory does not exist: " + directory.string() + "!");
+		}
+
+		for (const auto& item : std::filesystem::recursive_directory_iterator(directory))
+		{
+			if (item.is_regular_file() && AssetKind::Unknown != getAssetKind(item.path().string()))
+			{
+				sources.push_back(std::filesystem::relative(item.path(), root).generic_string());
+			}
+		}
+	}
+	std::sort(sources.begin(), sources.end());
+	sources.erase(std::unique(sources.begin(), sources.end()), sources.end());
+
+	// Bake across all cores
+	WorkerPool workerPool;
+	workerPool.create(m_Options.threadCount);
+	for (const std::string& source : sources)
+	{
+		workerPool.submit([this, &source]() { bakeAsset(source, getAssetKind(source)); });
+	}
+	workerPool.wait();
+	workerPool.destroy();
+
+	m_Database.retain(sources);
+	m_Database.save(databasePath);
+
+	// Pack the archive (nothing is published while an asset fails to bake)
+	if (0 == m_Failed)
+	{
+		AssetArchiveWriter writer;
+		for (const std::string& source : sources)
+		{
+			const BakeRecord* record = m_Database.find(source);
+			std::vector<uint8_t> cooked = detail::readFile(getCookedPath(record->key));
+
+			detail::CookedFileHeader header{};
+			if (cooked.size() < sizeof(header))
+			{
+				throw std::runtime_error("Invalid cooked file for " + source + "!");
+			}
+			std::memcpy(&header, cooked.data(), sizeof(header));
+			cooked.erase(cooked.begin(), cooked.begin() + sizeof(header));
+
+			writer.addStored(record->outputName, std::move(cooked), header.uncompressedSize, static_cast<AssetCompression>(header.compression));
+		}
+		writer.write(m_Options.outputFile);
+	}
+
+	auto end = std::chrono::high_resolution_clock::now();
+	m_Stats.baked = m_Baked;
+	m_Stats.upToDate = m_UpToDate;
+	m_Stats.failed = m_Failed;
+	m_Stats.milliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+	return 0 == m_Failed;
+}
+
+AssetBaker::AssetKind AssetBaker::getAssetKind(const std::string& path)
+{
+	std::string extension = std::filesystem::path(path).extension().string();
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return static_cast<char>(std::tolower(c)); });
+
+	if (".png" == extension || ".jpg" == extension || ".jpeg" == extension || ".tga" == extension || ".bmp" == extension)
+		return AssetKind::Texture;
+	if (".obj" == extension)
+		return AssetKind::Mesh;
+	if (".vert" == extension || ".frag" == extension || ".comp" == extension)
+		return AssetKind::Shader;
+	if (".spv" == extension)
+		return AssetKind::ShaderBinary;
+	return AssetKind::Unknown;
+}
+
+std::string AssetBaker::getOutputName(const std::string& source, AssetKind kind)
+{
+	switch (kind)
+	{
+	case AssetKind::Texture: return source.substr(0, source.find_last_of('.')) + ".vtc"; // (looked up by the runtime next to the source name)
+	case AssetKind::Mesh: return source.substr(0, source.find_last_of('.')) + ".vmesh";
+	case AssetKind::Shader: return source + ".vshader";
+	case AssetKind::ShaderBinary: return source.substr(0, source.find_last_of('.')) + ".vshader";
+	default: return source;
+	}
+}
+
+std::vector<std::string> AssetBaker::findDependencies(const std::string& path, AssetKind kind) const
+{
+	std::vector<std::string> dependencies = { path };
+	if (AssetKind::Shader != kind)
+		return dependencies;
+
+	// Local includes of the shader, recursively
+	std::unordered_set<std::string> visited = { path };
+	for (size_t i = 0; i < dependencies.size(); i++)
+	{
+		std::ifstream file(dependencies[i]);
+		std::string line;
+		while (std::getline(file, line))
+		{
+			size_t directive = line.find("#include");
+			size_t open = line.find('"', directive);
+			size_t close = line.find('"', open + 1);
+			if (std::string::npos == directive || std::string::npos == open || std::string::npos == close)
+				continue;
+
+			std::filesystem::path include = std::filesystem::path(dependencies[i]).parent_path() / line.substr(open + 1, close - open - 1);
+			std::string includePath = include.lexically_normal().string();
+			if (visited.insert(includePath).second)
+			{
+				dependencies.push_back(includePath);
+			}
+		}
+	}
+	return dependencies;
+}
+
+uint64_t AssetBaker::computeKey(const std::vector<std::string>& dependencies, AssetKind kind) const
+{
+	uint32_t settingsWords[] = { detail::s_BakerVersion, static_cast<uint32_t>(kind), m_Options.compress };
+	uint64_t key = hashBytes(settingsWords, sizeof(settingsWords));
+
+	for (const std::string& dependency : dependencies)
+	{
+		MappedFile file;
+		if (file.open(dependency))
+		{
+			key = hashBytes(file.getData(), file.getSize(), key);
+		}
+		key = hashBytes(dependency.data(), dependency.size(), key); // (moving an include changes the key)
+	}
+	return key;
+}
+
+bool AssetBaker::bakeAsset(const std::string& source, AssetKind kind)
+{
+	std::string path = (std::filesystem::path(m_Options.rootDirectory) / source).string();
+
+	try
+	{
+		BakeRecord record;
+		bool hasRecord = false;
+		{
+			std::lock_guard<std::mutex> lock(m_DatabaseMutex);
+			if (const BakeRecord* existing = m_Database.find(source))
+			{
+				record = *existing;
+				hasRecord = true;
+			}
+		}
+
+		// Unchanged dependencies : nothing to hash nor bake
+		if (!m_Options.force && hasRecord && BakeDatabase::isUpToDate(record) && std::filesystem::exists(getCookedPath(record.key)))
+		{
+			m_UpToDate++;
+			return true;
+		}
+
+		std::vector<std::string> dependencies = findDependencies(path, kind);
+		record.source = source;
+		record.outputName = getOutputName(source, kind);
+		record.dependencies.clear();
+		for (const std::string& dependency : dependencies)
+		{
+			record.dependencies.push_back(BakeDatabase::getDependencyState(dependency));
+		}
+		record.key = computeKey(dependencies, kind);
+
+		// Touched but identical inputs reuse the cooked file
+		if (!m_Options.force && std::filesystem::exists(getCookedPath(record.key)))
+		{
+			m_UpToDate++;
+		}
+		else
+		{
+			switch (kind)
+			{
+			case AssetKind::Texture: writeCookedFile(record.key, bakeTexture(path)); break;
+			case AssetKind::Mesh: writeCookedFile(record.key, bakeMesh(path)); break;
+			default: writeCookedFile(record.key, bakeShader(path, kind, record.key)); break;
+			}
+			m_Baked++;
+		}
+
+		std::lock_guard<std::mutex> lock(m_DatabaseMutex);
+		m_Database.update(record);
+		return true;
+	}
+	catch (const std::exception& e)
+	{
+		std::fprintf(stderr, "Failed to bake %s : %s\n", source.c_str(), e.what());
+		m_Failed++;
+		return false;
+	}
+}
+
+std::vector<uint8_t> AssetBaker::bakeTexture(const std::string& path) const
+{
+	MappedFile file;
+	detail::mapSource(path, file);
+
+	// Same settings as the runtime uses when mips cannot be blitted, so the baked chain is always complete
+	TextureImportSettings settings{};
+	settings.format = VK_FORMAT_R8G8B8A8_SRGB;
+	settings.srgb = true;
+	settings.generateMipsOnCpu = true;
+
+	uint32_t width, height;
+	if (!TextureDecoder::readInfo(file.getData(), file.getSize(), width, height))
+	{
+		throw std::runtime_error("Failed to decode texture!");
+	}
+
+	std::vector<MipLevel> levels;
+	size_t chainSize = MipmapGenerator::getMipChainLayout(width, height, levels);
+	std::vector<uint8_t> data = TextureCache::serializeEntryHeader(TextureCache::computeKey(file.getData(), file.getSize(), settings),
+	                                                               settings.format, levels, chainSize);
+	size_t payloadOffset = data.size();
+	data.resize(payloadOffset + chainSize);
+
+	if (!TextureDecoder::decodeRGBA8(file.getData(), file.getSize(), data.data() + payloadOffset, width, height))
+	{
+		throw std::runtime_error("Failed to decode texture!");
+	}
+	MipmapGenerator::generateRGBA8InPlace(data.data() + payloadOffset, settings.srgb, levels);
+	return data;
+}
+
+std::vector<uint8_t> AssetBaker::bakeMesh(const std::string& path) const
+{
+	MappedFile file;
+	detail::mapSource(path, file);
+
+	MeshData meshData;
+	if (!ObjLoader::load(reinterpret_cast<const char*>(file.getData()), file.getSize(), meshData))
+	{
+		throw std::runtime_error("Failed to parse mesh!");
+	}
+
+	MeshOptimizer::optimizeVertexCache(meshData);
+	MeshOptimizer::optimizeVertexFetch(meshData);
+
+	return CookedMesh::serialize(MeshImporter::prepare(meshData), MeshOptimizer::computeBoundingSphere(meshData));
+}
+
+std::vector<uint8_t> AssetBaker::bakeShader(const std::string& path, AssetKind kind, uint64_t key) const
+{
+	std::vector<uint8_t> binary;
+	if (AssetKind::ShaderBinary == kind)
+	{
+		binary = detail::readFile(path);
+	}
+	else
+	{
+		// Compile next to the cooked files (named after the key, so concurrent bakes never collide)
+		std::string spirvPath = getCookedPath(key) + ".spv";
+		std::string command = "\"" + m_Options.glslc + "\" \"" + path + "\" -o \"" + spirvPath + "\"";
+#ifdef _WIN32
+		command = "\"" + command + "\""; // (cmd strips the outer quotes)
+#endif
+		if (0 != std::system(command.c_str()))
+		{
+			throw std::runtime_error("Failed to compile shader!");
+		}
+		binary = detail::readFile(spirvPath);
+		std::filesystem::remove(spirvPath);
+	}
+
+	if (0 != binary.size() % 4)
+	{
+		throw std::runtime_error("Invalid SPIR-V module!");
+	}
+	std::vector<uint32_t> code(binary.size() / 4);
+	std::memcpy(code.data(), binary.data(), binary.size());
+
+	CookedShader shader;
+	if (!SpirvReflector::reflect(code, shader))
+	{
+		throw std::runtime_error("Invalid SPIR-V module!");
+	}
+	shader.code = code.data();
+	shader.codeSize = binary.size();
+	return CookedShader::serialize(shader);
+}
+
+std::string AssetBaker::getCookedPath(uint64_t key) const
+{
+	char name[32];
+	std::snprintf(name, sizeof(name), "%016llx.cooked", static_cast<unsigned long long>(key));
+	return (std::filesystem::path(m_Options.intermediateDirectory) / name).string();
+}
+
+void AssetBaker::writeCookedFile(uint64_t key, const std::vector<uint8_t>& data) const
+{
+	detail::CookedFileHeader header{};
+	header.magic = detail::s_CookedFileMagic;
+	header.compression = static_cast<uint32_t>(AssetCompression::None);
+	header.uncompressedSize = data.size();
+
+	// Compressed on this worker, stored uncompressed when it does not shrink
+	std::vector<uint8_t> compressed;
+	if (m_Options.compress)
+	{
+		compressed.resize(Lz4::getMaxCompressedSize(data.size()));
+		size_t compressedSize = Lz4::compress(data.data(), data.size(), compressed.data(), compressed.size());
+		if (0 != compressedSize && compressedSize < data.size())
+		{
+			compressed.resize(compressedSize);
+			header.compression = static_cast<uint32_t>(AssetCompression::LZ4);
+		}
+	}
+	const std::vector<uint8_t>& stored = static_cast<uint32_t>(AssetCompression::LZ4) == header.compression ? compressed : data;
+
+	// Written under a temporary name first, an interrupted bake never leaves a truncated cooked file
+	std::string path = getCookedPath(key);
+	std::string temporaryPath = path + ".tmp";
+	{
+		std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(stored.data()), stored.size());
+		if (!file)
+		{
+			throw std::runtime_error("Failed to write file: " + temporaryPath + "!");
+		}
+	}
+	std::filesystem::rename(temporaryPath, path);
+}
@@ -0,0 +1,77 @@
+﻿#pragma once
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "AssetArchive.h"
+#include "BakeDatabase.h"
+
+struct AssetBakerOptions
+{
+	std::string rootDirectory = "."; // archive entries are named relative to it
+	std::vector<std::string> inputDirectories; // relative to the root, the whole root when empty
+	std::string outputFile = "assets.vtpk";
+	std::string intermediateDirectory = "baked"; // cooked files and database
+	std::string glslc = "glslc";
+	uint32_t threadCount = 0; // one per hardware thread
+	bool compress = true;
+	bool force = false; // ignore the database and rebake everything
+};
+
+struct AssetBakerStats
+{
+	uint32_t baked = 0;
+	uint32_t upToDate = 0;
+	uint32_t failed = 0;
+	double milliseconds = 0.0;
+};
+
+/**
+ * Offline asset baker : turns the sources found under the input directories into GPU-ready entries of an asset archive.
+ *  - textures (png, jpg, tga, bmp) : RGBA8 sRGB with the full mip chain, in the texture cache layout (.vtc)
+ *  - meshes (obj) : vertex cache and fetch optimized, index type chosen per chunk (.vmesh, see CookedMesh)
+ *  - shaders (vert, frag, comp or spv) : SPIR-V with the reflected layout (.vshader, see CookedShader)
+ * Every source is baked on the worker pool into a cooked file named after the hash of its inputs,
+ * then the archive is packed from the cooked files.
+ * (the runtime only reads the .vtc entries so far, the meshes and shaders are baked ahead of a loader for them)
+ */
+class AssetBaker
+{
+public:
+	bool bake(const AssetBakerOptions& options);
+
+	const AssetBakerStats& getStats() const { return m_Stats; }
+
+private:
+	enum class AssetKind
+	{
+		Unknown,
+		Texture,
+		Mesh,
+		Shader,
+		ShaderBinary,
+	};
+
+	static AssetKind getAssetKind(const std::string& path);
+	static std::string getOutputName(const std::string& source, AssetKind kind);
+
+	// Dependencies of a source (the source first), for shaders its local includes
+	std::vector<std::string> findDependencies(const std::string& path, AssetKind kind) const;
+	uint64_t computeKey(const std::vector<std::string>& dependencies, AssetKind kind) const;
+
+	bool bakeAsset(const std::string& source, AssetKind kind);
+	std::vector<uint8_t> bakeTexture(const std::string& path) const;
+	std::vector<uint8_t> bakeMesh(const std::string& path) const;
+	std::vector<uint8_t> bakeShader(const std::string& path, AssetKind kind, uint64_t key) const;
+
+	std::string getCookedPath(uint64_t key) const;
+	void writeCookedFile(uint64_t key, const std::vector<uint8_t>& data) const;
+
+	AssetBakerOptions m_Options;
+	BakeDatabase m_Database;
+	std::mutex m_DatabaseMutex;
+	AssetBakerStats m_Stats;
+	std::atomic<uint32_t> m_Baked{0}, m_UpToDate{0}, m_Failed{0};
+};
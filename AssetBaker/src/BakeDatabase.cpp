@@ -0,0 +1,120 @@
+﻿#include "BakeDatabase.h"
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_set>
+
+namespace detail
+{
+	static constexpr const char* s_DatabaseHeader = "# AssetBaker database v1";
+}
+
+void BakeDatabase::load(const std::string& filepath)
+{
+	m_Records.clear();
+
+	std::ifstream file(filepath);
+	std::string line;
+	if (!file.is_open() || !std::getline(file, line) || line != detail::s_DatabaseHeader)
+		return; // (a missing or outdated database rebuilds everything)
+
+	// source \t output \t key \t dependency count (\t path \t size \t write time)*
+	while (std::getline(file, line))
+	{
+		std::istringstream stream(line);
+		BakeRecord record;
+		std::string key, count;
+		if (!std::getline(stream, record.source, '\t') || !std::getline(stream, record.outputName, '\t')
+		    || !std::getline(stream, key, '\t') || !std::getline(stream, count, '\t'))
+		{
+			continue;
+		}
+		record.key = std::stoull(key, nullptr, 16);
+
+		record.dependencies.resize(std::stoul(count));
+		bool isValid = true;
+		for (BakeDependency& dependency : record.dependencies)
+		{
+			std::string size, writeTime;
+			isValid = isValid && std::getline(stream, dependency.path, '\t') && std::getline(stream, size, '\t') && std::getline(stream, writeTime, '\t');
+			if (isValid)
+			{
+				dependency.size = std::stoull(size);
+				dependency.writeTime = std::stoll(writeTime);
+			}
+		}
+		if (isValid)
+		{
+			m_Records[record.source] = std::move(record);
+		}
+	}
+}
+
+void BakeDatabase::save(const std::string& filepath) const
+{
+	std::ofstream file(filepath, std::ios::trunc);
+	if (!file.is_open())
+	{
+		throw std::runtime_error("Failed to open file: " + filepath + "!");
+	}
+
+	file << detail::s_DatabaseHeader << '\n';
+	for (const auto& [source, record] : m_Records)
+	{
+		file << record.source << '\t' << record.outputName << '\t' << std::hex << record.key << std::dec << '\t' << record.dependencies.size() << '\t';
+		for (const BakeDependency& dependency : record.dependencies)
+		{
+			file << dependency.path << '\t' << dependency.size << '\t' << dependency.writeTime << '\t';
+		}
+		file << '\n';
+	}
+}
+
+const BakeRecord* BakeDatabase::find(const std::string& source) const
+{
+	auto it = m_Records.find(source);
+	return m_Records.end() == it ? nullptr : &it->second;
+}
+
+void BakeDatabase::update(const BakeRecord& record)
+{
+	m_Records[record.source] = record;
+}
+
+void BakeDatabase::retain(const std::vector<std::string>& sources)
+{
+	std::unordered_set<std::string> retained(sources.begin(), sources.end());
+	for (auto it = m_Records.begin(); it != m_Records.end(); )
+	{
+		it = retained.count(it->first) ? std::next(it) : m_Records.erase(it);
+	}
+}
+
+BakeDependency BakeDatabase::getDependencyState(const std::string& path)
+{
+	BakeDependency dependency{};
+	dependency.path = path;
+
+	std::error_code error;
+	dependency.size = std::filesystem::file_size(path, error);
+	if (error)
+	{
+		dependency.size = ~0ull;
+		return dependency;
+	}
+	dependency.writeTime = std::filesystem::last_write_time(path, error).time_since_epoch().count();
+	return dependency;
+}
+
+bool BakeDatabase::isUpToDate(const BakeRecord& record)
+{
+	for (const BakeDependency& dependency : record.dependencies)
+	{
+		BakeDependency current = getDependencyState(dependency.path);
+		if (current.size != dependency.size || current.writeTime != dependency.writeTime)
+			return false;
+	}
+	return !record.dependencies.empty();
+}
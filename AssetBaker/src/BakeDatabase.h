@@ -0,0 +1,46 @@
+﻿#pragma once
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// File a baked asset was produced from, with the state it had at the time
+struct BakeDependency
+{
+	std::string path;
+	uint64_t size = 0;
+	int64_t writeTime = 0;
+};
+
+struct BakeRecord
+{
+	std::string source; // relative to the root directory
+	std::string outputName; // archive entry
+	uint64_t key = 0; // hash of the inputs and the bake settings, names the cooked file
+	std::vector<BakeDependency> dependencies; // the source first
+};
+
+/**
+ * Dependency database of the baker, kept as a text file next to the cooked files.
+ * A record whose dependencies all kept their size and write time is up to date without hashing anything.
+ */
+class BakeDatabase
+{
+public:
+	void load(const std::string& filepath);
+	void save(const std::string& filepath) const;
+
+	const BakeRecord* find(const std::string& source) const;
+	void update(const BakeRecord& record);
+
+	// Drop the records of sources that are not part of the build anymore
+	void retain(const std::vector<std::string>& sources);
+
+	const std::unordered_map<std::string, BakeRecord>& getRecords() const { return m_Records; }
+
+	static BakeDependency getDependencyState(const std::string& path);
+	static bool isUpToDate(const BakeRecord& record);
+
+private:
+	std::unordered_map<std::string, BakeRecord> m_Records;
+};
@@ -0,0 +1,112 @@
+﻿#include "CookedMesh.h"
+
+#include <cstring>
+
+namespace detail
+{
+	static constexpr uint32_t s_CookedMeshMagic = 0x48534D56; // "VMSH"
+	static constexpr uint32_t s_CookedMeshVersion = 1;
+
+	struct CookedMeshFileHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t chunkCount;
+		uint32_t vertexStride; // sizeof(Vertex) when baked
+		float boundingSphere[4];
+	};
+	static_assert(sizeof(CookedMeshFileHeader) == 32, "Cooked mesh header must be packed");
+
+	struct CookedMeshFileChunk
+	{
+		uint64_t vertexOffset;
+		uint64_t indexOffset;
+		uint32_t vertexCount;
+		uint32_t indexCount;
+		uint32_t indexType;
+		uint32_t reserved;
+	};
+	static_assert(sizeof(CookedMeshFileChunk) == 32, "Cooked mesh chunk must be packed");
+
+	static size_t alignUp(size_t value)
+	{
+		return (value + 15) & ~size_t(15);
+	}
+}
+
+std::vector<uint8_t> CookedMesh::serialize(const std::vector<MeshChunk>& chunks, const glm::vec4& bounding_sphere)
+{
+	detail::CookedMeshFileHeader header{};
+	header.magic = detail::s_CookedMeshMagic;
+	header.version = detail::s_CookedMeshVersion;
+	header.chunkCount = static_cast<uint32_t>(chunks.size());
+	header.vertexStride = sizeof(Vertex);
+	std::memcpy(header.boundingSphere, &bounding_sphere, sizeof(header.boundingSphere));
+
+	// Lay out the arrays after the chunk table
+	std::vector<detail::CookedMeshFileChunk> fileChunks(chunks.size());
+	size_t size = detail::alignUp(sizeof(header) + chunks.size() * sizeof(detail::CookedMeshFileChunk));
+	for (size_t i = 0; i < chunks.size(); i++)
+	{
+		fileChunks[i].vertexOffset = size;
+		fileChunks[i].vertexCount = static_cast<uint32_t>(chunks[i].vertices.size());
+		size = detail::alignUp(size + chunks[i].vertices.size() * sizeof(Vertex));
+
+		fileChunks[i].indexOffset = size;
+		fileChunks[i].indexCount = chunks[i].indexCount;
+		fileChunks[i].indexType = static_cast<uint32_t>(chunks[i].indexType);
+		size = detail::alignUp(size + chunks[i].indices.size());
+	}
+
+	std::vector<uint8_t> data(size);
+	std::memcpy(data.data(), &header, sizeof(header));
+	std::memcpy(data.data() + sizeof(header), fileChunks.data(), fileChunks.size() * sizeof(detail::CookedMeshFileChunk));
+	for (size_t i = 0; i < chunks.size(); i++)
+	{
+		std::memcpy(data.data() + fileChunks[i].vertexOffset, chunks[i].vertices.data(), chunks[i].vertices.size() * sizeof(Vertex));
+		std::memcpy(data.data() + fileChunks[i].indexOffset, chunks[i].indices.data(), chunks[i].indices.size());
+	}
+	return data;
+}
+
+bool CookedMesh::parse(const uint8_t* data, size_t size, CookedMesh& mesh)
+{
+	detail::CookedMeshFileHeader header{};
+	if (size < sizeof(header))
+		return false;
+	std::memcpy(&header, data, sizeof(header));
+
+	if (detail::s_CookedMeshMagic != header.magic || detail::s_CookedMeshVersion != header.version || sizeof(Vertex) != header.vertexStride
+	    || (size - sizeof(header)) / sizeof(detail::CookedMeshFileChunk) < header.chunkCount)
+	{
+		return false;
+	}
+
+	std::memcpy(&mesh.boundingSphere, header.boundingSphere, sizeof(header.boundingSphere));
+	mesh.chunks.resize(header.chunkCount);
+	for (uint32_t i = 0; i < header.chunkCount; i++)
+	{
+		detail::CookedMeshFileChunk fileChunk{};
+		std::memcpy(&fileChunk, data + sizeof(header) + i * sizeof(fileChunk), sizeof(fileChunk));
+
+		VkIndexType indexType = static_cast<VkIndexType>(fileChunk.indexType);
+		if (VK_INDEX_TYPE_UINT16 != indexType && VK_INDEX_TYPE_UINT32 != indexType)
+			return false;
+
+		uint64_t vertexBytes = uint64_t(fileChunk.vertexCount) * sizeof(Vertex);
+		uint64_t indexBytes = uint64_t(fileChunk.indexCount) * MeshImporter::getIndexSize(indexType);
+		if (fileChunk.vertexOffset > size || vertexBytes > size - fileChunk.vertexOffset
+		    || fileChunk.indexOffset > size || indexBytes > size - fileChunk.indexOffset)
+		{
+			return false;
+		}
+
+		CookedMeshChunk& chunk = mesh.chunks[i];
+		chunk.vertices = reinterpret_cast<const Vertex*>(data + fileChunk.vertexOffset);
+		chunk.vertexCount = fileChunk.vertexCount;
+		chunk.indices = data + fileChunk.indexOffset;
+		chunk.indexCount = fileChunk.indexCount;
+		chunk.indexType = indexType;
+	}
+	return true;
+}
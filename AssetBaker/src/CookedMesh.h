@@ -0,0 +1,32 @@
+﻿#pragma once
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+#include "BufferData.h"
+#include "MeshImporter.h"
+
+// One chunk of a cooked mesh, pointing into the cooked data (ready for VulkanGeometryPool::addMesh)
+struct CookedMeshChunk
+{
+	const Vertex* vertices;
+	uint32_t vertexCount;
+	const uint8_t* indices;
+	uint32_t indexCount;
+	VkIndexType indexType;
+};
+
+/**
+ * Baked mesh : header | chunk table | per chunk, the vertices (runtime Vertex layout) then the packed indices.
+ * Every array is 16-byte aligned in the data, so a parsed mesh only points into it (nothing is converted).
+ */
+struct CookedMesh
+{
+	glm::vec4 boundingSphere; // xyz : center, w : radius (in object space)
+	std::vector<CookedMeshChunk> chunks;
+
+	static std::vector<uint8_t> serialize(const std::vector<MeshChunk>& chunks, const glm::vec4& bounding_sphere);
+
+	// The data must be at least 4-byte aligned and outlive the mesh
+	static bool parse(const uint8_t* data, size_t size, CookedMesh& mesh);
+};
@@ -0,0 +1,84 @@
+﻿#include "CookedShader.h"
+
+#include <cstring>
+
+namespace detail
+{
+	static constexpr uint32_t s_CookedShaderMagic = 0x44485356; // "VSHD"
+	static constexpr uint32_t s_CookedShaderVersion = 1;
+
+	struct CookedShaderFileHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t stage;
+		uint32_t pushConstantSize;
+		uint32_t localSize[3];
+		uint32_t bindingCount;
+		uint64_t codeOffset;
+		uint64_t codeSize;
+	};
+	static_assert(sizeof(CookedShaderFileHeader) == 48, "Cooked shader header must be packed");
+
+	struct CookedShaderFileBinding
+	{
+		uint32_t set;
+		uint32_t binding;
+		uint32_t descriptorType;
+		uint32_t descriptorCount;
+	};
+}
+
+std::vector<uint8_t> CookedShader::serialize(const CookedShader& shader)
+{
+	detail::CookedShaderFileHeader header{};
+	header.magic = detail::s_CookedShaderMagic;
+	header.version = detail::s_CookedShaderVersion;
+	header.stage = static_cast<uint32_t>(shader.stage);
+	header.pushConstantSize = shader.pushConstantSize;
+	std::memcpy(header.localSize, shader.localSize, sizeof(header.localSize));
+	header.bindingCount = static_cast<uint32_t>(shader.bindings.size());
+	header.codeOffset = sizeof(header) + shader.bindings.size() * sizeof(detail::CookedShaderFileBinding);
+	header.codeSize = shader.codeSize;
+
+	std::vector<uint8_t> data(static_cast<size_t>(header.codeOffset + header.codeSize));
+	std::memcpy(data.data(), &header, sizeof(header));
+	for (size_t i = 0; i < shader.bindings.size(); i++)
+	{
+		const CookedShaderBinding& binding = shader.bindings[i];
+		detail::CookedShaderFileBinding fileBinding{ binding.set, binding.binding, static_cast<uint32_t>(binding.descriptorType), binding.descriptorCount };
+		std::memcpy(data.data() + sizeof(header) + i * sizeof(fileBinding), &fileBinding, sizeof(fileBinding));
+	}
+	std::memcpy(data.data() + header.codeOffset, shader.code, shader.codeSize);
+	return data;
+}
+
+bool CookedShader::parse(const uint8_t* data, size_t size, CookedShader& shader)
+{
+	detail::CookedShaderFileHeader header{};
+	if (size < sizeof(header))
+		return false;
+	std::memcpy(&header, data, sizeof(header));
+
+	uint64_t bindingsEnd = sizeof(header) + uint64_t(header.bindingCount) * sizeof(detail::CookedShaderFileBinding);
+	if (detail::s_CookedShaderMagic != header.magic || detail::s_CookedShaderVersion != header.version
+	    || bindingsEnd > size || header.codeOffset < bindingsEnd || 0 != header.codeOffset % 4
+	    || header.codeOffset > size || header.codeSize > size - header.codeOffset || 0 != header.codeSize % 4)
+	{
+		return false;
+	}
+
+	shader.stage = static_cast<VkShaderStageFlagBits>(header.stage);
+	shader.pushConstantSize = header.pushConstantSize;
+	std::memcpy(shader.localSize, header.localSize, sizeof(shader.localSize));
+	shader.bindings.resize(header.bindingCount);
+	for (uint32_t i = 0; i < header.bindingCount; i++)
+	{
+		detail::CookedShaderFileBinding fileBinding{};
+		std::memcpy(&fileBinding, data + sizeof(header) + i * sizeof(fileBinding), sizeof(fileBinding));
+		shader.bindings[i] = { fileBinding.set, fileBinding.binding, static_cast<VkDescriptorType>(fileBinding.descriptorType), fileBinding.descriptorCount };
+	}
+	shader.code = reinterpret_cast<const uint32_t*>(data + header.codeOffset);
+	shader.codeSize = static_cast<size_t>(header.codeSize);
+	return true;
+}
@@ -0,0 +1,34 @@
+﻿#pragma once
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+// Descriptor used by a shader, as declared in its SPIR-V
+struct CookedShaderBinding
+{
+	uint32_t set;
+	uint32_t binding;
+	VkDescriptorType descriptorType;
+	uint32_t descriptorCount; // 0 for runtime sized arrays
+};
+
+/**
+ * Baked shader : SPIR-V along with the layout metadata reflected from it, so that descriptor set layouts
+ * and push constant ranges can be built without parsing the module.
+ * Layout : header | bindings | code (4-byte aligned).
+ */
+struct CookedShader
+{
+	VkShaderStageFlagBits stage = VK_SHADER_STAGE_VERTEX_BIT;
+	uint32_t pushConstantSize = 0;
+	uint32_t localSize[3] = { 1, 1, 1 }; // compute shaders only
+	std::vector<CookedShaderBinding> bindings;
+
+	const uint32_t* code = nullptr;
+	size_t codeSize = 0; // in bytes
+
+	static std::vector<uint8_t> serialize(const CookedShader& shader);
+
+	// The data must be at least 4-byte aligned and outlive the shader
+	static bool parse(const uint8_t* data, size_t size, CookedShader& shader);
+};
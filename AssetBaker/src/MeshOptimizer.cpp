@@ -0,0 +1,223 @@
+﻿#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace detail
+{
+	static constexpr uint32_t s_CacheSize = 32;
+	static constexpr float s_CacheDecayPower = 1.5f;
+	static constexpr float s_LastTriangleScore = 0.75f;
+	static constexpr float s_ValenceBoostScale = 2.f;
+	static constexpr float s_ValenceBoostPower = 0.5f;
+
+	static float computeVertexScore(int cache_position, uint32_t remaining_valence)
+	{
+		// Vertices that are not used anymore never attract triangles
+		if (0 == remaining_valence)
+			return -1.f;
+
+		float score = 0.f;
+		if (cache_position >= 0)
+		{
+			// The 3 most recent vertices belong to the last triangle, a fixed score avoids favoring strips too much
+			if (cache_position < 3)
+			{
+				score = s_LastTriangleScore;
+			}
+			else
+			{
+				float scale = 1.f / (s_CacheSize - 3);
+				score = std::pow(1.f - (cache_position - 3) * scale, s_CacheDecayPower);
+			}
+		}
+
+		// Finish off the vertices with few remaining triangles first
+		score += s_ValenceBoostScale * std::pow(static_cast<float>(remaining_valence), -s_ValenceBoostPower);
+		return score;
+	}
+}
+
+void MeshOptimizer::optimizeVertexCache(MeshData& mesh_data)
+{
+	const size_t vertexCount = mesh_data.vertices.size();
+	const size_t triangleCount = mesh_data.indices.size() / 3;
+	const std::vector<uint32_t>& indices = mesh_data.indices;
+	if (triangleCount < 2)
+		return;
+
+	// Triangles adjacent to every vertex
+	std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+	for (uint32_t index : indices)
+	{
+		adjacencyOffsets[index + 1]++;
+	}
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		adjacencyOffsets[i + 1] += adjacencyOffsets[i];
+	}
+	std::vector<uint32_t> remainingValence(vertexCount);
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		remainingValence[i] = adjacencyOffsets[i + 1] - adjacencyOffsets[i];
+	}
+	std::vector<uint32_t> adjacency(indices.size());
+	std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+	for (size_t i = 0; i < indices.size(); i++)
+	{
+		adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+	}
+
+	std::vector<int> cachePositions(vertexCount, -1);
+	std::vector<float> vertexScores(vertexCount);
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		vertexScores[i] = detail::computeVertexScore(-1, remainingValence[i]);
+	}
+
+	std::vector<float> triangleScores(triangleCount);
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		triangleScores[t] = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+	}
+
+	std::vector<bool> isEmitted(triangleCount, false);
+	std::vector<uint32_t> output;
+	output.reserve(indices.size());
+
+	// LRU cache, with room for the 3 vertices pushed in before the oldest ones are evicted
+	std::vector<uint32_t> cache, nextCache;
+	cache.reserve(detail::s_CacheSize + 3);
+	nextCache.reserve(detail::s_CacheSize + 3);
+
+	size_t bestTriangle = std::max_element(triangleScores.begin(), triangleScores.end()) - triangleScores.begin();
+	size_t scanPosition = 0; // (for the fallback search when the cache has nothing left to offer)
+	for (size_t emitted = 0; emitted < triangleCount; emitted++)
+	{
+		if (std::numeric_limits<size_t>::max() == bestTriangle)
+		{
+			while (isEmitted[scanPosition])
+				scanPosition++;
+			bestTriangle = scanPosition;
+		}
+
+		const uint32_t* triangle = &indices[bestTriangle * 3];
+		isEmitted[bestTriangle] = true;
+		output.insert(output.end(), triangle, triangle + 3);
+
+		// Move the triangle's vertices to the front of the cache and detach the triangle from them
+		nextCache.assign(triangle, triangle + 3);
+		for (uint32_t vertex : cache)
+		{
+			if (vertex != triangle[0] && vertex != triangle[1] && vertex != triangle[2])
+				nextCache.push_back(vertex);
+		}
+		for (int corner = 0; corner < 3; corner++)
+		{
+			uint32_t vertex = triangle[corner];
+			uint32_t* begin = &adjacency[adjacencyOffsets[vertex]];
+			uint32_t* end = begin + remainingValence[vertex];
+			*std::find(begin, end, static_cast<uint32_t>(bestTriangle)) = *(end - 1);
+			remainingValence[vertex]--;
+		}
+		std::swap(cache, nextCache);
+
+		// Vertices evicted from the cache lose their cache score
+		for (size_t i = detail::s_CacheSize; i < cache.size(); i++)
+		{
+			cachePositions[cache[i]] = -1;
+			vertexScores[cache[i]] = detail::computeVertexScore(-1, remainingValence[cache[i]]);
+		}
+		cache.resize(std::min<size_t>(cache.size(), detail::s_CacheSize));
+
+		// Rescore the cached vertices, then their triangles, and pick the next triangle among them
+		for (size_t i = 0; i < cache.size(); i++)
+		{
+			cachePositions[cache[i]] = static_cast<int>(i);
+			vertexScores[cache[i]] = detail::computeVertexScore(static_cast<int>(i), remainingValence[cache[i]]);
+		}
+
+		bestTriangle = std::numeric_limits<size_t>::max();
+		float bestScore = -1.f;
+		for (uint32_t vertex : cache)
+		{
+			for (uint32_t a = adjacencyOffsets[vertex]; a < adjacencyOffsets[vertex] + remainingValence[vertex]; a++)
+			{
+				uint32_t t = adjacency[a];
+				float score = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+				triangleScores[t] = score;
+				if (score > bestScore)
+				{
+					bestScore = score;
+					bestTriangle = t;
+				}
+			}
+		}
+	}
+
+	mesh_data.indices = std::move(output);
+}
+
+void MeshOptimizer::optimizeVertexFetch(MeshData& mesh_data)
+{
+	std::vector<uint32_t> remap(mesh_data.vertices.size(), std::numeric_limits<uint32_t>::max());
+	std::vector<Vertex> vertices;
+	vertices.reserve(mesh_data.vertices.size());
+
+	for (uint32_t& index : mesh_data.indices)
+	{
+		if (std::numeric_limits<uint32_t>::max() == remap[index])
+		{
+			remap[index] = static_cast<uint32_t>(vertices.size());
+			vertices.push_back(mesh_data.vertices[index]);
+		}
+		index = remap[index];
+	}
+
+	// (unreferenced vertices are dropped)
+	mesh_data.vertices = std::move(vertices);
+}
+
+float MeshOptimizer::computeAcmr(const MeshData& mesh_data, uint32_t cache_size)
+{
+	if (mesh_data.indices.empty())
+		return 0.f;
+
+	std::vector<uint32_t> cacheTimestamps(mesh_data.vertices.size(), 0);
+	uint32_t time = cache_size + 1;
+	size_t misses = 0;
+	for (uint32_t index : mesh_data.indices)
+	{
+		if (time - cacheTimestamps[index] > cache_size)
+		{
+			cacheTimestamps[index] = time++;
+			misses++;
+		}
+	}
+	return static_cast<float>(misses) / (mesh_data.indices.size() / 3);
+}
+
+glm::vec4 MeshOptimizer::computeBoundingSphere(const MeshData& mesh_data)
+{
+	if (mesh_data.vertices.empty())
+		return glm::vec4(0.f);
+
+	// Use the center of the bounding box and the farthest vertex from it
+	glm::vec3 minPos = mesh_data.vertices[0].pos;
+	glm::vec3 maxPos = mesh_data.vertices[0].pos;
+	for (const Vertex& vertex : mesh_data.vertices)
+	{
+		minPos = glm::min(minPos, vertex.pos);
+		maxPos = glm::max(maxPos, vertex.pos);
+	}
+
+	glm::vec3 center = (minPos + maxPos) * 0.5f;
+	float radius = 0.f;
+	for (const Vertex& vertex : mesh_data.vertices)
+	{
+		radius = glm::max(radius, glm::length(vertex.pos - center));
+	}
+
+	return glm::vec4(center, radius);
+}
@@ -0,0 +1,18 @@
+﻿#pragma once
+#include "MeshImporter.h"
+
+/**
+ * Offline reordering of indexed triangle lists for the GPU caches :
+ *  - triangles are reordered for the post-transform vertex cache (Forsyth's linear-speed algorithm)
+ *  - vertices are then renumbered in the order the triangles first use them, for vertex fetch locality
+ */
+struct MeshOptimizer
+{
+	static void optimizeVertexCache(MeshData& mesh_data);
+	static void optimizeVertexFetch(MeshData& mesh_data);
+
+	// Average cache misses per triangle for a FIFO cache of the given size (1.0 is a typical unoptimized mesh, 0.5 is ideal)
+	static float computeAcmr(const MeshData& mesh_data, uint32_t cache_size = 16);
+
+	static glm::vec4 computeBoundingSphere(const MeshData& mesh_data);
+};
@@ -0,0 +1,138 @@
+﻿#include "ObjLoader.h"
+
+#include <cstdlib>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace detail
+{
+	static const char* skipSpaces(const char* ptr, const char* end)
+	{
+		while (ptr < end && (' ' == *ptr || '\t' == *ptr))
+			ptr++;
+		return ptr;
+	}
+
+	static bool readFloats(const char* ptr, const char* end, float* values, int count)
+	{
+		std::string line(ptr, end); // (strtof needs a terminated string)
+		const char* cursor = line.c_str();
+		for (int i = 0; i < count; i++)
+		{
+			char* next;
+			values[i] = std::strtof(cursor, &next);
+			if (next == cursor)
+				return false;
+			cursor = next;
+		}
+		return true;
+	}
+
+	// OBJ indices are 1-based, negative ones are relative to the end of the list
+	static bool resolveIndex(long index, size_t count, uint32_t& resolved)
+	{
+		long value = index < 0 ? static_cast<long>(count) + index : index - 1;
+		if (value < 0 || static_cast<size_t>(value) >= count)
+			return false;
+		resolved = static_cast<uint32_t>(value);
+		return true;
+	}
+}
+
+bool ObjLoader::load(const char* text, size_t size, MeshData& mesh_data)
+{
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec2> uvs;
+	std::unordered_map<uint64_t, uint32_t> vertexIndices; // (position, uv + 1) -> vertex
+	std::vector<uint32_t> face;
+
+	mesh_data.vertices.clear();
+	mesh_data.indices.clear();
+
+	const char* end = text + size;
+	for (const char* line = text; line < end; )
+	{
+		const char* lineEnd = line;
+		while (lineEnd < end && '\n' != *lineEnd)
+			lineEnd++;
+
+		const char* ptr = detail::skipSpaces(line, lineEnd);
+		if (lineEnd - ptr > 2 && 'v' == ptr[0] && ' ' == ptr[1])
+		{
+			glm::vec3 position;
+			if (!detail::readFloats(ptr + 2, lineEnd, &position.x, 3))
+				return false;
+			positions.push_back(position);
+		}
+		else if (lineEnd - ptr > 3 && 'v' == ptr[0] && 't' == ptr[1] && ' ' == ptr[2])
+		{
+			glm::vec2 uv;
+			if (!detail::readFloats(ptr + 3, lineEnd, &uv.x, 2))
+				return false;
+			uvs.push_back(glm::vec2(uv.x, 1.f - uv.y)); // (OBJ has v pointing up, images are stored top-down)
+		}
+		else if (lineEnd - ptr > 2 && 'f' == ptr[0] && ' ' == ptr[1])
+		{
+			// Corners are v, v/vt, v//vn or v/vt/vn
+			face.clear();
+			std::string corners(ptr + 2, lineEnd);
+			const char* cursor = corners.c_str();
+			for (;;)
+			{
+				char* next;
+				long positionIndex = std::strtol(cursor, &next, 10);
+				if (next == cursor)
+					break;
+				cursor = next;
+
+				long uvIndex = 0;
+				if ('/' == *cursor)
+				{
+					cursor++;
+					if ('/' != *cursor)
+					{
+						uvIndex = std::strtol(cursor, &next, 10);
+						cursor = next;
+					}
+					if ('/' == *cursor)
+					{
+						std::strtol(cursor + 1, &next, 10); // (normals are not used by the vertex layout)
+						cursor = next;
+					}
+				}
+
+				uint32_t position, uv = 0;
+				if (!detail::resolveIndex(positionIndex, positions.size(), position))
+					return false;
+				if (0 != uvIndex && !detail::resolveIndex(uvIndex, uvs.size(), uv))
+					return false;
+
+				uint64_t key = (uint64_t(position) << 32) | (0 != uvIndex ? uv + 1 : 0);
+				auto inserted = vertexIndices.emplace(key, static_cast<uint32_t>(mesh_data.vertices.size()));
+				if (inserted.second)
+				{
+					Vertex vertex{};
+					vertex.pos = positions[position];
+					vertex.color = glm::vec3(1.f);
+					vertex.uv = 0 != uvIndex ? uvs[uv] : glm::vec2(0.f);
+					mesh_data.vertices.push_back(vertex);
+				}
+				face.push_back(inserted.first->second);
+			}
+
+			if (face.size() < 3)
+				return false;
+			for (size_t i = 1; i + 1 < face.size(); i++)
+			{
+				mesh_data.indices.push_back(face[0]);
+				mesh_data.indices.push_back(face[i]);
+				mesh_data.indices.push_back(face[i + 1]);
+			}
+		}
+
+		line = lineEnd + 1;
+	}
+
+	return !mesh_data.indices.empty();
+}
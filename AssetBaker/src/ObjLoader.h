@@ -0,0 +1,15 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+
+#include "MeshImporter.h"
+
+/**
+ * Wavefront OBJ geometry (v / vt / f, every object and group merged into one mesh).
+ * Faces are fan-triangulated and every distinct position/uv pair becomes one vertex.
+ */
+struct ObjLoader
+{
+	// Returns false on malformed input (out of range indices, faces with less than 3 corners)
+	static bool load(const char* text, size_t size, MeshData& mesh_data);
+};
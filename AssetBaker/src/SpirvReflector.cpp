@@ -0,0 +1,356 @@
+﻿#include "SpirvReflector.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+namespace detail
+{
+	static constexpr uint32_t s_SpirvMagic = 0x07230203;
+
+	// Opcodes, decorations and enumerants from the SPIR-V specification
+	enum SpirvOp : uint32_t
+	{
+		OpEntryPoint = 15,
+		OpExecutionMode = 16,
+		OpTypeInt = 21,
+		OpTypeFloat = 22,
+		OpTypeVector = 23,
+		OpTypeMatrix = 24,
+		OpTypeImage = 25,
+		OpTypeSampler = 26,
+		OpTypeSampledImage = 27,
+		OpTypeArray = 28,
+		OpTypeRuntimeArray = 29,
+		OpTypeStruct = 30,
+		OpTypePointer = 32,
+		OpConstant = 43,
+		OpVariable = 59,
+		OpDecorate = 71,
+		OpMemberDecorate = 72,
+	};
+
+	enum SpirvDecoration : uint32_t
+	{
+		DecorationBlock = 2,
+		DecorationBufferBlock = 3,
+		DecorationArrayStride = 6,
+		DecorationMatrixStride = 7,
+		DecorationBinding = 33,
+		DecorationDescriptorSet = 34,
+		DecorationOffset = 35,
+	};
+
+	enum SpirvStorageClass : uint32_t
+	{
+		StorageClassUniformConstant = 0,
+		StorageClassUniform = 2,
+		StorageClassPushConstant = 9,
+		StorageClassStorageBuffer = 12,
+	};
+
+	static constexpr uint32_t s_ExecutionModeLocalSize = 17;
+	static constexpr uint32_t s_DimBuffer = 5;
+
+	// Operands (result id included) that the decoded fields of an instruction need
+	static uint32_t getMinOperandCount(uint32_t opcode)
+	{
+		switch (opcode)
+		{
+		case OpTypeImage: return 7;
+		case OpTypeInt:
+		case OpTypeVector:
+		case OpTypeMatrix:
+		case OpTypeArray:
+		case OpTypePointer:
+		case OpConstant:
+		case OpVariable:
+		case OpMemberDecorate: return 3;
+		case OpDecorate:
+		case OpExecutionMode: return 2;
+		case OpTypeFloat:
+		case OpTypeSampledImage:
+		case OpTypeRuntimeArray: return 2;
+		default: return 1;
+		}
+	}
+
+	struct SpirvId
+	{
+		uint32_t opcode = 0;
+		std::vector<uint32_t> operands; // operands of the declaring instruction, result id excluded
+
+		// Decorations
+		uint32_t set = 0, binding = 0;
+		bool hasBinding = false;
+		bool isBlock = false, isBufferBlock = false;
+		uint32_t arrayStride = 0;
+		std::vector<uint32_t> memberOffsets;
+		std::vector<uint32_t> memberMatrixStrides;
+	};
+
+	using SpirvIds = std::unordered_map<uint32_t, SpirvId>;
+
+	static uint32_t getConstant(const SpirvIds& ids, uint32_t constant_id)
+	{
+		// operands : result type, result id, value (low word)
+		auto it = ids.find(constant_id);
+		return ids.end() == it || OpConstant != it->second.opcode || it->second.operands.size() < 3 ? 0 : it->second.operands[2];
+	}
+
+	static uint32_t getTypeSize(const SpirvIds& ids, uint32_t type_id, uint32_t matrix_stride = 0);
+
+	static uint32_t getStructSize(const SpirvIds& ids, const SpirvId& type)
+	{
+		// Up to the end of the member placed last
+		uint32_t size = 0;
+		for (size_t member = 0; member < type.operands.size(); member++)
+		{
+			uint32_t offset = member < type.memberOffsets.size() ? type.memberOffsets[member] : 0;
+			uint32_t matrixStride = member < type.memberMatrixStrides.size() ? type.memberMatrixStrides[member] : 0;
+			size = std::max(size, offset + getTypeSize(ids, type.operands[member], matrixStride));
+		}
+		return size;
+	}
+
+	static uint32_t getTypeSize(const SpirvIds& ids, uint32_t type_id, uint32_t matrix_stride)
+	{
+		auto it = ids.find(type_id);
+		if (ids.end() == it)
+			return 0;
+
+		const SpirvId& type = it->second;
+		switch (type.opcode)
+		{
+		case OpTypeInt:
+		case OpTypeFloat:
+			return type.operands[0] / 8;
+		case OpTypeVector:
+			return type.operands[1] * getTypeSize(ids, type.operands[0]);
+		case OpTypeMatrix:
+			return type.operands[1] * (matrix_stride ? matrix_stride : getTypeSize(ids, type.operands[0]));
+		case OpTypeArray:
+			return getConstant(ids, type.operands[1]) * (type.arrayStride ? type.arrayStride : getTypeSize(ids, type.operands[0]));
+		case OpTypeStruct:
+			return getStructSize(ids, type);
+		default:
+			return 0; // (runtime arrays have no static size)
+		}
+	}
+
+	static bool getDescriptorType(const SpirvIds& ids, uint32_t storage_class, uint32_t type_id, VkDescriptorType& descriptor_type)
+	{
+		auto it = ids.find(type_id);
+		if (ids.end() == it)
+			return false;
+		const SpirvId& type = it->second;
+
+		switch (storage_class)
+		{
+		case StorageClassUniform:
+			descriptor_type = type.isBufferBlock ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+			return true;
+		case StorageClassStorageBuffer:
+			descriptor_type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			return true;
+		case StorageClassUniformConstant:
+			switch (type.opcode)
+			{
+			case OpTypeSampler:
+				descriptor_type = VK_DESCRIPTOR_TYPE_SAMPLER;
+				return true;
+			case OpTypeSampledImage:
+				descriptor_type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+				return true;
+			case OpTypeImage:
+			{
+				// operands : sampled type, dim, depth, arrayed, multisampled, sampled (1 : with a sampler, 2 : storage)
+				bool isStorage = 2 == type.operands[5];
+				if (s_DimBuffer == type.operands[1])
+				{
+					descriptor_type = isStorage ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+				}
+				else
+				{
+					descriptor_type = isStorage ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+				}
+				return true;
+			}
+			default:
+				return false;
+			}
+		default:
+			return false;
+		}
+	}
+}
+
+bool SpirvReflector::reflect(const std::vector<uint32_t>& code, CookedShader& shader)
+{
+	if (code.size() < 5 || detail::s_SpirvMagic != code[0])
+		return false;
+
+	detail::SpirvIds ids;
+	std::vector<uint32_t> variables;
+	bool hasEntryPoint = false;
+
+	// Gather the declarations and decorations (header : magic, version, generator, bound, schema)
+	for (size_t position = 5; position < code.size(); )
+	{
+		uint32_t wordCount = code[position] >> 16;
+		uint32_t opcode = code[position] & 0xFFFF;
+		if (0 == wordCount || position + wordCount > code.size())
+			return false;
+		const uint32_t* operands = &code[position + 1];
+		uint32_t operandCount = wordCount - 1;
+		if (operandCount < detail::getMinOperandCount(opcode))
+			return false;
+
+		switch (opcode)
+		{
+		case detail::OpEntryPoint:
+			if (!hasEntryPoint)
+			{
+				switch (operands[0])
+				{
+				case 0: shader.stage = VK_SHADER_STAGE_VERTEX_BIT; break;
+				case 4: shader.stage = VK_SHADER_STAGE_FRAGMENT_BIT; break;
+				case 5: shader.stage = VK_SHADER_STAGE_COMPUTE_BIT; break;
+				default: return false;
+				}
+				hasEntryPoint = true;
+			}
+			break;
+		case detail::OpExecutionMode:
+			if (operandCount >= 5 && detail::s_ExecutionModeLocalSize == operands[1])
+			{
+				shader.localSize[0] = operands[2];
+				shader.localSize[1] = operands[3];
+				shader.localSize[2] = operands[4];
+			}
+			break;
+		case detail::OpTypeInt:
+		case detail::OpTypeFloat:
+		case detail::OpTypeVector:
+		case detail::OpTypeMatrix:
+		case detail::OpTypeImage:
+		case detail::OpTypeSampler:
+		case detail::OpTypeSampledImage:
+		case detail::OpTypeArray:
+		case detail::OpTypeRuntimeArray:
+		case detail::OpTypeStruct:
+		case detail::OpTypePointer:
+		{
+			detail::SpirvId& id = ids[operands[0]];
+			id.opcode = opcode;
+			id.operands.assign(operands + 1, operands + operandCount);
+			break;
+		}
+		case detail::OpConstant:
+		case detail::OpVariable:
+		{
+			// (result type first, then the result id)
+			detail::SpirvId& id = ids[operands[1]];
+			id.opcode = opcode;
+			id.operands.assign(operands, operands + operandCount);
+			if (detail::OpVariable == opcode)
+			{
+				variables.push_back(operands[1]);
+			}
+			break;
+		}
+		case detail::OpDecorate:
+		{
+			if (operandCount < 3 && detail::DecorationBlock != operands[1] && detail::DecorationBufferBlock != operands[1])
+				break;
+			detail::SpirvId& id = ids[operands[0]];
+			switch (operands[1])
+			{
+			case detail::DecorationBlock: id.isBlock = true; break;
+			case detail::DecorationBufferBlock: id.isBufferBlock = true; break;
+			case detail::DecorationArrayStride: id.arrayStride = operands[2]; break;
+			case detail::DecorationBinding: id.binding = operands[2]; id.hasBinding = true; break;
+			case detail::DecorationDescriptorSet: id.set = operands[2]; break;
+			default: break;
+			}
+			break;
+		}
+		case detail::OpMemberDecorate:
+		{
+			if (operandCount < 4)
+				break;
+			detail::SpirvId& id = ids[operands[0]];
+			uint32_t member = operands[1];
+			if (detail::DecorationOffset == operands[2])
+			{
+				id.memberOffsets.resize(std::max<size_t>(id.memberOffsets.size(), member + 1), 0);
+				id.memberOffsets[member] = operands[3];
+			}
+			else if (detail::DecorationMatrixStride == operands[2])
+			{
+				id.memberMatrixStrides.resize(std::max<size_t>(id.memberMatrixStrides.size(), member + 1), 0);
+				id.memberMatrixStrides[member] = operands[3];
+			}
+			break;
+		}
+		default:
+			break;
+		}
+
+		position += wordCount;
+	}
+
+	if (!hasEntryPoint)
+		return false;
+
+	// Resolve the interface variables
+	shader.bindings.clear();
+	shader.pushConstantSize = 0;
+	for (uint32_t variableId : variables)
+	{
+		const detail::SpirvId& variable = ids[variableId];
+		uint32_t storageClass = variable.operands[2];
+
+		// Variables are declared through a pointer type
+		const detail::SpirvId& pointer = ids[variable.operands[0]];
+		if (detail::OpTypePointer != pointer.opcode || pointer.operands.size() < 2)
+			continue;
+		uint32_t typeId = pointer.operands[1];
+
+		if (detail::StorageClassPushConstant == storageClass)
+		{
+			shader.pushConstantSize = std::max(shader.pushConstantSize, detail::getTypeSize(ids, typeId));
+			continue;
+		}
+		if (!variable.hasBinding)
+			continue;
+
+		// Arrays of descriptors
+		uint32_t descriptorCount = 1;
+		const detail::SpirvId& type = ids[typeId];
+		if (detail::OpTypeArray == type.opcode)
+		{
+			descriptorCount = detail::getConstant(ids, type.operands[1]);
+			typeId = type.operands[0];
+		}
+		else if (detail::OpTypeRuntimeArray == type.opcode)
+		{
+			descriptorCount = 0;
+			typeId = type.operands[0];
+		}
+
+		CookedShaderBinding binding{};
+		binding.set = variable.set;
+		binding.binding = variable.binding;
+		binding.descriptorCount = descriptorCount;
+		if (detail::getDescriptorType(ids, storageClass, typeId, binding.descriptorType))
+		{
+			shader.bindings.push_back(binding);
+		}
+	}
+
+	std::sort(shader.bindings.begin(), shader.bindings.end(), [](const CookedShaderBinding& a, const CookedShaderBinding& b)
+	{
+		return a.set != b.set ? a.set < b.set : a.binding < b.binding;
+	});
+	return true;
+}
@@ -0,0 +1,15 @@
+﻿#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "CookedShader.h"
+
+/**
+ * Minimal SPIR-V reflection : stage, compute local size, descriptor bindings and push constant block size.
+ * Only the instructions needed for that are decoded, the rest of the module is skipped.
+ */
+struct SpirvReflector
+{
+	// Fills everything but the code of the shader, returns false if the module is not valid SPIR-V
+	static bool reflect(const std::vector<uint32_t>& code, CookedShader& shader);
+};
@@ -0,0 +1,81 @@
+﻿#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include "AssetBaker.h"
+
+static void printUsage()
+{
+	(void)fprintf(stderr,
+		"Usage : AssetBaker [options] [input directories...]\n"
+		"  --root <dir>          directory the archive entries are named relative to (default .)\n"
+		"  --output <file>       archive to write (default assets.vtpk)\n"
+		"  --intermediate <dir>  cooked files and bake database (default baked)\n"
+		"  --glslc <path>        shader compiler (default from VK_SDK_PATH)\n"
+		"  --threads <count>     worker threads (default one per hardware thread)\n"
+		"  --no-compress         store the entries uncompressed\n"
+		"  --force               rebake every asset\n");
+}
+
+int main(int argc, char** argv)
+{
+	AssetBakerOptions options;
+	if (const char* sdkPath = std::getenv("VK_SDK_PATH"))
+	{
+#ifdef _WIN32
+		options.glslc = std::string(sdkPath) + "\\Bin\\glslc.exe";
+#else
+		options.glslc = std::string(sdkPath) + "/bin/glslc";
+#endif
+	}
+
+	for (int i = 1; i < argc; i++)
+	{
+		const char* argument = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if (0 == strcmp(argument, "--root") && hasValue)
+			options.rootDirectory = argv[++i];
+		else if (0 == strcmp(argument, "--output") && hasValue)
+			options.outputFile = argv[++i];
+		else if (0 == strcmp(argument, "--intermediate") && hasValue)
+			options.intermediateDirectory = argv[++i];
+		else if (0 == strcmp(argument, "--glslc") && hasValue)
+			options.glslc = argv[++i];
+		else if (0 == strcmp(argument, "--threads") && hasValue)
+			options.threadCount = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+		else if (0 == strcmp(argument, "--no-compress"))
+			options.compress = false;
+		else if (0 == strcmp(argument, "--force"))
+			options.force = true;
+		else if ('-' != argument[0])
+			options.inputDirectories.push_back(argument);
+		else
+		{
+			printUsage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	AssetBaker baker;
+	bool succeeded = false;
+	try {
+		succeeded = baker.bake(options);
+	} catch (const std::exception& e)
+	{
+		(void)fprintf(stderr, "Exception : %s\n", e.what());
+		return EXIT_FAILURE;
+	}
+
+	const AssetBakerStats& stats = baker.getStats();
+	(void)printf("%u baked, %u up to date, %u failed in %.1f ms\n", stats.baked, stats.upToDate, stats.failed, stats.milliseconds);
+	if (!succeeded)
+	{
+		(void)fprintf(stderr, "Archive not written : some assets failed to bake\n");
+		return EXIT_FAILURE;
+	}
+	(void)printf("Wrote %s\n", options.outputFile.c_str());
+	return 0;
+}
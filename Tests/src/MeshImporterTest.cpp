@@ -0,0 +1,110 @@
+﻿#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include "MeshImporter.h"
+
+namespace detail
+{
+	static uint32_t s_Failures = 0;
+
+	static void check(bool condition, const char* what)
+	{
+		if (!condition)
+		{
+			printf("[FAIL] %s\n", what);
+			s_Failures++;
+		}
+	}
+
+	static bool isSameVertex(const Vertex& a, const Vertex& b)
+	{
+		return 0 == std::memcmp(&a, &b, sizeof(Vertex));
+	}
+
+	// Grid of size x size vertices, every vertex unique (its position encodes its index)
+	static MeshData createGrid(uint32_t size)
+	{
+		MeshData grid{};
+		for (uint32_t y = 0; y < size; y++)
+		{
+			for (uint32_t x = 0; x < size; x++)
+			{
+				Vertex vertex{};
+				vertex.pos = { float(x), float(y), 0.0f };
+				vertex.uv = { float(x) / float(size - 1), float(y) / float(size - 1) };
+				grid.vertices.push_back(vertex);
+			}
+		}
+
+		for (uint32_t y = 0; y + 1 < size; y++)
+		{
+			for (uint32_t x = 0; x + 1 < size; x++)
+			{
+				uint32_t corner = y * size + x;
+				grid.indices.insert(grid.indices.end(), { corner, corner + 1, corner + size, corner + 1, corner + size + 1, corner + size });
+			}
+		}
+
+		// Shuffle the triangles (fixed seed) so that the chunks gather vertices from all over the grid
+		uint32_t state = 12345;
+		size_t triangleCount = grid.indices.size() / 3;
+		for (size_t i = triangleCount - 1; i > 0; i--)
+		{
+			state = state * 1664525u + 1013904223u;
+			size_t j = state % (i + 1);
+			for (size_t corner = 0; corner < 3; corner++)
+			{
+				std::swap(grid.indices[i * 3 + corner], grid.indices[j * 3 + corner]);
+			}
+		}
+		return grid;
+	}
+}
+
+// A mesh with more than 65535 vertices must split into 16-bit addressable chunks which keep every triangle, in order
+static void testSplitTo16Bit()
+{
+	MeshData mesh = detail::createGrid(300); // (90000 vertices, 178802 triangles)
+	std::vector<MeshData> chunks = MeshImporter::splitTo16Bit(mesh);
+	detail::check(chunks.size() > 1, "splitTo16Bit: a mesh with more than 65536 vertices is split");
+
+	size_t sourceIndex = 0;
+	bool indicesFit = true;
+	bool trianglesMatch = true;
+	for (const MeshData& chunk : chunks)
+	{
+		detail::check(!chunk.indices.empty() && 0 == chunk.indices.size() % 3, "splitTo16Bit: chunks hold whole triangles");
+		detail::check(chunk.vertices.size() <= 65536, "splitTo16Bit: chunks address at most 65536 vertices");
+
+		for (uint32_t index : chunk.indices)
+		{
+			indicesFit = indicesFit && index <= 0xFFFF && index < chunk.vertices.size();
+			if (!indicesFit || sourceIndex >= mesh.indices.size())
+			{
+				trianglesMatch = false;
+				break;
+			}
+			trianglesMatch = trianglesMatch && detail::isSameVertex(chunk.vertices[index], mesh.vertices[mesh.indices[sourceIndex]]);
+			sourceIndex++;
+		}
+	}
+	detail::check(indicesFit, "splitTo16Bit: every index fits in 16 bits");
+	detail::check(trianglesMatch && sourceIndex == mesh.indices.size(), "splitTo16Bit: the remapped triangles match the input");
+
+}
+
+int main()
+{
+	testSplitTo16Bit();
+
+	if (0 != detail::s_Failures)
+	{
+		printf("%u check(s) failed\n", detail::s_Failures);
+		return 1;
+	}
+	printf("All tests passed\n");
+	return 0;
+}
@@ -0,0 +1,19 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+layout (location = 0) in vec3 fragColor;
+
+layout (location = 0) out vec4 outColor;
+
+#include "texture_sampling.glsl"
+
+const float ALPHA_CUTOFF = 0.5;
+
+void main()
+{
+	vec4 color = sampleTexture();
+	if (color.a < ALPHA_CUTOFF)
+		discard;
+
+	outColor = vec4(color.rgb, 1.0);
+}
\ No newline at end of file
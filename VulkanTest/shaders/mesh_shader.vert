@@ -6,6 +6,10 @@ layout (location = 2) in vec2 inUV;
 
 layout (location = 0) out vec3 fragColor;
 layout (location = 1) out vec2 fragUV;
+layout (location = 2) flat out int fragAtlasLayer; // -1 - n : streamed texture slot n (-1 : scene texture)
+
+// The depth pre-pass and the equal-tested shading pass must produce bit-identical depths
+invariant gl_Position;
 
 layout (std140, binding = 0) uniform Matrices {
 	mat4 model;
@@ -13,10 +17,43 @@ layout (std140, binding = 0) uniform Matrices {
 	mat4 proj;
 } ubo;
 
+struct ObjectData
+{
+	mat4 model;
+	vec4 boundingSphere;
+	uvec4 mesh; // x : first index, y : index count, z : vertex offset, w : atlas region + 1 (0 : scene texture)
+};
+
+layout (std430, binding = 2) readonly buffer Objects {
+	ObjectData objects[];
+};
+
+struct AtlasRegion
+{
+	vec4 uvScaleOffset;
+	uvec4 layer; // x : layer (~slot for a texture streamed on its own)
+};
+
+layout (std430, binding = 3) readonly buffer AtlasRegions {
+	AtlasRegion atlasRegions[];
+};
+
 void main()
 {
-	gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 1.0);
+	// The indirect draw commands store the object index in firstInstance
+	mat4 model = ubo.model * objects[gl_InstanceIndex].model;
+	gl_Position = ubo.proj * ubo.view * model * vec4(inPosition, 1.0);
 	
 	fragColor = inColor;
 	fragUV = inUV;
+	fragAtlasLayer = -1;
+
+	// Atlased textures : move the UVs to the texture's region of its layer (the whole texture of a streamed slot)
+	uint atlasRegion = objects[gl_InstanceIndex].mesh.w;
+	if (0 != atlasRegion)
+	{
+		AtlasRegion region = atlasRegions[atlasRegion - 1];
+		fragUV = inUV * region.uvScaleOffset.xy + region.uvScaleOffset.zw;
+		fragAtlasLayer = int(region.layer.x);
+	}
 }
@@ -1,13 +1,13 @@
 #version 450
+#extension GL_GOOGLE_include_directive : require
 
 layout (location = 0) in vec3 fragColor;
-layout (location = 1) in vec2 fragUV;
 
 layout (location = 0) out vec4 outColor;
 
-layout (binding = 1) uniform sampler2D texQuad;
+#include "texture_sampling.glsl"
 
 void main()
 {
-	outColor = texture(texQuad, fragUV);
+	outColor = sampleTexture();
 }
\ No newline at end of file
@@ -0,0 +1,31 @@
+// Texturing shared by the scene fragment shaders : a streamed texture, or the region of an atlas layer
+
+layout (location = 1) in vec2 fragUV;
+layout (location = 2) flat in int fragAtlasLayer; // -1 - n : streamed texture slot n (0 : scene texture)
+
+// (STREAMED_TEXTURE_SLOTS in BufferData.h)
+const int STREAMED_TEXTURE_SLOTS = 15;
+
+layout (binding = 1) uniform sampler2D texStreamed[STREAMED_TEXTURE_SLOTS];
+layout (binding = 4) uniform sampler2DArray texAtlas;
+
+vec4 sampleStreamed(int slot)
+{
+	// The slot may change between the draws of one indirect command, so it is not dynamically uniform :
+	// the array is only indexed by the loop counter, the matching sampler is the one sampled
+	vec4 color = vec4(0.0);
+	for (int i = 0; i < STREAMED_TEXTURE_SLOTS; i++)
+	{
+		if (i == slot)
+			color = texture(texStreamed[i], fragUV);
+	}
+	return color;
+}
+
+vec4 sampleTexture()
+{
+	// (the layer is flat : every fragment of a primitive takes the same path, derivatives stay valid)
+	if (fragAtlasLayer < 0)
+		return sampleStreamed(-1 - fragAtlasLayer);
+	return texture(texAtlas, vec3(fragUV, fragAtlasLayer));
+}
\ No newline at end of file
@@ -0,0 +1,16 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+layout (location = 0) in vec3 fragColor;
+
+layout (location = 0) out vec4 outColor;
+
+#include "texture_sampling.glsl"
+
+const float OPACITY = 0.5;
+
+void main()
+{
+	vec4 color = sampleTexture();
+	outColor = vec4(color.rgb, color.a * OPACITY);
+}
\ No newline at end of file
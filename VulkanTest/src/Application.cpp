@@ -1,5 +1,12 @@
 ﻿#include "Application.h"
+#include <algorithm>
+#include <chrono>
 #include <cstdio>
+#include <memory>
+#include <stdexcept>
+
+#include "Profiler.h"
+#include "VulkanHostAllocator.h"
 
 namespace
 {
@@ -9,6 +16,11 @@ namespace
 
 namespace detail {
 	static void framebufferResizeCallback(GLFWwindow *window, int width, int height);
+	static void keyCallback(GLFWwindow *window, int key, int scancode, int action, int mods);
+	static void printGpuScopeTimings(const VulkanContext& context);
+	static void printPipelineStatistics(const VulkanContext& context);
+	static void accumulatePipelineStatistics(const VulkanContext& context, BenchmarkResults& results);
+	static uint64_t getHostAllocationCount(const VulkanHostAllocationStats& stats);
 }
 
 Application::Application(int width, int height, const char* name)
@@ -18,9 +30,72 @@ Application::Application(int width, int height, const char* name)
 
 void Application::run()
 {
-	m_VulkanContext.initContext(m_AppName, m_Window);
-	mainLoop();
+	PROFILE_THREAD("Main");
+
+	// (the suite creates a context per scene)
+	if (!m_RegressionBaseline.empty())
+	{
+		runRegression();
+		if (!m_TraceFile.empty() && Profiler::writeChromeTrace(m_TraceFile))
+		{
+			printf("Trace written to %s\n", m_TraceFile.c_str());
+		}
+		return;
+	}
+
+	if (m_Benchmark)
+	{
+		VulkanSceneSettings sceneSettings{};
+		sceneSettings.objectCount = m_BenchmarkSettings.objectCount;
+		sceneSettings.textureCount = m_BenchmarkSettings.textureCount;
+		sceneSettings.framesInFlight = m_BenchmarkSettings.framesInFlight;
+		sceneSettings.fixedTimeStep = m_BenchmarkSettings.timeStep;
+		m_VulkanContext.setSceneSettings(sceneSettings);
+		m_VulkanContext.setReplay(m_ReplayFile.empty() ? nullptr : &m_Replay);
+		m_VulkanContext.initHeadlessContext(m_AppName, { m_BenchmarkSettings.width, m_BenchmarkSettings.height });
+		m_VulkanContext.setPipelineStatisticsEnabled(m_BenchmarkSettings.pipelineStatistics);
+		if (!m_ReplayFile.empty())
+		{
+			printf("Replay of %s (%zu frames)\n", m_ReplayFile.c_str(), m_Replay.frames.size());
+		}
+		printf("Benchmark on %s (%u x %u, %u objects, %u textures, %u frames in flight)\n", m_VulkanContext.getDeviceName(),
+		       m_BenchmarkSettings.width, m_BenchmarkSettings.height, m_BenchmarkSettings.objectCount, m_BenchmarkSettings.textureCount,
+		       m_BenchmarkSettings.framesInFlight);
+	}
+	else if (m_Headless)
+	{
+		m_VulkanContext.initHeadlessContext(m_AppName, { static_cast<uint32_t>(m_Width), static_cast<uint32_t>(m_Height) });
+		printf("Headless rendering on %s (%d x %d, %zu frames)\n", m_VulkanContext.getDeviceName(), m_Width, m_Height, m_HeadlessFrameCount);
+	}
+	else
+	{
+		m_VulkanContext.initContext(m_AppName, m_Window);
+	}
+
+	printf("Textures decoded on %u worker threads\n", m_VulkanContext.getWorkerThreadCount());
+	static const char* s_TextureLoadSources[] = { "decode", "cache read", "archive read" };
+	for (const TextureLoadTiming& timing : m_VulkanContext.getTextureLoadTimings())
+	{
+		printf("  %s : %s %.2lf ms, upload %.2lf ms\n", timing.file.c_str(), s_TextureLoadSources[static_cast<int>(timing.source)], timing.decodeMilliseconds, timing.uploadMilliseconds);
+	}
+	printf("Texture atlas : %u textures in %u layers (%u files too large, streamed on their own)\n",
+	       m_VulkanContext.getAtlasTextureCount(), m_VulkanContext.getAtlasLayerCount(), m_VulkanContext.getAtlasStreamedFileCount());
+
+	if (m_Benchmark)
+		runBenchmark();
+	else
+		mainLoop();
+
+	if (!m_TraceFile.empty() && Profiler::writeChromeTrace(m_TraceFile))
+	{
+		printf("Trace written to %s\n", m_TraceFile.c_str());
+	}
+	uint32_t capturedFrameCount = m_VulkanContext.getCapturedFrameCount();
 	shutdown();
+	if (!m_CaptureFile.empty())
+	{
+		printf("Capture written to %s (%u frames)\n", m_CaptureFile.c_str(), capturedFrameCount);
+	}
 }
 
 void Application::initWindow()
@@ -34,41 +109,241 @@ void Application::initWindow()
 	m_Window = glfwCreateWindow(m_Width, m_Height, m_AppName, nullptr, nullptr);
 	glfwSetWindowUserPointer(m_Window, &m_VulkanContext);
 	glfwSetFramebufferSizeCallback(m_Window, detail::framebufferResizeCallback);
+	glfwSetKeyCallback(m_Window, detail::keyCallback);
 }
 
-void Application::mainLoop()
+void Application::initHeadless(size_t frame_count)
+{
+	m_Headless = true;
+	m_HeadlessFrameCount = frame_count;
+}
+
+void Application::initBenchmark(const BenchmarkSettings& settings)
+{
+	m_Headless = true;
+	m_Benchmark = true;
+	m_BenchmarkSettings = settings;
+}
+
+void Application::initReplay(const std::string& capture_file, const BenchmarkSettings& settings)
+{
+	SceneCapture::load(capture_file, m_Replay);
+	if (m_Replay.frames.empty())
+	{
+		throw std::runtime_error("Capture file has no frames!");
+	}
+
+	initBenchmark(settings);
+	m_ReplayFile = capture_file;
+
+	// Every captured frame is measured once, at the size it was captured at
+	const SceneCaptureSettings& captureSettings = m_Replay.settings;
+	m_BenchmarkSettings.objectCount = captureSettings.objectCount;
+	m_BenchmarkSettings.textureCount = captureSettings.textureCount;
+	m_BenchmarkSettings.framesInFlight = captureSettings.framesInFlight;
+	m_BenchmarkSettings.width = captureSettings.width;
+	m_BenchmarkSettings.height = captureSettings.height;
+	m_BenchmarkSettings.measuredFrames = static_cast<uint32_t>(m_Replay.frames.size());
+}
+
+void Application::initRegression(const std::string& baseline_file, bool update_baseline, const BenchmarkSettings& settings)
+{
+	m_Headless = true;
+	m_BenchmarkSettings = settings;
+	m_RegressionBaseline = baseline_file;
+	m_UpdateBaseline = update_baseline;
+}
+
+void Application::runRegression()
+{
+	RegressionBaseline baseline{};
+	if (!PerfRegression::loadBaseline(m_RegressionBaseline, baseline) && !m_UpdateBaseline)
+	{
+		throw std::runtime_error("Failed to load regression baseline file (write it with --update-baseline on this machine)!");
+	}
+
+	RegressionBaseline measured{};
+	measured.tolerance = baseline.tolerance;
+	for (const RegressionScene& scene : PerfRegression::getScenes())
+	{
+		printf("Scene %s (%u objects, %u textures, %u subdivisions)\n", scene.name, scene.objectCount, scene.textureCount, scene.meshSubdivisions);
+		RegressionMetrics metrics = measureRegressionScene(scene);
+		measured.scenes.emplace_back(scene.name, metrics);
+
+		if (!m_UpdateBaseline && !PerfRegression::compare(scene.name, metrics, baseline))
+		{
+			m_Failed = true;
+		}
+	}
+
+	if (m_UpdateBaseline)
+	{
+		PerfRegression::writeBaseline(m_RegressionBaseline, measured);
+		printf("Baseline written to %s\n", m_RegressionBaseline.c_str());
+	}
+	else
+	{
+		printf("Regression suite %s (tolerance %.0lf%%)\n", m_Failed ? "FAILED" : "passed", 100.0 * baseline.tolerance);
+	}
+}
+
+RegressionMetrics Application::measureRegressionScene(const RegressionScene& scene) const
+{
+	VulkanSceneSettings sceneSettings{};
+	sceneSettings.objectCount = scene.objectCount;
+	sceneSettings.textureCount = scene.textureCount;
+	sceneSettings.framesInFlight = m_BenchmarkSettings.framesInFlight;
+	sceneSettings.fixedTimeStep = m_BenchmarkSettings.timeStep;
+	sceneSettings.meshSubdivisions = scene.meshSubdivisions;
+
+	// (a context per scene, so that no scene inherits the caches or the texture residency of the previous one)
+	std::unique_ptr<VulkanContext> context = std::make_unique<VulkanContext>();
+	context->setSceneSettings(sceneSettings);
+	context->setTextureBudget(scene.textureBudget);
+	context->initHeadlessContext(m_AppName, { m_BenchmarkSettings.width, m_BenchmarkSettings.height });
+
+	for (uint32_t frame = 0; frame < m_BenchmarkSettings.warmupFrames; frame++)
+	{
+		context->drawFrame();
+	}
+
+	// Only the time spent in drawFrame counts (the CPU time the metrics are relative to)
+	VulkanHostAllocationStats hostStats = VulkanHostAllocator::getStats();
+	VkDeviceSize uploadedBytes = context->getTextureStreamingStats().uploadedBytes;
+	double cpuSeconds = 0.0;
+	uint64_t drawnObjects = 0;
+	for (uint32_t frame = 0; frame < m_BenchmarkSettings.measuredFrames; frame++)
+	{
+		double start = getTime();
+		context->drawFrame();
+		cpuSeconds += getTime() - start;
+
+		// Objects the culling pass kept (read back from the frame that just completed, framesInFlight frames earlier)
+		const CullingStats& cullingStats = context->getCullingStats();
+		drawnObjects += cullingStats.drawnEarly + cullingStats.drawnLate;
+	}
+	uint64_t hostAllocations = detail::getHostAllocationCount(VulkanHostAllocator::getStats()) - detail::getHostAllocationCount(hostStats);
+	uploadedBytes = context->getTextureStreamingStats().uploadedBytes - uploadedBytes;
+
+	context->shutdownContext();
+
+	RegressionMetrics metrics{};
+	cpuSeconds = std::max(cpuSeconds, 1e-9);
+	metrics.drawsPerSecond = static_cast<double>(drawnObjects) / cpuSeconds;
+	metrics.uploadMBPerFrame = static_cast<double>(uploadedBytes) / (1024.0 * 1024.0) / m_BenchmarkSettings.measuredFrames;
+	metrics.allocationsPerFrame = static_cast<double>(hostAllocations) / m_BenchmarkSettings.measuredFrames;
+	return metrics;
+}
+
+void Application::runBenchmark()
 {
-	double previous = glfwGetTime();
-	double lastFrameTime = 0.0;
-	double lastLogTime = previous;
-	size_t numFramesTillLastLog = 0;
+	for (uint32_t frame = 0; frame < m_BenchmarkSettings.warmupFrames; frame++)
+	{
+		m_VulkanContext.drawFrame();
+	}
 
-	while (!glfwWindowShouldClose(m_Window))
+	// (the GPU time read after a frame is the one of the frame submitted framesInFlight frames earlier)
+	BenchmarkResults results{};
+	results.device = m_VulkanContext.getDeviceName();
+	results.cpuFrameTimes.reserve(m_BenchmarkSettings.measuredFrames);
+	VulkanHostAllocationStats hostStats = VulkanHostAllocator::getStats();
+	for (uint32_t frame = 0; frame < m_BenchmarkSettings.measuredFrames; frame++)
 	{
-		glfwPollEvents();
+		double start = getTime();
 		m_VulkanContext.drawFrame();
+		results.cpuFrameTimes.push_back((getTime() - start) * 1000.0);
+
+		if (m_VulkanContext.getGpuFrameTime() >= 0.0)
+		{
+			results.gpuFrameTimes.push_back(m_VulkanContext.getGpuFrameTime());
+		}
+		detail::accumulatePipelineStatistics(m_VulkanContext, results);
+	}
+	m_NumFramesRendered = m_BenchmarkSettings.warmupFrames + m_BenchmarkSettings.measuredFrames;
+	uint64_t hostAllocations = detail::getHostAllocationCount(VulkanHostAllocator::getStats()) - detail::getHostAllocationCount(hostStats);
+
+	Benchmark::writeJson(m_BenchmarkSettings.outputFile, m_BenchmarkSettings, results);
 
-		double now = glfwGetTime();
-		m_FrameTime = now - previous;
-		previous = now;
+	FrameTimeSummary cpuSummary = Benchmark::summarize(results.cpuFrameTimes);
+	FrameTimeSummary gpuSummary = Benchmark::summarize(results.gpuFrameTimes);
+	printf("CPU frame time (ms)       : mean %.3lf, p50 %.3lf, p99 %.3lf\n", cpuSummary.mean, cpuSummary.p50, cpuSummary.p99);
+	printf("GPU frame time (ms)       : mean %.3lf, p50 %.3lf, p99 %.3lf\n", gpuSummary.mean, gpuSummary.p50, gpuSummary.p99);
+	printf("Vulkan host allocations   : %.2lf per frame\n", static_cast<double>(hostAllocations) / m_BenchmarkSettings.measuredFrames);
+	printf("Likely bottleneck         : %s\n", Benchmark::guessBottleneck(results));
+	printf("Results written to %s\n", m_BenchmarkSettings.outputFile.c_str());
+}
+
+void Application::mainLoop()
+{
+	double lastLogTime = getTime();
+	VulkanHostAllocationStats lastHostStats = VulkanHostAllocator::getStats();
+
+	while (m_Headless ? m_NumFramesRendered < m_HeadlessFrameCount : !glfwWindowShouldClose(m_Window))
+	{
+		if (!m_Headless)
+		{
+			glfwPollEvents();
+		}
+		m_VulkanContext.drawFrame();
 
 		m_NumFramesRendered++;
-		
-		m_AverageFrameTime += 1.0 / static_cast<double>(m_NumFramesRendered) * (m_FrameTime - m_AverageFrameTime);
-		lastFrameTime = m_FrameTime;
 
-		double deltaLogTime = now - lastLogTime;
-		size_t numFramesSizeLastLog = m_NumFramesRendered - numFramesTillLastLog;
-		if (deltaLogTime > 1.0)
+		double now = getTime();
+		if (now - lastLogTime > 1.0)
 		{
-			printf("Frame Time (latest)       : %lf\n", m_FrameTime);
-			printf("Frame Time (running mean) : %lf\n", m_AverageFrameTime);
-			printf("# Frames (total)          : %lld\n", m_NumFramesRendered);
-			printf("# Frames (since last log) : %lld\n", numFramesSizeLastLog);
-			printf("Frames per second         : %lf\n", static_cast<double>(numFramesSizeLastLog) / deltaLogTime);
+			m_VulkanContext.getFrameStatistics().dump(false);
+			detail::printGpuScopeTimings(m_VulkanContext);
+			detail::printPipelineStatistics(m_VulkanContext);
+
+			const CullingStats& cullingStats = m_VulkanContext.getCullingStats();
+			printf("# Objects (total)         : %u\n", m_VulkanContext.getSceneObjectCount());
+			printf("# Objects drawn (early)   : %u\n", cullingStats.drawnEarly);
+			printf("# Objects drawn (late)    : %u\n", cullingStats.drawnLate);
+			printf("# Objects frustum culled  : %u\n", cullingStats.frustumCulled);
+			printf("# Objects occluded        : %u\n", cullingStats.occlusionCulled);
+			const VulkanBindStats& bindStats = m_VulkanContext.getBindStats();
+			printf("# Binds issued            : %u\n", bindStats.getIssued());
+			printf("# Binds elided            : %u\n", bindStats.getElided());
+			const VulkanStreamingStats& streamingStats = m_VulkanContext.getTextureStreamingStats();
+			printf("Texture memory (resident) : %.1lf / %.1lf MiB\n", streamingStats.residentBytes / (1024.0 * 1024.0), streamingStats.budgetBytes / (1024.0 * 1024.0));
+			printf("# Mip levels streamed in  : %u\n", streamingStats.streamedInLevels);
+			printf("# Mip levels evicted      : %u\n", streamingStats.evictedLevels);
+			const VulkanHandleCacheStats& samplerStats = m_VulkanContext.getSamplerCacheStats();
+			const VulkanHandleCacheStats& imageViewStats = m_VulkanContext.getImageViewCacheStats();
+			printf("# Samplers live/shared    : %u / %u\n", samplerStats.live, samplerStats.shared);
+			printf("# Image views live/shared : %u / %u\n", imageViewStats.live, imageViewStats.shared);
+			VulkanMemoryStats memoryStats = m_VulkanContext.getMemoryStats();
+			for (size_t heap = 0; heap < memoryStats.heaps.size(); heap++)
+			{
+				const VulkanMemoryHeapStats& heapStats = memoryStats.heaps[heap];
+				printf("Memory heap %zu%-13s : %.1lf / %.1lf MiB, %u allocations\n", heap, heapStats.deviceLocal ? " (device)" : "",
+				       heapStats.usage / (1024.0 * 1024.0), heapStats.budget / (1024.0 * 1024.0), heapStats.allocationCount);
+			}
+			printf("Memory per category (MiB) :");
+			for (uint32_t category = 0; category < static_cast<uint32_t>(VulkanMemoryCategory::Count); category++)
+			{
+				printf(" %s %.1lf", VulkanMemoryTelemetry::getCategoryName(static_cast<VulkanMemoryCategory>(category)),
+				       memoryStats.categories[category].bytes / (1024.0 * 1024.0));
+			}
+			printf("\n");
+			VulkanHostAllocationStats hostStats = VulkanHostAllocator::getStats();
+			printf("Vulkan host memory        : allocs (since last log), live KiB, pooled\n");
+			for (uint32_t scope = 0; scope < VulkanHostAllocationStats::SCOPE_COUNT; scope++)
+			{
+				const VulkanHostAllocationScopeStats& scopeStats = hostStats.scopes[scope];
+				printf("  %-23s : %8llu %10.1lf %5.1lf%%\n", VulkanHostAllocator::getScopeName(static_cast<VkSystemAllocationScope>(scope)),
+				       static_cast<unsigned long long>(scopeStats.allocations - lastHostStats.scopes[scope].allocations),
+				       scopeStats.liveBytes / 1024.0, scopeStats.allocations ? 100.0 * scopeStats.pooled / scopeStats.allocations : 0.0);
+			}
+			lastHostStats = hostStats;
+			printf("Depth pre-pass [P]        : %s\n", m_VulkanContext.isDepthPrePassEnabled() ? "on" : "off");
+			printf("Occlusion culling [O]     : %s\n", m_VulkanContext.isOcclusionCullingEnabled() ? "on" : "off");
+			printf("Pipeline statistics [S]   : %s\n", m_VulkanContext.isPipelineStatisticsEnabled() ? "on" : "off");
+			printf("Full frame statistics     : [H]\n");
+			printf("Write trace.json          : [T]\n");
+			printf("Write memory.json         : [M]\n");
 			printf("-----------------------------------------------\n");
 			lastLogTime = now;
-			numFramesTillLastLog = m_NumFramesRendered;
 		}
 
 	}
@@ -77,8 +352,20 @@ void Application::mainLoop()
 void Application::shutdown()
 {
 	m_VulkanContext.shutdownContext();
-	glfwDestroyWindow(m_Window);
-	glfwTerminate();
+	if (!m_Headless)
+	{
+		glfwDestroyWindow(m_Window);
+		glfwTerminate();
+	}
+}
+
+double Application::getTime() const
+{
+	if (!m_Headless)
+		return glfwGetTime();
+
+	using Seconds = std::chrono::duration<double>;
+	return Seconds(std::chrono::steady_clock::now().time_since_epoch()).count();
 }
 
 
@@ -88,3 +375,127 @@ void detail::framebufferResizeCallback(GLFWwindow *window, int width, int height
 	VulkanContext* context = static_cast<VulkanContext*>(glfwGetWindowUserPointer(window));
 	context->handleFramebufferResized(width, height);
 }
+
+void detail::printGpuScopeTimings(const VulkanContext& context)
+{
+	const std::vector<VulkanGpuScopeTiming>& timings = context.getGpuScopeTimings();
+	if (timings.empty())
+		return;
+
+	printf("GPU time (ms)\n");
+	for (const VulkanGpuScopeTiming& timing : timings)
+	{
+		int indent = 2 + 2 * static_cast<int>(timing.depth);
+		if (timing.milliseconds >= 0.0)
+			printf("%*s%-*s : %8.3lf\n", indent, "", 28 - indent, timing.name, timing.milliseconds);
+		else
+			printf("%*s%-*s :      n/a\n", indent, "", 28 - indent, timing.name);
+	}
+}
+
+void detail::printPipelineStatistics(const VulkanContext& context)
+{
+	const std::vector<VulkanPassStatistics>& passes = context.getPassStatistics();
+	if (!passes.empty())
+	{
+		printf("Pipeline statistics       :   IA verts  IA prims  VS invoc  clip in  clip out  FS invoc  CS invoc\n");
+		for (const VulkanPassStatistics& statistics : passes)
+		{
+			if (!statistics.available)
+			{
+				printf("  %-23s : n/a\n", statistics.name);
+				continue;
+			}
+			printf("  %-23s : %10llu %9llu %9llu %8llu %9llu %9llu %9llu\n", statistics.name,
+			       static_cast<unsigned long long>(statistics.inputAssemblyVertices), static_cast<unsigned long long>(statistics.inputAssemblyPrimitives),
+			       static_cast<unsigned long long>(statistics.vertexShaderInvocations), static_cast<unsigned long long>(statistics.clippingInvocations),
+			       static_cast<unsigned long long>(statistics.clippingPrimitives), static_cast<unsigned long long>(statistics.fragmentShaderInvocations),
+			       static_cast<unsigned long long>(statistics.computeShaderInvocations));
+		}
+	}
+
+	const std::vector<VulkanOcclusionResult>& groups = context.getOcclusionResults();
+	if (!groups.empty())
+	{
+		printf("Samples passed\n");
+		for (const VulkanOcclusionResult& group : groups)
+		{
+			std::string name = group.pass ? std::string(group.pass) + " / " + group.name : group.name;
+			if (group.available)
+				printf("  %-40s : %10llu\n", name.c_str(), static_cast<unsigned long long>(group.samplesPassed));
+			else
+				printf("  %-40s : n/a\n", name.c_str());
+		}
+	}
+}
+
+void detail::accumulatePipelineStatistics(const VulkanContext& context, BenchmarkResults& results)
+{
+	// (the passes and groups are matched by name, a group drawn in only some of the frames is averaged over those)
+	for (const VulkanPassStatistics& statistics : context.getPassStatistics())
+	{
+		if (!statistics.available)
+			continue;
+
+		auto it = std::find_if(results.passStatistics.begin(), results.passStatistics.end(),
+		                       [&statistics](const BenchmarkPassStatistics& sum) { return sum.name == statistics.name; });
+		if (results.passStatistics.end() == it)
+		{
+			it = results.passStatistics.insert(it, BenchmarkPassStatistics{});
+			it->name = statistics.name;
+		}
+		it->frames++;
+		it->inputAssemblyVertices += static_cast<double>(statistics.inputAssemblyVertices);
+		it->inputAssemblyPrimitives += static_cast<double>(statistics.inputAssemblyPrimitives);
+		it->vertexShaderInvocations += static_cast<double>(statistics.vertexShaderInvocations);
+		it->clippingInvocations += static_cast<double>(statistics.clippingInvocations);
+		it->clippingPrimitives += static_cast<double>(statistics.clippingPrimitives);
+		it->fragmentShaderInvocations += static_cast<double>(statistics.fragmentShaderInvocations);
+		it->computeShaderInvocations += static_cast<double>(statistics.computeShaderInvocations);
+	}
+
+	for (const VulkanOcclusionResult& group : context.getOcclusionResults())
+	{
+		if (!group.available)
+			continue;
+
+		std::string name = group.pass ? std::string(group.pass) + " / " + group.name : group.name;
+		auto it = std::find_if(results.occlusionStatistics.begin(), results.occlusionStatistics.end(),
+		                       [&name](const BenchmarkOcclusionStatistics& sum) { return sum.name == name; });
+		if (results.occlusionStatistics.end() == it)
+		{
+			it = results.occlusionStatistics.insert(it, BenchmarkOcclusionStatistics{});
+			it->name = name;
+		}
+		it->frames++;
+		it->samplesPassed += static_cast<double>(group.samplesPassed);
+	}
+}
+
+uint64_t detail::getHostAllocationCount(const VulkanHostAllocationStats& stats)
+{
+	uint64_t count = 0;
+	for (const VulkanHostAllocationScopeStats& scopeStats : stats.scopes)
+	{
+		count += scopeStats.allocations;
+	}
+	return count;
+}
+
+void detail::keyCallback(GLFWwindow *window, int key, int, int action, int)
+{
+	if (GLFW_PRESS != action)
+		return;
+
+	VulkanContext* context = static_cast<VulkanContext*>(glfwGetWindowUserPointer(window));
+	switch (key)
+	{
+	case GLFW_KEY_P: context->setDepthPrePassEnabled(!context->isDepthPrePassEnabled()); break;
+	case GLFW_KEY_O: context->setOcclusionCullingEnabled(!context->isOcclusionCullingEnabled()); break;
+	case GLFW_KEY_H: context->getFrameStatistics().dump(true); break;
+	case GLFW_KEY_T: Profiler::writeChromeTrace("trace.json"); break;
+	case GLFW_KEY_M: VulkanMemoryTelemetry::writeJson("memory.json", context->getMemoryStats()); break;
+	case GLFW_KEY_S: context->setPipelineStatisticsEnabled(!context->isPipelineStatisticsEnabled()); break;
+	default: break;
+	}
+}
@@ -1,5 +1,7 @@
 ﻿#pragma once
 
+#include "Benchmark.h"
+#include "PerfRegression.h"
 #include "VulkanContext.h"
 
 #define GLFW_INCLUDE_VULKAN
@@ -12,17 +14,45 @@ public:
 
 	void run();
 	void initWindow();
+	// Renders frame_count frames offscreen instead, without a window (GLFW is never initialized)
+	void initHeadless(size_t frame_count);
+	// Headless run of fixed warm-up and measured frames on a simulated clock, the results are written as JSON
+	void initBenchmark(const BenchmarkSettings& settings);
+	// Benchmark of a capture : its scene and frames are replayed as fast as possible (the capture decides the scene settings and frame count)
+	void initReplay(const std::string& capture_file, const BenchmarkSettings& settings);
+	// Headless run of every scene of the regression suite, compared against (or written to, update_baseline) the baseline file
+	// (the warm-up and measured frame counts and the time step of the settings apply to every scene)
+	void initRegression(const std::string& baseline_file, bool update_baseline, const BenchmarkSettings& settings);
+	// A metric regressed past the tolerance of the baseline
+	bool hasFailed() const { return m_Failed; }
+	// Records the scene and the frames of the run, for later replays
+	void setCaptureFile(const std::string& file) { m_VulkanContext.setCaptureFile(file); m_CaptureFile = file; }
+	// Writes the CPU and GPU profile as a Chrome trace when the application exits
+	void setTraceFile(const std::string& file) { m_TraceFile = file; }
 
 private:
 	void mainLoop();
+	void runBenchmark();
+	void runRegression();
+	RegressionMetrics measureRegressionScene(const RegressionScene& scene) const;
 	void shutdown();
+	double getTime() const;
 
 	const char* m_AppName = nullptr;
 	int m_Width, m_Height;
 	GLFWwindow* m_Window{};
+	bool m_Headless = false;
+	size_t m_HeadlessFrameCount = 0;
+	bool m_Benchmark = false;
+	BenchmarkSettings m_BenchmarkSettings{};
+	std::string m_TraceFile;
+	std::string m_CaptureFile;
+	std::string m_ReplayFile;
+	SceneCapture m_Replay;
+	std::string m_RegressionBaseline;
+	bool m_UpdateBaseline = false;
+	bool m_Failed = false;
 	VulkanContext m_VulkanContext{};
 
 	size_t m_NumFramesRendered = 0;
-	double m_FrameTime = 0;
-	double m_AverageFrameTime = 0.0;
 };
@@ -0,0 +1,237 @@
+﻿#include "AssetArchive.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include "Lz4.h"
+
+namespace detail
+{
+	static constexpr uint32_t s_ArchiveMagic = 0x4B505456; // "VTPK"
+	static constexpr uint32_t s_ArchiveVersion = 1;
+
+	struct AssetArchiveFileHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t entryCount;
+		uint32_t reserved;
+		uint64_t tocOffset;
+		uint64_t namesOffset;
+		uint64_t namesSize;
+	};
+	static_assert(sizeof(AssetArchiveFileHeader) == 40, "Archive header must be packed");
+
+	struct AssetArchiveFileEntry
+	{
+		uint64_t offset;
+		uint64_t size;
+		uint64_t uncompressedSize;
+		uint32_t nameOffset;
+		uint32_t nameLength;
+		uint32_t compression;
+		uint32_t alignment;
+	};
+	static_assert(sizeof(AssetArchiveFileEntry) == 40, "Archive entry must be packed");
+
+	static uint64_t alignUp(uint64_t value, uint64_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+}
+
+bool AssetArchive::open(const std::string& filepath)
+{
+	close();
+
+	if (!m_File.open(filepath))
+		return false;
+
+	const uint8_t* data = m_File.getData();
+	uint64_t size = m_File.getSize();
+
+	detail::AssetArchiveFileHeader header{};
+	if (size < sizeof(header))
+	{
+		close();
+		return false;
+	}
+	std::memcpy(&header, data, sizeof(header));
+
+	uint64_t tocSize = uint64_t(header.entryCount) * sizeof(detail::AssetArchiveFileEntry);
+	if (detail::s_ArchiveMagic != header.magic || detail::s_ArchiveVersion != header.version
+	    || header.tocOffset > size || tocSize > size - header.tocOffset
+	    || header.namesOffset > size || header.namesSize > size - header.namesOffset)
+	{
+		close();
+		return false;
+	}
+
+	const char* names = reinterpret_cast<const char*>(data + header.namesOffset);
+	m_Entries.resize(header.entryCount);
+	for (uint32_t i = 0; i < header.entryCount; i++)
+	{
+		detail::AssetArchiveFileEntry fileEntry{};
+		std::memcpy(&fileEntry, data + header.tocOffset + i * sizeof(fileEntry), sizeof(fileEntry));
+
+		if (fileEntry.offset > size || fileEntry.size > size - fileEntry.offset
+		    || uint64_t(fileEntry.nameOffset) + fileEntry.nameLength > header.namesSize
+		    || fileEntry.compression > static_cast<uint32_t>(AssetCompression::LZ4)
+		    || (static_cast<uint32_t>(AssetCompression::None) == fileEntry.compression && fileEntry.size != fileEntry.uncompressedSize))
+		{
+			close();
+			return false;
+		}
+
+		AssetArchiveEntry& entry = m_Entries[i];
+		entry.name.assign(names + fileEntry.nameOffset, fileEntry.nameLength);
+		entry.offset = fileEntry.offset;
+		entry.size = fileEntry.size;
+		entry.uncompressedSize = fileEntry.uncompressedSize;
+		entry.compression = static_cast<AssetCompression>(fileEntry.compression);
+		entry.alignment = fileEntry.alignment;
+		m_EntryIndices[entry.name] = i;
+	}
+
+	return true;
+}
+
+void AssetArchive::close()
+{
+	m_File.close();
+	m_Entries.clear();
+	m_EntryIndices.clear();
+}
+
+const AssetArchiveEntry* AssetArchive::find(const std::string& name) const
+{
+	auto it = m_EntryIndices.find(normalizeName(name));
+	return m_EntryIndices.end() == it ? nullptr : &m_Entries[it->second];
+}
+
+bool AssetArchive::read(const AssetArchiveEntry& entry, uint8_t* dst) const
+{
+	switch (entry.compression)
+	{
+	case AssetCompression::None:
+		std::memcpy(dst, getData(entry), entry.size);
+		return true;
+	case AssetCompression::LZ4:
+		return Lz4::decompress(getData(entry), entry.size, dst, entry.uncompressedSize);
+	default:
+		return false;
+	}
+}
+
+std::string AssetArchive::normalizeName(const std::string& name)
+{
+	std::string normalized = name;
+	std::replace(normalized.begin(), normalized.end(), '\\', '/');
+	return normalized;
+}
+
+void AssetArchiveWriter::add(const std::string& name, const uint8_t* data, size_t size, AssetCompression compression, uint32_t alignment)
+{
+	PendingEntry pending{};
+	pending.entry.name = AssetArchive::normalizeName(name);
+	pending.entry.uncompressedSize = size;
+	pending.entry.compression = AssetCompression::None;
+	pending.entry.alignment = std::max(1u, alignment);
+
+	if (AssetCompression::LZ4 == compression)
+	{
+		pending.data.resize(Lz4::getMaxCompressedSize(size));
+		size_t compressedSize = Lz4::compress(data, size, pending.data.data(), pending.data.size());
+		if (0 != compressedSize && compressedSize < size)
+		{
+			pending.data.resize(compressedSize);
+			pending.entry.compression = AssetCompression::LZ4;
+		}
+	}
+	if (AssetCompression::None == pending.entry.compression)
+	{
+		pending.data.assign(data, data + size);
+	}
+	pending.entry.size = pending.data.size();
+
+	m_PendingEntries.push_back(std::move(pending));
+}
+
+void AssetArchiveWriter::addStored(const std::string& name, std::vector<uint8_t> stored_data, uint64_t uncompressed_size, AssetCompression compression, uint32_t alignment)
+{
+	PendingEntry pending{};
+	pending.entry.name = AssetArchive::normalizeName(name);
+	pending.entry.size = stored_data.size();
+	pending.entry.uncompressedSize = uncompressed_size;
+	pending.entry.compression = compression;
+	pending.entry.alignment = std::max(1u, alignment);
+	pending.data = std::move(stored_data);
+
+	m_PendingEntries.push_back(std::move(pending));
+}
+
+void AssetArchiveWriter::write(const std::string& filepath) const
+{
+	// Lay out the data, then the table of contents and the names
+	std::vector<detail::AssetArchiveFileEntry> fileEntries(m_PendingEntries.size());
+	std::string names;
+	uint64_t offset = sizeof(detail::AssetArchiveFileHeader);
+	for (size_t i = 0; i < m_PendingEntries.size(); i++)
+	{
+		const AssetArchiveEntry& entry = m_PendingEntries[i].entry;
+		offset = detail::alignUp(offset, entry.alignment);
+
+		fileEntries[i].offset = offset;
+		fileEntries[i].size = entry.size;
+		fileEntries[i].uncompressedSize = entry.uncompressedSize;
+		fileEntries[i].nameOffset = static_cast<uint32_t>(names.size());
+		fileEntries[i].nameLength = static_cast<uint32_t>(entry.name.size());
+		fileEntries[i].compression = static_cast<uint32_t>(entry.compression);
+		fileEntries[i].alignment = entry.alignment;
+
+		names += entry.name;
+		offset += entry.size;
+	}
+
+	detail::AssetArchiveFileHeader header{};
+	header.magic = detail::s_ArchiveMagic;
+	header.version = detail::s_ArchiveVersion;
+	header.entryCount = static_cast<uint32_t>(fileEntries.size());
+	header.tocOffset = detail::alignUp(offset, 8);
+	header.namesOffset = header.tocOffset + fileEntries.size() * sizeof(detail::AssetArchiveFileEntry);
+	header.namesSize = names.size();
+
+	std::ofstream file(filepath, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+	{
+		throw std::runtime_error("Failed to open file: " + filepath + "!");
+	}
+
+	static const char s_Padding[256] = {};
+	auto padTo = [&](uint64_t target)
+	{
+		for (uint64_t position = static_cast<uint64_t>(file.tellp()); position < target; )
+		{
+			uint64_t count = std::min<uint64_t>(target - position, sizeof(s_Padding));
+			file.write(s_Padding, count);
+			position += count;
+		}
+	};
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	for (size_t i = 0; i < m_PendingEntries.size(); i++)
+	{
+		padTo(fileEntries[i].offset);
+		file.write(reinterpret_cast<const char*>(m_PendingEntries[i].data.data()), m_PendingEntries[i].data.size());
+	}
+	padTo(header.tocOffset);
+	file.write(reinterpret_cast<const char*>(fileEntries.data()), fileEntries.size() * sizeof(detail::AssetArchiveFileEntry));
+	file.write(names.data(), names.size());
+
+	if (!file)
+	{
+		throw std::runtime_error("Failed to write file: " + filepath + "!");
+	}
+}
@@ -0,0 +1,82 @@
+﻿#pragma once
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "MappedFile.h"
+
+enum class AssetCompression : uint32_t
+{
+	None = 0,
+	LZ4, // block format, see Lz4.h
+};
+
+// Table of contents entry, offsets are from the start of the archive
+struct AssetArchiveEntry
+{
+	std::string name;
+	uint64_t offset;
+	uint64_t size; // stored size
+	uint64_t uncompressedSize;
+	AssetCompression compression;
+	uint32_t alignment; // of the stored data in the file
+};
+
+/**
+ * Read-only packed archive of assets, memory-mapped as a whole.
+ * Layout : header | entry data (each aligned as requested) | table of contents | names.
+ * Entries are looked up by their path relative to the working directory, with '/' separators
+ * ("assets\\image.png" and "assets/image.png" name the same entry).
+ * Uncompressed entries are read in place through getData(), compressed ones are decompressed by read().
+ */
+class AssetArchive
+{
+public:
+	// Returns false if the file does not exist or is not a valid archive
+	bool open(const std::string& filepath);
+	void close();
+
+	bool isOpen() const { return m_File.isOpen(); }
+
+	const AssetArchiveEntry* find(const std::string& name) const;
+	const std::vector<AssetArchiveEntry>& getEntries() const { return m_Entries; }
+
+	// Stored bytes of the entry, inside the mapping
+	const uint8_t* getData(const AssetArchiveEntry& entry) const { return m_File.getData() + entry.offset; }
+
+	// Copies or decompresses the entry into dst (uncompressedSize bytes), thread-safe
+	bool read(const AssetArchiveEntry& entry, uint8_t* dst) const;
+
+	static std::string normalizeName(const std::string& name);
+
+private:
+	MappedFile m_File;
+	std::vector<AssetArchiveEntry> m_Entries;
+	std::unordered_map<std::string, size_t> m_EntryIndices;
+};
+
+/**
+ * Builds an archive in memory and writes it out in one go.
+ * Compressed entries that do not shrink are stored uncompressed.
+ */
+class AssetArchiveWriter
+{
+public:
+	void add(const std::string& name, const uint8_t* data, size_t size, AssetCompression compression = AssetCompression::None, uint32_t alignment = 16);
+
+	// Adds data that is already stored as it should be in the archive (compressed ahead of time)
+	void addStored(const std::string& name, std::vector<uint8_t> stored_data, uint64_t uncompressed_size, AssetCompression compression, uint32_t alignment = 16);
+
+	// Throws if the file cannot be written
+	void write(const std::string& filepath) const;
+
+private:
+	struct PendingEntry
+	{
+		AssetArchiveEntry entry;
+		std::vector<uint8_t> data; // as stored
+	};
+
+	std::vector<PendingEntry> m_PendingEntries;
+};
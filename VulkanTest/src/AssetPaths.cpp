@@ -0,0 +1,26 @@
+﻿#include "AssetPaths.h"
+
+std::filesystem::path AssetPaths::s_ShaderDirectory;
+std::filesystem::path AssetPaths::s_AssetRoot;
+
+void AssetPaths::setExecutable(const std::filesystem::path& executable)
+{
+	std::error_code error;
+	std::filesystem::path absolute = std::filesystem::absolute(executable, error);
+	s_ShaderDirectory = (error ? executable : absolute).lexically_normal().parent_path();
+}
+
+void AssetPaths::setAssetRoot(const std::filesystem::path& asset_root)
+{
+	s_AssetRoot = asset_root;
+}
+
+std::string AssetPaths::getShader(const std::string& name)
+{
+	return (s_ShaderDirectory / name).make_preferred().string();
+}
+
+std::string AssetPaths::getAsset(const std::string& name)
+{
+	return (s_AssetRoot / name).make_preferred().string();
+}
@@ -0,0 +1,23 @@
+﻿#pragma once
+#include <filesystem>
+#include <string>
+
+/**
+ * Locations of the files loaded at runtime, joined with std::filesystem so that the separators are portable.
+ *  - Shaders are compiled next to the executable
+ *  - Assets (loose files, the asset archive and the texture cache) are relative to the asset root, the working directory by default
+ * Asset names stay relative to the root (they also name the entries of the archive and the textures of captures).
+ */
+struct AssetPaths
+{
+	// (argv[0], before the working directory changes)
+	static void setExecutable(const std::filesystem::path& executable);
+	static void setAssetRoot(const std::filesystem::path& asset_root);
+
+	static std::string getShader(const std::string& name);
+	static std::string getAsset(const std::string& name);
+
+private:
+	static std::filesystem::path s_ShaderDirectory;
+	static std::filesystem::path s_AssetRoot;
+};
@@ -0,0 +1,147 @@
+﻿#include "Benchmark.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <numeric>
+#include <stdexcept>
+
+namespace detail
+{
+	// Nearest-rank percentile of sorted samples
+	static double percentile(const std::vector<double>& sorted_samples, double percent)
+	{
+		size_t rank = static_cast<size_t>(std::ceil(percent / 100.0 * static_cast<double>(sorted_samples.size())));
+		return sorted_samples[std::clamp<size_t>(rank, 1, sorted_samples.size()) - 1];
+	}
+
+	static void writeSummary(std::ostream& output, const char* name, const FrameTimeSummary& summary)
+	{
+		output << "\t\"" << name << "\": { \"count\": " << summary.count
+		       << ", \"mean\": " << summary.mean << ", \"min\": " << summary.min
+		       << ", \"p50\": " << summary.p50 << ", \"p90\": " << summary.p90 << ", \"p95\": " << summary.p95 << ", \"p99\": " << summary.p99
+		       << ", \"max\": " << summary.max << " }";
+	}
+
+	static void writePassStatistics(std::ostream& output, const BenchmarkPassStatistics& statistics)
+	{
+		double frames = std::max(1.0, static_cast<double>(statistics.frames));
+		output << "\t\t{ \"pass\": \"" << statistics.name << "\", \"frames\": " << statistics.frames
+		       << ", \"inputAssemblyVertices\": " << statistics.inputAssemblyVertices / frames
+		       << ", \"inputAssemblyPrimitives\": " << statistics.inputAssemblyPrimitives / frames
+		       << ", \"vertexShaderInvocations\": " << statistics.vertexShaderInvocations / frames
+		       << ", \"clippingInvocations\": " << statistics.clippingInvocations / frames
+		       << ", \"clippingPrimitives\": " << statistics.clippingPrimitives / frames
+		       << ", \"fragmentShaderInvocations\": " << statistics.fragmentShaderInvocations / frames
+		       << ", \"computeShaderInvocations\": " << statistics.computeShaderInvocations / frames << " }";
+	}
+
+	static std::string escape(const std::string& text)
+	{
+		std::string escaped;
+		for (char c : text)
+		{
+			if ('"' == c || '\\' == c)
+				escaped += '\\';
+			escaped += c;
+		}
+		return escaped;
+	}
+}
+
+const char* Benchmark::guessBottleneck(const BenchmarkResults& results)
+{
+	if (results.cpuFrameTimes.empty())
+		return "unknown";
+
+	// (the CPU frame time includes waiting for the GPU, a GPU busy for less than 90% of it is waited on)
+	if (!results.gpuFrameTimes.empty() && summarize(results.gpuFrameTimes).p50 < 0.9 * summarize(results.cpuFrameTimes).p50)
+		return "cpu";
+
+	double vertexInvocations = 0.0;
+	double fragmentInvocations = 0.0;
+	for (const BenchmarkPassStatistics& statistics : results.passStatistics)
+	{
+		if (0 == statistics.frames)
+			continue;
+		vertexInvocations += statistics.vertexShaderInvocations / statistics.frames;
+		fragmentInvocations += statistics.fragmentShaderInvocations / statistics.frames;
+	}
+	if (0.0 == vertexInvocations && 0.0 == fragmentInvocations)
+		return "gpu";
+	return fragmentInvocations > vertexInvocations ? "fragment" : "vertex";
+}
+
+FrameTimeSummary Benchmark::summarize(std::vector<double> samples)
+{
+	FrameTimeSummary summary{};
+	if (samples.empty())
+		return summary;
+
+	std::sort(samples.begin(), samples.end());
+
+	summary.count = static_cast<uint32_t>(samples.size());
+	summary.mean = std::accumulate(samples.begin(), samples.end(), 0.0) / static_cast<double>(samples.size());
+	summary.min = samples.front();
+	summary.p50 = detail::percentile(samples, 50.0);
+	summary.p90 = detail::percentile(samples, 90.0);
+	summary.p95 = detail::percentile(samples, 95.0);
+	summary.p99 = detail::percentile(samples, 99.0);
+	summary.max = samples.back();
+	return summary;
+}
+
+void Benchmark::writeJson(const std::string& file, const BenchmarkSettings& settings, const BenchmarkResults& results)
+{
+	std::ofstream output(file, std::ios::trunc);
+	if (!output.is_open())
+	{
+		throw std::runtime_error("Failed to open benchmark output file!");
+	}
+
+	output << std::fixed << std::setprecision(4);
+	output << "{\n";
+	output << "\t\"device\": \"" << detail::escape(results.device) << "\",\n";
+	output << "\t\"settings\": { \"objects\": " << settings.objectCount << ", \"textures\": " << settings.textureCount
+	       << ", \"framesInFlight\": " << settings.framesInFlight << ", \"width\": " << settings.width << ", \"height\": " << settings.height
+	       << ", \"warmupFrames\": " << settings.warmupFrames << ", \"measuredFrames\": " << settings.measuredFrames
+	       << ", \"timeStep\": " << std::setprecision(6) << settings.timeStep << std::setprecision(4)
+	       << ", \"pipelineStatistics\": " << (settings.pipelineStatistics ? "true" : "false") << " },\n";
+
+	detail::writeSummary(output, "cpuFrameMs", summarize(results.cpuFrameTimes));
+	output << ",\n";
+	if (results.gpuFrameTimes.empty())
+	{
+		output << "\t\"gpuFrameMs\": null";
+	}
+	else
+	{
+		detail::writeSummary(output, "gpuFrameMs", summarize(results.gpuFrameTimes));
+	}
+	output << ",\n";
+
+	// Per frame averages
+	output << "\t\"pipelineStatistics\": [";
+	for (size_t i = 0; i < results.passStatistics.size(); i++)
+	{
+		output << (0 == i ? "\n" : ",\n");
+		detail::writePassStatistics(output, results.passStatistics[i]);
+	}
+	output << (results.passStatistics.empty() ? "],\n" : "\n\t],\n");
+	output << "\t\"occlusion\": [";
+	for (size_t i = 0; i < results.occlusionStatistics.size(); i++)
+	{
+		const BenchmarkOcclusionStatistics& statistics = results.occlusionStatistics[i];
+		output << (0 == i ? "\n" : ",\n") << "\t\t{ \"group\": \"" << statistics.name << "\", \"frames\": " << statistics.frames
+		       << ", \"samplesPassed\": " << statistics.samplesPassed / std::max(1.0, static_cast<double>(statistics.frames)) << " }";
+	}
+	output << (results.occlusionStatistics.empty() ? "],\n" : "\n\t],\n");
+	output << "\t\"bottleneck\": \"" << guessBottleneck(results) << "\"";
+	output << "\n}\n";
+
+	if (!output.good())
+	{
+		throw std::runtime_error("Failed to write benchmark output file!");
+	}
+}
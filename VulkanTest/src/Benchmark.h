@@ -0,0 +1,82 @@
+﻿#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Scene and run parameters of a benchmark
+struct BenchmarkSettings
+{
+	uint32_t objectCount = 16;
+	uint32_t textureCount = 2;
+	uint32_t framesInFlight = 1;
+	uint32_t width = 800;
+	uint32_t height = 600;
+	uint32_t warmupFrames = 100; // rendered before measuring (pipelines, caches and texture residency settle)
+	uint32_t measuredFrames = 1000;
+	double timeStep = 1.0 / 60.0; // simulated seconds per frame
+	bool pipelineStatistics = false; // collect pipeline statistics and occlusion queries over the measured frames
+	std::string outputFile = "benchmark.json";
+};
+
+// Distribution of a series of frame times, in milliseconds (nearest-rank percentiles)
+struct FrameTimeSummary
+{
+	uint32_t count = 0;
+	double mean = 0.0;
+	double min = 0.0;
+	double p50 = 0.0;
+	double p90 = 0.0;
+	double p95 = 0.0;
+	double p99 = 0.0;
+	double max = 0.0;
+};
+
+// Pipeline statistics of a pass, summed over the frames they were available in
+struct BenchmarkPassStatistics
+{
+	std::string name;
+	uint32_t frames = 0;
+	double inputAssemblyVertices = 0.0;
+	double inputAssemblyPrimitives = 0.0;
+	double vertexShaderInvocations = 0.0;
+	double clippingInvocations = 0.0;
+	double clippingPrimitives = 0.0;
+	double fragmentShaderInvocations = 0.0;
+	double computeShaderInvocations = 0.0;
+};
+
+// Samples passed by a draw group, summed over the frames they were available in
+struct BenchmarkOcclusionStatistics
+{
+	std::string name;
+	uint32_t frames = 0;
+	double samplesPassed = 0.0;
+};
+
+struct BenchmarkResults
+{
+	std::string device;
+	std::vector<double> cpuFrameTimes; // wall time of each measured drawFrame() call
+	std::vector<double> gpuFrameTimes; // between the first and last timestamp of a frame (empty : no timestamps)
+	std::vector<BenchmarkPassStatistics> passStatistics; // (empty : pipeline statistics not collected or not supported)
+	std::vector<BenchmarkOcclusionStatistics> occlusionStatistics;
+};
+
+/**
+ * Frame time statistics of a benchmark run, written as JSON so runs can be diffed or compared against a baseline file :
+ * { "device", "settings" : {...}, "cpuFrameMs" : { "count", "mean", "min", "p50", "p90", "p95", "p99", "max" }, "gpuFrameMs" : {...} | null,
+ *   "pipelineStatistics" : [ { "pass", per frame averages... } ], "occlusion" : [ { "group", "samplesPassed" } ], "bottleneck" }
+ */
+struct Benchmark
+{
+	static FrameTimeSummary summarize(std::vector<double> samples);
+
+	/**
+	 * Rough guess of what bounds the frame rate : "cpu" when the GPU idles for a good part of the CPU frame time,
+	 * otherwise "vertex" or "fragment" from whichever stage had the most shader invocations ("gpu" without pipeline statistics).
+	 * (invocation counts ignore the cost of each shader, the GPU scope timings tell more when the guess is close)
+	 */
+	static const char* guessBottleneck(const BenchmarkResults& results);
+
+	static void writeJson(const std::string& file, const BenchmarkSettings& settings, const BenchmarkResults& results);
+};
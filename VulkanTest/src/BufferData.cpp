@@ -1,8 +1,11 @@
 ﻿#include "BufferData.h"
 
+#include <cstring>
 #include <vector>
 #include <xutility>
 
+#include <glm/gtc/matrix_transform.hpp>
+
 std::vector<VkVertexInputBindingDescription>& Vertex::getBindingDescriptions()
 {
 	static std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
@@ -78,3 +81,86 @@ size_t Mesh::getNumIndices()
 	return std::size(mesh::indices);
 }
 
+
+glm::vec4 Mesh::getBoundingSphere()
+{
+	// Use the center of the bounding box and the farthest vertex from it
+	glm::vec3 minPos = mesh::vertices[0].pos;
+	glm::vec3 maxPos = mesh::vertices[0].pos;
+	for (const Vertex& vertex : mesh::vertices)
+	{
+		minPos = glm::min(minPos, vertex.pos);
+		maxPos = glm::max(maxPos, vertex.pos);
+	}
+
+	glm::vec3 center = (minPos + maxPos) * 0.5f;
+	float radius = 0.f;
+	for (const Vertex& vertex : mesh::vertices)
+	{
+		radius = glm::max(radius, glm::length(vertex.pos - center));
+	}
+
+	return glm::vec4(center, radius);
+}
+
+std::vector<ObjectData> Scene::generateObjects(uint32_t count)
+{
+	// Stack copies of the mesh below each other so that the top layer occludes most of the ones below it
+	constexpr float LAYER_SPACING = 0.05f;
+
+	std::vector<ObjectData> objects(count);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		objects[i].model = glm::translate(glm::mat4(1.f), glm::vec3(0.f, 0.f, -LAYER_SPACING * static_cast<float>(i)));
+		objects[i].boundingSphere = Mesh::getBoundingSphere();
+	}
+
+	return objects;
+}
+
+DrawLayer getDrawLayer(MaterialClass material_class)
+{
+	switch (material_class)
+	{
+	case MaterialClass::AlphaTest:   return DrawLayer::AlphaTest;
+	case MaterialClass::Transparent: return DrawLayer::Transparent;
+	default:                         return DrawLayer::Opaque;
+	}
+}
+
+uint64_t DrawSortKey::make(DrawLayer layer, uint32_t pipeline, uint32_t material, uint32_t mesh, float view_depth)
+{
+	uint64_t state = (static_cast<uint64_t>(pipeline & 0xfff) << 24) | (static_cast<uint64_t>(material & 0xfff) << 12) | (mesh & 0xfff);
+	uint64_t depth = quantizeDepth(view_depth);
+
+	uint64_t key = static_cast<uint64_t>(layer) << 60;
+	if (DrawLayer::Transparent == layer)
+	{
+		key |= ((~depth & 0xffffff) << 36) | state;
+	}
+	else
+	{
+		key |= (state << 24) | depth;
+	}
+	return key;
+}
+
+uint32_t DrawSortKey::quantizeDepth(float view_depth)
+{
+	// The bit pattern of a positive float grows with its value : keep the exponent and the top of the mantissa
+	float depth = glm::max(view_depth, 0.f);
+	uint32_t bits;
+	std::memcpy(&bits, &depth, sizeof(bits));
+	return bits >> 8;
+}
+
+MaterialClass Scene::getMaterialClass(uint32_t object_index)
+{
+	// Mix the classes through the stack so that every bucket is populated
+	switch (object_index % 4)
+	{
+	case 2:  return MaterialClass::AlphaTest;
+	case 3:  return MaterialClass::Transparent;
+	default: return MaterialClass::Opaque;
+	}
+}
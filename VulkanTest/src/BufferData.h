@@ -21,6 +21,78 @@ struct Mesh
 	static const uint16_t* getIndices();
 	static size_t getNumVertices(); // number of vertices
 	static size_t getNumIndices(); // number of vertices
+	static glm::vec4 getBoundingSphere(); // xyz : center, w : radius (in object space)
+};
+
+
+// Per-object data read by the vertex shader (model matrix) and the culling shader (bounds)
+struct ObjectData
+{
+	glm::mat4 model;
+	glm::vec4 boundingSphere; // xyz : center, w : radius (in object space)
+	glm::uvec4 mesh; // x : first index, y : index count, z : vertex offset (range of the mesh in the geometry pool), w : atlas region + 1 (0 : scene texture)
+};
+
+// Streamed textures bound next to the atlas, the scene texture first
+// (with the atlas, stays within the 16 sampled images per stage every device supports)
+constexpr uint32_t STREAMED_TEXTURE_SLOTS = 15;
+
+// Decides the pipeline an object is drawn with and the order it is drawn in
+enum class MaterialClass : uint32_t
+{
+	Opaque = 0,  // no blending, drawn front-to-back
+	AlphaTest,   // no blending, fragments below the alpha cutoff are discarded, drawn front-to-back
+	Transparent, // alpha blended without depth writes, drawn back-to-front after everything else
+	Count
+};
+
+// Contiguous range of the draw list (and of the indirect draw commands) holding one material class
+struct DrawBucket
+{
+	uint32_t first;
+	uint32_t count;
+};
+
+// Order in which the draws of a pass are submitted (top bits of the sort key)
+enum class DrawLayer : uint32_t
+{
+	DepthPrePass = 0,
+	Opaque,
+	AlphaTest,
+	Transparent,
+};
+
+DrawLayer getDrawLayer(MaterialClass material_class);
+
+/**
+ * 64-bit draw sort key :
+ *  - front-to-back layers : layer (4) | pipeline (12) | material (12) | mesh (12) | depth (24)
+ *    (state changes are minimized first, ties are broken by depth to help early-Z)
+ *  - back-to-front layers : layer (4) | inverted depth (24) | pipeline (12) | material (12) | mesh (12)
+ *    (blending order comes first)
+ */
+struct DrawSortKey
+{
+	static uint64_t make(DrawLayer layer, uint32_t pipeline, uint32_t material, uint32_t mesh, float view_depth);
+
+	static DrawLayer getLayer(uint64_t key) { return static_cast<DrawLayer>(key >> 60); }
+	static uint32_t quantizeDepth(float view_depth); // 24 bits, monotonic for positive depths
+};
+
+// Run of consecutive draw list slots sharing a material class and an index type, drawn with one indirect draw
+struct DrawRun
+{
+	uint32_t first;
+	uint32_t count;
+	MaterialClass materialClass;
+	VkIndexType indexType;
+	float viewDepth; // depth of the first object, keeps the runs of the transparent bucket in back-to-front order
+};
+
+struct Scene
+{
+	static std::vector<ObjectData> generateObjects(uint32_t count);
+	static MaterialClass getMaterialClass(uint32_t object_index);
 };
 
 
@@ -31,3 +103,22 @@ struct MatricesUBO
 	glm::mat4 proj;
 };
 
+
+
+struct CullingPushConstants
+{
+	uint32_t objectCount;
+	uint32_t phase; // 0 : early (last frame's visible set), 1 : late (test against the depth pyramid)
+	uint32_t occlusionEnabled;
+	uint32_t transparentBegin; // first slot of the transparent bucket in the draw list
+	glm::vec2 depthSize; // size of the depth buffer the pyramid was built from (in pixels)
+};
+
+// Counters written by the culling shader, read back on the CPU once the frame has finished
+struct CullingStats
+{
+	uint32_t drawnEarly;      // objects visible last frame and drawn in the first phase
+	uint32_t drawnLate;       // newly visible objects drawn in the second phase
+	uint32_t frustumCulled;   // objects outside the view frustum
+	uint32_t occlusionCulled; // objects inside the view frustum but hidden behind the depth pyramid
+};
@@ -0,0 +1,206 @@
+﻿#include "FrameStatistics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace detail
+{
+	static constexpr uint32_t s_PhaseCount = static_cast<uint32_t>(FramePhase::Count);
+
+	static uint32_t findMostSignificantBit(uint64_t value)
+	{
+		uint32_t bit = 0;
+		while (value >>= 1)
+		{
+			bit++;
+		}
+		return bit;
+	}
+
+	// Smallest value reached by the given share of the recorded values (nearest rank)
+	static double getPercentile(const std::vector<uint64_t>& counts, uint64_t total, double percent)
+	{
+		uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(percent / 100.0 * static_cast<double>(total))));
+		uint64_t seen = 0;
+		for (uint32_t bucket = 0; bucket < counts.size(); bucket++)
+		{
+			seen += counts[bucket];
+			if (seen >= rank)
+				return static_cast<double>(FrameTimeHistogram::getBucketValue(bucket)) * 1e-3;
+		}
+		return 0.0;
+	}
+}
+
+void FrameTimeHistogram::record(uint64_t microseconds)
+{
+	m_Counts[getBucket(microseconds)].fetch_add(1, std::memory_order_relaxed);
+
+	uint64_t max = m_Max.load(std::memory_order_relaxed);
+	while (microseconds > max && !m_Max.compare_exchange_weak(max, microseconds, std::memory_order_relaxed))
+	{
+	}
+}
+
+void FrameTimeHistogram::reset()
+{
+	for (std::atomic<uint32_t>& count : m_Counts)
+	{
+		count.store(0, std::memory_order_relaxed);
+	}
+	m_Max.store(0, std::memory_order_relaxed);
+}
+
+void FrameTimeHistogram::accumulate(std::vector<uint64_t>& counts, uint64_t& max) const
+{
+	counts.resize(BUCKET_COUNT);
+	for (uint32_t bucket = 0; bucket < BUCKET_COUNT; bucket++)
+	{
+		counts[bucket] += m_Counts[bucket].load(std::memory_order_relaxed);
+	}
+	max = std::max(max, m_Max.load(std::memory_order_relaxed));
+}
+
+uint32_t FrameTimeHistogram::getBucket(uint64_t value)
+{
+	constexpr uint64_t subBucketCount = 1ull << SUB_BUCKET_BITS;
+	if (value < subBucketCount)
+		return static_cast<uint32_t>(value);
+
+	// Octave of the value (longer durations land in the last bucket), then its position in the octave from the bits following the most significant one
+	uint32_t exponent = std::min(detail::findMostSignificantBit(value), MAX_EXPONENT - 1);
+	uint64_t subBucket = std::min(value >> (exponent - SUB_BUCKET_BITS), 2 * subBucketCount - 1) - subBucketCount;
+	return static_cast<uint32_t>(((exponent - SUB_BUCKET_BITS + 1) << SUB_BUCKET_BITS) + subBucket);
+}
+
+uint64_t FrameTimeHistogram::getBucketValue(uint32_t bucket)
+{
+	constexpr uint64_t subBucketCount = 1ull << SUB_BUCKET_BITS;
+	if (bucket < subBucketCount)
+		return bucket;
+
+	uint32_t exponent = (bucket >> SUB_BUCKET_BITS) + SUB_BUCKET_BITS - 1;
+	uint64_t subBucket = bucket & (subBucketCount - 1);
+	uint32_t shift = exponent - SUB_BUCKET_BITS;
+	return ((subBucketCount + subBucket + 1) << shift) - 1;
+}
+
+void FrameStatistics::create(double window_seconds, uint32_t window_slices)
+{
+	m_SliceCount = std::max(1u, window_slices);
+	m_SliceDuration = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(window_seconds / m_SliceCount));
+	m_CurrentSlice = 0;
+	m_SliceStart = Clock::now();
+
+	m_Totals = std::make_unique<FrameTimeHistogram[]>(detail::s_PhaseCount);
+	m_Slices = std::make_unique<FrameTimeHistogram[]>(detail::s_PhaseCount * m_SliceCount);
+}
+
+void FrameStatistics::record(FramePhase phase, uint64_t microseconds)
+{
+	m_Totals[static_cast<uint32_t>(phase)].record(microseconds);
+	getSlice(m_CurrentSlice.load(std::memory_order_relaxed), phase).record(microseconds);
+}
+
+void FrameStatistics::record(FramePhase phase, Clock::duration duration)
+{
+	record(phase, static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(duration).count()));
+}
+
+void FrameStatistics::advance(Clock::time_point now)
+{
+	if (now - m_SliceStart < m_SliceDuration)
+		return;
+
+	// Clear the slices that went by (all of them after a long pause)
+	uint64_t elapsedSlices = static_cast<uint64_t>((now - m_SliceStart) / m_SliceDuration);
+	uint32_t slice = m_CurrentSlice.load(std::memory_order_relaxed);
+	for (uint64_t i = 0; i < std::min<uint64_t>(elapsedSlices, m_SliceCount); i++)
+	{
+		slice = (slice + 1) % m_SliceCount;
+		for (uint32_t phase = 0; phase < detail::s_PhaseCount; phase++)
+		{
+			getSlice(slice, static_cast<FramePhase>(phase)).reset();
+		}
+	}
+	m_CurrentSlice.store(slice, std::memory_order_relaxed);
+	m_SliceStart += elapsedSlices * m_SliceDuration;
+}
+
+FramePhaseSummary FrameStatistics::getSummary(FramePhase phase, bool window) const
+{
+	std::vector<uint64_t> counts(FrameTimeHistogram::BUCKET_COUNT, 0);
+	uint64_t max = 0;
+	if (window)
+	{
+		for (uint32_t slice = 0; slice < m_SliceCount; slice++)
+		{
+			getSlice(slice, phase).accumulate(counts, max);
+		}
+	}
+	else
+	{
+		m_Totals[static_cast<uint32_t>(phase)].accumulate(counts, max);
+	}
+
+	FramePhaseSummary summary{};
+	for (uint64_t count : counts)
+	{
+		summary.count += count;
+	}
+	if (0 == summary.count)
+		return summary;
+
+	summary.p50 = detail::getPercentile(counts, summary.count, 50.0);
+	summary.p90 = detail::getPercentile(counts, summary.count, 90.0);
+	summary.p99 = detail::getPercentile(counts, summary.count, 99.0);
+	summary.p999 = detail::getPercentile(counts, summary.count, 99.9);
+	summary.max = static_cast<double>(max) * 1e-3;
+
+	// (bucket upper bounds may overshoot the largest recorded value)
+	summary.p50 = std::min(summary.p50, summary.max);
+	summary.p90 = std::min(summary.p90, summary.max);
+	summary.p99 = std::min(summary.p99, summary.max);
+	summary.p999 = std::min(summary.p999, summary.max);
+	return summary;
+}
+
+void FrameStatistics::dump(bool include_total) const
+{
+	double windowSeconds = std::chrono::duration<double>(m_SliceDuration * m_SliceCount).count();
+	for (int total = 0; total <= (include_total ? 1 : 0); total++)
+	{
+		if (total)
+			printf("Frame times since start (ms) :    count      p50      p90      p99    p99.9      max\n");
+		else
+			printf("Frame times, last %4.0lf s (ms) :    count      p50      p90      p99    p99.9      max\n", windowSeconds);
+
+		for (uint32_t phase = 0; phase < detail::s_PhaseCount; phase++)
+		{
+			FramePhaseSummary summary = getSummary(static_cast<FramePhase>(phase), !total);
+			printf("  %-26s : %8llu %8.3lf %8.3lf %8.3lf %8.3lf %8.3lf\n", getPhaseName(static_cast<FramePhase>(phase)),
+			       static_cast<unsigned long long>(summary.count), summary.p50, summary.p90, summary.p99, summary.p999, summary.max);
+		}
+	}
+}
+
+const char* FrameStatistics::getPhaseName(FramePhase phase)
+{
+	switch (phase)
+	{
+	case FramePhase::CpuFrame:    return "CPU frame";
+	case FramePhase::AcquireWait: return "Acquire wait";
+	case FramePhase::FenceWait:   return "Fence wait";
+	case FramePhase::Record:      return "Record";
+	case FramePhase::Submit:      return "Submit";
+	case FramePhase::Present:     return "Present";
+	case FramePhase::GpuFrame:    return "GPU frame";
+	default:                      return "Unknown";
+	}
+}
+
+FrameTimeHistogram& FrameStatistics::getSlice(uint32_t slice, FramePhase phase) const
+{
+	return m_Slices[static_cast<uint32_t>(phase) * m_SliceCount + slice];
+}
@@ -0,0 +1,92 @@
+﻿#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+enum class FramePhase : uint32_t
+{
+	CpuFrame = 0, // from the start of a frame to the start of the next one
+	AcquireWait,
+	FenceWait,
+	Record, // uniforms, draw list and command buffer
+	Submit,
+	Present,
+	GpuFrame, // between the timestamps of the frame's command buffer
+	Count,
+};
+
+// Percentiles of a phase in milliseconds (within the precision of the histogram buckets)
+struct FramePhaseSummary
+{
+	uint64_t count = 0;
+	double p50 = 0.0;
+	double p90 = 0.0;
+	double p99 = 0.0;
+	double p999 = 0.0;
+	double max = 0.0;
+};
+
+/**
+ * Log-linear histogram of durations in microseconds, HDR style : every power of two is split in 2^SUB_BUCKET_BITS buckets,
+ * so a recorded value is known within 1/64th of itself (values below 64 us are exact), from 1 us up to 2^32 us.
+ * Counts are atomics : a single thread records while any thread reads, without locks.
+ */
+class FrameTimeHistogram
+{
+public:
+	static constexpr uint32_t SUB_BUCKET_BITS = 6;
+	static constexpr uint32_t MAX_EXPONENT = 32;
+	static constexpr uint32_t BUCKET_COUNT = (MAX_EXPONENT - SUB_BUCKET_BITS + 1) << SUB_BUCKET_BITS;
+
+	void record(uint64_t microseconds);
+	void reset();
+
+	// Adds the counts of the histogram to counts (BUCKET_COUNT entries)
+	void accumulate(std::vector<uint64_t>& counts, uint64_t& max) const;
+
+	static uint32_t getBucket(uint64_t value);
+	// Highest value falling in the bucket
+	static uint64_t getBucketValue(uint32_t bucket);
+
+private:
+	std::atomic<uint32_t> m_Counts[BUCKET_COUNT]{};
+	std::atomic<uint64_t> m_Max{ 0 };
+};
+
+/**
+ * Durations of the phases of every frame, kept since the collector was created and over a rolling window.
+ * The window is a ring of slices : advance() moves to the next slice (clearing it) once the current one is over,
+ * so the window covers the last window_seconds, give or take one slice.
+ * Only the rendering thread records and advances, summaries and dumps can be taken from any thread at any time.
+ */
+class FrameStatistics
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	void create(double window_seconds = 10.0, uint32_t window_slices = 10);
+
+	void record(FramePhase phase, uint64_t microseconds);
+	void record(FramePhase phase, Clock::duration duration);
+	void advance(Clock::time_point now);
+
+	FramePhaseSummary getSummary(FramePhase phase, bool window) const;
+
+	// Prints the percentiles of every phase (over the window, and since the start when include_total is set)
+	void dump(bool include_total) const;
+
+	static const char* getPhaseName(FramePhase phase);
+
+private:
+	FrameTimeHistogram& getSlice(uint32_t slice, FramePhase phase) const;
+
+	Clock::duration m_SliceDuration{};
+	uint32_t m_SliceCount = 0;
+	std::atomic<uint32_t> m_CurrentSlice{ 0 };
+	Clock::time_point m_SliceStart{};
+
+	std::unique_ptr<FrameTimeHistogram[]> m_Totals; // one per phase
+	std::unique_ptr<FrameTimeHistogram[]> m_Slices; // m_SliceCount per phase
+};
@@ -0,0 +1,87 @@
+﻿#include "FreeListAllocator.h"
+
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+
+void FreeListAllocator::init(uint64_t capacity)
+{
+	m_Capacity = capacity;
+	reset(0);
+}
+
+std::optional<uint64_t> FreeListAllocator::allocate(uint64_t size)
+{
+	if (0 == size)
+		return std::nullopt;
+
+	for (auto it = m_FreeBlocks.begin(); it != m_FreeBlocks.end(); ++it)
+	{
+		if (it->second < size)
+			continue;
+
+		// Take the allocation from the front of the block
+		uint64_t offset = it->first;
+		uint64_t remaining = it->second - size;
+		m_FreeBlocks.erase(it);
+		if (remaining > 0)
+		{
+			m_FreeBlocks.emplace(offset + size, remaining);
+		}
+
+		m_FreeSize -= size;
+		return offset;
+	}
+
+	return std::nullopt;
+}
+
+void FreeListAllocator::free(uint64_t offset, uint64_t size)
+{
+	assert(offset + size <= m_Capacity);
+	m_FreeSize += size;
+
+	auto next = m_FreeBlocks.lower_bound(offset);
+
+	// Merge with the following block
+	if (next != m_FreeBlocks.end() && offset + size == next->first)
+	{
+		size += next->second;
+		next = m_FreeBlocks.erase(next);
+	}
+
+	// Merge with the preceding block
+	if (next != m_FreeBlocks.begin())
+	{
+		auto prev = std::prev(next);
+		if (prev->first + prev->second == offset)
+		{
+			prev->second += size;
+			return;
+		}
+	}
+
+	m_FreeBlocks.emplace(offset, size);
+}
+
+void FreeListAllocator::reset(uint64_t used_size)
+{
+	assert(used_size <= m_Capacity);
+
+	m_FreeBlocks.clear();
+	if (used_size < m_Capacity)
+	{
+		m_FreeBlocks.emplace(used_size, m_Capacity - used_size);
+	}
+	m_FreeSize = m_Capacity - used_size;
+}
+
+uint64_t FreeListAllocator::getLargestFreeBlock() const
+{
+	uint64_t largest = 0;
+	for (const auto& [offset, size] : m_FreeBlocks)
+	{
+		largest = std::max(largest, size);
+	}
+	return largest;
+}
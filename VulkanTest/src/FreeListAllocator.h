@@ -0,0 +1,29 @@
+﻿#pragma once
+#include <cstdint>
+#include <map>
+#include <optional>
+
+/**
+ * First-fit allocator over an abstract range [0, capacity).
+ * Free blocks are kept sorted by offset so that a freed range is merged with its free neighbours.
+ */
+class FreeListAllocator
+{
+public:
+	void init(uint64_t capacity);
+
+	std::optional<uint64_t> allocate(uint64_t size);
+	void free(uint64_t offset, uint64_t size);
+
+	// Mark [0, used_size) as allocated and everything after it as free (after compacting the allocations)
+	void reset(uint64_t used_size);
+
+	uint64_t getCapacity() const { return m_Capacity; }
+	uint64_t getFreeSize() const { return m_FreeSize; }
+	uint64_t getLargestFreeBlock() const;
+
+private:
+	std::map<uint64_t, uint64_t> m_FreeBlocks; // offset -> size
+	uint64_t m_Capacity = 0;
+	uint64_t m_FreeSize = 0;
+};
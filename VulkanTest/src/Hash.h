@@ -0,0 +1,19 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * 64-bit FNV-1a, chained through the seed to hash several buffers into one key.
+ * (structs are hashed field by field, the padding of the struct is undefined)
+ */
+inline uint64_t hashBytes(const void* data, size_t size, uint64_t seed = 0xcbf29ce484222325ull)
+{
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	uint64_t value = seed;
+	for (size_t i = 0; i < size; i++)
+	{
+		value ^= bytes[i];
+		value *= 0x100000001b3ull;
+	}
+	return value;
+}
@@ -0,0 +1,261 @@
+﻿#include "Ktx2Loader.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace detail
+{
+	static constexpr uint8_t s_Ktx2Identifier[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+
+	// Layout of the file up to the level index
+	struct Ktx2FileHeader
+	{
+		uint8_t identifier[12];
+		uint32_t vkFormat;
+		uint32_t typeSize;
+		uint32_t pixelWidth;
+		uint32_t pixelHeight;
+		uint32_t pixelDepth;
+		uint32_t layerCount;
+		uint32_t faceCount;
+		uint32_t levelCount;
+		uint32_t supercompressionScheme;
+
+		uint32_t dfdByteOffset;
+		uint32_t dfdByteLength;
+		uint32_t kvdByteOffset;
+		uint32_t kvdByteLength;
+		uint64_t sgdByteOffset;
+		uint64_t sgdByteLength;
+	};
+	static_assert(sizeof(Ktx2FileHeader) == 80, "KTX2 header must be packed");
+
+	struct Ktx2LevelIndex
+	{
+		uint64_t byteOffset;
+		uint64_t byteLength;
+		uint64_t uncompressedByteLength;
+	};
+
+	struct Ktx2BlockInfo
+	{
+		uint32_t width;
+		uint32_t height;
+		uint32_t bytes;
+	};
+
+	// Texel block of the formats a 2D texture may use (a zero size for the others)
+	static Ktx2BlockInfo getBlockInfo(VkFormat format)
+	{
+		if (format >= VK_FORMAT_ASTC_4x4_UNORM_BLOCK && format <= VK_FORMAT_ASTC_12x12_SRGB_BLOCK)
+		{
+			// (UNORM and SRGB pairs, in the order of the enum)
+			static constexpr uint32_t s_AstcBlocks[][2] = {
+				{ 4, 4 }, { 5, 4 }, { 5, 5 }, { 6, 5 }, { 6, 6 }, { 8, 5 }, { 8, 6 },
+				{ 8, 8 }, { 10, 5 }, { 10, 6 }, { 10, 8 }, { 10, 10 }, { 12, 10 }, { 12, 12 },
+			};
+			const uint32_t* block = s_AstcBlocks[(format - VK_FORMAT_ASTC_4x4_UNORM_BLOCK) / 2];
+			return { block[0], block[1], 16 };
+		}
+
+		switch (format)
+		{
+		case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+		case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+		case VK_FORMAT_BC4_UNORM_BLOCK:
+		case VK_FORMAT_BC4_SNORM_BLOCK:
+		case VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK:
+		case VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK:
+		case VK_FORMAT_ETC2_R8G8B8A1_UNORM_BLOCK:
+		case VK_FORMAT_ETC2_R8G8B8A1_SRGB_BLOCK:
+		case VK_FORMAT_EAC_R11_UNORM_BLOCK:
+		case VK_FORMAT_EAC_R11_SNORM_BLOCK:
+			return { 4, 4, 8 };
+		case VK_FORMAT_BC2_UNORM_BLOCK:
+		case VK_FORMAT_BC2_SRGB_BLOCK:
+		case VK_FORMAT_BC3_UNORM_BLOCK:
+		case VK_FORMAT_BC3_SRGB_BLOCK:
+		case VK_FORMAT_BC5_UNORM_BLOCK:
+		case VK_FORMAT_BC5_SNORM_BLOCK:
+		case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+		case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+		case VK_FORMAT_BC7_UNORM_BLOCK:
+		case VK_FORMAT_BC7_SRGB_BLOCK:
+		case VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK:
+		case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK:
+		case VK_FORMAT_EAC_R11G11_UNORM_BLOCK:
+		case VK_FORMAT_EAC_R11G11_SNORM_BLOCK:
+			return { 4, 4, 16 };
+		case VK_FORMAT_R8_UNORM:
+		case VK_FORMAT_R8_SRGB:
+			return { 1, 1, 1 };
+		case VK_FORMAT_R8G8_UNORM:
+		case VK_FORMAT_R8G8_SRGB:
+		case VK_FORMAT_R16_UNORM:
+		case VK_FORMAT_R16_SFLOAT:
+			return { 1, 1, 2 };
+		case VK_FORMAT_R8G8B8A8_UNORM:
+		case VK_FORMAT_R8G8B8A8_SRGB:
+		case VK_FORMAT_B8G8R8A8_UNORM:
+		case VK_FORMAT_B8G8R8A8_SRGB:
+		case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+		case VK_FORMAT_R16G16_UNORM:
+		case VK_FORMAT_R16G16_SFLOAT:
+		case VK_FORMAT_R32_SFLOAT:
+		case VK_FORMAT_B10G11R11_UFLOAT_PACK32:
+		case VK_FORMAT_E5B9G9R9_UFLOAT_PACK32:
+			return { 1, 1, 4 };
+		case VK_FORMAT_R16G16B16A16_UNORM:
+		case VK_FORMAT_R16G16B16A16_SFLOAT:
+		case VK_FORMAT_R32G32_SFLOAT:
+			return { 1, 1, 8 };
+		case VK_FORMAT_R32G32B32A32_SFLOAT:
+			return { 1, 1, 16 };
+		default:
+			return { 1, 1, 0 };
+		}
+	}
+
+	static uint64_t getLevelSize(const Ktx2BlockInfo& block, uint32_t width, uint32_t height)
+	{
+		// (saturates instead of overflowing, no file can hold that much)
+		uint64_t rowBytes = (uint64_t(width) + block.width - 1) / block.width * block.bytes;
+		uint64_t blocksY = (uint64_t(height) + block.height - 1) / block.height;
+		return blocksY > UINT64_MAX / rowBytes ? UINT64_MAX : rowBytes * blocksY;
+	}
+
+	static Ktx2FileHeader readFileHeader(std::ifstream& file, const std::string& filepath)
+	{
+		Ktx2FileHeader fileHeader{};
+		file.read(reinterpret_cast<char*>(&fileHeader), sizeof(fileHeader));
+		if (!file || 0 != std::memcmp(fileHeader.identifier, s_Ktx2Identifier, sizeof(s_Ktx2Identifier)))
+		{
+			throw std::runtime_error("Invalid KTX2 file: " + filepath + "!");
+		}
+		return fileHeader;
+	}
+
+	static Ktx2Header toHeader(const Ktx2FileHeader& file_header)
+	{
+		Ktx2Header header{};
+		header.format = static_cast<VkFormat>(file_header.vkFormat);
+		header.width = file_header.pixelWidth;
+		header.height = std::max(1u, file_header.pixelHeight);
+		header.depth = file_header.pixelDepth;
+		header.layerCount = file_header.layerCount;
+		header.faceCount = file_header.faceCount;
+		header.levelCount = file_header.levelCount; // (0 asks the loader to generate the mips)
+		header.supercompressionScheme = file_header.supercompressionScheme;
+		return header;
+	}
+}
+
+Ktx2Header Ktx2Loader::readHeader(const std::string& filepath)
+{
+	std::ifstream file(filepath, std::ios::binary);
+	if (!file.is_open())
+	{
+		throw std::runtime_error("Failed to open file: " + filepath + "!");
+	}
+
+	return detail::toHeader(detail::readFileHeader(file, filepath));
+}
+
+Ktx2Image Ktx2Loader::load(const std::string& filepath)
+{
+	std::ifstream file(filepath, std::ios::binary);
+	if (!file.is_open())
+	{
+		throw std::runtime_error("Failed to open file: " + filepath + "!");
+	}
+
+	Ktx2Image image{};
+	image.header = detail::toHeader(detail::readFileHeader(file, filepath));
+
+	if (0 != image.header.supercompressionScheme || VK_FORMAT_UNDEFINED == image.header.format)
+	{
+		throw std::runtime_error("Supercompressed KTX2 textures are not supported: " + filepath + "!");
+	}
+	if (image.header.depth > 1 || image.header.layerCount > 1 || image.header.faceCount != 1)
+	{
+		throw std::runtime_error("Only 2D KTX2 textures are supported: " + filepath + "!");
+	}
+
+	// The levels are uploaded as stored : mips cannot be generated for compressed formats
+	if (0 == image.header.levelCount)
+	{
+		throw std::runtime_error("KTX2 textures without stored mip levels are not supported: " + filepath + "!");
+	}
+
+	detail::Ktx2BlockInfo block = detail::getBlockInfo(image.header.format);
+	if (0 == block.bytes || 0 == image.header.width
+	    || image.header.levelCount > MipmapGenerator::getMipLevelCount(image.header.width, image.header.height))
+	{
+		throw std::runtime_error("Invalid KTX2 format or extent: " + filepath + "!");
+	}
+
+	std::vector<detail::Ktx2LevelIndex> levelIndex(image.header.levelCount);
+	file.read(reinterpret_cast<char*>(levelIndex.data()), levelIndex.size() * sizeof(detail::Ktx2LevelIndex));
+	if (!file)
+	{
+		throw std::runtime_error("Invalid KTX2 level index: " + filepath + "!");
+	}
+
+	file.seekg(0, std::ios::end);
+	uint64_t fileSize = static_cast<uint64_t>(file.tellg());
+
+	// The levels are stored smallest first and each one is aligned to the texel block size,
+	// so the whole level data can be read at once and the offsets stay aligned for buffer to image copies
+	// (every level must lie within the file and hold at least the size its format and extent imply)
+	uint64_t dataBegin = UINT64_MAX, dataEnd = 0;
+	for (uint32_t level = 0; level < image.header.levelCount; level++)
+	{
+		const detail::Ktx2LevelIndex& levelRange = levelIndex[level];
+		uint64_t levelSize = detail::getLevelSize(block, std::max(1u, image.header.width >> level), std::max(1u, image.header.height >> level));
+		if (levelRange.byteOffset > fileSize || levelRange.byteLength > fileSize - levelRange.byteOffset || levelRange.byteLength < levelSize)
+		{
+			throw std::runtime_error("Invalid KTX2 level range: " + filepath + "!");
+		}
+
+		dataBegin = std::min(dataBegin, levelRange.byteOffset);
+		dataEnd = std::max(dataEnd, levelRange.byteOffset + levelRange.byteLength);
+	}
+
+	image.data.resize(static_cast<size_t>(dataEnd - dataBegin));
+	file.clear();
+	file.seekg(dataBegin);
+	file.read(reinterpret_cast<char*>(image.data.data()), image.data.size());
+	if (!file)
+	{
+		throw std::runtime_error("Failed to read KTX2 level data: " + filepath + "!");
+	}
+
+	image.levels.resize(image.header.levelCount);
+	for (uint32_t level = 0; level < image.header.levelCount; level++)
+	{
+		image.levels[level].width = std::max(1u, image.header.width >> level);
+		image.levels[level].height = std::max(1u, image.header.height >> level);
+		image.levels[level].offset = static_cast<size_t>(levelIndex[level].byteOffset - dataBegin);
+	}
+
+	return image;
+}
+
+bool Ktx2Loader::isFormatSupported(VkPhysicalDevice physical_device, VkFormat format)
+{
+	VkFormatProperties formatProperties;
+	vkGetPhysicalDeviceFormatProperties(physical_device, format, &formatProperties);
+
+	return 0 != (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
+}
+
+bool Ktx2Loader::isBlockCompressed(VkFormat format)
+{
+	return (format >= VK_FORMAT_BC1_RGB_UNORM_BLOCK && format <= VK_FORMAT_BC7_SRGB_BLOCK) ||
+	       (format >= VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK && format <= VK_FORMAT_EAC_R11G11_SNORM_BLOCK) ||
+	       (format >= VK_FORMAT_ASTC_4x4_UNORM_BLOCK && format <= VK_FORMAT_ASTC_12x12_SRGB_BLOCK);
+}
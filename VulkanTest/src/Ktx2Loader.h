@@ -0,0 +1,42 @@
+﻿#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+#include "MipmapGenerator.h"
+
+// Fields of the KTX2 header needed to decide whether a file can be used
+struct Ktx2Header
+{
+	VkFormat format;
+	uint32_t width;
+	uint32_t height;
+	uint32_t depth;
+	uint32_t layerCount;
+	uint32_t faceCount;
+	uint32_t levelCount; // (0 : the mips are to be generated, which load rejects)
+	uint32_t supercompressionScheme; // 0 : none, 1 : BasisLZ, 2 : zstd, 3 : zlib
+};
+
+// Image data of a KTX2 file, ready to be copied into an image with one region per level
+struct Ktx2Image
+{
+	Ktx2Header header{};
+	std::vector<MipLevel> levels;
+	std::vector<uint8_t> data;
+};
+
+/**
+ * Loader for KTX2 containers holding 2D textures in their final VkFormat (BCn, ETC2, ASTC or uncompressed).
+ * Supercompressed files (BasisLZ/UASTC transcoding, zstd, zlib) are rejected : no transcoder is linked in.
+ */
+struct Ktx2Loader
+{
+	static Ktx2Header readHeader(const std::string& filepath);
+	static Ktx2Image load(const std::string& filepath);
+
+	// The format must be sampleable with optimal tiling (block-compressed families depend on the device features)
+	static bool isFormatSupported(VkPhysicalDevice physical_device, VkFormat format);
+	static bool isBlockCompressed(VkFormat format);
+};
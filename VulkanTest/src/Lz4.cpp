@@ -0,0 +1,193 @@
+﻿#include "Lz4.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace detail
+{
+	static constexpr size_t s_MinMatch = 4;
+	static constexpr size_t s_LastLiterals = 5; // the last bytes of a block are always literals
+	static constexpr size_t s_MatchFindLimit = 12; // no match starts in the last bytes of a block
+	static constexpr size_t s_MaxOffset = 65535;
+	static constexpr uint32_t s_HashBits = 16;
+
+	static uint32_t read32(const uint8_t* ptr)
+	{
+		uint32_t value;
+		std::memcpy(&value, ptr, sizeof(value));
+		return value;
+	}
+
+	static uint32_t hash(uint32_t sequence)
+	{
+		return (sequence * 2654435761u) >> (32 - s_HashBits);
+	}
+
+	// Writes the 255-byte continuation of a length field
+	static bool writeLength(size_t length, uint8_t*& op, const uint8_t* op_end)
+	{
+		for (; length >= 255; length -= 255)
+		{
+			if (op >= op_end)
+				return false;
+			*op++ = 255;
+		}
+		if (op >= op_end)
+			return false;
+		*op++ = static_cast<uint8_t>(length);
+		return true;
+	}
+
+	static bool readLength(size_t& length, const uint8_t*& ip, const uint8_t* ip_end)
+	{
+		uint8_t byte;
+		do
+		{
+			if (ip >= ip_end)
+				return false;
+			byte = *ip++;
+			length += byte;
+		} while (255 == byte);
+		return true;
+	}
+
+	static bool writeSequence(const uint8_t* literals, size_t literal_length, size_t offset, size_t match_length, uint8_t*& op, const uint8_t* op_end)
+	{
+		if (op >= op_end)
+			return false;
+
+		uint8_t* token = op++;
+		*token = static_cast<uint8_t>(std::min<size_t>(literal_length, 15) << 4);
+		if (literal_length >= 15 && !writeLength(literal_length - 15, op, op_end))
+			return false;
+
+		if (static_cast<size_t>(op_end - op) < literal_length)
+			return false;
+		if (literal_length)
+		{
+			std::memcpy(op, literals, literal_length);
+			op += literal_length;
+		}
+
+		// (the last sequence has no match)
+		if (0 == match_length)
+			return true;
+
+		if (op_end - op < 2)
+			return false;
+		*op++ = static_cast<uint8_t>(offset);
+		*op++ = static_cast<uint8_t>(offset >> 8);
+
+		size_t matchCode = match_length - s_MinMatch;
+		*token |= static_cast<uint8_t>(std::min<size_t>(matchCode, 15));
+		return matchCode < 15 || writeLength(matchCode - 15, op, op_end);
+	}
+}
+
+size_t Lz4::compress(const uint8_t* src, size_t src_size, uint8_t* dst, size_t dst_capacity)
+{
+	uint8_t* op = dst;
+	const uint8_t* opEnd = dst + dst_capacity;
+
+	size_t anchor = 0;
+	if (src_size > detail::s_MatchFindLimit)
+	{
+		// Positions + 1 of the last occurence of each hashed 4-byte sequence (0 when empty)
+		std::vector<uint32_t> table(size_t(1) << detail::s_HashBits, 0);
+
+		const size_t matchLimit = src_size - detail::s_LastLiterals;
+		size_t position = 0;
+		while (position + detail::s_MatchFindLimit <= src_size)
+		{
+			uint32_t sequence = detail::read32(src + position);
+			uint32_t& entry = table[detail::hash(sequence)];
+			size_t candidate = entry;
+			entry = static_cast<uint32_t>(position + 1);
+
+			if (0 == candidate || position - (candidate - 1) > detail::s_MaxOffset || detail::read32(src + candidate - 1) != sequence)
+			{
+				position++;
+				continue;
+			}
+			candidate--;
+
+			size_t matchLength = detail::s_MinMatch;
+			while (position + matchLength < matchLimit && src[candidate + matchLength] == src[position + matchLength])
+			{
+				matchLength++;
+			}
+
+			if (!detail::writeSequence(src + anchor, position - anchor, position - candidate, matchLength, op, opEnd))
+				return 0;
+
+			position += matchLength;
+			anchor = position;
+		}
+	}
+
+	if (!detail::writeSequence(src + anchor, src_size - anchor, 0, 0, op, opEnd))
+		return 0;
+
+	return static_cast<size_t>(op - dst);
+}
+
+bool Lz4::decompress(const uint8_t* src, size_t src_size, uint8_t* dst, size_t dst_size)
+{
+	const uint8_t* ip = src;
+	const uint8_t* ipEnd = src + src_size;
+	uint8_t* op = dst;
+	uint8_t* opEnd = dst + dst_size;
+
+	for (;;)
+	{
+		if (ip >= ipEnd)
+			return false;
+		uint8_t token = *ip++;
+
+		size_t literalLength = token >> 4;
+		if (15 == literalLength && !detail::readLength(literalLength, ip, ipEnd))
+			return false;
+		if (static_cast<size_t>(ipEnd - ip) < literalLength || static_cast<size_t>(opEnd - op) < literalLength)
+			return false;
+		if (literalLength)
+		{
+			std::memcpy(op, ip, literalLength);
+			ip += literalLength;
+			op += literalLength;
+		}
+
+		// The last sequence ends the block right after its literals
+		if (ip == ipEnd)
+			return op == opEnd;
+
+		if (ipEnd - ip < 2)
+			return false;
+		size_t offset = size_t(ip[0]) | (size_t(ip[1]) << 8);
+		ip += 2;
+		if (0 == offset || offset > static_cast<size_t>(op - dst))
+			return false;
+
+		size_t matchLength = token & 15;
+		if (15 == matchLength && !detail::readLength(matchLength, ip, ipEnd))
+			return false;
+		matchLength += detail::s_MinMatch;
+		if (static_cast<size_t>(opEnd - op) < matchLength)
+			return false;
+
+		// Matches may overlap their own output (offset < length repeats the pattern)
+		const uint8_t* match = op - offset;
+		if (offset >= matchLength)
+		{
+			std::memcpy(op, match, matchLength);
+			op += matchLength;
+		}
+		else
+		{
+			for (size_t i = 0; i < matchLength; i++)
+			{
+				*op++ = match[i];
+			}
+		}
+	}
+}
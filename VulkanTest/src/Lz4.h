@@ -0,0 +1,18 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * LZ4 block format (no frame), compatible with the reference implementation.
+ * The compressor is a simple greedy single-probe matcher : fast and good enough for offline packing.
+ */
+struct Lz4
+{
+	static size_t getMaxCompressedSize(size_t size) { return size + size / 255 + 16; }
+
+	// Returns the compressed size, 0 if dst is too small
+	static size_t compress(const uint8_t* src, size_t src_size, uint8_t* dst, size_t dst_capacity);
+
+	// The decompressed size must be known, returns false on corrupt input
+	static bool decompress(const uint8_t* src, size_t src_size, uint8_t* dst, size_t dst_size);
+};
@@ -0,0 +1,107 @@
+﻿#include "MappedFile.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::string& filepath)
+{
+	close();
+
+	HANDLE file = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (INVALID_HANDLE_VALUE == file)
+		return false;
+
+	LARGE_INTEGER size{};
+	if (!GetFileSizeEx(file, &size) || 0 == size.QuadPart)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mapping)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!data)
+	{
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	m_File = file;
+	m_Mapping = mapping;
+	m_Data = static_cast<const uint8_t*>(data);
+	m_Size = static_cast<size_t>(size.QuadPart);
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (m_Data)
+	{
+		UnmapViewOfFile(m_Data);
+		CloseHandle(m_Mapping);
+		CloseHandle(m_File);
+	}
+	m_Data = nullptr;
+	m_Size = 0;
+	m_File = nullptr;
+	m_Mapping = nullptr;
+}
+
+#else
+
+bool MappedFile::open(const std::string& filepath)
+{
+	close();
+
+	int file = ::open(filepath.c_str(), O_RDONLY);
+	if (file < 0)
+		return false;
+
+	struct stat status{};
+	if (0 != fstat(file, &status) || 0 == status.st_size)
+	{
+		::close(file);
+		return false;
+	}
+
+	// (the mapping keeps its own reference to the file)
+	void* data = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+	::close(file);
+	if (MAP_FAILED == data)
+		return false;
+
+	m_Data = static_cast<const uint8_t*>(data);
+	m_Size = static_cast<size_t>(status.st_size);
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (m_Data)
+	{
+		munmap(const_cast<uint8_t*>(m_Data), m_Size);
+	}
+	m_Data = nullptr;
+	m_Size = 0;
+}
+
+#endif
@@ -0,0 +1,34 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * Read-only memory mapping of a whole file (pages are loaded by the OS on first access).
+ */
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile() { close(); }
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// Returns false if the file cannot be opened or mapped (empty files cannot be mapped)
+	bool open(const std::string& filepath);
+	void close();
+
+	bool isOpen() const { return nullptr != m_Data; }
+	const uint8_t* getData() const { return m_Data; }
+	size_t getSize() const { return m_Size; }
+
+private:
+	const uint8_t* m_Data = nullptr;
+	size_t m_Size = 0;
+
+#ifdef _WIN32
+	void* m_File = nullptr;
+	void* m_Mapping = nullptr;
+#endif
+};
@@ -0,0 +1,119 @@
+﻿#include "MeshImporter.h"
+
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+
+namespace detail
+{
+	static constexpr size_t s_MaxVertices16 = size_t(std::numeric_limits<uint16_t>::max()) + 1;
+
+	static MeshChunk packChunk(const MeshData& mesh_data, VkIndexType index_type)
+	{
+		MeshChunk chunk{};
+		chunk.vertices = mesh_data.vertices;
+		chunk.indexCount = static_cast<uint32_t>(mesh_data.indices.size());
+		chunk.indexType = index_type;
+		chunk.indices.resize(mesh_data.indices.size() * MeshImporter::getIndexSize(index_type));
+
+		if (VK_INDEX_TYPE_UINT16 == index_type)
+		{
+			uint16_t* indices = reinterpret_cast<uint16_t*>(chunk.indices.data());
+			for (size_t i = 0; i < mesh_data.indices.size(); i++)
+			{
+				indices[i] = static_cast<uint16_t>(mesh_data.indices[i]);
+			}
+		}
+		else
+		{
+			std::memcpy(chunk.indices.data(), mesh_data.indices.data(), chunk.indices.size());
+		}
+
+		return chunk;
+	}
+}
+
+VkIndexType MeshImporter::chooseIndexType(size_t vertex_count)
+{
+	return vertex_count <= detail::s_MaxVertices16 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+}
+
+VkDeviceSize MeshImporter::getIndexSize(VkIndexType index_type)
+{
+	return VK_INDEX_TYPE_UINT16 == index_type ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+std::vector<MeshChunk> MeshImporter::prepare(const MeshData& mesh_data)
+{
+	VkIndexType indexType = chooseIndexType(mesh_data.vertices.size());
+	if (VK_INDEX_TYPE_UINT16 == indexType)
+	{
+		return { detail::packChunk(mesh_data, indexType) };
+	}
+
+	// Compare the size of the 32-bit mesh against the split one
+	std::vector<MeshData> splitMeshes = splitTo16Bit(mesh_data);
+
+	size_t splitVertexCount = 0;
+	for (const MeshData& splitMesh : splitMeshes)
+	{
+		splitVertexCount += splitMesh.vertices.size();
+	}
+
+	size_t size32 = mesh_data.vertices.size() * sizeof(Vertex) + mesh_data.indices.size() * sizeof(uint32_t);
+	size_t size16 = splitVertexCount * sizeof(Vertex) + mesh_data.indices.size() * sizeof(uint16_t);
+	if (size32 <= size16)
+	{
+		return { detail::packChunk(mesh_data, VK_INDEX_TYPE_UINT32) };
+	}
+
+	std::vector<MeshChunk> chunks;
+	chunks.reserve(splitMeshes.size());
+	for (const MeshData& splitMesh : splitMeshes)
+	{
+		chunks.push_back(detail::packChunk(splitMesh, VK_INDEX_TYPE_UINT16));
+	}
+	return chunks;
+}
+
+std::vector<MeshData> MeshImporter::splitTo16Bit(const MeshData& mesh_data)
+{
+	std::vector<MeshData> splitMeshes(1);
+	std::unordered_map<uint32_t, uint32_t> remap; // source vertex -> vertex in the current chunk
+
+	for (size_t triangle = 0; triangle + 2 < mesh_data.indices.size(); triangle += 3)
+	{
+		// Count the vertices the triangle adds to the current chunk
+		size_t newVertices = 0;
+		for (size_t corner = 0; corner < 3; corner++)
+		{
+			uint32_t index = mesh_data.indices[triangle + corner];
+			bool seen = remap.count(index) > 0;
+			for (size_t previous = 0; previous < corner && !seen; previous++)
+			{
+				seen = mesh_data.indices[triangle + previous] == index;
+			}
+			newVertices += seen ? 0 : 1;
+		}
+
+		if (splitMeshes.back().vertices.size() + newVertices > detail::s_MaxVertices16)
+		{
+			splitMeshes.emplace_back();
+			remap.clear();
+		}
+
+		MeshData& splitMesh = splitMeshes.back();
+		for (size_t corner = 0; corner < 3; corner++)
+		{
+			uint32_t index = mesh_data.indices[triangle + corner];
+			auto [it, inserted] = remap.try_emplace(index, static_cast<uint32_t>(splitMesh.vertices.size()));
+			if (inserted)
+			{
+				splitMesh.vertices.push_back(mesh_data.vertices[index]);
+			}
+			splitMesh.indices.push_back(it->second);
+		}
+	}
+
+	return splitMeshes;
+}
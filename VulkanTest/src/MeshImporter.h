@@ -0,0 +1,40 @@
+﻿#pragma once
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+#include "BufferData.h"
+
+// Mesh as it comes out of a loader, before choosing how it is stored on the GPU
+struct MeshData
+{
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+};
+
+// Mesh ready to be uploaded : indices are packed in the chosen index type
+struct MeshChunk
+{
+	std::vector<Vertex> vertices;
+	std::vector<uint8_t> indices;
+	uint32_t indexCount = 0;
+	VkIndexType indexType = VK_INDEX_TYPE_UINT16;
+};
+
+struct MeshImporter
+{
+	// Narrowest index type able to address every vertex (indexed draws add the vertex offset, so indices stay local to the mesh)
+	static VkIndexType chooseIndexType(size_t vertex_count);
+	static VkDeviceSize getIndexSize(VkIndexType index_type);
+
+	/**
+	 * Pack a mesh for upload :
+	 *  - meshes with up to 65536 vertices use 16-bit indices
+	 *  - larger meshes are split into 16-bit addressable chunks, unless the vertices duplicated along the chunk borders
+	 *    cost more memory than 32-bit indices would
+	 */
+	static std::vector<MeshChunk> prepare(const MeshData& mesh_data);
+
+	// Split the triangle list in order, starting a new chunk whenever the next triangle would need more than 65536 vertices
+	static std::vector<MeshData> splitTo16Bit(const MeshData& mesh_data);
+};
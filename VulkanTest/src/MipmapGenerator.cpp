@@ -0,0 +1,168 @@
+﻿#include "MipmapGenerator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VKTUT_MIPMAP_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace detail
+{
+	static constexpr uint32_t s_LinearBits = 12;
+	static constexpr uint32_t s_LinearMax = (1u << s_LinearBits) - 1;
+
+	// 8-bit -> 12-bit linear and back, built once
+	struct ConversionTables
+	{
+		uint16_t srgbToLinear[256];
+		uint16_t unormToLinear[256];
+		uint8_t linearToSrgb[s_LinearMax + 1];
+		uint8_t linearToUnorm[s_LinearMax + 1];
+
+		ConversionTables()
+		{
+			for (uint32_t i = 0; i < 256; i++)
+			{
+				float c = static_cast<float>(i) / 255.f;
+				float linear = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+				srgbToLinear[i] = static_cast<uint16_t>(linear * s_LinearMax + 0.5f);
+				unormToLinear[i] = static_cast<uint16_t>(c * s_LinearMax + 0.5f);
+			}
+			for (uint32_t i = 0; i <= s_LinearMax; i++)
+			{
+				float linear = static_cast<float>(i) / s_LinearMax;
+				float c = linear <= 0.0031308f ? linear * 12.92f : 1.055f * std::pow(linear, 1.f / 2.4f) - 0.055f;
+				linearToSrgb[i] = static_cast<uint8_t>(std::clamp(c, 0.f, 1.f) * 255.f + 0.5f);
+				linearToUnorm[i] = static_cast<uint8_t>(linear * 255.f + 0.5f);
+			}
+		}
+	};
+
+	static const ConversionTables& getConversionTables()
+	{
+		static ConversionTables tables;
+		return tables;
+	}
+
+	// 2x2 box filter of a 16-bit RGBA level (values are at most 12 bits, so the sum of 4 cannot overflow)
+	static void downsample(const uint16_t* src, uint32_t src_width, uint32_t src_height, uint16_t* dst, uint32_t dst_width, uint32_t dst_height)
+	{
+		for (uint32_t y = 0; y < dst_height; y++)
+		{
+			const uint16_t* row0 = src + size_t(std::min(2 * y, src_height - 1)) * src_width * 4;
+			const uint16_t* row1 = src + size_t(std::min(2 * y + 1, src_height - 1)) * src_width * 4;
+			uint16_t* dstRow = dst + size_t(y) * dst_width * 4;
+
+			uint32_t x = 0;
+#ifdef VKTUT_MIPMAP_SSE2
+			// Two destination pixels (four source pixels per row) at a time, while the source pixels are all inside the row
+			const __m128i rounding = _mm_set1_epi16(2);
+			for (; 2 * x + 3 < src_width && x + 1 < dst_width; x += 2)
+			{
+				__m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + 8 * x));
+				__m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + 8 * x + 8));
+				__m128i a1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + 8 * x));
+				__m128i b1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + 8 * x + 8));
+
+				__m128i sum0 = _mm_add_epi16(a0, a1); // pixels 0, 1
+				__m128i sum1 = _mm_add_epi16(b0, b1); // pixels 2, 3
+				__m128i sum = _mm_add_epi16(_mm_unpacklo_epi64(sum0, sum1), _mm_unpackhi_epi64(sum0, sum1));
+				sum = _mm_srli_epi16(_mm_add_epi16(sum, rounding), 2);
+
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dstRow + 4 * x), sum);
+			}
+#endif
+			for (; x < dst_width; x++)
+			{
+				uint32_t x0 = std::min(2 * x, src_width - 1);
+				uint32_t x1 = std::min(2 * x + 1, src_width - 1);
+				for (uint32_t c = 0; c < 4; c++)
+				{
+					uint32_t sum = row0[4 * x0 + c] + row0[4 * x1 + c] + row1[4 * x0 + c] + row1[4 * x1 + c];
+					dstRow[4 * x + c] = static_cast<uint16_t>((sum + 2) >> 2);
+				}
+			}
+		}
+	}
+}
+
+uint32_t MipmapGenerator::getMipLevelCount(uint32_t width, uint32_t height)
+{
+	uint32_t levels = 1;
+	for (uint32_t size = std::max(width, height); size > 1; size /= 2)
+	{
+		levels++;
+	}
+	return levels;
+}
+
+size_t MipmapGenerator::getMipChainLayout(uint32_t width, uint32_t height, std::vector<MipLevel>& levels)
+{
+	uint32_t levelCount = getMipLevelCount(width, height);
+	levels.resize(levelCount);
+
+	size_t chainSize = 0;
+	for (uint32_t level = 0; level < levelCount; level++)
+	{
+		levels[level].width = std::max(1u, width >> level);
+		levels[level].height = std::max(1u, height >> level);
+		levels[level].offset = chainSize;
+		chainSize += size_t(levels[level].width) * levels[level].height * 4;
+	}
+
+	return chainSize;
+}
+
+std::vector<uint8_t> MipmapGenerator::generateRGBA8(const uint8_t* pixels, uint32_t width, uint32_t height, bool srgb, std::vector<MipLevel>& levels)
+{
+	std::vector<uint8_t> chain(getMipChainLayout(width, height, levels));
+	std::memcpy(chain.data(), pixels, size_t(width) * height * 4);
+
+	generateRGBA8InPlace(chain.data(), srgb, levels);
+
+	return chain;
+}
+
+void MipmapGenerator::generateRGBA8InPlace(uint8_t* chain, bool srgb, const std::vector<MipLevel>& levels)
+{
+	const detail::ConversionTables& tables = detail::getConversionTables();
+	const uint16_t* toLinear = srgb ? tables.srgbToLinear : tables.unormToLinear;
+	const uint8_t* fromLinear = srgb ? tables.linearToSrgb : tables.linearToUnorm;
+
+	const uint8_t* pixels = chain + levels[0].offset;
+	uint32_t levelCount = static_cast<uint32_t>(levels.size());
+
+	// Filter in 12-bit linear space (alpha is always linear)
+	std::vector<uint16_t> current(size_t(levels[0].width) * levels[0].height * 4);
+	for (size_t i = 0; i < current.size(); i += 4)
+	{
+		current[i + 0] = toLinear[pixels[i + 0]];
+		current[i + 1] = toLinear[pixels[i + 1]];
+		current[i + 2] = toLinear[pixels[i + 2]];
+		current[i + 3] = tables.unormToLinear[pixels[i + 3]];
+	}
+
+	std::vector<uint16_t> next;
+	for (uint32_t level = 1; level < levelCount; level++)
+	{
+		const MipLevel& src = levels[level - 1];
+		const MipLevel& dst = levels[level];
+
+		next.resize(size_t(dst.width) * dst.height * 4);
+		detail::downsample(current.data(), src.width, src.height, next.data(), dst.width, dst.height);
+
+		uint8_t* dstPixels = chain + dst.offset;
+		for (size_t i = 0; i < next.size(); i += 4)
+		{
+			dstPixels[i + 0] = fromLinear[next[i + 0]];
+			dstPixels[i + 1] = fromLinear[next[i + 1]];
+			dstPixels[i + 2] = fromLinear[next[i + 2]];
+			dstPixels[i + 3] = tables.linearToUnorm[next[i + 3]];
+		}
+
+		std::swap(current, next);
+	}
+}
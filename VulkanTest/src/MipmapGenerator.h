@@ -0,0 +1,32 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Placement of one level in a packed mip chain
+struct MipLevel
+{
+	uint32_t width;
+	uint32_t height;
+	size_t offset; // in bytes from the start of the chain
+};
+
+/**
+ * CPU mip chain generation for RGBA8 images : the chains of streamed textures (kept in system memory to stream
+ * the levels from), and the atlas layers when the GPU cannot blit with linear filtering.
+ * Every level is a 2x2 box filter of the previous one (odd edges are clamped). sRGB color channels are
+ * averaged in linear space with 12 bits of precision, the filtering itself is vectorized with SSE2 when available.
+ */
+struct MipmapGenerator
+{
+	static uint32_t getMipLevelCount(uint32_t width, uint32_t height);
+
+	// Lays out the levels one after the other and returns the size of the whole chain
+	static size_t getMipChainLayout(uint32_t width, uint32_t height, std::vector<MipLevel>& levels);
+
+	// Returns the complete chain (level 0 included) with the levels packed one after the other
+	static std::vector<uint8_t> generateRGBA8(const uint8_t* pixels, uint32_t width, uint32_t height, bool srgb, std::vector<MipLevel>& levels);
+
+	// Fills levels 1.. of a chain laid out by getMipChainLayout whose level 0 is already in place
+	static void generateRGBA8InPlace(uint8_t* chain, bool srgb, const std::vector<MipLevel>& levels);
+};
@@ -0,0 +1,209 @@
+﻿#include "PerfRegression.h"
+
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+namespace detail
+{
+	// Reader of the baseline file : nested objects of numbers, flattened to "scenes.<scene>.<metric>" paths
+	// (the file is written by writeBaseline, anything else than objects, strings as keys and numbers is rejected)
+	struct BaselineParser
+	{
+		explicit BaselineParser(const std::string& text) : text(text) {}
+
+		const std::string& text;
+		size_t offset = 0;
+		std::vector<std::pair<std::string, double>> values;
+
+		void skipSpaces()
+		{
+			while (offset < text.size() && std::isspace(static_cast<unsigned char>(text[offset])))
+				offset++;
+		}
+
+		bool consume(char c)
+		{
+			skipSpaces();
+			if (offset >= text.size() || c != text[offset])
+				return false;
+			offset++;
+			return true;
+		}
+
+		bool parseString(std::string& string)
+		{
+			if (!consume('"'))
+				return false;
+			size_t end = text.find('"', offset);
+			if (std::string::npos == end)
+				return false;
+			string = text.substr(offset, end - offset);
+			offset = end + 1;
+			return true;
+		}
+
+		bool parseObject(const std::string& path)
+		{
+			if (!consume('{'))
+				return false;
+			if (consume('}'))
+				return true;
+
+			do
+			{
+				std::string key;
+				if (!parseString(key) || !consume(':'))
+					return false;
+
+				std::string keyPath = path.empty() ? key : path + "." + key;
+				skipSpaces();
+				if (offset < text.size() && '{' == text[offset])
+				{
+					if (!parseObject(keyPath))
+						return false;
+					continue;
+				}
+
+				const char* begin = text.c_str() + offset;
+				char* end = nullptr;
+				double value = std::strtod(begin, &end);
+				if (end == begin)
+					return false;
+				offset += end - begin;
+				values.emplace_back(keyPath, value);
+			} while (consume(','));
+
+			return consume('}');
+		}
+	};
+
+	static RegressionMetrics* findOrAdd(RegressionBaseline& baseline, const std::string& scene)
+	{
+		for (auto& [name, metrics] : baseline.scenes)
+		{
+			if (name == scene)
+				return &metrics;
+		}
+		baseline.scenes.emplace_back(scene, RegressionMetrics{});
+		return &baseline.scenes.back().second;
+	}
+
+	// Returns false if the value regressed past the tolerance
+	// (lower is better metrics also get an absolute slack, for the baselines at or near zero)
+	static bool compareMetric(const char* name, double value, double baseline, double tolerance, bool higher_is_better, double slack = 0.0)
+	{
+		bool regressed = higher_is_better ? value < baseline * (1.0 - tolerance)
+		                                  : value > baseline * (1.0 + tolerance) + slack;
+		double change = 0.0 != baseline ? 100.0 * (value - baseline) / baseline : 0.0;
+		printf("  %-20s : %14.2lf (baseline %14.2lf, %+7.1lf%%)%s\n", name, value, baseline, change, regressed ? "  REGRESSED" : "");
+		return !regressed;
+	}
+}
+
+const RegressionMetrics* RegressionBaseline::find(const std::string& scene) const
+{
+	for (const auto& [name, metrics] : scenes)
+	{
+		if (name == scene)
+			return &metrics;
+	}
+	return nullptr;
+}
+
+const std::vector<RegressionScene>& PerfRegression::getScenes()
+{
+	static const std::vector<RegressionScene> s_Scenes = {
+		// name                objects  textures  subdivisions  texture budget
+		{ "many-small-draws",  8192,    2,        1,            0 },
+		{ "few-huge-meshes",   4,       2,        255,          0 },
+		{ "texture-heavy",     256,     64,       1,            0 },
+		{ "upload-storm",      1024,    2,        1,            256 * 1024 }, // (the scene texture keeps losing and regaining levels)
+	};
+	return s_Scenes;
+}
+
+bool PerfRegression::loadBaseline(const std::string& file, RegressionBaseline& baseline)
+{
+	std::ifstream input(file);
+	if (!input.is_open())
+		return false;
+
+	std::stringstream buffer;
+	buffer << input.rdbuf();
+	std::string text = buffer.str();
+
+	detail::BaselineParser parser{ text };
+	if (!parser.parseObject(""))
+		return false;
+
+	baseline = {};
+	for (const auto& [path, value] : parser.values)
+	{
+		if ("tolerance" == path)
+		{
+			baseline.tolerance = value;
+			continue;
+		}
+
+		// scenes.<scene>.<metric>
+		size_t metricSeparator = path.rfind('.');
+		if (0 != path.rfind("scenes.", 0) || metricSeparator <= 7)
+			continue;
+
+		RegressionMetrics* metrics = detail::findOrAdd(baseline, path.substr(7, metricSeparator - 7));
+		std::string metric = path.substr(metricSeparator + 1);
+		if ("drawsPerSecond" == metric)           metrics->drawsPerSecond = value;
+		else if ("uploadMBPerFrame" == metric)    metrics->uploadMBPerFrame = value;
+		else if ("allocationsPerFrame" == metric) metrics->allocationsPerFrame = value;
+	}
+	return true;
+}
+
+void PerfRegression::writeBaseline(const std::string& file, const RegressionBaseline& baseline)
+{
+	std::ofstream output(file, std::ios::trunc);
+	if (!output.is_open())
+	{
+		throw std::runtime_error("Failed to open regression baseline file!");
+	}
+
+	output << std::fixed << std::setprecision(2);
+	output << "{\n";
+	output << "\t\"tolerance\": " << baseline.tolerance << ",\n";
+	output << "\t\"scenes\": {";
+	for (size_t i = 0; i < baseline.scenes.size(); i++)
+	{
+		const auto& [name, metrics] = baseline.scenes[i];
+		output << (0 == i ? "\n" : ",\n");
+		output << "\t\t\"" << name << "\": { \"drawsPerSecond\": " << metrics.drawsPerSecond << ", \"uploadMBPerFrame\": " << metrics.uploadMBPerFrame
+		       << ", \"allocationsPerFrame\": " << metrics.allocationsPerFrame << " }";
+	}
+	output << "\n\t}\n}\n";
+
+	if (!output.good())
+	{
+		throw std::runtime_error("Failed to write regression baseline file!");
+	}
+}
+
+bool PerfRegression::compare(const std::string& scene, const RegressionMetrics& metrics, const RegressionBaseline& baseline)
+{
+	const RegressionMetrics* reference = baseline.find(scene);
+	if (!reference)
+	{
+		printf("  no baseline for this scene (added by a run with --update-baseline)  REGRESSED\n");
+		return false;
+	}
+
+	bool passed = true;
+	passed &= detail::compareMetric("Draws/s", metrics.drawsPerSecond, reference->drawsPerSecond, baseline.tolerance, true);
+	passed &= detail::compareMetric("Upload MB/frame", metrics.uploadMBPerFrame, reference->uploadMBPerFrame, baseline.tolerance, false, 0.01);
+	// (an allocation every other frame is noise rather than a regression)
+	passed &= detail::compareMetric("Allocations/frame", metrics.allocationsPerFrame, reference->allocationsPerFrame, baseline.tolerance, false, 0.5);
+	return passed;
+}
@@ -0,0 +1,49 @@
+﻿#pragma once
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Synthetic scene of the regression suite, rendered headless on a simulated clock like a benchmark
+struct RegressionScene
+{
+	const char* name;
+	uint32_t objectCount;
+	uint32_t textureCount;
+	uint32_t meshSubdivisions;
+	uint64_t textureBudget; // bytes the streamed textures may use (0 : derived from the device memory budget)
+};
+
+// CPU-side metrics of a scene, all per second of CPU frame time or per frame
+struct RegressionMetrics
+{
+	double drawsPerSecond = 0.0;      // objects drawn after culling (higher is better)
+	double uploadMBPerFrame = 0.0;    // texture levels staged for streaming (lower is better : less residency churn)
+	double allocationsPerFrame = 0.0; // Vulkan host allocations (lower is better)
+};
+
+struct RegressionBaseline
+{
+	double tolerance = 0.15; // relative change allowed before a metric counts as regressed
+	std::vector<std::pair<std::string, RegressionMetrics>> scenes;
+
+	const RegressionMetrics* find(const std::string& scene) const;
+};
+
+/**
+ * Guards the CPU hot paths : every scene of the suite is measured and compared against a baseline file
+ * { "tolerance", "scenes" : { "<scene>" : { "drawsPerSecond", "uploadMBPerFrame", "allocationsPerFrame" }, ... } }
+ * Baselines depend on the machine : no baseline is committed, one is written by a run with --update-baseline on the
+ * machine the suite guards (and named after it). Without a baseline file the suite refuses to run, a scene missing
+ * from the baseline fails it until the baseline is updated.
+ */
+struct PerfRegression
+{
+	static const std::vector<RegressionScene>& getScenes();
+
+	static bool loadBaseline(const std::string& file, RegressionBaseline& baseline);
+	static void writeBaseline(const std::string& file, const RegressionBaseline& baseline);
+
+	// Prints a line per metric, returns false if any metric regressed past the tolerance or the scene has no baseline
+	static bool compare(const std::string& scene, const RegressionMetrics& metrics, const RegressionBaseline& baseline);
+};
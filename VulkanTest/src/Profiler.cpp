@@ -0,0 +1,183 @@
+﻿#include "Profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace detail
+{
+	struct ProfileEvent
+	{
+		const char* name;
+		uint64_t begin;
+		uint64_t end;
+	};
+
+	// Ring of the events of one track, written by a single thread
+	struct ProfileTrack
+	{
+		std::string name;
+		uint32_t id = 0;
+		bool steadyTime = false; // events in steady clock nanoseconds rather than profiler ticks
+		std::unique_ptr<ProfileEvent[]> events;
+		std::atomic<uint64_t> written{ 0 };
+
+		void record(const char* event_name, uint64_t begin, uint64_t end)
+		{
+			uint64_t index = written.load(std::memory_order_relaxed);
+			events[index % Profiler::THREAD_EVENT_COUNT] = { event_name, begin, end };
+			written.store(index + 1, std::memory_order_release);
+		}
+	};
+
+	// The tracks outlive their threads, so that the scopes of finished threads are still exported
+	static std::mutex s_TracksMutex;
+	static std::vector<std::unique_ptr<ProfileTrack>> s_Tracks;
+	static ProfileTrack* s_GpuTrack = nullptr;
+
+	// Both clocks read at startup, to convert ticks into steady time
+	static const uint64_t s_ReferenceTicks = Profiler::now();
+	static const uint64_t s_ReferenceTime = Profiler::getSteadyTime();
+
+	static ProfileTrack* createTrack(const char* name)
+	{
+		auto track = std::make_unique<ProfileTrack>();
+		track->events = std::make_unique<ProfileEvent[]>(Profiler::THREAD_EVENT_COUNT);
+
+		std::lock_guard<std::mutex> lock(s_TracksMutex);
+		track->id = static_cast<uint32_t>(s_Tracks.size()) + 1;
+		track->name = name ? name : "Thread " + std::to_string(track->id);
+		s_Tracks.push_back(std::move(track));
+		return s_Tracks.back().get();
+	}
+
+	static ProfileTrack& getThreadTrack()
+	{
+		thread_local ProfileTrack* t_Track = createTrack(nullptr);
+		return *t_Track;
+	}
+
+	static std::string escapeJson(const char* text)
+	{
+		std::string escaped;
+		for (; *text; text++)
+		{
+			if ('"' == *text || '\\' == *text)
+				escaped += '\\';
+			escaped += *text;
+		}
+		return escaped;
+	}
+}
+
+void Profiler::record(const char* name, uint64_t begin, uint64_t end)
+{
+	detail::getThreadTrack().record(name, begin, end);
+}
+
+void Profiler::setThreadName(const char* name)
+{
+	detail::ProfileTrack& track = detail::getThreadTrack();
+	std::lock_guard<std::mutex> lock(detail::s_TracksMutex);
+	track.name = name;
+}
+
+void Profiler::recordGpu(const char* name, uint64_t begin, uint64_t end)
+{
+	if (!detail::s_GpuTrack)
+	{
+		detail::s_GpuTrack = detail::createTrack("GPU");
+		detail::s_GpuTrack->steadyTime = true;
+	}
+	detail::s_GpuTrack->record(name, begin, end);
+}
+
+bool Profiler::writeChromeTrace(const std::string& file)
+{
+	std::ofstream output(file);
+	if (!output)
+	{
+		printf("[WARN] Failed to write the trace to %s!\n", file.c_str());
+		return false;
+	}
+
+	std::vector<detail::ProfileTrack*> tracks;
+	{
+		std::lock_guard<std::mutex> lock(detail::s_TracksMutex);
+		for (const std::unique_ptr<detail::ProfileTrack>& track : detail::s_Tracks)
+		{
+			tracks.push_back(track.get());
+		}
+	}
+
+	// Rate of the profiler clock, measured since startup
+	uint64_t elapsedTicks = now() - detail::s_ReferenceTicks;
+	uint64_t elapsedTime = getSteadyTime() - detail::s_ReferenceTime;
+	double nanosecondsPerTick = elapsedTicks > 0 ? static_cast<double>(elapsedTime) / static_cast<double>(elapsedTicks) : 1.0;
+	auto toSteadyTime = [&](uint64_t ticks)
+	{
+		return detail::s_ReferenceTime + static_cast<int64_t>(static_cast<double>(static_cast<int64_t>(ticks - detail::s_ReferenceTicks)) * nanosecondsPerTick);
+	};
+
+	// Copy the rings first (in steady time), so that the timeline starts at the earliest event kept
+	std::vector<std::vector<detail::ProfileEvent>> trackEvents(tracks.size());
+	uint64_t origin = UINT64_MAX;
+	for (size_t i = 0; i < tracks.size(); i++)
+	{
+		detail::ProfileTrack& track = *tracks[i];
+		uint64_t end = track.written.load(std::memory_order_acquire);
+		uint64_t begin = end > THREAD_EVENT_COUNT ? end - THREAD_EVENT_COUNT : 0;
+		for (uint64_t index = begin; index < end; index++)
+		{
+			trackEvents[i].push_back(track.events[index % THREAD_EVENT_COUNT]);
+		}
+
+		// (the events the thread wrote over during the copy are unreliable)
+		uint64_t overwritten = track.written.load(std::memory_order_acquire);
+		uint64_t valid = overwritten > THREAD_EVENT_COUNT ? overwritten - THREAD_EVENT_COUNT : 0;
+		if (valid > begin)
+		{
+			trackEvents[i].erase(trackEvents[i].begin(), trackEvents[i].begin() + std::min<uint64_t>(valid - begin, trackEvents[i].size()));
+		}
+
+		for (detail::ProfileEvent& event : trackEvents[i])
+		{
+			if (!track.steadyTime)
+			{
+				event.begin = toSteadyTime(event.begin);
+				event.end = toSteadyTime(event.end);
+			}
+			origin = std::min(origin, event.begin);
+		}
+	}
+
+	// Complete events ("X") in microseconds, one thread per track
+	output << std::fixed;
+	output.precision(3);
+	output << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	const char* separator = "\n";
+	for (size_t i = 0; i < tracks.size(); i++)
+	{
+		uint32_t tid = tracks[i]->id;
+		{
+			std::lock_guard<std::mutex> lock(detail::s_TracksMutex);
+			output << separator << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid
+			       << ",\"args\":{\"name\":\"" << detail::escapeJson(tracks[i]->name.c_str()) << "\"}}";
+		}
+		separator = ",\n";
+
+		for (const detail::ProfileEvent& event : trackEvents[i])
+		{
+			output << separator << "{\"name\":\"" << detail::escapeJson(event.name) << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << tid
+			       << ",\"ts\":" << static_cast<double>(event.begin - origin) * 1e-3
+			       << ",\"dur\":" << static_cast<double>(event.end - event.begin) * 1e-3 << "}";
+		}
+	}
+	output << "\n]}\n";
+	return true;
+}
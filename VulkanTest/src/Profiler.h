@@ -0,0 +1,77 @@
+﻿#pragma once
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+	#include <intrin.h>
+	#define VKTUT_PROFILER_TSC 1
+#elif defined(__x86_64__) || defined(__i386__)
+	#include <x86intrin.h>
+	#define VKTUT_PROFILER_TSC 1
+#endif
+
+// Scope macros, compiled out unless VKTUT_ENABLE_PROFILER is defined
+// (names must be string literals, or outlive the profile)
+#ifdef VKTUT_ENABLE_PROFILER
+	#define VKTUT_PROFILE_CONCAT_IMPL(a, b) a##b
+	#define VKTUT_PROFILE_CONCAT(a, b) VKTUT_PROFILE_CONCAT_IMPL(a, b)
+	#define PROFILE_SCOPE(name) CpuProfileScope VKTUT_PROFILE_CONCAT(profileScope, __LINE__)(name)
+	#define PROFILE_THREAD(name) Profiler::setThreadName(name)
+#else
+	#define PROFILE_SCOPE(name) ((void)0)
+	#define PROFILE_THREAD(name) ((void)0)
+#endif
+
+/**
+ * Timeline of the scopes of every thread, exported as Chrome trace events (chrome://tracing, ui.perfetto.dev).
+ * Each thread records into its own ring of the last THREAD_EVENT_COUNT scopes, without locks : the export copies the rings
+ * while they are written and drops the events overwritten in the meantime.
+ * Scopes are timed with the time stamp counter where available (a few nanoseconds, against tens for the steady clock),
+ * which is related to the steady clock when the trace is written. GPU scopes are recorded on a track of their own, in steady clock time.
+ */
+class Profiler
+{
+public:
+	static constexpr uint32_t THREAD_EVENT_COUNT = 1u << 16;
+
+	// Ticks of the profiler clock
+	static uint64_t now()
+	{
+#ifdef VKTUT_PROFILER_TSC
+		return __rdtsc();
+#else
+		return getSteadyTime();
+#endif
+	}
+
+	// Nanoseconds on the steady clock
+	static uint64_t getSteadyTime()
+	{
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+	}
+
+	// Scope of the calling thread
+	static void record(const char* name, uint64_t begin, uint64_t end);
+	static void setThreadName(const char* name);
+
+	// Scope on the GPU track, in steady clock time (from the rendering thread only)
+	static void recordGpu(const char* name, uint64_t begin, uint64_t end);
+
+	static bool writeChromeTrace(const std::string& file);
+};
+
+// Records the lifetime of the scope on the calling thread's track
+class CpuProfileScope
+{
+public:
+	explicit CpuProfileScope(const char* name) : m_Name(name), m_Begin(Profiler::now()) {}
+	~CpuProfileScope() { Profiler::record(m_Name, m_Begin, Profiler::now()); }
+
+	CpuProfileScope(const CpuProfileScope&) = delete;
+	CpuProfileScope& operator=(const CpuProfileScope&) = delete;
+
+private:
+	const char* m_Name;
+	uint64_t m_Begin;
+};
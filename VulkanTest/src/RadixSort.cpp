@@ -0,0 +1,111 @@
+﻿#include "RadixSort.h"
+
+#include <algorithm>
+
+#include "WorkerPool.h"
+
+namespace detail
+{
+	// The calling thread takes the first chunk while the workers take the others
+	template<typename Function>
+	static void forEachChunk(WorkerPool* worker_pool, uint32_t num_chunks, Function&& function)
+	{
+		if (1 == num_chunks)
+		{
+			function(0);
+			return;
+		}
+
+		for (uint32_t chunk = 1; chunk < num_chunks; chunk++)
+		{
+			worker_pool->submit([&function, chunk]() { function(chunk); });
+		}
+		function(0);
+
+		worker_pool->wait();
+	}
+}
+
+void RadixSorter::sort(uint64_t* keys, uint32_t* values, size_t count)
+{
+	if (count < 2)
+		return;
+
+	uint32_t numChunks = 1;
+	if (m_WorkerPool && count >= PARALLEL_THRESHOLD)
+	{
+		numChunks = std::max(1u, std::min(m_WorkerPool->getThreadCount() + 1, static_cast<uint32_t>(count / (PARALLEL_THRESHOLD / 4))));
+	}
+	size_t chunkSize = (count + numChunks - 1) / numChunks;
+
+	m_ScratchKeys.resize(count);
+	m_ScratchValues.resize(count);
+	m_Histograms.resize(numChunks * RADIX_SIZE);
+
+	uint64_t* srcKeys = keys;
+	uint32_t* srcValues = values;
+	uint64_t* dstKeys = m_ScratchKeys.data();
+	uint32_t* dstValues = m_ScratchValues.data();
+
+	for (uint32_t shift = 0; shift < 64; shift += RADIX_BITS)
+	{
+		// Count the digits of every chunk
+		detail::forEachChunk(m_WorkerPool, numChunks, [&](uint32_t chunk)
+		{
+			uint32_t* histogram = &m_Histograms[chunk * RADIX_SIZE];
+			std::fill(histogram, histogram + RADIX_SIZE, 0u);
+
+			size_t end = std::min(count, (chunk + 1) * chunkSize);
+			for (size_t i = chunk * chunkSize; i < end; i++)
+			{
+				histogram[(srcKeys[i] >> shift) & (RADIX_SIZE - 1)]++;
+			}
+		});
+
+		// Skip the pass when all the keys share this digit
+		uint32_t firstDigit = (srcKeys[0] >> shift) & (RADIX_SIZE - 1);
+		size_t firstDigitCount = 0;
+		for (uint32_t chunk = 0; chunk < numChunks; chunk++)
+		{
+			firstDigitCount += m_Histograms[chunk * RADIX_SIZE + firstDigit];
+		}
+		if (count == firstDigitCount)
+			continue;
+
+		// Turn the counts into the output offset of each (digit, chunk) pair, chunks keep their relative order (stable)
+		uint32_t offset = 0;
+		for (uint32_t digit = 0; digit < RADIX_SIZE; digit++)
+		{
+			for (uint32_t chunk = 0; chunk < numChunks; chunk++)
+			{
+				uint32_t digitCount = m_Histograms[chunk * RADIX_SIZE + digit];
+				m_Histograms[chunk * RADIX_SIZE + digit] = offset;
+				offset += digitCount;
+			}
+		}
+
+		// Scatter
+		detail::forEachChunk(m_WorkerPool, numChunks, [&](uint32_t chunk)
+		{
+			uint32_t* offsets = &m_Histograms[chunk * RADIX_SIZE];
+
+			size_t end = std::min(count, (chunk + 1) * chunkSize);
+			for (size_t i = chunk * chunkSize; i < end; i++)
+			{
+				uint32_t destination = offsets[(srcKeys[i] >> shift) & (RADIX_SIZE - 1)]++;
+				dstKeys[destination] = srcKeys[i];
+				dstValues[destination] = srcValues[i];
+			}
+		});
+
+		std::swap(srcKeys, dstKeys);
+		std::swap(srcValues, dstValues);
+	}
+
+	// An odd number of passes leaves the result in the scratch buffers
+	if (srcKeys != keys)
+	{
+		std::copy(srcKeys, srcKeys + count, keys);
+		std::copy(srcValues, srcValues + count, values);
+	}
+}
@@ -0,0 +1,33 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class WorkerPool;
+
+/**
+ * LSD radix sort of 64-bit keys carrying a 32-bit payload, 8 bits per pass.
+ *  - Passes where every key has the same digit are skipped (sort keys usually leave most fields constant)
+ *  - Large inputs are split into chunks : the histograms and the scatter of each pass run on the workers, one task per chunk
+ * The scratch buffers are kept between calls so that sorting every frame does not allocate.
+ */
+class RadixSorter
+{
+public:
+	// (optional, without workers the sort stays on the calling thread)
+	void setWorkerPool(WorkerPool* worker_pool) { m_WorkerPool = worker_pool; }
+
+	void sort(uint64_t* keys, uint32_t* values, size_t count);
+
+	// Below this many keys the sort stays on the calling thread
+	static constexpr size_t PARALLEL_THRESHOLD = 16384;
+
+private:
+	static constexpr uint32_t RADIX_BITS = 8;
+	static constexpr uint32_t RADIX_SIZE = 1u << RADIX_BITS;
+
+	WorkerPool* m_WorkerPool = nullptr;
+	std::vector<uint64_t> m_ScratchKeys;
+	std::vector<uint32_t> m_ScratchValues;
+	std::vector<uint32_t> m_Histograms; // RADIX_SIZE counters per chunk
+};
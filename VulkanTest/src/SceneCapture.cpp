@@ -0,0 +1,429 @@
+﻿#include "SceneCapture.h"
+
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#include "Lz4.h"
+#include "MappedFile.h"
+#include "MeshImporter.h"
+
+namespace detail
+{
+	static constexpr uint32_t s_CaptureMagic = 0x50414356; // "VCAP"
+	static constexpr uint32_t s_CaptureVersion = 1;
+
+	enum class CaptureRecordType : uint32_t
+	{
+		Mesh = 1,
+		AtlasTextures,
+		Objects,
+		Frame,
+	};
+
+	struct CaptureFileHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t objectCount;
+		uint32_t textureCount;
+		uint32_t framesInFlight;
+		uint32_t width;
+		uint32_t height;
+		uint32_t vertexStride; // sizeof(Vertex) when captured
+	};
+	static_assert(sizeof(CaptureFileHeader) == 32, "Capture header must be packed");
+
+	struct CaptureRecordHeader
+	{
+		uint32_t type;
+		uint32_t size;
+		uint32_t compressedSize;
+	};
+	static_assert(sizeof(CaptureRecordHeader) == 12, "Capture record header must be packed");
+
+	struct CaptureMeshHeader
+	{
+		uint32_t vertexCount;
+		uint32_t indexCount;
+		uint32_t indexType;
+		uint32_t indexBytes;
+	};
+
+	struct CaptureFrameHeader
+	{
+		float matrices[3][16]; // model, view, proj
+		uint32_t flags;
+		uint32_t drawListCount;
+		uint32_t drawRunCount;
+		uint32_t reserved;
+	};
+	static_assert(sizeof(CaptureFrameHeader) == 208, "Capture frame header must be packed");
+
+	struct CaptureDrawRun
+	{
+		uint32_t first;
+		uint32_t count;
+		uint32_t materialClass;
+		uint32_t indexType;
+		float viewDepth;
+	};
+	static_assert(sizeof(CaptureDrawRun) == 20, "Capture draw run must be packed");
+
+	static constexpr uint32_t s_FrameDepthPrePass = 1u << 0;
+	static constexpr uint32_t s_FrameOcclusionCulling = 1u << 1;
+
+	static void append(std::vector<uint8_t>& payload, const void* data, size_t size)
+	{
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		payload.insert(payload.end(), bytes, bytes + size);
+	}
+
+	// Bounds checked reads from a decompressed payload
+	struct PayloadReader
+	{
+		const uint8_t* data;
+		size_t size;
+		size_t offset = 0;
+
+		bool read(void* dst, size_t bytes)
+		{
+			if (bytes > size - offset)
+				return false;
+			std::memcpy(dst, data + offset, bytes);
+			offset += bytes;
+			return true;
+		}
+	};
+
+	static bool readMesh(PayloadReader& reader, SceneCapture& capture)
+	{
+		CaptureMeshHeader header{};
+		if (!reader.read(&header, sizeof(header)))
+			return false;
+
+		VkIndexType indexType = static_cast<VkIndexType>(header.indexType);
+		if ((VK_INDEX_TYPE_UINT16 != indexType && VK_INDEX_TYPE_UINT32 != indexType)
+		    || uint64_t(header.indexCount) * MeshImporter::getIndexSize(indexType) > header.indexBytes)
+		{
+			return false;
+		}
+
+		SceneCaptureMesh mesh{};
+		mesh.vertices.resize(header.vertexCount);
+		mesh.indices.resize(header.indexBytes);
+		mesh.indexCount = header.indexCount;
+		mesh.indexType = indexType;
+		if (!reader.read(mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex)) || !reader.read(mesh.indices.data(), mesh.indices.size()))
+			return false;
+
+		capture.meshes.push_back(std::move(mesh));
+		return true;
+	}
+
+	static bool readAtlasTextures(PayloadReader& reader, SceneCapture& capture)
+	{
+		uint32_t count = 0;
+		if (!reader.read(&count, sizeof(count)))
+			return false;
+
+		capture.atlasTextures.clear();
+		for (uint32_t i = 0; i < count; i++)
+		{
+			uint32_t length = 0;
+			if (!reader.read(&length, sizeof(length)) || length > reader.size - reader.offset)
+				return false;
+
+			std::string file(length, '\0');
+			reader.read(file.data(), length);
+			capture.atlasTextures.push_back(std::move(file));
+		}
+		return true;
+	}
+
+	static bool readObjects(PayloadReader& reader, SceneCapture& capture)
+	{
+		uint32_t count = 0;
+		if (!reader.read(&count, sizeof(count)) || uint64_t(count) * (sizeof(ObjectData) + sizeof(uint32_t)) > reader.size - reader.offset)
+			return false;
+
+		capture.objects.resize(count);
+		capture.objectMeshes.resize(count);
+		reader.read(capture.objects.data(), count * sizeof(ObjectData));
+		reader.read(capture.objectMeshes.data(), count * sizeof(uint32_t));
+		return true;
+	}
+
+	static bool readFrame(PayloadReader& reader, SceneCapture& capture, std::vector<uint32_t>& previous_draw_list)
+	{
+		CaptureFrameHeader header{};
+		if (!reader.read(&header, sizeof(header))
+		    || uint64_t(header.drawListCount) * sizeof(uint32_t) + uint64_t(header.drawRunCount) * sizeof(CaptureDrawRun) > reader.size - reader.offset)
+		{
+			return false;
+		}
+
+		SceneCaptureFrame frame{};
+		std::memcpy(&frame.matrices.model, header.matrices[0], sizeof(header.matrices[0]));
+		std::memcpy(&frame.matrices.view, header.matrices[1], sizeof(header.matrices[1]));
+		std::memcpy(&frame.matrices.proj, header.matrices[2], sizeof(header.matrices[2]));
+		frame.depthPrePass = 0 != (header.flags & s_FrameDepthPrePass);
+		frame.occlusionCulling = 0 != (header.flags & s_FrameOcclusionCulling);
+
+		// Undo the XOR with the previous frame's draw list (a list of another size is stored as is)
+		frame.drawList.resize(header.drawListCount);
+		reader.read(frame.drawList.data(), frame.drawList.size() * sizeof(uint32_t));
+		if (previous_draw_list.size() == frame.drawList.size())
+		{
+			for (size_t i = 0; i < frame.drawList.size(); i++)
+			{
+				frame.drawList[i] ^= previous_draw_list[i];
+			}
+		}
+		previous_draw_list = frame.drawList;
+
+		frame.drawRuns.resize(header.drawRunCount);
+		for (DrawRun& run : frame.drawRuns)
+		{
+			CaptureDrawRun captureRun{};
+			reader.read(&captureRun, sizeof(captureRun));
+			if (captureRun.materialClass >= static_cast<uint32_t>(MaterialClass::Count)
+			    || (VK_INDEX_TYPE_UINT16 != captureRun.indexType && VK_INDEX_TYPE_UINT32 != captureRun.indexType))
+			{
+				return false;
+			}
+			run = { captureRun.first, captureRun.count, static_cast<MaterialClass>(captureRun.materialClass),
+			        static_cast<VkIndexType>(captureRun.indexType), captureRun.viewDepth };
+		}
+
+		capture.frames.push_back(std::move(frame));
+		return true;
+	}
+}
+
+void SceneCapture::load(const std::string& file, SceneCapture& capture)
+{
+	MappedFile mappedFile;
+	if (!mappedFile.open(file))
+	{
+		throw std::runtime_error("Failed to open capture file!");
+	}
+
+	const uint8_t* data = mappedFile.getData();
+	size_t size = mappedFile.getSize();
+
+	// Reject anything truncated or written by another version
+	detail::CaptureFileHeader header{};
+	if (size < sizeof(header))
+	{
+		throw std::runtime_error("Invalid capture file: truncated header!");
+	}
+	std::memcpy(&header, data, sizeof(header));
+	if (detail::s_CaptureMagic != header.magic || detail::s_CaptureVersion != header.version || sizeof(Vertex) != header.vertexStride)
+	{
+		throw std::runtime_error("Invalid capture file: unknown format or version!");
+	}
+	if (0 == header.framesInFlight || 0 == header.width || 0 == header.height)
+	{
+		throw std::runtime_error("Invalid capture file: empty frame settings!");
+	}
+
+	capture = {};
+	capture.settings = { header.objectCount, header.textureCount, header.framesInFlight, header.width, header.height };
+
+	std::vector<uint8_t> payload;
+	std::vector<uint32_t> previousDrawList;
+	size_t offset = sizeof(header);
+	while (offset < size)
+	{
+		detail::CaptureRecordHeader record{};
+		if (sizeof(record) > size - offset)
+		{
+			throw std::runtime_error("Invalid capture file: truncated record!");
+		}
+		std::memcpy(&record, data + offset, sizeof(record));
+		offset += sizeof(record);
+
+		payload.resize(record.size);
+		if (record.compressedSize > size - offset || !Lz4::decompress(data + offset, record.compressedSize, payload.data(), payload.size()))
+		{
+			throw std::runtime_error("Invalid capture file: corrupted record!");
+		}
+		offset += record.compressedSize;
+
+		detail::PayloadReader reader{ payload.data(), payload.size() };
+		bool valid = false;
+		switch (static_cast<detail::CaptureRecordType>(record.type))
+		{
+		case detail::CaptureRecordType::Mesh: valid = detail::readMesh(reader, capture); break;
+		case detail::CaptureRecordType::AtlasTextures: valid = detail::readAtlasTextures(reader, capture); break;
+		case detail::CaptureRecordType::Objects: valid = detail::readObjects(reader, capture); break;
+		case detail::CaptureRecordType::Frame: valid = detail::readFrame(reader, capture, previousDrawList); break;
+		default: valid = true; break; // (skipped, records added later keep older readers working)
+		}
+		if (!valid)
+		{
+			throw std::runtime_error("Invalid capture file: malformed record!");
+		}
+	}
+
+	if (capture.meshes.empty() || capture.settings.objectCount != capture.objects.size())
+	{
+		throw std::runtime_error("Invalid capture file: missing meshes or objects!");
+	}
+
+	// The objects must draw within the captured meshes and reference the captured atlas regions (0 : scene texture)
+	for (size_t objectIndex = 0; objectIndex < capture.objects.size(); objectIndex++)
+	{
+		uint32_t mesh = capture.objectMeshes[objectIndex];
+		const glm::uvec4& range = capture.objects[objectIndex].mesh;
+		if (mesh >= capture.meshes.size() || 0 == range.y || range.y > capture.meshes[mesh].indexCount)
+		{
+			throw std::runtime_error("Invalid capture file: object outside of the captured meshes!");
+		}
+		if (range.w > capture.atlasTextures.size())
+		{
+			throw std::runtime_error("Invalid capture file: object outside of the captured atlas!");
+		}
+	}
+
+	// The frames must draw every object once, in runs within the draw list
+	for (const SceneCaptureFrame& frame : capture.frames)
+	{
+		bool valid = frame.drawList.size() == capture.objects.size();
+		for (uint32_t objectIndex : frame.drawList)
+		{
+			valid = valid && objectIndex < capture.objects.size();
+		}
+		for (const DrawRun& run : frame.drawRuns)
+		{
+			valid = valid && run.first <= frame.drawList.size() && run.count <= frame.drawList.size() - run.first;
+		}
+		if (!valid)
+		{
+			throw std::runtime_error("Invalid capture file: frame outside of the captured objects!");
+		}
+	}
+}
+
+void SceneCaptureWriter::open(const std::string& file, const SceneCaptureSettings& settings)
+{
+	m_File.open(file, std::ios::binary | std::ios::trunc);
+	if (!m_File.is_open())
+	{
+		throw std::runtime_error("Failed to open capture file!");
+	}
+
+	detail::CaptureFileHeader header{};
+	header.magic = detail::s_CaptureMagic;
+	header.version = detail::s_CaptureVersion;
+	header.objectCount = settings.objectCount;
+	header.textureCount = settings.textureCount;
+	header.framesInFlight = settings.framesInFlight;
+	header.width = settings.width;
+	header.height = settings.height;
+	header.vertexStride = sizeof(Vertex);
+	m_File.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	m_PreviousDrawList.clear();
+	m_FrameCount = 0;
+}
+
+void SceneCaptureWriter::close()
+{
+	if (!m_File.is_open())
+		return;
+
+	m_File.close();
+	if (m_File.fail())
+	{
+		printf("[WARN] Failed to write the capture file, it is incomplete!\n");
+	}
+}
+
+void SceneCaptureWriter::writeMesh(const Vertex* vertices, uint32_t vertex_count, const uint8_t* indices, uint32_t index_count, VkIndexType index_type)
+{
+	detail::CaptureMeshHeader header{};
+	header.vertexCount = vertex_count;
+	header.indexCount = index_count;
+	header.indexType = static_cast<uint32_t>(index_type);
+	header.indexBytes = index_count * static_cast<uint32_t>(MeshImporter::getIndexSize(index_type));
+
+	m_Payload.clear();
+	detail::append(m_Payload, &header, sizeof(header));
+	detail::append(m_Payload, vertices, vertex_count * sizeof(Vertex));
+	detail::append(m_Payload, indices, header.indexBytes);
+	writeRecord(static_cast<uint32_t>(detail::CaptureRecordType::Mesh), m_Payload);
+}
+
+void SceneCaptureWriter::writeAtlasTextures(const std::vector<std::string>& texture_files)
+{
+	uint32_t count = static_cast<uint32_t>(texture_files.size());
+
+	m_Payload.clear();
+	detail::append(m_Payload, &count, sizeof(count));
+	for (const std::string& file : texture_files)
+	{
+		uint32_t length = static_cast<uint32_t>(file.size());
+		detail::append(m_Payload, &length, sizeof(length));
+		detail::append(m_Payload, file.data(), length);
+	}
+	writeRecord(static_cast<uint32_t>(detail::CaptureRecordType::AtlasTextures), m_Payload);
+}
+
+void SceneCaptureWriter::writeObjects(const std::vector<ObjectData>& objects, const std::vector<uint32_t>& object_meshes)
+{
+	uint32_t count = static_cast<uint32_t>(objects.size());
+
+	m_Payload.clear();
+	detail::append(m_Payload, &count, sizeof(count));
+	detail::append(m_Payload, objects.data(), objects.size() * sizeof(ObjectData));
+	detail::append(m_Payload, object_meshes.data(), object_meshes.size() * sizeof(uint32_t));
+	writeRecord(static_cast<uint32_t>(detail::CaptureRecordType::Objects), m_Payload);
+}
+
+void SceneCaptureWriter::writeFrame(const MatricesUBO& matrices, bool depth_pre_pass, bool occlusion_culling,
+                                    const std::vector<uint32_t>& draw_list, const std::vector<DrawRun>& draw_runs)
+{
+	detail::CaptureFrameHeader header{};
+	std::memcpy(header.matrices[0], &matrices.model, sizeof(header.matrices[0]));
+	std::memcpy(header.matrices[1], &matrices.view, sizeof(header.matrices[1]));
+	std::memcpy(header.matrices[2], &matrices.proj, sizeof(header.matrices[2]));
+	header.flags = (depth_pre_pass ? detail::s_FrameDepthPrePass : 0) | (occlusion_culling ? detail::s_FrameOcclusionCulling : 0);
+	header.drawListCount = static_cast<uint32_t>(draw_list.size());
+	header.drawRunCount = static_cast<uint32_t>(draw_runs.size());
+
+	m_Payload.clear();
+	detail::append(m_Payload, &header, sizeof(header));
+
+	size_t drawListOffset = m_Payload.size();
+	detail::append(m_Payload, draw_list.data(), draw_list.size() * sizeof(uint32_t));
+	if (m_PreviousDrawList.size() == draw_list.size())
+	{
+		uint32_t* drawList = reinterpret_cast<uint32_t*>(m_Payload.data() + drawListOffset);
+		for (size_t i = 0; i < draw_list.size(); i++)
+		{
+			drawList[i] ^= m_PreviousDrawList[i];
+		}
+	}
+	m_PreviousDrawList = draw_list;
+
+	for (const DrawRun& run : draw_runs)
+	{
+		detail::CaptureDrawRun captureRun{ run.first, run.count, static_cast<uint32_t>(run.materialClass),
+		                                   static_cast<uint32_t>(run.indexType), run.viewDepth };
+		detail::append(m_Payload, &captureRun, sizeof(captureRun));
+	}
+	writeRecord(static_cast<uint32_t>(detail::CaptureRecordType::Frame), m_Payload);
+	m_FrameCount++;
+}
+
+void SceneCaptureWriter::writeRecord(uint32_t type, const std::vector<uint8_t>& payload)
+{
+	m_Compressed.resize(Lz4::getMaxCompressedSize(payload.size()));
+	size_t compressedSize = Lz4::compress(payload.data(), payload.size(), m_Compressed.data(), m_Compressed.size());
+
+	detail::CaptureRecordHeader record{ type, static_cast<uint32_t>(payload.size()), static_cast<uint32_t>(compressedSize) };
+	m_File.write(reinterpret_cast<const char*>(&record), sizeof(record));
+	m_File.write(reinterpret_cast<const char*>(m_Compressed.data()), compressedSize);
+}
@@ -0,0 +1,84 @@
+﻿#pragma once
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+#include "BufferData.h"
+
+// Scene parameters a capture was recorded with (the replay renders at the same size)
+struct SceneCaptureSettings
+{
+	uint32_t objectCount = 0;
+	uint32_t textureCount = 0;
+	uint32_t framesInFlight = 1;
+	uint32_t width = 0;
+	uint32_t height = 0;
+};
+
+// One upload to the geometry pool, in the packed index format of the mesh
+struct SceneCaptureMesh
+{
+	std::vector<Vertex> vertices;
+	std::vector<uint8_t> indices;
+	uint32_t indexCount = 0;
+	VkIndexType indexType = VK_INDEX_TYPE_UINT16;
+};
+
+// What the CPU decided for a frame : the camera, the toggles, and the draw list and runs the draw packets are built from
+struct SceneCaptureFrame
+{
+	MatricesUBO matrices{};
+	bool depthPrePass = false;
+	bool occlusionCulling = false;
+	std::vector<uint32_t> drawList;
+	std::vector<DrawRun> drawRuns;
+};
+
+/**
+ * In-memory capture of the renderer's workload, loaded in full so a replay reads nothing from disk while measuring.
+ * The textures are captured by asset path (they are baked and cached, and far larger than the rest of a capture).
+ */
+struct SceneCapture
+{
+	SceneCaptureSettings settings;
+	std::vector<SceneCaptureMesh> meshes; // in geometry pool order
+	std::vector<std::string> atlasTextures;
+	std::vector<ObjectData> objects;
+	std::vector<uint32_t> objectMeshes; // index in meshes of every object
+	std::vector<SceneCaptureFrame> frames;
+
+	// Throws if the file cannot be read, or anything in it is out of range of the rest of the capture
+	static void load(const std::string& file, SceneCapture& capture);
+};
+
+/**
+ * Streams a capture to disk : header | records, each record being  type | size | compressed size | LZ4 payload.
+ * The resources come first (in creation order), then one record per frame. A frame's draw list is stored
+ * XORed with the previous one, so the frames where the sort order barely changes compress to almost nothing.
+ */
+class SceneCaptureWriter
+{
+public:
+	void open(const std::string& file, const SceneCaptureSettings& settings);
+	void close();
+	bool isOpen() const { return m_File.is_open(); }
+
+	void writeMesh(const Vertex* vertices, uint32_t vertex_count, const uint8_t* indices, uint32_t index_count, VkIndexType index_type);
+	void writeAtlasTextures(const std::vector<std::string>& texture_files);
+	void writeObjects(const std::vector<ObjectData>& objects, const std::vector<uint32_t>& object_meshes);
+	void writeFrame(const MatricesUBO& matrices, bool depth_pre_pass, bool occlusion_culling,
+	                const std::vector<uint32_t>& draw_list, const std::vector<DrawRun>& draw_runs);
+
+	uint32_t getFrameCount() const { return m_FrameCount; }
+
+private:
+	void writeRecord(uint32_t type, const std::vector<uint8_t>& payload);
+
+	std::ofstream m_File;
+	std::vector<uint8_t> m_Payload;
+	std::vector<uint8_t> m_Compressed;
+	std::vector<uint32_t> m_PreviousDrawList;
+	uint32_t m_FrameCount = 0;
+};
@@ -0,0 +1,131 @@
+﻿#include "TextureAtlas.h"
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <stdexcept>
+
+namespace detail
+{
+	static uint32_t alignUp(uint32_t value, uint32_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	// Row of textures of at most its height, filled from the left
+	struct AtlasShelf
+	{
+		uint32_t layer;
+		uint32_t y;
+		uint32_t height;
+		uint32_t width; // used so far
+	};
+}
+
+uint32_t TextureAtlasPacker::pack(const std::vector<glm::uvec2>& sizes, uint32_t layer_size, uint32_t padding, std::vector<TextureAtlasPlacement>& placements)
+{
+	// Tallest first keeps the shelves tight
+	std::vector<uint32_t> order(sizes.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return sizes[a].y > sizes[b].y; });
+
+	std::vector<detail::AtlasShelf> shelves;
+	std::vector<uint32_t> layerHeights; // used by the shelves of each layer
+	placements.assign(sizes.size(), TextureAtlasPlacement{});
+
+	for (uint32_t index : order)
+	{
+		// Cells hold the padding on both sides and start on a multiple of the padding
+		uint32_t cellWidth = detail::alignUp(sizes[index].x + 2 * padding, std::max(padding, 1u));
+		uint32_t cellHeight = detail::alignUp(sizes[index].y + 2 * padding, std::max(padding, 1u));
+		if (cellWidth > layer_size || cellHeight > layer_size)
+		{
+			throw std::runtime_error("Texture does not fit in a Texture Atlas layer!");
+		}
+
+		detail::AtlasShelf* shelf = nullptr;
+		for (detail::AtlasShelf& candidate : shelves)
+		{
+			if (cellHeight <= candidate.height && cellWidth <= layer_size - candidate.width)
+			{
+				shelf = &candidate;
+				break;
+			}
+		}
+
+		if (!shelf)
+		{
+			// Open a shelf on the first layer with room left, or on a new layer
+			uint32_t layer = 0;
+			while (layer < layerHeights.size() && cellHeight > layer_size - layerHeights[layer])
+			{
+				layer++;
+			}
+			if (layer == layerHeights.size())
+			{
+				layerHeights.push_back(0);
+			}
+
+			shelves.push_back({ layer, layerHeights[layer], cellHeight, 0 });
+			layerHeights[layer] += cellHeight;
+			shelf = &shelves.back();
+		}
+
+		TextureAtlasPlacement& placement = placements[index];
+		placement.layer = shelf->layer;
+		placement.x = shelf->width + padding;
+		placement.y = shelf->y + padding;
+		placement.width = sizes[index].x;
+		placement.height = sizes[index].y;
+		shelf->width += cellWidth;
+	}
+
+	return static_cast<uint32_t>(layerHeights.size());
+}
+
+uint32_t TextureAtlasPacker::getMipLevelCount(uint32_t layer_size, uint32_t padding)
+{
+	// At level log2(padding) the padding is down to a single texel
+	uint32_t levels = 1;
+	while ((2u << (levels - 1)) <= padding && (layer_size >> levels) > 0)
+	{
+		levels++;
+	}
+	return levels;
+}
+
+void TextureAtlasPacker::blitRGBA8(const uint8_t* pixels, uint8_t* layer, uint32_t layer_size, const TextureAtlasPlacement& placement, uint32_t padding)
+{
+	// Every row of the padded cell repeats the nearest row of the texture, each row is extended with its edge texels
+	for (int32_t row = -static_cast<int32_t>(padding); row < static_cast<int32_t>(placement.height + padding); row++)
+	{
+		uint32_t sourceRow = static_cast<uint32_t>(std::clamp(row, 0, static_cast<int32_t>(placement.height) - 1));
+		const uint8_t* source = pixels + size_t(sourceRow) * placement.width * 4;
+		uint8_t* destination = layer + (size_t(placement.y + row) * layer_size + placement.x) * 4;
+
+		std::memcpy(destination, source, size_t(placement.width) * 4);
+		for (uint32_t i = 1; i <= padding; i++)
+		{
+			std::memcpy(destination - size_t(i) * 4, source, 4);
+			std::memcpy(destination + (size_t(placement.width) + i - 1) * 4, source + (size_t(placement.width) - 1) * 4, 4);
+		}
+	}
+}
+
+TextureAtlasRegion TextureAtlasPacker::getRegion(const TextureAtlasPlacement& placement, uint32_t layer_size)
+{
+	float size = static_cast<float>(layer_size);
+
+	TextureAtlasRegion region{};
+	region.uvScaleOffset = glm::vec4(placement.width / size, placement.height / size, placement.x / size, placement.y / size);
+	region.layer = placement.layer;
+	return region;
+}
+
+TextureAtlasRegion TextureAtlasPacker::getStreamedRegion(uint32_t slot)
+{
+	TextureAtlasRegion region{};
+	region.uvScaleOffset = glm::vec4(1.f, 1.f, 0.f, 0.f);
+	region.layer = ~slot;
+	return region;
+}
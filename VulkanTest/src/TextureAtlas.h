@@ -0,0 +1,43 @@
+﻿#pragma once
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Where a texture landed in a texture array, as read by the shaders (std430 layout)
+struct TextureAtlasRegion
+{
+	glm::vec4 uvScaleOffset; // layer UV = texture UV * xy + zw
+	uint32_t layer; // or ~slot for a texture streamed on its own (read as -1 - slot by the shaders)
+	uint32_t padding[3];
+};
+
+// Texel rectangle of a texture inside its layer (the padding surrounds it)
+struct TextureAtlasPlacement
+{
+	uint32_t layer;
+	uint32_t x, y;
+	uint32_t width, height;
+};
+
+/**
+ * Packs small textures into the layers of a 2D texture array, so that a single descriptor covers all of them.
+ * Every texture is surrounded by padding texels extruded from its edges, and the cells are aligned to the padding :
+ * the first log2(padding) + 1 mip levels never filter across two textures (getMipLevelCount()).
+ * Shelf packing, tallest first, a new layer is started when a texture fits none of the open shelves.
+ */
+struct TextureAtlasPacker
+{
+	// Returns the number of layers used, throws if a texture does not fit in a layer
+	static uint32_t pack(const std::vector<glm::uvec2>& sizes, uint32_t layer_size, uint32_t padding, std::vector<TextureAtlasPlacement>& placements);
+
+	// Levels of the layers free of bleeding between textures
+	static uint32_t getMipLevelCount(uint32_t layer_size, uint32_t padding);
+
+	// Copies an RGBA8 texture to its placement in an RGBA8 layer and extrudes its edges into the padding
+	static void blitRGBA8(const uint8_t* pixels, uint8_t* layer, uint32_t layer_size, const TextureAtlasPlacement& placement, uint32_t padding);
+
+	static TextureAtlasRegion getRegion(const TextureAtlasPlacement& placement, uint32_t layer_size);
+	// Region of a texture kept out of the atlas, sampled whole from its streamed texture slot
+	static TextureAtlasRegion getStreamedRegion(uint32_t slot);
+};
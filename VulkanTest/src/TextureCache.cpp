@@ -0,0 +1,182 @@
+﻿#include "TextureCache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+
+#include "Hash.h"
+
+namespace detail
+{
+	static constexpr uint32_t s_CacheMagic = 0x31435456; // "VTC1"
+	static constexpr uint32_t s_CacheVersion = 1;
+	static constexpr uint64_t s_PayloadAlignment = 16;
+
+	struct TextureCacheFileHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint64_t key;
+		uint32_t format;
+		uint32_t levelCount;
+		uint64_t payloadOffset;
+		uint64_t payloadSize;
+	};
+	static_assert(sizeof(TextureCacheFileHeader) == 40, "Texture cache header must be packed");
+
+	struct TextureCacheFileLevel
+	{
+		uint32_t width;
+		uint32_t height;
+		uint64_t offset;
+	};
+
+	// Payloads hold decoded RGBA8 levels (0 : a format no entry is written with)
+	static uint64_t getTexelSize(VkFormat format)
+	{
+		switch (format)
+		{
+		case VK_FORMAT_R8G8B8A8_UNORM:
+		case VK_FORMAT_R8G8B8A8_SRGB:
+		case VK_FORMAT_B8G8R8A8_UNORM:
+		case VK_FORMAT_B8G8R8A8_SRGB:
+			return 4;
+		default:
+			return 0;
+		}
+	}
+}
+
+void TextureCache::create(const std::string& directory)
+{
+	m_Directory = directory;
+
+	std::error_code error;
+	std::filesystem::create_directories(m_Directory, error);
+}
+
+uint64_t TextureCache::computeKey(const uint8_t* source, size_t source_size, const TextureImportSettings& settings)
+{
+	uint32_t settingsWords[] = { static_cast<uint32_t>(settings.format), settings.srgb, settings.generateMipsOnCpu, detail::s_CacheVersion };
+	uint64_t key = hashBytes(source, source_size);
+	key = hashBytes(settingsWords, sizeof(settingsWords), key);
+	return 0 == key ? 1 : key;
+}
+
+bool TextureCache::load(uint64_t key, TextureCacheEntry& entry) const
+{
+	if (!entry.file.open(getEntryPath(key)))
+		return false;
+
+	if (!parseEntry(entry.file.getData(), entry.file.getSize(), entry) || key != entry.key)
+	{
+		entry.file.close();
+		return false;
+	}
+	return true;
+}
+
+bool TextureCache::parseEntry(const uint8_t* data, size_t size, TextureCacheEntry& entry)
+{
+	// Reject anything truncated or written by another version
+	detail::TextureCacheFileHeader header{};
+	if (size < sizeof(header))
+		return false;
+	std::memcpy(&header, data, sizeof(header));
+
+	size_t levelsEnd = sizeof(header) + size_t(header.levelCount) * sizeof(detail::TextureCacheFileLevel);
+	if (detail::s_CacheMagic != header.magic || detail::s_CacheVersion != header.version
+	    || 0 == header.levelCount || levelsEnd > size || header.payloadOffset < levelsEnd
+	    || header.payloadOffset > size || header.payloadSize > size - header.payloadOffset)
+	{
+		return false;
+	}
+
+	uint64_t texelSize = detail::getTexelSize(static_cast<VkFormat>(header.format));
+	if (0 == texelSize)
+		return false;
+
+	entry.key = header.key;
+	entry.format = static_cast<VkFormat>(header.format);
+	entry.levels.resize(header.levelCount);
+	for (uint32_t level = 0; level < header.levelCount; level++)
+	{
+		detail::TextureCacheFileLevel fileLevel{};
+		std::memcpy(&fileLevel, data + sizeof(header) + level * sizeof(fileLevel), sizeof(fileLevel));
+
+		// Every level must lie within the payload (the size is checked by division, width * height may overflow)
+		uint64_t maxTexels = header.payloadSize / texelSize;
+		if (0 == fileLevel.width || 0 == fileLevel.height || fileLevel.height > maxTexels / fileLevel.width
+		    || fileLevel.offset > header.payloadSize
+		    || uint64_t(fileLevel.width) * fileLevel.height * texelSize > header.payloadSize - fileLevel.offset)
+		{
+			return false;
+		}
+		entry.levels[level] = { fileLevel.width, fileLevel.height, static_cast<size_t>(fileLevel.offset) };
+	}
+	entry.payload = data + header.payloadOffset;
+	entry.payloadSize = static_cast<size_t>(header.payloadSize);
+	return true;
+}
+
+std::vector<uint8_t> TextureCache::serializeEntryHeader(uint64_t key, VkFormat format, const std::vector<MipLevel>& levels, size_t payload_size)
+{
+	detail::TextureCacheFileHeader header{};
+	header.magic = detail::s_CacheMagic;
+	header.version = detail::s_CacheVersion;
+	header.key = key;
+	header.format = static_cast<uint32_t>(format);
+	header.levelCount = static_cast<uint32_t>(levels.size());
+	header.payloadOffset = sizeof(header) + levels.size() * sizeof(detail::TextureCacheFileLevel);
+	header.payloadOffset = (header.payloadOffset + detail::s_PayloadAlignment - 1) & ~(detail::s_PayloadAlignment - 1);
+	header.payloadSize = payload_size;
+
+	// (zero filled up to the payload)
+	std::vector<uint8_t> bytes(static_cast<size_t>(header.payloadOffset));
+	std::memcpy(bytes.data(), &header, sizeof(header));
+	for (size_t level = 0; level < levels.size(); level++)
+	{
+		detail::TextureCacheFileLevel fileLevel{ levels[level].width, levels[level].height, levels[level].offset };
+		std::memcpy(bytes.data() + sizeof(header) + level * sizeof(fileLevel), &fileLevel, sizeof(fileLevel));
+	}
+	return bytes;
+}
+
+void TextureCache::store(uint64_t key, VkFormat format, const std::vector<MipLevel>& levels, const uint8_t* payload, size_t payload_size) const
+{
+	std::vector<uint8_t> header = serializeEntryHeader(key, format, levels, payload_size);
+
+	// Write to a file of its own and rename it over the entry, readers never see a partial entry
+	std::string path = getEntryPath(key);
+	std::string temporaryPath = path + "." + std::to_string(std::random_device()()) + ".tmp";
+	{
+		std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+			return; // (caching is best effort)
+
+		file.write(reinterpret_cast<const char*>(header.data()), header.size());
+		file.write(reinterpret_cast<const char*>(payload), payload_size);
+		if (!file)
+		{
+			file.close();
+			std::remove(temporaryPath.c_str());
+			return;
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::rename(temporaryPath, path, error);
+	if (error)
+	{
+		std::remove(temporaryPath.c_str());
+	}
+}
+
+std::string TextureCache::getEntryPath(uint64_t key) const
+{
+	char name[32];
+	std::snprintf(name, sizeof(name), "%016llx.vtc", static_cast<unsigned long long>(key));
+	return (std::filesystem::path(m_Directory) / name).string();
+}
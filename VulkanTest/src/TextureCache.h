@@ -0,0 +1,59 @@
+﻿#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+#include "MappedFile.h"
+#include "MipmapGenerator.h"
+
+// Everything that changes the payload produced from a source image, part of the cache key
+struct TextureImportSettings
+{
+	VkFormat format = VK_FORMAT_R8G8B8A8_SRGB;
+	bool srgb = true;
+	bool generateMipsOnCpu = true; // otherwise only level 0 is stored (atlas sources, the mips are generated per layer)
+};
+
+// Payload of a cache hit, mapped from the cache file (or of a baked texture parsed from memory)
+struct TextureCacheEntry
+{
+	MappedFile file;
+	uint64_t key = 0;
+	VkFormat format = VK_FORMAT_UNDEFINED;
+	std::vector<MipLevel> levels; // offsets from the start of the payload
+	const uint8_t* payload = nullptr;
+	size_t payloadSize = 0;
+};
+
+/**
+ * On-disk cache of decoded (and mipped) texture payloads, one file per entry in the cache directory.
+ * Entries are keyed by a hash of the source file bytes and of the import settings, so editing a source
+ * or changing how it is imported simply misses and writes a new entry.
+ * The entry layout (header | levels | payload) is also the layout of baked textures in asset archives.
+ */
+class TextureCache
+{
+public:
+	void create(const std::string& directory);
+
+	static uint64_t computeKey(const uint8_t* source, size_t source_size, const TextureImportSettings& settings);
+
+	// Maps the entry of the key, returns false on a miss (or an invalid entry)
+	bool load(uint64_t key, TextureCacheEntry& entry) const;
+
+	// Writes the entry of the key (safe to call from several threads and processes, the last writer wins)
+	void store(uint64_t key, VkFormat format, const std::vector<MipLevel>& levels, const uint8_t* payload, size_t payload_size) const;
+
+	// Parses a serialized entry, the payload points into data
+	// (returns false if the header or any level lies outside the data, so a corrupted entry is a miss)
+	static bool parseEntry(const uint8_t* data, size_t size, TextureCacheEntry& entry);
+
+	// Everything that precedes the payload in a serialized entry
+	static std::vector<uint8_t> serializeEntryHeader(uint64_t key, VkFormat format, const std::vector<MipLevel>& levels, size_t payload_size);
+
+private:
+	std::string getEntryPath(uint64_t key) const;
+
+	std::string m_Directory;
+};
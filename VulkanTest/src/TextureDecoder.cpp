@@ -0,0 +1,31 @@
+﻿#include "TextureDecoder.h"
+
+#include <cstring>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+bool TextureDecoder::readInfo(const uint8_t* file_data, size_t file_size, uint32_t& width, uint32_t& height)
+{
+	int texWidth, texHeight, texChannels;
+	if (!stbi_info_from_memory(file_data, static_cast<int>(file_size), &texWidth, &texHeight, &texChannels))
+		return false;
+
+	width = static_cast<uint32_t>(texWidth);
+	height = static_cast<uint32_t>(texHeight);
+	return true;
+}
+
+bool TextureDecoder::decodeRGBA8(const uint8_t* file_data, size_t file_size, uint8_t* dst, uint32_t width, uint32_t height)
+{
+	int texWidth, texHeight, texChannels;
+	stbi_uc* pixels = stbi_load_from_memory(file_data, static_cast<int>(file_size), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+
+	bool isDecoded = pixels && static_cast<uint32_t>(texWidth) == width && static_cast<uint32_t>(texHeight) == height;
+	if (isDecoded)
+	{
+		std::memcpy(dst, pixels, size_t(width) * height * 4);
+	}
+	stbi_image_free(pixels);
+	return isDecoded;
+}
@@ -0,0 +1,13 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Image file decoding (stb_image) into caller owned memory (one copy from the decoder's buffer), safe to use from several threads
+struct TextureDecoder
+{
+	// Dimensions of an encoded image file held in memory (mapped or read), without decoding it
+	static bool readInfo(const uint8_t* file_data, size_t file_size, uint32_t& width, uint32_t& height);
+
+	// Decodes the image to RGBA8 into dst (width * height * 4 bytes), returns false if the file cannot be decoded
+	static bool decodeRGBA8(const uint8_t* file_data, size_t file_size, uint8_t* dst, uint32_t width, uint32_t height);
+};
@@ -5,6 +5,8 @@
 #include "VulkanCommon.h"
 #include "VulkanContext.h"
 #include "VulkanFunctions.h"
+#include "VulkanHostAllocator.h"
+#include "VulkanMemoryTelemetry.h"
 
 namespace detail
 {
@@ -20,7 +22,9 @@ void VulkanBuffer::create(
 	bufferCreateInfo.size = size;
 	bufferCreateInfo.usage = usage;
 
-	if (device_context.m_QueueFamilyIndices.transferFamily.has_value())
+	// (the transfer family falls back to the graphics family when there's no dedicated one)
+	if (device_context.m_QueueFamilyIndices.transferFamily.has_value() &&
+	    device_context.m_QueueFamilyIndices.transferFamily != device_context.m_QueueFamilyIndices.graphicsFamily)
 	{
 		bufferCreateInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
 
@@ -33,7 +37,7 @@ void VulkanBuffer::create(
 		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 	}
 
-	if (VK_SUCCESS != vkCreateBuffer(device_context.m_Device, &bufferCreateInfo, nullptr, &m_Buffer))
+	if (VK_SUCCESS != vkCreateBuffer(device_context.m_Device, &bufferCreateInfo, VulkanHostAllocator::getCallbacks(), &m_Buffer))
 	{
 		throw std::runtime_error("Failed to create Vertex Buffer!");
 	}
@@ -47,10 +51,12 @@ void VulkanBuffer::create(
 	memoryAllocateInfo.allocationSize = memoryRequirements.size;
 	memoryAllocateInfo.memoryTypeIndex = vulkan::findMemoryType(device_context.m_PhysicalDevice, memoryRequirements.memoryTypeBits, properties);
 
-	if (VK_SUCCESS != vkAllocateMemory(device_context.m_Device, &memoryAllocateInfo, nullptr, &m_Memory))
+	if (VK_SUCCESS != vkAllocateMemory(device_context.m_Device, &memoryAllocateInfo, VulkanHostAllocator::getCallbacks(), &m_Memory))
 	{
 		throw std::runtime_error("Failed to allocate vertex buffer Memory!");
 	}
+	VulkanMemoryTelemetry::trackAllocation(device_context, m_Memory, memoryAllocateInfo.allocationSize, memoryAllocateInfo.memoryTypeIndex,
+	                                       VulkanMemoryTelemetry::getBufferCategory(usage));
 
 	vkBindBufferMemory(device_context.m_Device, m_Buffer, m_Memory, 0);
 
@@ -58,6 +64,7 @@ void VulkanBuffer::create(
 
 void VulkanBuffer::destroy(VkDevice device)
 {
-	vkDestroyBuffer(device, m_Buffer, nullptr);
-	vkFreeMemory(device, m_Memory, nullptr);
+	vkDestroyBuffer(device, m_Buffer, VulkanHostAllocator::getCallbacks());
+	VulkanMemoryTelemetry::untrackAllocation(m_Memory);
+	vkFreeMemory(device, m_Memory, VulkanHostAllocator::getCallbacks());
 }
@@ -0,0 +1,88 @@
+﻿#include "VulkanCommandRecorder.h"
+
+void VulkanCommandRecorder::begin(VkCommandBuffer command_buffer)
+{
+	m_CommandBuffer = command_buffer;
+
+	m_BoundPipeline = VK_NULL_HANDLE;
+	m_BoundPipelineLayout = VK_NULL_HANDLE;
+	m_BoundDescriptorSet = VK_NULL_HANDLE;
+	m_BoundVertexBuffer = VK_NULL_HANDLE;
+	m_BoundIndexBuffer = VK_NULL_HANDLE;
+	m_BoundIndexType = VK_INDEX_TYPE_MAX_ENUM;
+}
+
+void VulkanCommandRecorder::bindPipeline(VkPipeline pipeline)
+{
+	if (pipeline == m_BoundPipeline)
+	{
+		m_Stats.pipelineBindsElided++;
+		return;
+	}
+
+	vkCmdBindPipeline(m_CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+	m_BoundPipeline = pipeline;
+	m_Stats.pipelineBinds++;
+}
+
+void VulkanCommandRecorder::bindDescriptorSet(VkPipelineLayout pipeline_layout, VkDescriptorSet descriptor_set)
+{
+	// (the graphics pipelines share one pipeline layout, so a bound set stays valid across pipeline binds)
+	if (descriptor_set == m_BoundDescriptorSet && pipeline_layout == m_BoundPipelineLayout)
+	{
+		m_Stats.descriptorSetBindsElided++;
+		return;
+	}
+
+	vkCmdBindDescriptorSets(m_CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout, 0, 1, &descriptor_set, 0, nullptr);
+	m_BoundPipelineLayout = pipeline_layout;
+	m_BoundDescriptorSet = descriptor_set;
+	m_Stats.descriptorSetBinds++;
+}
+
+void VulkanCommandRecorder::bindVertexBuffer(VkBuffer vertex_buffer)
+{
+	if (vertex_buffer == m_BoundVertexBuffer)
+	{
+		m_Stats.vertexBufferBindsElided++;
+		return;
+	}
+
+	VkDeviceSize offset = 0;
+	vkCmdBindVertexBuffers(m_CommandBuffer, 0, 1, &vertex_buffer, &offset);
+	m_BoundVertexBuffer = vertex_buffer;
+	m_Stats.vertexBufferBinds++;
+}
+
+void VulkanCommandRecorder::bindIndexBuffer(VkBuffer index_buffer, VkIndexType index_type)
+{
+	if (index_buffer == m_BoundIndexBuffer && index_type == m_BoundIndexType)
+	{
+		m_Stats.indexBufferBindsElided++;
+		return;
+	}
+
+	vkCmdBindIndexBuffer(m_CommandBuffer, index_buffer, 0, index_type);
+	m_BoundIndexBuffer = index_buffer;
+	m_BoundIndexType = index_type;
+	m_Stats.indexBufferBinds++;
+}
+
+void VulkanCommandRecorder::record(const VulkanDrawPacket& packet)
+{
+	bindPipeline(packet.pipeline);
+	bindDescriptorSet(packet.pipelineLayout, packet.descriptorSet);
+	bindVertexBuffer(packet.vertexBuffer);
+	bindIndexBuffer(packet.indexBuffer, packet.indexType);
+
+	vkCmdDrawIndexedIndirect(m_CommandBuffer, packet.indirectBuffer, packet.indirectOffset, packet.drawCount,
+	                         sizeof(VkDrawIndexedIndirectCommand));
+}
+
+void VulkanCommandRecorder::record(const std::vector<VulkanDrawPacket>& packets)
+{
+	for (const VulkanDrawPacket& packet : packets)
+	{
+		record(packet);
+	}
+}
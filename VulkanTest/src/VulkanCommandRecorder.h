@@ -0,0 +1,67 @@
+﻿#pragma once
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+// One indirect draw of a pass along with the state it needs
+struct VulkanDrawPacket
+{
+	uint64_t sortKey;
+
+	VkPipeline pipeline;
+	VkPipelineLayout pipelineLayout;
+	VkDescriptorSet descriptorSet;
+	VkBuffer vertexBuffer;
+	VkBuffer indexBuffer;
+	VkIndexType indexType;
+
+	VkBuffer indirectBuffer;
+	VkDeviceSize indirectOffset;
+	uint32_t drawCount;
+};
+
+// Binds issued to the command buffer versus binds skipped because the state was already bound
+struct VulkanBindStats
+{
+	uint32_t pipelineBinds, pipelineBindsElided;
+	uint32_t descriptorSetBinds, descriptorSetBindsElided;
+	uint32_t vertexBufferBinds, vertexBufferBindsElided;
+	uint32_t indexBufferBinds, indexBufferBindsElided;
+
+	uint32_t getIssued() const { return pipelineBinds + descriptorSetBinds + vertexBufferBinds + indexBufferBinds; }
+	uint32_t getElided() const { return pipelineBindsElided + descriptorSetBindsElided + vertexBufferBindsElided + indexBufferBindsElided; }
+};
+
+/**
+ * Records draw packets into a command buffer while tracking the bound graphics state,
+ * so that the vkCmdBind* calls matching what is already bound are skipped.
+ * The packets are expected to be sorted by their key, which groups the packets sharing state.
+ */
+class VulkanCommandRecorder
+{
+public:
+	// Forget the tracked state (a new command buffer starts with nothing bound)
+	void begin(VkCommandBuffer command_buffer);
+	void resetStats() { m_Stats = {}; }
+
+	void bindPipeline(VkPipeline pipeline);
+	void bindDescriptorSet(VkPipelineLayout pipeline_layout, VkDescriptorSet descriptor_set);
+	void bindVertexBuffer(VkBuffer vertex_buffer);
+	void bindIndexBuffer(VkBuffer index_buffer, VkIndexType index_type);
+
+	void record(const VulkanDrawPacket& packet);
+	void record(const std::vector<VulkanDrawPacket>& packets);
+
+	const VulkanBindStats& getStats() const { return m_Stats; }
+
+private:
+	VkCommandBuffer m_CommandBuffer{};
+
+	VkPipeline m_BoundPipeline{};
+	VkPipelineLayout m_BoundPipelineLayout{};
+	VkDescriptorSet m_BoundDescriptorSet{};
+	VkBuffer m_BoundVertexBuffer{};
+	VkBuffer m_BoundIndexBuffer{};
+	VkIndexType m_BoundIndexType = VK_INDEX_TYPE_MAX_ENUM;
+
+	VulkanBindStats m_Stats{};
+};
@@ -6,30 +6,52 @@
 #include <optional>
 #include <set>
 #include <chrono>
+#include <filesystem>
 
 #define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "AssetArchive.h"
+#include "AssetPaths.h"
 #include "BufferData.h"
-#include "stb_image.h"
+#include "Ktx2Loader.h"
+#include "MeshImporter.h"
+#include "Profiler.h"
+#include "TextureCache.h"
+#include "TextureDecoder.h"
 #include "VulkanCommon.h"
 #include "VulkanFunctions.h"
+#include "VulkanHostAllocator.h"
 
 namespace detail
 {
 	static bool check_validation_layer_support();
 	static void populate_debug_messenger_create_info(VkDebugUtilsMessengerCreateInfoEXT& createInfo);
-	static std::vector<const char*> get_required_instance_extensions();
+	static std::vector<const char*> get_required_instance_extensions(bool headless);
 	static bool is_device_suitable(VkPhysicalDevice device, VkSurfaceKHR surface);
 	static VulkanQueueFamilyIndices find_queue_families(VkPhysicalDevice device, VkSurfaceKHR surface);
 	static bool check_device_extension_support(VkPhysicalDevice device);
 	static VulkanSwapchainSupportDetails query_swapchain_support(VkPhysicalDevice device, VkSurfaceKHR surface);
 
+	// Pipeline identifiers encoded in the draw sort keys
+	enum ScenePipelineId : uint32_t
+	{
+		Opaque = 0,
+		DepthPrePass,
+		EqualTest,
+		AlphaTest,
+		Transparent,
+	};
+
 	static VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& available_formats);
 	static VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& available_present_modes);
 	static VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities, uint32_t window_width, uint32_t window_height);
 
+	// Demo quad split into subdivisions x subdivisions quads (attributes interpolated from its corners)
+	static void subdivideQuad(uint32_t subdivisions, MeshData& mesh_data);
+
 	static VKAPI_ATTR VkBool32 VKAPI_CALL debug_messenger_callback(
 	    VkDebugUtilsMessageSeverityFlagBitsEXT           messageSeverity,
 	    VkDebugUtilsMessageTypeFlagsEXT                  messageTypes,
@@ -55,6 +77,8 @@ namespace detail
 			VK_KHR_SWAPCHAIN_EXTENSION_NAME,
 		};
 
+		// GPU profiler scope of each draw layer
+		const char* s_DrawLayerNames[] = { "Depth pre-pass", "Opaque", "Alpha test", "Transparent" };
 	}
 }
 
@@ -71,10 +95,46 @@ void VulkanDeviceContext::retrieveDeviceContext()
 	vkEnumerateDeviceExtensionProperties(m_PhysicalDevice, nullptr, &extensionCount, m_AvailableExtensions.data());
 }
 
+void VulkanContext::initHeadlessContext(const char* app_name, VkExtent2D extent, bool enable_debugging)
+{
+	m_Headless = true;
+	m_SwapchainImageExtent = extent;
+
+	initContext(app_name, nullptr, enable_debugging);
+}
+
 void VulkanContext::initContext(const char* app_name, GLFWwindow* window, bool enable_debugging)
 {
+	PROFILE_SCOPE("initContext");
+
 	m_Window = window;
 
+	m_FrameStatistics.create();
+
+	if (m_Replay)
+	{
+		m_SceneSettings.objectCount = m_Replay->settings.objectCount;
+		m_SceneSettings.textureCount = m_Replay->settings.textureCount;
+		m_SceneSettings.framesInFlight = m_Replay->settings.framesInFlight;
+		m_ReplayFrame = 0;
+	}
+
+	// Objects duplicated for each frame in flight
+	uint32_t framesInFlight = m_SceneSettings.framesInFlight;
+	m_CommandBuffers.resize(framesInFlight);
+	m_ImageAvailableSemaphores.resize(framesInFlight);
+	m_RenderFinishedSemaphores.resize(framesInFlight);
+	m_InFlightFences.resize(framesInFlight);
+	m_StreamedTextureViewVersions.resize(framesInFlight);
+	m_DrawListBuffers.resize(framesInFlight);
+	m_DrawListMapped.resize(framesInFlight);
+	m_CullingStatsBuffers.resize(framesInFlight);
+	m_CullingStatsMapped.resize(framesInFlight);
+	m_DescriptorSets.resize(framesInFlight);
+	m_CullingDescriptorSets.resize(framesInFlight);
+	m_UniformBuffers.resize(framesInFlight);
+	m_UniformBufferMapped.resize(framesInFlight);
+
 #ifdef VKTUT_VK_ENABLE_VALIDATION
 	detail::s_EnableDebugLayers = enable_debugging;
 #endif
@@ -88,8 +148,11 @@ void VulkanContext::initContext(const char* app_name, GLFWwindow* window, bool e
 	setupDebugMessenger();
 
 	// Create a window surface for presenting on screen
-	// (can be skipped if rendering off-screen or in headless mode)
-	createSurface(window);
+	// (skipped in headless mode, the devices are then selected without any presentation support)
+	if (!m_Headless)
+	{
+		createSurface(window);
+	}
 
 	// Select a Vulkan supported GPU for use
 	// (can use multiple physical devices as well)
@@ -100,107 +163,239 @@ void VulkanContext::initContext(const char* app_name, GLFWwindow* window, bool e
 	// Create a logical device for the selected GPU
 	// (can create multiple logical devices for same physical device with different extensions and features)
 	createLogicalDevice();
+	m_SamplerCache.create(m_DeviceContext);
+	m_ImageViewCache.create(m_DeviceContext);
 
 	// createSwapchain(window, indices);
-	VulkanSwapchainSupportDetails swapchainSupportDetails = detail::query_swapchain_support(m_DeviceContext.m_PhysicalDevice, m_Surface);
+	VulkanSwapchainSupportDetails swapchainSupportDetails{};
+	if (m_Headless)
+	{
+		// Any color format the device can render to (the extent was given by initHeadlessContext)
+		m_SwapchainImageFormat.format = vulkan::findSupportedFormat(m_DeviceContext.m_PhysicalDevice,
+		                                                            { VK_FORMAT_B8G8R8A8_SRGB, VK_FORMAT_R8G8B8A8_SRGB },
+		                                                            VK_IMAGE_TILING_OPTIMAL,
+		                                                            VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT);
+		m_SwapchainImageFormat.colorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
+	}
+	else
+	{
+		swapchainSupportDetails = detail::query_swapchain_support(m_DeviceContext.m_PhysicalDevice, m_Surface);
 
-	int width, height;
-	glfwGetFramebufferSize(window, &width, &height);
+		int width, height;
+		glfwGetFramebufferSize(window, &width, &height);
 
-	VkSurfaceFormatKHR surfaceFormat = detail::chooseSwapSurfaceFormat(swapchainSupportDetails.formats);
-	VkPresentModeKHR presentMode = detail::chooseSwapPresentMode(swapchainSupportDetails.presentModes);
-	VkExtent2D extent = detail::chooseSwapExtent(swapchainSupportDetails.capabilities, width, height);
+		// Save the extent and format
+		m_SwapchainImageFormat = detail::chooseSwapSurfaceFormat(swapchainSupportDetails.formats);
+		m_SwapchainImageExtent = detail::chooseSwapExtent(swapchainSupportDetails.capabilities, width, height);
+	}
 
-	m_RenderPass.create(m_DeviceContext.m_Device, surfaceFormat.format);
+	// Select a depth format that can also be sampled when building the depth pyramid
+	m_DepthFormat = vulkan::findSupportedFormat(m_DeviceContext.m_PhysicalDevice,
+	                                            { VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT },
+	                                            VK_IMAGE_TILING_OPTIMAL,
+	                                            VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
 
-	uint32_t imageCount = swapchainSupportDetails.capabilities.minImageCount + 1;
-	if (swapchainSupportDetails.capabilities.maxImageCount > 0 && imageCount > swapchainSupportDetails.capabilities.maxImageCount)
+	m_RenderPass.create(m_DeviceContext.m_Device, m_SwapchainImageFormat.format, m_DepthFormat);
+	m_LateRenderPass.create(m_DeviceContext.m_Device, m_SwapchainImageFormat.format, m_DepthFormat, true, !m_Headless);
+
+	if (m_Headless)
 	{
-		imageCount--;
+		// One offscreen image per frame in flight, the frame index is the image index
+		m_Swapchain.createOffscreen(m_DeviceContext, m_SwapchainImageFormat.format, m_SwapchainImageExtent, m_SceneSettings.framesInFlight);
 	}
+	else
+	{
+		VkPresentModeKHR presentMode = detail::chooseSwapPresentMode(swapchainSupportDetails.presentModes);
 
-	// Save the extent and format
-	m_SwapchainImageFormat = surfaceFormat;
-	m_SwapchainImageExtent = extent;
+		uint32_t imageCount = swapchainSupportDetails.capabilities.minImageCount + 1;
+		if (swapchainSupportDetails.capabilities.maxImageCount > 0 && imageCount > swapchainSupportDetails.capabilities.maxImageCount)
+		{
+			imageCount--;
+		}
 
-	m_Swapchain.create(
-		m_DeviceContext.m_Device,
-		m_Surface,
-		swapchainSupportDetails,
-		surfaceFormat,
-		presentMode,
-		extent,
-		imageCount,
-		m_DeviceContext.m_QueueFamilyIndices
-	);
+		m_Swapchain.create(
+			m_DeviceContext.m_Device,
+			m_Surface,
+			swapchainSupportDetails,
+			m_SwapchainImageFormat,
+			presentMode,
+			m_SwapchainImageExtent,
+			imageCount,
+			m_DeviceContext.m_QueueFamilyIndices
+		);
+	}
 
 	m_Swapchain.createImageViews(m_DeviceContext.m_Device, m_SwapchainImageFormat.format);
-	m_Swapchain.createFramebuffers(m_DeviceContext.m_Device, m_RenderPass.m_RenderPass, m_SwapchainImageExtent);
 
 	m_GraphicsPipeline.create(m_DeviceContext.m_Device,
-							  "..\\build\\bin\\Debug-x86_64\\VulkanTest\\mesh_shader.vert.spv",
-	                          "..\\build\\bin\\Debug-x86_64\\VulkanTest\\simple_shader.frag.spv",
+							  AssetPaths::getShader("mesh_shader.vert.spv"),
+	                          AssetPaths::getShader("simple_shader.frag.spv"),
 							  m_SwapchainImageExtent,
 	                          m_RenderPass.m_RenderPass);
 
+	// Depth pre-pass variants of the graphics pipeline
+	// (every variant shares the layouts of the graphics pipeline, so the bound descriptor set stays valid across them)
+	m_DepthPrePassPipeline.create(m_DeviceContext.m_Device,
+	                              AssetPaths::getShader("mesh_shader.vert.spv"),
+	                              "",
+	                              m_SwapchainImageExtent,
+	                              m_RenderPass.m_RenderPass,
+	                              VulkanDepthMode::PrePass,
+	                              VulkanBlendMode::Opaque,
+	                              &m_GraphicsPipeline);
+	m_EqualTestPipeline.create(m_DeviceContext.m_Device,
+	                           AssetPaths::getShader("mesh_shader.vert.spv"),
+	                           AssetPaths::getShader("simple_shader.frag.spv"),
+	                           m_SwapchainImageExtent,
+	                           m_RenderPass.m_RenderPass,
+	                           VulkanDepthMode::EqualTest,
+	                           VulkanBlendMode::Opaque,
+	                           &m_GraphicsPipeline);
+
+	// Alpha-tested and transparent material variants
+	m_AlphaTestPipeline.create(m_DeviceContext.m_Device,
+	                           AssetPaths::getShader("mesh_shader.vert.spv"),
+	                           AssetPaths::getShader("alpha_test_shader.frag.spv"),
+	                           m_SwapchainImageExtent,
+	                           m_RenderPass.m_RenderPass,
+	                           VulkanDepthMode::ReadWrite,
+	                           VulkanBlendMode::Opaque,
+	                           &m_GraphicsPipeline);
+	m_TransparentPipeline.create(m_DeviceContext.m_Device,
+	                             AssetPaths::getShader("mesh_shader.vert.spv"),
+	                             AssetPaths::getShader("transparent_shader.frag.spv"),
+	                             m_SwapchainImageExtent,
+	                             m_RenderPass.m_RenderPass,
+	                             VulkanDepthMode::ReadOnly,
+	                             VulkanBlendMode::AlphaBlend,
+	                             &m_GraphicsPipeline);
+
 	createCommandPool();
 	createCommandBuffer();
 	createSyncObjects();
+	m_GpuProfiler.create(m_DeviceContext, m_CommandPool, m_SceneSettings.framesInFlight);
+	m_PipelineStatistics.create(m_DeviceContext, m_SceneSettings.framesInFlight);
+
+	// Create the culling pipelines and buffers before the depth buffer, since the depth pyramid is created along with it
+	createCullingResources();
 
-	createVertexBuffer();
-	createIndexBuffer();
+	createDepthResources();
+	m_Swapchain.createFramebuffers(m_DeviceContext.m_Device, m_RenderPass.m_RenderPass, m_SwapchainImageExtent, m_DepthImageView);
 
-	createTextureImage("assets\\pusheen-thug-life.png");
-	createTextureImageView();
+	if (!m_CaptureFile.empty())
+	{
+		SceneCaptureSettings captureSettings{ m_SceneSettings.objectCount, m_SceneSettings.textureCount, m_SceneSettings.framesInFlight,
+		                                      m_SwapchainImageExtent.width, m_SwapchainImageExtent.height };
+		m_CaptureWriter.open(m_CaptureFile, captureSettings);
+	}
+
+	m_WorkerPool.create();
+	m_DrawSorter.setWorkerPool(&m_WorkerPool);
+	m_TextureCache.create(AssetPaths::getAsset(TEXTURE_CACHE_DIRECTORY));
+	m_AssetArchive.open(AssetPaths::getAsset(ASSET_ARCHIVE_FILE)); // (optional, loose files are used otherwise)
+
+	m_TextureStreamer.create(m_DeviceContext, m_CommandPool, m_ImageViewCache, TEXTURE_STREAMING_STAGING_SIZE, m_SceneSettings.framesInFlight);
+	createTextureImage("assets/pusheen-thug-life.png");
+	// (textures past the demo assets repeat them, as separate textures)
+	std::vector<std::string> atlasTextures;
+	static const char* s_AtlasAssets[] = { "assets/UV_Checker.png", "assets/pusheen-thug-life.png" };
+	for (uint32_t i = 0; i < m_SceneSettings.textureCount; i++)
+	{
+		atlasTextures.push_back(s_AtlasAssets[i % std::size(s_AtlasAssets)]);
+	}
+	if (m_Replay)
+	{
+		atlasTextures = m_Replay->atlasTextures;
+	}
+	if (m_CaptureWriter.isOpen())
+	{
+		m_CaptureWriter.writeAtlasTextures(atlasTextures);
+	}
+	createTextureAtlas(atlasTextures);
 	createTextureSampler();
 
+	// (the objects reference the atlas regions)
+	createGeometryPool();
+	createSceneObjects();
+
 	createUniformBuffers();
 	createDescriptorPool();
 	createDescriptorSets();
+	updateCullingDescriptorSets();
 }
 
 void VulkanContext::shutdownContext()
 {
 	vkDeviceWaitIdle(m_DeviceContext.m_Device);
 
+	m_CaptureWriter.close();
+
 	m_Swapchain.destroy(m_DeviceContext.m_Device);
 
-	vkDestroySampler(m_DeviceContext.m_Device, m_TextureSampler, nullptr);
-	vkDestroyImageView(m_DeviceContext.m_Device, m_TextureImageView, nullptr);
-	m_TextureImage.destroy(m_DeviceContext.m_Device);
+	m_DepthPyramid.destroy(m_DeviceContext.m_Device, m_SamplerCache, m_ImageViewCache);
+	m_ImageViewCache.release(m_DepthImageView);
+	m_DepthImage.destroy(m_DeviceContext.m_Device);
+
+	m_DrawCommandBuffer.destroy(m_DeviceContext.m_Device);
+	m_VisibilityBuffer.destroy(m_DeviceContext.m_Device);
+	m_ObjectBuffer.destroy(m_DeviceContext.m_Device);
 
-	m_IndexBuffer.destroy(m_DeviceContext.m_Device);
-	m_VertexBuffer.destroy(m_DeviceContext.m_Device);
+	m_SamplerCache.release(m_TextureSampler);
+	m_TextureStreamer.destroy(m_DeviceContext.m_Device);
+	m_ImageViewCache.release(m_TextureAtlasImageView);
+	m_TextureAtlasImage.destroy(m_DeviceContext.m_Device);
+	m_TextureAtlasRegionBuffer.destroy(m_DeviceContext.m_Device);
 
-	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+	m_GeometryPool.destroy(m_DeviceContext.m_Device);
+
+	m_WorkerPool.destroy();
+	m_AssetArchive.close();
+
+	for (size_t i = 0; i < m_SceneSettings.framesInFlight; i++)
 	{
 		m_UniformBuffers[i].destroy(m_DeviceContext.m_Device);
+		m_CullingStatsBuffers[i].destroy(m_DeviceContext.m_Device);
+		m_DrawListBuffers[i].destroy(m_DeviceContext.m_Device);
 
-		vkDestroyDescriptorPool(m_DeviceContext.m_Device, m_DescriptorPool, nullptr);
-
-		vkDestroySemaphore(m_DeviceContext.m_Device, m_ImageAvailableSemaphores[i], nullptr);
-		vkDestroySemaphore(m_DeviceContext.m_Device, m_RenderFinishedSemaphores[i], nullptr);
-		vkDestroyFence(m_DeviceContext.m_Device, m_InFlightFences[i], nullptr);
+		vkDestroySemaphore(m_DeviceContext.m_Device, m_ImageAvailableSemaphores[i], VulkanHostAllocator::getCallbacks());
+		vkDestroySemaphore(m_DeviceContext.m_Device, m_RenderFinishedSemaphores[i], VulkanHostAllocator::getCallbacks());
+		vkDestroyFence(m_DeviceContext.m_Device, m_InFlightFences[i], VulkanHostAllocator::getCallbacks());
 	}
 
+	vkDestroyDescriptorPool(m_DeviceContext.m_Device, m_DescriptorPool, VulkanHostAllocator::getCallbacks());
+	m_GpuProfiler.destroy(m_DeviceContext.m_Device);
+	m_PipelineStatistics.destroy(m_DeviceContext.m_Device);
+
 	vkFreeCommandBuffers(m_DeviceContext.m_Device, m_CommandPool, m_CommandBuffers.size(), m_CommandBuffers.data());
 
-	vkDestroyCommandPool(m_DeviceContext.m_Device, m_CommandPool, nullptr);
+	vkDestroyCommandPool(m_DeviceContext.m_Device, m_CommandPool, VulkanHostAllocator::getCallbacks());
 
-	m_GraphicsPipeline.destroy(m_DeviceContext.m_Device);
+	m_DepthPrePassPipeline.destroy(m_DeviceContext.m_Device);
+	m_EqualTestPipeline.destroy(m_DeviceContext.m_Device);
+	m_AlphaTestPipeline.destroy(m_DeviceContext.m_Device);
+	m_TransparentPipeline.destroy(m_DeviceContext.m_Device);
+	m_GraphicsPipeline.destroy(m_DeviceContext.m_Device); // (owns the layouts the variants share)
+	m_DepthPyramidPipeline.destroy(m_DeviceContext.m_Device);
+	m_CullingPipeline.destroy(m_DeviceContext.m_Device);
 
 	m_RenderPass.destroy(m_DeviceContext.m_Device);
+	m_LateRenderPass.destroy(m_DeviceContext.m_Device);
 
+	m_SamplerCache.destroy(m_DeviceContext.m_Device);
+	m_ImageViewCache.destroy(m_DeviceContext.m_Device);
 
-	vkDestroyDevice(m_DeviceContext.m_Device, nullptr);
-	vkDestroySurfaceKHR(m_Instance, m_Surface, nullptr);
+	vkDestroyDevice(m_DeviceContext.m_Device, VulkanHostAllocator::getCallbacks());
+	if (VK_NULL_HANDLE != m_Surface)
+	{
+		vkDestroySurfaceKHR(m_Instance, m_Surface, VulkanHostAllocator::getCallbacks());
+	}
 
 	if (detail::s_EnableDebugLayers)
 	{
-		vulkan::destroyDebugUtilsMessengerEXT(m_Instance, m_DebugMessenger, nullptr);
+		vulkan::destroyDebugUtilsMessengerEXT(m_Instance, m_DebugMessenger, VulkanHostAllocator::getCallbacks());
 	}
 
-	vkDestroyInstance(m_Instance, nullptr);
+	vkDestroyInstance(m_Instance, VulkanHostAllocator::getCallbacks());
 }
 
 void VulkanContext::createInstance(const char* app_name)
@@ -239,11 +434,11 @@ void VulkanContext::createInstance(const char* app_name)
 		createInfo.pNext = nullptr;
 	}
 	
-	const std::vector<const char*> extensions = detail::get_required_instance_extensions();
+	const std::vector<const char*> extensions = detail::get_required_instance_extensions(m_Headless);
 	createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
 	createInfo.ppEnabledExtensionNames = extensions.data();
 
-	if (VK_SUCCESS != vkCreateInstance(&createInfo, nullptr, &m_Instance))
+	if (VK_SUCCESS != vkCreateInstance(&createInfo, VulkanHostAllocator::getCallbacks(), &m_Instance))
 	{
 		throw std::runtime_error("Failed to create Vulkan Instance!");
 	}
@@ -256,7 +451,7 @@ void VulkanContext::setupDebugMessenger()
 	VkDebugUtilsMessengerCreateInfoEXT createInfo{};
 	detail::populate_debug_messenger_create_info(createInfo);
 
-	if (VK_SUCCESS != vulkan::createDebugUtilsMessengerEXT(m_Instance, &createInfo, nullptr, &m_DebugMessenger))
+	if (VK_SUCCESS != vulkan::createDebugUtilsMessengerEXT(m_Instance, &createInfo, VulkanHostAllocator::getCallbacks(), &m_DebugMessenger))
 	{
 		throw std::runtime_error("Failed to set up Debug Messenger!");
 	}
@@ -264,7 +459,7 @@ void VulkanContext::setupDebugMessenger()
 
 void VulkanContext::createSurface(GLFWwindow* window)
 {
-	if (VK_SUCCESS != glfwCreateWindowSurface(m_Instance, window, nullptr, &m_Surface))
+	if (VK_SUCCESS != glfwCreateWindowSurface(m_Instance, window, VulkanHostAllocator::getCallbacks(), &m_Surface))
 	{
 		throw std::runtime_error("Failed to create window Surface!");
 	}
@@ -284,14 +479,24 @@ void VulkanContext::selectPhysicalDevice()
 	std::vector<VkPhysicalDevice> devices(deviceCount);
 	vkEnumeratePhysicalDevices(m_Instance, &deviceCount, devices.data());
 
-	// Select the first device suited to our needs
-	// (can be modified to allow selection of device or assign priorities to devices based on available features and extensions)
+	// Select the first device suited to our needs, the first discrete GPU if there is one
+	// (only headless mode accepts other devices, software implementations included)
 	for (const VkPhysicalDevice& device : devices)
 	{
 		if (detail::is_device_suitable(device, m_Surface))
 		{
-			m_DeviceContext.m_PhysicalDevice = device;
-			break;
+			VkPhysicalDeviceProperties deviceProperties{};
+			vkGetPhysicalDeviceProperties(device, &deviceProperties);
+
+			bool isDiscrete = VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU == deviceProperties.deviceType;
+			if (VK_NULL_HANDLE == m_DeviceContext.m_PhysicalDevice || isDiscrete)
+			{
+				m_DeviceContext.m_PhysicalDevice = device;
+			}
+			if (isDiscrete)
+			{
+				break;
+			}
 		}
 	}
 
@@ -330,6 +535,16 @@ void VulkanContext::createLogicalDevice()
 	// TODO: Replicate the required physical device features required
 	VkPhysicalDeviceFeatures deviceFeatures{};
 	deviceFeatures.samplerAnisotropy = VK_TRUE;
+	deviceFeatures.multiDrawIndirect = VK_TRUE; // draw all the objects with a single indirect call
+	deviceFeatures.drawIndirectFirstInstance = VK_TRUE; // firstInstance carries the object index
+	deviceFeatures.shaderSampledImageArrayDynamicIndexing = VK_TRUE; // the streamed textures are an array of samplers
+	// (optional) block-compressed texture families, KTX2 textures are only used if their format is sampleable
+	deviceFeatures.textureCompressionBC = m_DeviceContext.m_PhysicalDeviceFeatures.textureCompressionBC;
+	deviceFeatures.textureCompressionETC2 = m_DeviceContext.m_PhysicalDeviceFeatures.textureCompressionETC2;
+	deviceFeatures.textureCompressionASTC_LDR = m_DeviceContext.m_PhysicalDeviceFeatures.textureCompressionASTC_LDR;
+	// (optional) query types of the pipeline statistics
+	deviceFeatures.pipelineStatisticsQuery = m_DeviceContext.m_PhysicalDeviceFeatures.pipelineStatisticsQuery;
+	deviceFeatures.occlusionQueryPrecise = m_DeviceContext.m_PhysicalDeviceFeatures.occlusionQueryPrecise;
 
 	VkDeviceCreateInfo createInfo{};
 	createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -339,8 +554,25 @@ void VulkanContext::createLogicalDevice()
 
 	// Enable the required device extensions
 	// (the availability of these extensions was already checked while selecting the physical device)
-	createInfo.enabledExtensionCount = static_cast<uint32_t>(detail::s_DeviceExtensions.size());
-	createInfo.ppEnabledExtensionNames = detail::s_DeviceExtensions.data();
+	// (headless mode presents nothing, so it does without the swapchain extension)
+	std::vector<const char*> deviceExtensions;
+	if (!m_Headless)
+	{
+		deviceExtensions = detail::s_DeviceExtensions;
+	}
+
+	// (optional) memory budget queries, used to size the texture streaming budget
+	for (const VkExtensionProperties& extension : m_DeviceContext.m_AvailableExtensions)
+	{
+		if (0 == strcmp(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME, extension.extensionName))
+		{
+			deviceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+			m_DeviceContext.m_HasMemoryBudget = true;
+		}
+	}
+
+	createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
+	createInfo.ppEnabledExtensionNames = deviceExtensions.data();
 
 	if (detail::s_EnableDebugLayers)
 	{
@@ -352,7 +584,7 @@ void VulkanContext::createLogicalDevice()
 		createInfo.enabledLayerCount = 0;
 	}
 
-	if (VK_SUCCESS != vkCreateDevice(m_DeviceContext.m_PhysicalDevice, &createInfo, nullptr, &m_DeviceContext.m_Device))
+	if (VK_SUCCESS != vkCreateDevice(m_DeviceContext.m_PhysicalDevice, &createInfo, VulkanHostAllocator::getCallbacks(), &m_DeviceContext.m_Device))
 	{
 		throw std::runtime_error("Failed to create Logical Device!");
 	}
@@ -378,15 +610,113 @@ void VulkanContext::createCommandPool()
 	commandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 	commandPoolCreateInfo.queueFamilyIndex = m_DeviceContext.m_QueueFamilyIndices.graphicsFamily.value();
 
-	if (VK_SUCCESS != vkCreateCommandPool(m_DeviceContext.m_Device, &commandPoolCreateInfo, nullptr, &m_CommandPool))
+	if (VK_SUCCESS != vkCreateCommandPool(m_DeviceContext.m_Device, &commandPoolCreateInfo, VulkanHostAllocator::getCallbacks(), &m_CommandPool))
 	{
 		throw std::runtime_error("Failed to create Command Pool!");
 	}
 }
 
-void VulkanContext::createVertexBuffer()
+void VulkanContext::createDepthResources()
+{
+	m_DepthImage.create(m_DeviceContext,
+	                    m_SwapchainImageExtent.width,
+	                    m_SwapchainImageExtent.height,
+	                    1,
+	                    VK_IMAGE_TYPE_2D,
+	                    m_DepthFormat,
+	                    VK_IMAGE_TILING_OPTIMAL,
+	                    VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+	                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	// Layout transitions are handled by the render passes
+	m_DepthImageView = m_ImageViewCache.acquire(m_DepthImage.m_Image, m_DepthFormat, 1, 1, VK_IMAGE_ASPECT_DEPTH_BIT);
+
+	// The depth pyramid follows the size of the depth buffer
+	m_DepthPyramid.create(m_DeviceContext, m_SamplerCache, m_ImageViewCache, m_SwapchainImageExtent, m_DepthImageView, m_DepthPyramidPipeline);
+	transitionImageLayout(m_DepthPyramid.m_Image.m_Image, VK_FORMAT_R32_SFLOAT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+	                      m_DepthPyramid.m_MipLevels);
+}
+
+void VulkanContext::createGeometryPool()
 {
-	size_t size = Mesh::getNumVertices() * sizeof(Vertex);
+	PROFILE_SCOPE("createGeometryPool");
+
+	m_GeometryPool.create(m_DeviceContext, m_CommandPool, sizeof(Vertex), GEOMETRY_POOL_VERTEX_CAPACITY, GEOMETRY_POOL_INDEX_BUFFER_SIZE);
+
+	// A replay uploads the captured meshes in the same order, so they land at the same ranges of the pool
+	if (m_Replay)
+	{
+		for (const SceneCaptureMesh& mesh : m_Replay->meshes)
+		{
+			m_GeometryPool.addMesh(mesh.vertices.data(), static_cast<uint32_t>(mesh.vertices.size()), mesh.indices.data(), mesh.indexCount, mesh.indexType);
+		}
+		return;
+	}
+
+	// Let the importer pick the index type of the mesh
+	MeshData quadData{};
+	if (m_SceneSettings.meshSubdivisions > 1)
+	{
+		detail::subdivideQuad(std::min(m_SceneSettings.meshSubdivisions, 255u), quadData);
+	}
+	else
+	{
+		quadData.vertices.assign(Mesh::getVertices(), Mesh::getVertices() + Mesh::getNumVertices());
+		quadData.indices.assign(Mesh::getIndices(), Mesh::getIndices() + Mesh::getNumIndices());
+	}
+
+	std::vector<MeshChunk> quadChunks = MeshImporter::prepare(quadData);
+	assert(1 == quadChunks.size()); // (only meshes with more than 65536 vertices can be split)
+
+	const MeshChunk& quadChunk = quadChunks.front();
+	m_QuadMesh = m_GeometryPool.addMesh(quadChunk.vertices.data(), static_cast<uint32_t>(quadChunk.vertices.size()),
+	                                    quadChunk.indices.data(), quadChunk.indexCount, quadChunk.indexType);
+	if (m_CaptureWriter.isOpen())
+	{
+		m_CaptureWriter.writeMesh(quadChunk.vertices.data(), static_cast<uint32_t>(quadChunk.vertices.size()),
+		                          quadChunk.indices.data(), quadChunk.indexCount, quadChunk.indexType);
+	}
+}
+
+void VulkanContext::createSceneObjects()
+{
+	if (m_Replay)
+	{
+		// (the captured objects already reference their meshes and atlas regions, at the ranges they are uploaded to again)
+		m_SceneObjects = m_Replay->objects;
+		m_SceneObjectMeshes = m_Replay->objectMeshes;
+		for (size_t objectIndex = 0; objectIndex < m_SceneObjects.size(); objectIndex++)
+		{
+			const VulkanMeshRange& mesh = m_GeometryPool.getMesh(m_SceneObjectMeshes[objectIndex]);
+			const glm::uvec4& range = m_SceneObjects[objectIndex].mesh;
+			if (range.x < mesh.firstIndex || range.x - mesh.firstIndex > mesh.indexCount
+			    || range.y > mesh.indexCount - (range.x - mesh.firstIndex) || range.z != mesh.vertexOffset)
+			{
+				throw std::runtime_error("Captured object does not match the range of its mesh in the geometry pool!");
+			}
+		}
+	}
+	else
+	{
+		m_SceneObjects = Scene::generateObjects(m_SceneSettings.objectCount);
+
+		// Every object draws the quad from the geometry pool
+		// (every other object is textured from the atlas, cycling through its textures)
+		m_SceneObjectMeshes.assign(m_SceneSettings.objectCount, m_QuadMesh);
+		for (uint32_t objectIndex = 0; objectIndex < m_SceneSettings.objectCount; objectIndex++)
+		{
+			const VulkanMeshRange& mesh = m_GeometryPool.getMesh(m_SceneObjectMeshes[objectIndex]);
+			uint32_t atlasRegion = (objectIndex % 2) && getAtlasTextureCount() ? 1 + (objectIndex / 2) % getAtlasTextureCount() : 0;
+			m_SceneObjects[objectIndex].mesh = glm::uvec4(mesh.firstIndex, mesh.indexCount, mesh.vertexOffset, atlasRegion);
+		}
+	}
+	if (m_CaptureWriter.isOpen())
+	{
+		m_CaptureWriter.writeObjects(m_SceneObjects, m_SceneObjectMeshes);
+	}
+
+	const std::vector<ObjectData>& objects = m_SceneObjects;
+	size_t size = objects.size() * sizeof(ObjectData);
 
 	// Create a temporary staging buffer
 	VulkanBuffer stagingBuffer;
@@ -398,57 +728,123 @@ void VulkanContext::createVertexBuffer()
 	// Fill the buffer
 	void* data;
 	vkMapMemory(m_DeviceContext.m_Device, stagingBuffer.m_Memory, 0, size, 0, &data);
-	std::memcpy(data, Mesh::getVertices(), size);
+	std::memcpy(data, objects.data(), size);
 	vkUnmapMemory(m_DeviceContext.m_Device, stagingBuffer.m_Memory);
 
-	// Create the vertex buffer
-	m_VertexBuffer.create(m_DeviceContext,
+	// Create the object buffer (read by the vertex and culling shaders)
+	m_ObjectBuffer.create(m_DeviceContext,
 	                      size,
-	                      VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+	                      VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
 	                      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
-	// Copy vertex data from staging buffer to index buffer
-	copyBuffer(stagingBuffer.m_Buffer, m_VertexBuffer.m_Buffer, size);
+	// Copy object data from staging buffer to object buffer
+	copyBuffer(stagingBuffer.m_Buffer, m_ObjectBuffer.m_Buffer, size);
 
 	// Cleanup staging buffer
 	stagingBuffer.destroy(m_DeviceContext.m_Device);
-}
 
-void VulkanContext::createIndexBuffer()
-{
-	size_t size = Mesh::getNumIndices() * sizeof(uint16_t);
+	// Create the visibility buffer with every object marked as hidden
+	// (the first frame then draws everything in the late phase against an empty depth pyramid)
+	VkDeviceSize visibilitySize = m_SceneSettings.objectCount * sizeof(uint32_t);
+	m_VisibilityBuffer.create(m_DeviceContext,
+	                          visibilitySize,
+	                          VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+	                          VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
-	// Create a temporary staging buffers
-	VulkanBuffer stagingBuffer;
-	stagingBuffer.create(m_DeviceContext,
-	                     size,
-	                     VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-	                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	VkCommandBuffer commandBuffer = vulkan::beginOneShotCommands(m_DeviceContext.m_Device, m_CommandPool);
+	vkCmdFillBuffer(commandBuffer, m_VisibilityBuffer.m_Buffer, 0, visibilitySize, 0);
+	vulkan::endOneShotCommands(m_DeviceContext.m_Device, commandBuffer, m_CommandPool, m_DeviceContext.m_GraphicsQueue);
 
-	// Fill the buffer
-	void* data;
-	vkMapMemory(m_DeviceContext.m_Device, stagingBuffer.m_Memory, 0, size, 0, &data);
-	std::memcpy(data, Mesh::getIndices(), size);
-	vkUnmapMemory(m_DeviceContext.m_Device, stagingBuffer.m_Memory);
+	// Bucket the objects by material class (the classes do not change, only the order inside a bucket does)
+	m_DrawList.clear();
+	m_DrawList.reserve(m_SceneSettings.objectCount);
+	for (uint32_t materialClass = 0; materialClass < static_cast<uint32_t>(MaterialClass::Count); materialClass++)
+	{
+		m_DrawBuckets[materialClass].first = static_cast<uint32_t>(m_DrawList.size());
+		for (uint32_t objectIndex = 0; objectIndex < m_SceneSettings.objectCount; objectIndex++)
+		{
+			if (static_cast<uint32_t>(Scene::getMaterialClass(objectIndex)) == materialClass)
+			{
+				m_DrawList.push_back(objectIndex);
+			}
+		}
+		m_DrawBuckets[materialClass].count = static_cast<uint32_t>(m_DrawList.size()) - m_DrawBuckets[materialClass].first;
+	}
+	m_DrawKeys.resize(m_SceneSettings.objectCount);
+	m_DrawDepths.resize(m_SceneSettings.objectCount);
 
-	// Create the index buffer
-	m_IndexBuffer.create(m_DeviceContext,
-	                     size,
-	                     VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-	                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	// The draw list is rewritten by the CPU every frame
+	VkDeviceSize drawListSize = m_SceneSettings.objectCount * sizeof(uint32_t);
+	for (size_t i = 0; i < m_SceneSettings.framesInFlight; i++)
+	{
+		m_DrawListBuffers[i].create(m_DeviceContext, drawListSize,
+		                            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		                            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
 
-	// Copy vertex data from staging buffer to index buffer
-	copyBuffer(stagingBuffer.m_Buffer, m_IndexBuffer.m_Buffer, size);
+		vkMapMemory(m_DeviceContext.m_Device, m_DrawListBuffers[i].m_Memory, 0, drawListSize, 0, &m_DrawListMapped[i]);
+		assert(m_DrawListMapped[i] != nullptr);
+		std::memcpy(m_DrawListMapped[i], m_DrawList.data(), drawListSize);
+	}
+}
 
-	// Cleanup staging buffer
-	stagingBuffer.destroy(m_DeviceContext.m_Device);
+void VulkanContext::createCullingResources()
+{
+	// Depth pyramid reduction : (0) source level, (1) destination level
+	std::vector<VkDescriptorSetLayoutBinding> depthPyramidBindings(2);
+	depthPyramidBindings[0].binding = 0;
+	depthPyramidBindings[0].descriptorCount = 1;
+	depthPyramidBindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	depthPyramidBindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	depthPyramidBindings[1].binding = 1;
+	depthPyramidBindings[1].descriptorCount = 1;
+	depthPyramidBindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	depthPyramidBindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	m_DepthPyramidPipeline.create(m_DeviceContext.m_Device,
+	                              AssetPaths::getShader("depth_pyramid.comp.spv"),
+	                              depthPyramidBindings);
+
+	// Culling : (0) matrices, (1) objects, (2) draw commands, (3) visibility, (4) stats, (5) depth pyramid, (6) draw list
+	std::vector<VkDescriptorSetLayoutBinding> cullingBindings(7);
+	for (uint32_t i = 0; i < cullingBindings.size(); i++)
+	{
+		cullingBindings[i].binding = i;
+		cullingBindings[i].descriptorCount = 1;
+		cullingBindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		cullingBindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+	cullingBindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	cullingBindings[5].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+
+	m_CullingPipeline.create(m_DeviceContext.m_Device,
+	                         AssetPaths::getShader("occlusion_cull.comp.spv"),
+	                         cullingBindings,
+	                         sizeof(CullingPushConstants));
+
+	// Draw commands for both phases, written by the culling shader and consumed by indirect draws
+	m_DrawCommandBuffer.create(m_DeviceContext,
+	                           2 * m_SceneSettings.objectCount * sizeof(VkDrawIndexedIndirectCommand),
+	                           VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+	                           VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	// Stats are read back on the CPU after the frame's fence is signalled
+	for (size_t i = 0; i < m_SceneSettings.framesInFlight; i++)
+	{
+		m_CullingStatsBuffers[i].create(m_DeviceContext, sizeof(CullingStats),
+		                                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		                                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+		vkMapMemory(m_DeviceContext.m_Device, m_CullingStatsBuffers[i].m_Memory, 0, sizeof(CullingStats), 0, &m_CullingStatsMapped[i]);
+		assert(m_CullingStatsMapped[i] != nullptr);
+		std::memset(m_CullingStatsMapped[i], 0, sizeof(CullingStats));
+	}
 }
 
 void VulkanContext::createUniformBuffers()
 {
 	VkDeviceSize size = sizeof(MatricesUBO);
 
-	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+	for (size_t i = 0; i < m_SceneSettings.framesInFlight; i++)
 	{
 		m_UniformBuffers[i].create(m_DeviceContext, size,
 		                           VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
@@ -461,19 +857,22 @@ void VulkanContext::createUniformBuffers()
 
 void VulkanContext::createDescriptorPool()
 {
-	VkDescriptorPoolSize descriptorPoolSizes[2];
+	// Each frame has a graphics descriptor set and a culling descriptor set
+	VkDescriptorPoolSize descriptorPoolSizes[3];
 	descriptorPoolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	descriptorPoolSizes[0].descriptorCount = MAX_FRAMES_IN_FLIGHT;
+	descriptorPoolSizes[0].descriptorCount = 2 * m_SceneSettings.framesInFlight;
 	descriptorPoolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	descriptorPoolSizes[1].descriptorCount = MAX_FRAMES_IN_FLIGHT;
+	descriptorPoolSizes[1].descriptorCount = (STREAMED_TEXTURE_SLOTS + 2) * m_SceneSettings.framesInFlight;
+	descriptorPoolSizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	descriptorPoolSizes[2].descriptorCount = 7 * m_SceneSettings.framesInFlight;
 
 	VkDescriptorPoolCreateInfo descriptorPoolCreateInfo{};
 	descriptorPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
 	descriptorPoolCreateInfo.poolSizeCount = std::size(descriptorPoolSizes);
 	descriptorPoolCreateInfo.pPoolSizes = descriptorPoolSizes;
-	descriptorPoolCreateInfo.maxSets = MAX_FRAMES_IN_FLIGHT;
+	descriptorPoolCreateInfo.maxSets = 2 * m_SceneSettings.framesInFlight;
 
-	if (VK_SUCCESS != vkCreateDescriptorPool(m_DeviceContext.m_Device, &descriptorPoolCreateInfo, nullptr, &m_DescriptorPool))
+	if (VK_SUCCESS != vkCreateDescriptorPool(m_DeviceContext.m_Device, &descriptorPoolCreateInfo, VulkanHostAllocator::getCallbacks(), &m_DescriptorPool))
 	{
 		throw std::runtime_error("Failed to create Descriptor Pool!");
 	}
@@ -481,12 +880,12 @@ void VulkanContext::createDescriptorPool()
 
 void VulkanContext::createDescriptorSets()
 {
-	std::vector<VkDescriptorSetLayout> descriptorSetLayouts(MAX_FRAMES_IN_FLIGHT, m_GraphicsPipeline.m_DescriptorSetLayout);
+	std::vector<VkDescriptorSetLayout> descriptorSetLayouts(m_SceneSettings.framesInFlight, m_GraphicsPipeline.m_DescriptorSetLayout);
 
 	VkDescriptorSetAllocateInfo descriptorSetAllocateInfo{};
 	descriptorSetAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
 	descriptorSetAllocateInfo.descriptorPool = m_DescriptorPool;
-	descriptorSetAllocateInfo.descriptorSetCount = MAX_FRAMES_IN_FLIGHT;
+	descriptorSetAllocateInfo.descriptorSetCount = m_SceneSettings.framesInFlight;
 	descriptorSetAllocateInfo.pSetLayouts = descriptorSetLayouts.data();
 
 	if (VK_SUCCESS != vkAllocateDescriptorSets(m_DeviceContext.m_Device, &descriptorSetAllocateInfo, m_DescriptorSets.data()))
@@ -494,19 +893,48 @@ void VulkanContext::createDescriptorSets()
 		throw std::runtime_error("Failed to allocate Descriptor Sets!");
 	}
 
-	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+	std::vector<VkDescriptorSetLayout> cullingDescriptorSetLayouts(m_SceneSettings.framesInFlight, m_CullingPipeline.m_DescriptorSetLayout);
+	descriptorSetAllocateInfo.pSetLayouts = cullingDescriptorSetLayouts.data();
+
+	if (VK_SUCCESS != vkAllocateDescriptorSets(m_DeviceContext.m_Device, &descriptorSetAllocateInfo, m_CullingDescriptorSets.data()))
+	{
+		throw std::runtime_error("Failed to allocate culling Descriptor Sets!");
+	}
+
+	for (size_t i = 0; i < m_SceneSettings.framesInFlight; i++)
 	{
 		VkDescriptorBufferInfo descriptorBufferInfo{};
 		descriptorBufferInfo.buffer = m_UniformBuffers[i].m_Buffer;
 		descriptorBufferInfo.offset = 0;
 		descriptorBufferInfo.range = sizeof(MatricesUBO); // VK_WHOLE_SIZE
 
-		VkDescriptorImageInfo descriptorImageInfo{};
-		descriptorImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		descriptorImageInfo.imageView = m_TextureImageView;
-		descriptorImageInfo.sampler = m_TextureSampler;
+		VkDescriptorImageInfo descriptorImageInfos[STREAMED_TEXTURE_SLOTS]{};
+		m_StreamedTextureViewVersions[i].resize(STREAMED_TEXTURE_SLOTS);
+		for (uint32_t slot = 0; slot < STREAMED_TEXTURE_SLOTS; slot++)
+		{
+			uint32_t texture = getSlotTexture(slot);
+			descriptorImageInfos[slot].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			descriptorImageInfos[slot].imageView = m_TextureStreamer.getImageView(texture);
+			descriptorImageInfos[slot].sampler = m_TextureSampler;
+			m_StreamedTextureViewVersions[i][slot] = m_TextureStreamer.getViewVersion(texture);
+		}
+
+		VkDescriptorBufferInfo objectsBufferInfo{};
+		objectsBufferInfo.buffer = m_ObjectBuffer.m_Buffer;
+		objectsBufferInfo.offset = 0;
+		objectsBufferInfo.range = VK_WHOLE_SIZE;
+
+		VkDescriptorBufferInfo atlasRegionsBufferInfo{};
+		atlasRegionsBufferInfo.buffer = m_TextureAtlasRegionBuffer.m_Buffer;
+		atlasRegionsBufferInfo.offset = 0;
+		atlasRegionsBufferInfo.range = VK_WHOLE_SIZE;
+
+		VkDescriptorImageInfo atlasImageInfo{};
+		atlasImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		atlasImageInfo.imageView = m_TextureAtlasImageView;
+		atlasImageInfo.sampler = m_TextureSampler;
 
-		VkWriteDescriptorSet descriptorWrites[2]{};
+		VkWriteDescriptorSet descriptorWrites[5]{};
 
 		descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
 		descriptorWrites[0].dstSet = m_DescriptorSets[i];
@@ -523,8 +951,118 @@ void VulkanContext::createDescriptorSets()
 		descriptorWrites[1].dstBinding = 1;
 		descriptorWrites[1].dstArrayElement = 0;
 		descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-		descriptorWrites[1].descriptorCount = 1;
-		descriptorWrites[1].pImageInfo = &descriptorImageInfo; // (optional) used to read image data
+		descriptorWrites[1].descriptorCount = STREAMED_TEXTURE_SLOTS;
+		descriptorWrites[1].pImageInfo = descriptorImageInfos; // (optional) used to read image data
+
+		descriptorWrites[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrites[2].dstSet = m_DescriptorSets[i];
+		descriptorWrites[2].dstBinding = 2;
+		descriptorWrites[2].dstArrayElement = 0;
+		descriptorWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		descriptorWrites[2].descriptorCount = 1;
+		descriptorWrites[2].pBufferInfo = &objectsBufferInfo;
+
+		descriptorWrites[3].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrites[3].dstSet = m_DescriptorSets[i];
+		descriptorWrites[3].dstBinding = 3;
+		descriptorWrites[3].dstArrayElement = 0;
+		descriptorWrites[3].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		descriptorWrites[3].descriptorCount = 1;
+		descriptorWrites[3].pBufferInfo = &atlasRegionsBufferInfo;
+
+		descriptorWrites[4].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrites[4].dstSet = m_DescriptorSets[i];
+		descriptorWrites[4].dstBinding = 4;
+		descriptorWrites[4].dstArrayElement = 0;
+		descriptorWrites[4].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		descriptorWrites[4].descriptorCount = 1;
+		descriptorWrites[4].pImageInfo = &atlasImageInfo;
+
+		vkUpdateDescriptorSets(m_DeviceContext.m_Device, std::size(descriptorWrites), descriptorWrites, 0, nullptr);
+	}
+}
+
+void VulkanContext::updateTextureDescriptors(uint32_t current_image)
+{
+	// Rebind the streamed textures whose resident levels changed (the frame's previous submission has completed)
+	VkDescriptorImageInfo descriptorImageInfos[STREAMED_TEXTURE_SLOTS]{};
+	VkWriteDescriptorSet descriptorWrites[STREAMED_TEXTURE_SLOTS]{};
+	uint32_t writeCount = 0;
+	for (uint32_t slot = 0; slot < STREAMED_TEXTURE_SLOTS; slot++)
+	{
+		uint32_t texture = getSlotTexture(slot);
+		uint32_t viewVersion = m_TextureStreamer.getViewVersion(texture);
+		if (m_StreamedTextureViewVersions[current_image][slot] == viewVersion)
+			continue;
+
+		descriptorImageInfos[writeCount].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		descriptorImageInfos[writeCount].imageView = m_TextureStreamer.getImageView(texture);
+		descriptorImageInfos[writeCount].sampler = m_TextureSampler;
+
+		VkWriteDescriptorSet& descriptorWrite = descriptorWrites[writeCount];
+		descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrite.dstSet = m_DescriptorSets[current_image];
+		descriptorWrite.dstBinding = 1;
+		descriptorWrite.dstArrayElement = slot;
+		descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		descriptorWrite.descriptorCount = 1;
+		descriptorWrite.pImageInfo = &descriptorImageInfos[writeCount];
+		writeCount++;
+
+		m_StreamedTextureViewVersions[current_image][slot] = viewVersion;
+	}
+
+	if (writeCount)
+	{
+		vkUpdateDescriptorSets(m_DeviceContext.m_Device, writeCount, descriptorWrites, 0, nullptr);
+	}
+}
+
+uint32_t VulkanContext::getSlotTexture(uint32_t slot) const
+{
+	// (the unused slots repeat the scene texture, every element of the array must stay a valid view)
+	return slot < m_StreamedTextureSlots.size() ? m_StreamedTextureSlots[slot] : m_SceneTexture;
+}
+
+void VulkanContext::updateCullingDescriptorSets()
+{
+	// Rewritten whenever the depth pyramid is recreated
+	for (size_t i = 0; i < m_SceneSettings.framesInFlight; i++)
+	{
+		VkDescriptorBufferInfo bufferInfos[7]{};
+		bufferInfos[0].buffer = m_UniformBuffers[i].m_Buffer;
+		bufferInfos[0].range = sizeof(MatricesUBO);
+		bufferInfos[1].buffer = m_ObjectBuffer.m_Buffer;
+		bufferInfos[1].range = VK_WHOLE_SIZE;
+		bufferInfos[2].buffer = m_DrawCommandBuffer.m_Buffer;
+		bufferInfos[2].range = VK_WHOLE_SIZE;
+		bufferInfos[3].buffer = m_VisibilityBuffer.m_Buffer;
+		bufferInfos[3].range = VK_WHOLE_SIZE;
+		bufferInfos[4].buffer = m_CullingStatsBuffers[i].m_Buffer;
+		bufferInfos[4].range = VK_WHOLE_SIZE;
+		bufferInfos[6].buffer = m_DrawListBuffers[i].m_Buffer;
+		bufferInfos[6].range = VK_WHOLE_SIZE;
+
+		VkDescriptorImageInfo depthPyramidInfo{};
+		depthPyramidInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+		depthPyramidInfo.imageView = m_DepthPyramid.m_ImageView;
+		depthPyramidInfo.sampler = m_DepthPyramid.m_Sampler;
+
+		VkWriteDescriptorSet descriptorWrites[7]{};
+		for (uint32_t binding = 0; binding < std::size(descriptorWrites); binding++)
+		{
+			descriptorWrites[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			descriptorWrites[binding].dstSet = m_CullingDescriptorSets[i];
+			descriptorWrites[binding].dstBinding = binding;
+			descriptorWrites[binding].dstArrayElement = 0;
+			descriptorWrites[binding].descriptorCount = 1;
+			descriptorWrites[binding].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			descriptorWrites[binding].pBufferInfo = &bufferInfos[binding];
+		}
+		descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		descriptorWrites[5].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		descriptorWrites[5].pBufferInfo = nullptr;
+		descriptorWrites[5].pImageInfo = &depthPyramidInfo;
 
 		vkUpdateDescriptorSets(m_DeviceContext.m_Device, std::size(descriptorWrites), descriptorWrites, 0, nullptr);
 	}
@@ -554,11 +1092,11 @@ void VulkanContext::createSyncObjects()
 	fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
 	fenceCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT; // Creates the fence in the signalled state which prevents blocking indefinitely on the first frame
 
-	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+	for (size_t i = 0; i < m_SceneSettings.framesInFlight; i++)
 	{
-		if (VK_SUCCESS != vkCreateSemaphore(m_DeviceContext.m_Device, &semaphoreCreateInfo, nullptr, &m_ImageAvailableSemaphores[i]) ||
-			VK_SUCCESS != vkCreateSemaphore(m_DeviceContext.m_Device, &semaphoreCreateInfo, nullptr, &m_RenderFinishedSemaphores[i]) ||
-			VK_SUCCESS != vkCreateFence(m_DeviceContext.m_Device, &fenceCreateInfo, nullptr, &m_InFlightFences[i]))
+		if (VK_SUCCESS != vkCreateSemaphore(m_DeviceContext.m_Device, &semaphoreCreateInfo, VulkanHostAllocator::getCallbacks(), &m_ImageAvailableSemaphores[i]) ||
+			VK_SUCCESS != vkCreateSemaphore(m_DeviceContext.m_Device, &semaphoreCreateInfo, VulkanHostAllocator::getCallbacks(), &m_RenderFinishedSemaphores[i]) ||
+			VK_SUCCESS != vkCreateFence(m_DeviceContext.m_Device, &fenceCreateInfo, VulkanHostAllocator::getCallbacks(), &m_InFlightFences[i]))
 		{
 			throw std::runtime_error("Failed to create Sync objects for frame!");
 		}
@@ -567,60 +1105,454 @@ void VulkanContext::createSyncObjects()
 
 void VulkanContext::createTextureImage(const std::string& texture_file)
 {
-	// Read the pixel data from the texture file
-	int texWidth, texHeight, texChannels;
-	stbi_uc *pixels = stbi_load(texture_file.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-	VkDeviceSize imageSize = texWidth * texHeight * 4;
+	// Prefer a KTX2 version of the texture (block-compressed, with its mips) when the device can sample its format
+	std::filesystem::path ktx2File = std::filesystem::path(AssetPaths::getAsset(texture_file)).replace_extension(".ktx2");
+	if (std::filesystem::exists(ktx2File))
+	{
+		// (a damaged or unsupported KTX2 file falls back to the source image instead of aborting startup)
+		try
+		{
+			Ktx2Header header = Ktx2Loader::readHeader(ktx2File.string());
+			if (0 == header.supercompressionScheme && 0 != header.levelCount && Ktx2Loader::isFormatSupported(m_DeviceContext.m_PhysicalDevice, header.format))
+			{
+				m_SceneTexture = createTextureImageFromKtx2(ktx2File.string());
+				return;
+			}
+		}
+		catch (const std::exception& e)
+		{
+			printf("[WARN] Failed to load KTX2 texture, falling back to %s: %s\n", texture_file.c_str(), e.what());
+		}
+	}
+
+	m_SceneTexture = loadStreamedTextures({ texture_file })[0];
+}
+
+uint32_t VulkanContext::createTextureImageFromKtx2(const std::string& texture_file)
+{
+	PROFILE_SCOPE("createTextureImageFromKtx2");
+
+	// The levels are streamed as stored in the file (compressed formats cannot be blitted to generate mips)
+	auto start = std::chrono::high_resolution_clock::now();
+	Ktx2Image image = Ktx2Loader::load(texture_file);
+	auto loaded = std::chrono::high_resolution_clock::now();
+
+	StreamedTextureSource source;
+	source.format = image.header.format;
+	source.levels = std::move(image.levels);
+	source.payload = std::move(image.data);
+	uint32_t texture = m_TextureStreamer.addTexture(std::move(source));
+	auto end = std::chrono::high_resolution_clock::now();
+
+	TextureLoadTiming timing{};
+	timing.file = texture_file;
+	timing.decodeMilliseconds = std::chrono::duration<double, std::milli>(loaded - start).count();
+	timing.uploadMilliseconds = std::chrono::duration<double, std::milli>(end - loaded).count();
+	m_TextureLoadTimings.push_back(timing);
+	return texture;
+}
+
+std::vector<uint32_t> VulkanContext::loadStreamedTextures(const std::vector<std::string>& texture_files)
+{
+	PROFILE_SCOPE("loadStreamedTextures");
+
+	// The whole chain is kept in system memory to stream the levels from (and again after they are evicted), so the mips
+	// are always generated by the workers and decoded into the payload : the staging pool only holds the levels being streamed in
+	TextureImportSettings importSettings{};
+	importSettings.format = VK_FORMAT_R8G8B8A8_SRGB;
+	importSettings.srgb = true;
+	importSettings.generateMipsOnCpu = true;
+
+	std::vector<StreamedTextureSource> sources(texture_files.size());
+	size_t firstTiming = m_TextureLoadTimings.size();
+	m_TextureLoadTimings.resize(firstTiming + texture_files.size());
+
+	for (size_t i = 0; i < texture_files.size(); i++)
+	{
+		m_WorkerPool.submit([&, i]()
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+
+			StreamedTextureSource& source = sources[i];
+			source.format = importSettings.format;
+			TextureLoadTiming& timing = m_TextureLoadTimings[firstTiming + i];
+			timing.file = texture_files[i];
+			timing.source = readTextureChain(texture_files[i], importSettings, [&](size_t size)
+			{
+				source.payload.resize(size);
+				return source.payload.data();
+			}, source.levels);
+
+			auto end = std::chrono::high_resolution_clock::now();
+			timing.decodeMilliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+		});
+	}
+
+	try
+	{
+		m_WorkerPool.wait();
+	}
+	catch (...)
+	{
+		m_TextureLoadTimings.resize(firstTiming);
+		throw;
+	}
+
+	// Only the tails are uploaded here, the larger levels are streamed in while rendering
+	std::vector<uint32_t> textures;
+	for (size_t i = 0; i < texture_files.size(); i++)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		textures.push_back(m_TextureStreamer.addTexture(std::move(sources[i])));
+		auto end = std::chrono::high_resolution_clock::now();
+		m_TextureLoadTimings[firstTiming + i].uploadMilliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+	}
+	return textures;
+}
+
+TextureLoadSource VulkanContext::readTextureChain(
+	const std::string& texture_file,
+	const TextureImportSettings& import_settings,
+	const std::function<uint8_t*(size_t)>& allocate,
+	std::vector<MipLevel>& levels)
+{
+	PROFILE_SCOPE("readTextureChain");
+
+	// Called from the workers : levels are filled with offsets in the memory returned by allocate
+	// (only the base level without generateMipsOnCpu, for the atlas which filters its layers instead)
+	// allocate may return nullptr to skip the texture once its levels are known, nothing is copied or decoded then
+	const VkFormat textureFormat = import_settings.format;
+
+	// A texture baked into the archive is uploaded as is (decompressed first if needed)
+	std::string bakedName = texture_file.substr(0, texture_file.find_last_of('.')) + ".vtc";
+	const AssetArchiveEntry* bakedEntry = m_AssetArchive.find(bakedName);
+
+	std::vector<uint8_t> bakedBytes;
+	TextureCacheEntry bakedTexture;
+	if (bakedEntry)
+	{
+		const uint8_t* bakedData = m_AssetArchive.getData(*bakedEntry);
+		if (AssetCompression::None != bakedEntry->compression)
+		{
+			bakedBytes.resize(bakedEntry->uncompressedSize);
+			if (!m_AssetArchive.read(*bakedEntry, bakedBytes.data()))
+			{
+				throw std::runtime_error("Failed to decompress Texture from Asset Archive!");
+			}
+			bakedData = bakedBytes.data();
+		}
+		if (!TextureCache::parseEntry(bakedData, bakedBytes.empty() ? bakedEntry->size : bakedBytes.size(), bakedTexture) || textureFormat != bakedTexture.format)
+		{
+			bakedEntry = nullptr; // (stale format or levels outside the payload, fall back to the source image)
+		}
+	}
 
-	if (!pixels)
+	if (bakedEntry)
+	{
+		levels = bakedTexture.levels;
+		if (uint8_t* destination = allocate(bakedTexture.payloadSize))
+		{
+			std::memcpy(destination, bakedTexture.payload, bakedTexture.payloadSize);
+		}
+		return TextureLoadSource::Archive;
+	}
+
+	// The source image comes from the archive mapping or is mapped from the loose file
+	const uint8_t* sourceData = nullptr;
+	size_t sourceSize = 0;
+	std::vector<uint8_t> sourceBytes;
+	MappedFile sourceFile;
+
+	if (const AssetArchiveEntry* sourceEntry = m_AssetArchive.find(texture_file))
+	{
+		sourceData = m_AssetArchive.getData(*sourceEntry);
+		sourceSize = static_cast<size_t>(sourceEntry->uncompressedSize);
+		if (AssetCompression::None != sourceEntry->compression)
+		{
+			sourceBytes.resize(sourceSize);
+			if (!m_AssetArchive.read(*sourceEntry, sourceBytes.data()))
+			{
+				throw std::runtime_error("Failed to decompress Texture from Asset Archive!");
+			}
+			sourceData = sourceBytes.data();
+		}
+	}
+	else if (sourceFile.open(AssetPaths::getAsset(texture_file)))
+	{
+		sourceData = sourceFile.getData();
+		sourceSize = sourceFile.getSize();
+	}
+	else
 	{
 		throw std::runtime_error("Failed to Load Texture!");
 	}
 
-	// Create a staging buffer to copy data to device memory
-	//  - Can be done using a staging image as well but buffers are faster
+	// A cache hit is copied from the mapped cache file, nothing is decoded
+	uint64_t cacheKey = m_EnableTextureCache ? TextureCache::computeKey(sourceData, sourceSize, import_settings) : 0;
+	TextureCacheEntry cacheEntry;
+	if (cacheKey && m_TextureCache.load(cacheKey, cacheEntry) && textureFormat == cacheEntry.format)
+	{
+		levels = cacheEntry.levels;
+		if (uint8_t* destination = allocate(cacheEntry.payloadSize))
+		{
+			std::memcpy(destination, cacheEntry.payload, cacheEntry.payloadSize);
+		}
+		return TextureLoadSource::Cache;
+	}
+
+	// Reserve the whole chain
+	uint32_t width, height;
+	if (!TextureDecoder::readInfo(sourceData, sourceSize, width, height))
+	{
+		throw std::runtime_error("Failed to Load Texture!");
+	}
+
+	size_t size = size_t(width) * height * 4;
+	levels = { { width, height, 0 } };
+	if (import_settings.generateMipsOnCpu)
+	{
+		size = MipmapGenerator::getMipChainLayout(width, height, levels);
+	}
+	uint8_t* destination = allocate(size);
+	if (!destination)
+	{
+		return TextureLoadSource::Decoded;
+	}
+
+	// The chain is built in the destination (system memory), the cache entry is written from it
+	if (!TextureDecoder::decodeRGBA8(sourceData, sourceSize, destination, width, height))
+	{
+		throw std::runtime_error("Failed to Load Texture!");
+	}
+	if (import_settings.generateMipsOnCpu)
+	{
+		MipmapGenerator::generateRGBA8InPlace(destination, import_settings.srgb, levels);
+	}
+
+	if (cacheKey)
+	{
+		m_TextureCache.store(cacheKey, textureFormat, levels, destination, size);
+	}
+	return TextureLoadSource::Decoded;
+}
+
+void VulkanContext::createTextureAtlas(const std::vector<std::string>& texture_files)
+{
+	PROFILE_SCOPE("createTextureAtlas");
+
+	// Only the base level of each texture is used, the mips are generated per layer once the textures are packed
+	// (so they are not generated on import either)
+	TextureImportSettings importSettings{};
+	importSettings.format = VK_FORMAT_R8G8B8A8_SRGB;
+	importSettings.srgb = true;
+	importSettings.generateMipsOnCpu = false;
+
+	// Every file is read once, the textures repeating a file share its pixels (but keep their own placement)
+	std::vector<std::string> files;
+	std::vector<uint32_t> textureFiles;
+	for (const std::string& textureFile : texture_files)
+	{
+		auto it = std::find(files.begin(), files.end(), textureFile);
+		textureFiles.push_back(static_cast<uint32_t>(it - files.begin()));
+		if (files.end() == it)
+		{
+			files.push_back(textureFile);
+		}
+	}
+
+	// Files larger than TEXTURE_ATLAS_MAX_TEXTURE_SIZE are skipped once their size is known, they are streamed on their own
+	std::vector<std::vector<uint8_t>> pixels(files.size());
+	std::vector<std::vector<MipLevel>> levels(files.size());
+	for (size_t i = 0; i < files.size(); i++)
+	{
+		m_WorkerPool.submit([&, i]()
+		{
+			readTextureChain(files[i], importSettings, [&](size_t size) -> uint8_t*
+			{
+				if (std::max(levels[i][0].width, levels[i][0].height) > TEXTURE_ATLAS_MAX_TEXTURE_SIZE)
+					return nullptr;
+				pixels[i].resize(size);
+				return pixels[i].data();
+			}, levels[i]);
+		});
+	}
+	m_WorkerPool.wait();
+
+	// Streamed texture slots : the scene texture, then the files kept out of the atlas
+	std::vector<std::string> streamedFiles;
+	std::vector<uint32_t> fileSlots(files.size());
+	for (size_t i = 0; i < files.size(); i++)
+	{
+		if (pixels[i].empty())
+		{
+			fileSlots[i] = static_cast<uint32_t>(1 + streamedFiles.size());
+			streamedFiles.push_back(files[i]);
+		}
+	}
+	if (1 + streamedFiles.size() > STREAMED_TEXTURE_SLOTS)
+	{
+		throw std::runtime_error("Too many textures too large for the Texture Atlas!");
+	}
+	m_StreamedTextureSlots = { m_SceneTexture };
+	std::vector<uint32_t> streamedTextures = loadStreamedTextures(streamedFiles);
+	m_StreamedTextureSlots.insert(m_StreamedTextureSlots.end(), streamedTextures.begin(), streamedTextures.end());
+
+	std::vector<glm::uvec2> sizes;
+	std::vector<uint32_t> atlasedTextures; // (indices in texture_files)
+	for (uint32_t i = 0; i < textureFiles.size(); i++)
+	{
+		const std::vector<uint8_t>& filePixels = pixels[textureFiles[i]];
+		const MipLevel& baseLevel = levels[textureFiles[i]][0];
+		if (!filePixels.empty())
+		{
+			sizes.emplace_back(baseLevel.width, baseLevel.height);
+			atlasedTextures.push_back(i);
+		}
+	}
+
+	// (an empty layer when every texture is streamed, the descriptor still needs an image)
+	std::vector<TextureAtlasPlacement> placements;
+	uint32_t layerCount = std::max(TextureAtlasPacker::pack(sizes, TEXTURE_ATLAS_LAYER_SIZE, TEXTURE_ATLAS_PADDING, placements), 1u);
+	uint32_t mipLevels = TextureAtlasPacker::getMipLevelCount(TEXTURE_ATLAS_LAYER_SIZE, TEXTURE_ATLAS_PADDING);
+
+	// The mips of the layers are blitted on the GPU when the format supports linear filtering, generated by the workers otherwise
+	VkFormatProperties formatProperties;
+	vkGetPhysicalDeviceFormatProperties(m_DeviceContext.m_PhysicalDevice, importSettings.format, &formatProperties);
+	const VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+	bool generateOnGpu = blitFeatures == (formatProperties.optimalTilingFeatures & blitFeatures);
+
+	// Every layer is staged as a chain of its uploaded levels (only level 0 when blitting)
+	std::vector<MipLevel> layerLevels;
+	MipmapGenerator::getMipChainLayout(TEXTURE_ATLAS_LAYER_SIZE, TEXTURE_ATLAS_LAYER_SIZE, layerLevels);
+	layerLevels.resize(generateOnGpu ? 1 : mipLevels);
+	size_t layerSize = layerLevels.back().offset + size_t(layerLevels.back().width) * layerLevels.back().height * 4;
+
+	m_TextureAtlasImage.create(m_DeviceContext,
+	                           TEXTURE_ATLAS_LAYER_SIZE,
+	                           TEXTURE_ATLAS_LAYER_SIZE,
+	                           1,
+	                           VK_IMAGE_TYPE_2D,
+	                           importSettings.format,
+	                           VK_IMAGE_TILING_OPTIMAL,
+	                           VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, // (blit source)
+	                           VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+	                           mipLevels,
+	                           layerCount);
+	transitionImageLayout(m_TextureAtlasImage.m_Image, importSettings.format, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels, layerCount);
+
+	// The layers are streamed through a staging buffer of a few layers : composed by the workers, then uploaded
+	uint32_t batchLayers = std::min(layerCount, TEXTURE_ATLAS_STAGING_LAYERS);
+	VkDeviceSize stagingSize = batchLayers * layerSize;
 	VulkanBuffer stagingBuffer;
 	stagingBuffer.create(m_DeviceContext,
-	                     imageSize,
+	                     stagingSize,
 	                     VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
 	                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
 
-	// Fill the buffer
 	void* data;
-	vkMapMemory(m_DeviceContext.m_Device, stagingBuffer.m_Memory, 0, imageSize, 0, &data);
-	std::memcpy(data, pixels, imageSize);
-	vkUnmapMemory(m_DeviceContext.m_Device, stagingBuffer.m_Memory);
+	vkMapMemory(m_DeviceContext.m_Device, stagingBuffer.m_Memory, 0, stagingSize, 0, &data);
+	uint8_t* staging = static_cast<uint8_t*>(data);
 
-	// Free the pixel data
-	stbi_image_free(pixels);
+	for (uint32_t firstLayer = 0; firstLayer < layerCount; firstLayer += batchLayers)
+	{
+		uint32_t endLayer = std::min(firstLayer + batchLayers, layerCount);
 
-	// Create the image and image memory
-	m_TextureImage.create(m_DeviceContext,
-		                  texWidth,
-		                  texHeight,
-		                  1,
-		                  VK_IMAGE_TYPE_2D,
-		                  VK_FORMAT_R8G8B8A8_SRGB,
-		                  VK_IMAGE_TILING_OPTIMAL,
-		                  VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-		                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		// Compose the layers straight into the staging buffer
+		// (the CPU mips are filtered in system memory first, staging memory may be write-combined, slow to read back)
+		for (uint32_t layer = firstLayer; layer < endLayer; layer++)
+		{
+			m_WorkerPool.submit([&, layer]()
+			{
+				PROFILE_SCOPE("Compose atlas layer");
+
+				uint8_t* layerStaging = staging + (layer - firstLayer) * layerSize;
+				std::vector<uint8_t> filtered(generateOnGpu ? 0 : layerSize);
+				uint8_t* chain = generateOnGpu ? layerStaging : filtered.data();
+				std::memset(chain, 0, size_t(TEXTURE_ATLAS_LAYER_SIZE) * TEXTURE_ATLAS_LAYER_SIZE * 4); // (texels outside the placements)
+				for (size_t i = 0; i < placements.size(); i++)
+				{
+					if (layer == placements[i].layer)
+					{
+						uint32_t file = textureFiles[atlasedTextures[i]];
+						TextureAtlasPacker::blitRGBA8(pixels[file].data() + levels[file][0].offset, chain, TEXTURE_ATLAS_LAYER_SIZE, placements[i], TEXTURE_ATLAS_PADDING);
+					}
+				}
+				if (!generateOnGpu)
+				{
+					MipmapGenerator::generateRGBA8InPlace(chain, importSettings.srgb, layerLevels);
+					std::memcpy(layerStaging, chain, layerSize);
+				}
+			});
+		}
+		m_WorkerPool.wait();
 
-	// Transition image to TRANSFER_DST_OPTIMAL
-	transitionImageLayout(m_TextureImage.m_Image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+		// Copy every staged level of the batch's layers (waits for the copy before the staging buffer is reused)
+		std::vector<VkBufferImageCopy> regions;
+		for (uint32_t layer = firstLayer; layer < endLayer; layer++)
+		{
+			for (uint32_t level = 0; level < layerLevels.size(); level++)
+			{
+				VkBufferImageCopy region{};
+				region.bufferOffset = (layer - firstLayer) * layerSize + layerLevels[level].offset;
+				region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+				region.imageSubresource.mipLevel = level;
+				region.imageSubresource.baseArrayLayer = layer;
+				region.imageSubresource.layerCount = 1;
+				region.imageExtent = { layerLevels[level].width, layerLevels[level].height, 1 };
+				regions.push_back(region);
+			}
+		}
 
-	// Copy data from staging buffer to image
-	copyBufferToImage(stagingBuffer.m_Buffer, m_TextureImage.m_Image, texWidth, texHeight);
+		VkCommandBuffer commandBuffer = vulkan::beginOneShotCommands(m_DeviceContext.m_Device, m_CommandPool);
+		vkCmdCopyBufferToImage(commandBuffer, stagingBuffer.m_Buffer, m_TextureAtlasImage.m_Image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		                       static_cast<uint32_t>(regions.size()), regions.data());
+		vulkan::endOneShotCommands(m_DeviceContext.m_Device, commandBuffer, m_CommandPool, m_DeviceContext.m_GraphicsQueue);
+	}
+	vkUnmapMemory(m_DeviceContext.m_Device, stagingBuffer.m_Memory);
 
-	// Transition image to SHADER_READ_ONLY_OPTIMAL
-	transitionImageLayout(m_TextureImage.m_Image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	if (generateOnGpu)
+	{
+		generateMipmaps(m_TextureAtlasImage.m_Image, TEXTURE_ATLAS_LAYER_SIZE, TEXTURE_ATLAS_LAYER_SIZE, mipLevels, layerCount);
+	}
+	else
+	{
+		transitionImageLayout(m_TextureAtlasImage.m_Image, importSettings.format, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, mipLevels, layerCount);
+	}
 
-	// Cleanup staging buffer
 	stagingBuffer.destroy(m_DeviceContext.m_Device);
-}
 
-void VulkanContext::createTextureImageView()
-{
-	m_TextureImageView = vulkan::createImageView(m_DeviceContext.m_Device, m_TextureImage.m_Image, VK_FORMAT_R8G8B8A8_SRGB, 1, 1);
+	m_TextureAtlasImageView = m_ImageViewCache.acquire(m_TextureAtlasImage.m_Image, importSettings.format,
+	                                                   mipLevels, layerCount, VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_IMAGE_VIEW_TYPE_2D_ARRAY);
+
+	// Regions of the textures, in the order of the files
+	m_TextureAtlasRegions.assign(texture_files.size(), TextureAtlasRegion{});
+	for (uint32_t i = 0; i < textureFiles.size(); i++)
+	{
+		if (pixels[textureFiles[i]].empty())
+		{
+			m_TextureAtlasRegions[i] = TextureAtlasPacker::getStreamedRegion(fileSlots[textureFiles[i]]);
+		}
+	}
+	for (size_t i = 0; i < placements.size(); i++)
+	{
+		m_TextureAtlasRegions[atlasedTextures[i]] = TextureAtlasPacker::getRegion(placements[i], TEXTURE_ATLAS_LAYER_SIZE);
+	}
+
+	VkDeviceSize regionsSize = m_TextureAtlasRegions.size() * sizeof(TextureAtlasRegion);
+	stagingBuffer.create(m_DeviceContext,
+	                     regionsSize,
+	                     VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+	                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	vkMapMemory(m_DeviceContext.m_Device, stagingBuffer.m_Memory, 0, regionsSize, 0, &data);
+	std::memcpy(data, m_TextureAtlasRegions.data(), regionsSize);
+	vkUnmapMemory(m_DeviceContext.m_Device, stagingBuffer.m_Memory);
+
+	m_TextureAtlasRegionBuffer.create(m_DeviceContext,
+	                                  regionsSize,
+	                                  VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+	                                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	copyBuffer(stagingBuffer.m_Buffer, m_TextureAtlasRegionBuffer.m_Buffer, regionsSize);
+	stagingBuffer.destroy(m_DeviceContext.m_Device);
 }
 
 void VulkanContext::createTextureSampler()
@@ -638,7 +1570,7 @@ void VulkanContext::createTextureSampler()
 	samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
 	samplerCreateInfo.mipLodBias = 0.f;
 	samplerCreateInfo.minLod = 0.f;
-	samplerCreateInfo.maxLod = 0.f;
+	samplerCreateInfo.maxLod = VK_LOD_CLAMP_NONE; // sample from every resident level (the streamed views change)
 	samplerCreateInfo.unnormalizedCoordinates = VK_FALSE;
 	if (m_DeviceContext.m_PhysicalDeviceFeatures.samplerAnisotropy)
 	{
@@ -651,13 +1583,10 @@ void VulkanContext::createTextureSampler()
 		samplerCreateInfo.maxAnisotropy = 1.f;
 	}
 
-	if (VK_SUCCESS != vkCreateSampler(m_DeviceContext.m_Device, &samplerCreateInfo, nullptr, &m_TextureSampler))
-	{
-		throw std::runtime_error("Failed to create Texture Sampler!");
-	}
+	m_TextureSampler = m_SamplerCache.acquire(samplerCreateInfo);
 }
 
-void VulkanContext::transitionImageLayout(VkImage image, VkFormat format, VkImageLayout old_layout, VkImageLayout new_layout)
+void VulkanContext::transitionImageLayout(VkImage image, VkFormat format, VkImageLayout old_layout, VkImageLayout new_layout, uint32_t mip_levels, uint32_t array_layers)
 {
 	VkCommandBuffer commandBuffer = vulkan::beginOneShotCommands(m_DeviceContext.m_Device, m_CommandPool);
 
@@ -670,9 +1599,9 @@ void VulkanContext::transitionImageLayout(VkImage image, VkFormat format, VkImag
 	imageMemoryBarrier.image = image;
 	imageMemoryBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 	imageMemoryBarrier.subresourceRange.baseMipLevel = 0;
-	imageMemoryBarrier.subresourceRange.levelCount = 1;
+	imageMemoryBarrier.subresourceRange.levelCount = mip_levels;
 	imageMemoryBarrier.subresourceRange.baseArrayLayer = 0;
-	imageMemoryBarrier.subresourceRange.layerCount = 1;
+	imageMemoryBarrier.subresourceRange.layerCount = array_layers;
 
 	VkPipelineStageFlags srcStage, dstStage;
 
@@ -703,7 +1632,7 @@ void VulkanContext::copyBuffer(VkBuffer src_buffer, VkBuffer dst_buffer, VkDevic
 
 	VkCommandPool transferCommandPool{};
 
-	if (VK_SUCCESS != vkCreateCommandPool(m_DeviceContext.m_Device, &commandPoolCreateInfo, nullptr, &transferCommandPool))
+	if (VK_SUCCESS != vkCreateCommandPool(m_DeviceContext.m_Device, &commandPoolCreateInfo, VulkanHostAllocator::getCallbacks(), &transferCommandPool))
 	{
 		throw std::runtime_error("Failed to create Transfer Command Pool!");
 	}
@@ -722,7 +1651,7 @@ void VulkanContext::copyBuffer(VkBuffer src_buffer, VkBuffer dst_buffer, VkDevic
 		                       transferCommandPool,
 		                       m_DeviceContext.m_TransferQueue);
 	
-	vkDestroyCommandPool(m_DeviceContext.m_Device, transferCommandPool, nullptr);
+	vkDestroyCommandPool(m_DeviceContext.m_Device, transferCommandPool, VulkanHostAllocator::getCallbacks());
 }
 
 void VulkanContext::copyBufferToImage(VkBuffer src_buffer, VkImage dst_image, uint32_t width, uint32_t height)
@@ -734,7 +1663,7 @@ void VulkanContext::copyBufferToImage(VkBuffer src_buffer, VkImage dst_image, ui
 
 	VkCommandPool transferCommandPool{};
 
-	if (VK_SUCCESS != vkCreateCommandPool(m_DeviceContext.m_Device, &commandPoolCreateInfo, nullptr, &transferCommandPool))
+	if (VK_SUCCESS != vkCreateCommandPool(m_DeviceContext.m_Device, &commandPoolCreateInfo, VulkanHostAllocator::getCallbacks(), &transferCommandPool))
 	{
 		throw std::runtime_error("Failed to create Transfer Command Pool!");
 	}
@@ -759,15 +1688,134 @@ void VulkanContext::copyBufferToImage(VkBuffer src_buffer, VkImage dst_image, ui
 		                       transferCommandPool,
 		                       m_DeviceContext.m_TransferQueue);
 	
-	vkDestroyCommandPool(m_DeviceContext.m_Device, transferCommandPool, nullptr);
+	vkDestroyCommandPool(m_DeviceContext.m_Device, transferCommandPool, VulkanHostAllocator::getCallbacks());
+}
+
+void VulkanContext::generateMipmaps(VkImage image, uint32_t width, uint32_t height, uint32_t mip_levels, uint32_t array_layers)
+{
+	// Blits need a graphics capable queue
+	VkCommandBuffer commandBuffer = vulkan::beginOneShotCommands(m_DeviceContext.m_Device, m_CommandPool);
+
+	// Every level starts in TRANSFER_DST_OPTIMAL, level 0 holds the image (of every layer)
+	VkImageMemoryBarrier imageMemoryBarrier{};
+	imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageMemoryBarrier.image = image;
+	imageMemoryBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	imageMemoryBarrier.subresourceRange.levelCount = 1;
+	imageMemoryBarrier.subresourceRange.baseArrayLayer = 0;
+	imageMemoryBarrier.subresourceRange.layerCount = array_layers;
+
+	int32_t mipWidth = static_cast<int32_t>(width);
+	int32_t mipHeight = static_cast<int32_t>(height);
+
+	for (uint32_t level = 1; level < mip_levels; level++)
+	{
+		// Previous level : TRANSFER_DST_OPTIMAL -> TRANSFER_SRC_OPTIMAL (wait for its copy or blit to finish)
+		imageMemoryBarrier.subresourceRange.baseMipLevel = level - 1;
+		imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+		vkCmdPipelineBarrier(commandBuffer,
+		                     VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+		                     0, nullptr,
+		                     0, nullptr,
+		                     1, &imageMemoryBarrier);
+
+		int32_t nextWidth = mipWidth > 1 ? mipWidth / 2 : 1;
+		int32_t nextHeight = mipHeight > 1 ? mipHeight / 2 : 1;
+
+		// (linear filtering of an exact halving is the same 2x2 box filter as the CPU path, in linear space for sRGB formats)
+		VkImageBlit blit{};
+		blit.srcOffsets[0] = { 0, 0, 0 };
+		blit.srcOffsets[1] = { mipWidth, mipHeight, 1 };
+		blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		blit.srcSubresource.mipLevel = level - 1;
+		blit.srcSubresource.baseArrayLayer = 0;
+		blit.srcSubresource.layerCount = array_layers;
+		blit.dstOffsets[0] = { 0, 0, 0 };
+		blit.dstOffsets[1] = { nextWidth, nextHeight, 1 };
+		blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		blit.dstSubresource.mipLevel = level;
+		blit.dstSubresource.baseArrayLayer = 0;
+		blit.dstSubresource.layerCount = array_layers;
+
+		vkCmdBlitImage(commandBuffer,
+		               image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		               image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		               1, &blit,
+		               VK_FILTER_LINEAR);
+
+		// Previous level : TRANSFER_SRC_OPTIMAL -> SHADER_READ_ONLY_OPTIMAL (done with it)
+		imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+		vkCmdPipelineBarrier(commandBuffer,
+		                     VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+		                     0, nullptr,
+		                     0, nullptr,
+		                     1, &imageMemoryBarrier);
+
+		mipWidth = nextWidth;
+		mipHeight = nextHeight;
+	}
+
+	// Last level was only written to : TRANSFER_DST_OPTIMAL -> SHADER_READ_ONLY_OPTIMAL
+	imageMemoryBarrier.subresourceRange.baseMipLevel = mip_levels - 1;
+	imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer,
+	                     VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+	                     0, nullptr,
+	                     0, nullptr,
+	                     1, &imageMemoryBarrier);
+
+	vulkan::endOneShotCommands(m_DeviceContext.m_Device, commandBuffer, m_CommandPool, m_DeviceContext.m_GraphicsQueue);
 }
 
 void VulkanContext::updateUniformBuffers(uint32_t current_image)
 {
+	PROFILE_SCOPE("updateUniformBuffers");
+
+	// A replay takes the camera, the toggles and the sorted draw list of the captured frame as they are
+	if (m_Replay && !m_Replay->frames.empty())
+	{
+		const SceneCaptureFrame& frame = m_Replay->frames[m_ReplayFrame % m_Replay->frames.size()];
+		m_ReplayFrame++;
+
+		m_EnableDepthPrePass = frame.depthPrePass;
+		m_EnableOcclusionCulling = frame.occlusionCulling;
+		memcpy(m_UniformBufferMapped[current_image], &frame.matrices, sizeof(frame.matrices));
+
+		m_DrawList = frame.drawList;
+		m_DrawRuns = frame.drawRuns;
+		memcpy(m_DrawListMapped[current_image], m_DrawList.data(), m_DrawList.size() * sizeof(uint32_t));
+
+		updateTextureDemand(frame.matrices.view * frame.matrices.model, frame.matrices.proj);
+		return;
+	}
+
 	static auto startTime = std::chrono::high_resolution_clock::now();
 
-	auto currentTime = std::chrono::high_resolution_clock::now();
-	float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
+	// A fixed time step makes the animation (and so the culling and streaming work) the same on every run
+	float time;
+	if (m_SceneSettings.fixedTimeStep > 0.0)
+	{
+		time = static_cast<float>(static_cast<double>(m_FrameCount) * m_SceneSettings.fixedTimeStep);
+	}
+	else
+	{
+		auto currentTime = std::chrono::high_resolution_clock::now();
+		time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
+	}
 
 	MatricesUBO ubo{};
 	ubo.model = glm::rotate(glm::mat4(1.f), time * glm::radians(90.f), glm::vec3(0.f, 0.f, 1.f));
@@ -778,6 +1826,91 @@ void VulkanContext::updateUniformBuffers(uint32_t current_image)
 	ubo.proj[1][1] *= -1; // invert Y of clip space (OpenGL->Vulkan)
 
 	memcpy(m_UniformBufferMapped[current_image], &ubo, sizeof(ubo));
+
+	updateDrawList(current_image, ubo.view * ubo.model);
+	updateTextureDemand(ubo.view * ubo.model, ubo.proj);
+
+	if (m_CaptureWriter.isOpen())
+	{
+		m_CaptureWriter.writeFrame(ubo, m_EnableDepthPrePass, m_EnableOcclusionCulling, m_DrawList, m_DrawRuns);
+	}
+}
+
+void VulkanContext::updateDrawList(uint32_t current_image, const glm::mat4& model_view)
+{
+	PROFILE_SCOPE("updateDrawList");
+
+	// Key every object by its layer and view space depth (the camera looks down -z)
+	// Opaque surfaces go front-to-back to reject as much as possible with early-Z, transparent ones back-to-front to blend in order
+	// (the layer is in the top bits, so the buckets computed at creation keep their ranges)
+	// The index type goes in the mesh field : objects sharing it can be drawn by the same indirect draw
+	for (uint32_t objectIndex = 0; objectIndex < m_SceneSettings.objectCount; objectIndex++)
+	{
+		const ObjectData& object = m_SceneObjects[objectIndex];
+		glm::vec4 center = model_view * object.model * glm::vec4(glm::vec3(object.boundingSphere), 1.f);
+		m_DrawDepths[objectIndex] = -center.z;
+
+		MaterialClass materialClass = Scene::getMaterialClass(objectIndex);
+		VkIndexType indexType = m_GeometryPool.getMesh(m_SceneObjectMeshes[objectIndex]).indexType;
+		m_DrawKeys[objectIndex] = DrawSortKey::make(getDrawLayer(materialClass), 0, static_cast<uint32_t>(materialClass),
+		                                            static_cast<uint32_t>(indexType), m_DrawDepths[objectIndex]);
+		m_DrawList[objectIndex] = objectIndex;
+	}
+
+	m_DrawSorter.sort(m_DrawKeys.data(), m_DrawList.data(), m_SceneSettings.objectCount);
+
+	// Split the sorted list into runs of the same material class and index type
+	m_DrawRuns.clear();
+	for (uint32_t slot = 0; slot < m_SceneSettings.objectCount; slot++)
+	{
+		uint32_t objectIndex = m_DrawList[slot];
+		MaterialClass materialClass = Scene::getMaterialClass(objectIndex);
+		VkIndexType indexType = m_GeometryPool.getMesh(m_SceneObjectMeshes[objectIndex]).indexType;
+
+		if (!m_DrawRuns.empty() && m_DrawRuns.back().materialClass == materialClass && m_DrawRuns.back().indexType == indexType)
+		{
+			m_DrawRuns.back().count++;
+			continue;
+		}
+
+		m_DrawRuns.push_back({ slot, 1, materialClass, indexType, m_DrawDepths[objectIndex] });
+	}
+
+	memcpy(m_DrawListMapped[current_image], m_DrawList.data(), m_DrawList.size() * sizeof(uint32_t));
+}
+
+void VulkanContext::updateTextureDemand(const glm::mat4& model_view, const glm::mat4& projection)
+{
+	PROFILE_SCOPE("updateTextureDemand");
+
+	// Screen-space size of every object in front of the camera, from its bounding sphere
+	// (the texture covers the object, so its largest dimension spans about the projected diameter)
+	float pixelsPerUnit = 0.5f * projection[1][1] * static_cast<float>(m_SwapchainImageExtent.height);
+	for (uint32_t objectIndex = 0; objectIndex < m_SceneSettings.objectCount; objectIndex++)
+	{
+		// Objects textured from the atlas are always resident, the others request their streamed texture
+		const ObjectData& object = m_SceneObjects[objectIndex];
+		uint32_t slot = 0;
+		if (0 != object.mesh.w)
+		{
+			int32_t layer = static_cast<int32_t>(m_TextureAtlasRegions[object.mesh.w - 1].layer);
+			if (layer >= 0)
+				continue;
+			slot = static_cast<uint32_t>(-1 - layer);
+		}
+
+		glm::mat4 objectModelView = model_view * object.model;
+		glm::vec4 center = objectModelView * glm::vec4(glm::vec3(object.boundingSphere), 1.f);
+		float scale = std::max({ glm::length(glm::vec3(objectModelView[0])), glm::length(glm::vec3(objectModelView[1])), glm::length(glm::vec3(objectModelView[2])) });
+		float radius = object.boundingSphere.w * scale;
+
+		float depth = -center.z;
+		if (depth + radius <= 0.f)
+			continue; // (behind the camera)
+
+		float screenSize = 2.f * radius * pixelsPerUnit / std::max(depth - radius, 0.1f); // (nearest point of the sphere)
+		m_TextureStreamer.requestScreenSize(m_StreamedTextureSlots[slot], screenSize);
+	}
 }
 
 void VulkanContext::recreateSwapchain()
@@ -786,6 +1919,10 @@ void VulkanContext::recreateSwapchain()
 
 	m_Swapchain.destroy(m_DeviceContext.m_Device);
 
+	m_DepthPyramid.destroy(m_DeviceContext.m_Device, m_SamplerCache, m_ImageViewCache);
+	m_ImageViewCache.release(m_DepthImageView);
+	m_DepthImage.destroy(m_DeviceContext.m_Device);
+
 	VulkanSwapchainSupportDetails swapchainSupportDetails = detail::query_swapchain_support(m_DeviceContext.m_PhysicalDevice, m_Surface);
 
 	VkPresentModeKHR presentMode = detail::chooseSwapPresentMode(swapchainSupportDetails.presentModes);
@@ -808,11 +1945,18 @@ void VulkanContext::recreateSwapchain()
 	);
 
 	m_Swapchain.createImageViews(m_DeviceContext.m_Device, m_SwapchainImageFormat.format);
-	m_Swapchain.createFramebuffers(m_DeviceContext.m_Device, m_RenderPass.m_RenderPass, m_SwapchainImageExtent);
+
+	// The depth buffer (and the depth pyramid built from it) must match the new extent
+	createDepthResources();
+	updateCullingDescriptorSets();
+
+	m_Swapchain.createFramebuffers(m_DeviceContext.m_Device, m_RenderPass.m_RenderPass, m_SwapchainImageExtent, m_DepthImageView);
 }
 
 void VulkanContext::recordCommandBuffer(VkCommandBuffer command_buffer, uint32_t image_index)
 {
+	PROFILE_SCOPE("recordCommandBuffer");
+
 	VkCommandBufferBeginInfo beginInfo{};
 	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 	beginInfo.flags = 0; // usage-related flags
@@ -823,23 +1967,120 @@ void VulkanContext::recordCommandBuffer(VkCommandBuffer command_buffer, uint32_t
 		throw std::runtime_error("Failed to Begin Recording command buffer!");
 	}
 
+	m_GpuProfiler.beginFrame(command_buffer, m_CurrentFrame);
+	m_PipelineStatistics.beginFrame(command_buffer, m_CurrentFrame);
+	uint32_t frameScope = m_GpuProfiler.beginScope("Frame");
+
+	// Texture residency changes come first, the frame's descriptor set is rebound to the new views before any use
+	uint32_t streamingScope = m_GpuProfiler.beginScope("Texture streaming");
+	m_TextureStreamer.update(command_buffer);
+	m_GpuProfiler.endScope(streamingScope);
+	updateTextureDescriptors(m_CurrentFrame);
+
+	m_CommandRecorder.begin(command_buffer);
+	m_CommandRecorder.resetStats();
+
+	// Wait for the previous frame's culling results and indirect draws before overwriting them
+	VkMemoryBarrier memoryBarrier{};
+	memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+	vkCmdPipelineBarrier(
+		command_buffer,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		0,
+		1, &memoryBarrier, // MemoryBarrier
+		0, nullptr, // BufferMemoryBarrier
+		0, nullptr // ImageMemoryBarrier
+	);
+
+	/**
+	 * Two phase occlusion culling:
+	 *  - Early : draw the objects that were visible last frame (and are still in the frustum)
+	 *  - Build the depth pyramid from the resulting depth buffer
+	 *  - Late : test every object against the pyramid and draw the ones that just became visible
+	 */
+	recordCullingPass(command_buffer, 0);
+	recordScenePass(command_buffer, image_index, m_RenderPass.m_RenderPass, 0);
+
+	if (m_EnableOcclusionCulling)
+	{
+		VulkanGpuProfileScope profileScope(m_GpuProfiler, "Depth pyramid");
+		m_DepthPyramid.record(command_buffer, m_DepthPyramidPipeline);
+	}
+
+	recordCullingPass(command_buffer, 1);
+	recordScenePass(command_buffer, image_index, m_LateRenderPass.m_RenderPass, 1);
+
+	m_BindStats = m_CommandRecorder.getStats();
+
+	m_GpuProfiler.endScope(frameScope);
+
+	// End recording the command buffer
+	if (VK_SUCCESS != vkEndCommandBuffer(command_buffer))
+	{
+		throw std::runtime_error("Failed to Record command buffer!");
+	}
+}
+
+void VulkanContext::recordCullingPass(VkCommandBuffer command_buffer, uint32_t phase)
+{
+	VulkanGpuProfileScope profileScope(m_GpuProfiler, 0 == phase ? "Culling (early)" : "Culling (late)");
+	uint32_t statisticsPass = m_PipelineStatistics.beginPass(0 == phase ? "Culling (early)" : "Culling (late)");
+
+	CullingPushConstants pushConstants{};
+	pushConstants.objectCount = m_SceneSettings.objectCount;
+	pushConstants.phase = phase;
+	pushConstants.occlusionEnabled = m_EnableOcclusionCulling ? 1 : 0;
+	pushConstants.depthSize = glm::vec2(static_cast<float>(m_SwapchainImageExtent.width), static_cast<float>(m_SwapchainImageExtent.height));
+	pushConstants.transparentBegin = m_DrawBuckets[static_cast<size_t>(MaterialClass::Transparent)].first;
+
+	vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_CullingPipeline.m_Pipeline);
+	vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_CullingPipeline.m_PipelineLayout, 0, 1,
+	                        &m_CullingDescriptorSets[m_CurrentFrame], 0, nullptr);
+	vkCmdPushConstants(command_buffer, m_CullingPipeline.m_PipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), &pushConstants);
+
+	vkCmdDispatch(command_buffer, (m_SceneSettings.objectCount + 63) / 64, 1, 1);
+	m_PipelineStatistics.endPass(statisticsPass);
+
+	// The draw commands are consumed by the indirect draws, the visibility by the next culling pass
+	VkMemoryBarrier memoryBarrier{};
+	memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	memoryBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+	vkCmdPipelineBarrier(
+		command_buffer,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		0,
+		1, &memoryBarrier, // MemoryBarrier
+		0, nullptr, // BufferMemoryBarrier
+		0, nullptr // ImageMemoryBarrier
+	);
+}
+
+void VulkanContext::recordScenePass(VkCommandBuffer command_buffer, uint32_t image_index, VkRenderPass render_pass, uint32_t phase)
+{
+	VulkanGpuProfileScope profileScope(m_GpuProfiler, 0 == phase ? "Scene pass (early)" : "Scene pass (late)");
+	uint32_t statisticsPass = m_PipelineStatistics.beginPass(0 == phase ? "Scene pass (early)" : "Scene pass (late)");
+
 	// Start a render pass
 	VkRenderPassBeginInfo renderPassBeginInfo{};
 	renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-	renderPassBeginInfo.renderPass = m_RenderPass.m_RenderPass;
+	renderPassBeginInfo.renderPass = render_pass;
 	renderPassBeginInfo.framebuffer = m_Swapchain.m_Framebuffers[image_index];
 	renderPassBeginInfo.renderArea.offset = {0, 0};
 	renderPassBeginInfo.renderArea.extent = m_SwapchainImageExtent;
-	VkClearValue clearColor = {{{ 0.f, 0.f, 0.f, 1.f }}};
-	renderPassBeginInfo.clearValueCount = 1;
-	renderPassBeginInfo.pClearValues = &clearColor;
+	VkClearValue clearValues[2]{}; // (ignored by the late pass which loads the attachments)
+	clearValues[0].color = {{ 0.f, 0.f, 0.f, 1.f }};
+	clearValues[1].depthStencil = { 1.f, 0 };
+	renderPassBeginInfo.clearValueCount = static_cast<uint32_t>(std::size(clearValues));
+	renderPassBeginInfo.pClearValues = clearValues;
 
 	vkCmdBeginRenderPass(command_buffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE); // INLINE : no secondary cmd buffers present
 
 
-	// Drawing commands
-	vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_GraphicsPipeline.m_Pipeline);
-
 #if 1
   // Create the viewport
 	VkViewport viewport{};
@@ -858,30 +2099,103 @@ void VulkanContext::recordCommandBuffer(VkCommandBuffer command_buffer, uint32_t
 	vkCmdSetScissor(command_buffer, 0, 1, &scissor);
 #endif
 
-	VkBuffer vertexBuffers[] = { m_VertexBuffer.m_Buffer };
-	VkDeviceSize vertexOffsets[] = { 0 };
-	vkCmdBindVertexBuffers(command_buffer, 0, 1, vertexBuffers, vertexOffsets);
-
-	vkCmdBindIndexBuffer(command_buffer, m_IndexBuffer.m_Buffer, 0, VK_INDEX_TYPE_UINT16);
+	// Build one draw packet per (pipeline, draw run) of this pass
+	// (the commands are in draw list order, so each run is a contiguous range of indirect commands)
+	m_DrawPackets.clear();
+	auto addPacket = [&](DrawLayer layer, detail::ScenePipelineId pipeline_id, const VulkanPipeline& pipeline, const DrawRun& run)
+	{
+		VulkanDrawPacket packet{};
+		packet.sortKey = DrawSortKey::make(layer, pipeline_id, static_cast<uint32_t>(run.materialClass),
+		                                   static_cast<uint32_t>(run.indexType), run.viewDepth);
+		packet.pipeline = pipeline.m_Pipeline;
+		packet.pipelineLayout = pipeline.m_PipelineLayout;
+		packet.descriptorSet = m_DescriptorSets[m_CurrentFrame];
+		packet.vertexBuffer = m_GeometryPool.m_VertexBuffer.m_Buffer;
+		packet.indexBuffer = m_GeometryPool.m_IndexBuffer.m_Buffer;
+		packet.indexType = run.indexType;
+		packet.indirectBuffer = m_DrawCommandBuffer.m_Buffer;
+		packet.indirectOffset = (phase * m_SceneSettings.objectCount + run.first) * sizeof(VkDrawIndexedIndirectCommand);
+		packet.drawCount = run.count;
+		m_DrawPackets.push_back(packet);
+	};
+
+	for (const DrawRun& run : m_DrawRuns)
+	{
+		switch (run.materialClass)
+		{
+		case MaterialClass::Opaque:
+			if (m_EnableDepthPrePass)
+			{
+				// Lay down the depth first, then shade only the visible fragments (no overdraw in the fragment shader)
+				addPacket(DrawLayer::DepthPrePass, detail::ScenePipelineId::DepthPrePass, m_DepthPrePassPipeline, run);
+				addPacket(DrawLayer::Opaque, detail::ScenePipelineId::EqualTest, m_EqualTestPipeline, run);
+			}
+			else
+			{
+				addPacket(DrawLayer::Opaque, detail::ScenePipelineId::Opaque, m_GraphicsPipeline, run);
+			}
+			break;
 
-	vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_GraphicsPipeline.m_PipelineLayout, 0, 1,
-	                        &m_DescriptorSets[m_CurrentFrame], 0, nullptr);
+		case MaterialClass::AlphaTest:
+			addPacket(DrawLayer::AlphaTest, detail::ScenePipelineId::AlphaTest, m_AlphaTestPipeline, run);
+			break;
 
-	// vkCmdDraw(command_buffer, static_cast<uint32_t>(Mesh::getNumVertices()), 1, 0, 0);
-	vkCmdDrawIndexed(command_buffer, static_cast<uint32_t>(Mesh::getNumIndices()), 1, 0, 0, 0);
+		case MaterialClass::Transparent:
+			// Transparent objects are only drawn in the late phase, after every opaque object
+			if (1 == phase)
+			{
+				addPacket(DrawLayer::Transparent, detail::ScenePipelineId::Transparent, m_TransparentPipeline, run);
+			}
+			break;
 
-	// End the render pass
-	vkCmdEndRenderPass(command_buffer);
+		default:
+			break;
+		}
+	}
 
-	// End recording the command buffer
-	if (VK_SUCCESS != vkEndCommandBuffer(command_buffer))
+	// Sort the packets by key and record them, skipping the binds of state that is already bound
+	m_DrawPacketKeys.resize(m_DrawPackets.size());
+	m_DrawPacketOrder.resize(m_DrawPackets.size());
+	for (uint32_t i = 0; i < m_DrawPackets.size(); i++)
 	{
-		throw std::runtime_error("Failed to Record command buffer!");
+		m_DrawPacketKeys[i] = m_DrawPackets[i].sortKey;
+		m_DrawPacketOrder[i] = i;
+	}
+	m_DrawSorter.sort(m_DrawPacketKeys.data(), m_DrawPacketOrder.data(), m_DrawPackets.size());
+
+	// The packets of a layer are contiguous once sorted, each layer is profiled as a draw group
+	// (and gets an occlusion query, counting the samples its draws wrote in this pass)
+	uint32_t layerScope = VulkanGpuProfiler::INVALID_SCOPE;
+	uint32_t layerGroup = VulkanPipelineStatistics::INVALID_QUERY;
+	DrawLayer currentLayer{};
+	bool firstPacket = true;
+	for (uint32_t packetIndex : m_DrawPacketOrder)
+	{
+		DrawLayer layer = DrawSortKey::getLayer(m_DrawPackets[packetIndex].sortKey);
+		if (firstPacket || layer != currentLayer)
+		{
+			m_GpuProfiler.endScope(layerScope);
+			m_PipelineStatistics.endGroup(layerGroup);
+			const char* layerName = detail::s_DrawLayerNames[static_cast<uint32_t>(layer)];
+			layerScope = m_GpuProfiler.beginScope(layerName);
+			layerGroup = m_PipelineStatistics.beginGroup(layerName);
+			currentLayer = layer;
+			firstPacket = false;
+		}
+		m_CommandRecorder.record(m_DrawPackets[packetIndex]);
 	}
+	m_GpuProfiler.endScope(layerScope);
+	m_PipelineStatistics.endGroup(layerGroup);
+
+	// End the render pass
+	vkCmdEndRenderPass(command_buffer);
+	m_PipelineStatistics.endPass(statisticsPass);
 }
 
 void VulkanContext::drawFrame()
 {
+	PROFILE_SCOPE("drawFrame");
+
 	/**
 	 * Basic flow:
 	 *  - Wait for prev frame to finish - (Fence)
@@ -895,38 +2209,75 @@ void VulkanContext::drawFrame()
 	 *  - Fences : Synchronizing between GPU and CPU
 	 */
 
+	// The CPU frame time spans from one call to the next
+	FrameStatistics::Clock::time_point frameStart = FrameStatistics::Clock::now();
+	if (FrameStatistics::Clock::time_point{} != m_FrameStart)
+	{
+		m_FrameStatistics.record(FramePhase::CpuFrame, frameStart - m_FrameStart);
+	}
+	m_FrameStart = frameStart;
+	m_FrameStatistics.advance(frameStart);
+
 	// Wait for the previous frame to finish
-	vkWaitForFences(m_DeviceContext.m_Device, 1, &m_InFlightFences[m_CurrentFrame], VK_TRUE, UINT64_MAX);
+	{
+		PROFILE_SCOPE("Wait for fence");
+		vkWaitForFences(m_DeviceContext.m_Device, 1, &m_InFlightFences[m_CurrentFrame], VK_TRUE, UINT64_MAX);
+	}
+	FrameStatistics::Clock::time_point phaseEnd = FrameStatistics::Clock::now();
+	m_FrameStatistics.record(FramePhase::FenceWait, phaseEnd - frameStart);
 
-	// Acquire an image from the swapchain
-	uint32_t imageIndex;
-	VkResult result = vkAcquireNextImageKHR(m_DeviceContext.m_Device,
-											m_Swapchain.m_Swapchain,
-											UINT64_MAX,
-	                                        m_ImageAvailableSemaphores[m_CurrentFrame],
-											VK_NULL_HANDLE,
-											&imageIndex);
-
-	if (result == VK_ERROR_OUT_OF_DATE_KHR /*|| m_IsFramebufferResized*/)
-	{
-		/*m_IsFramebufferResized = false;*/
-		recreateSwapchain();
-		return;
+	// Collect the culling stats of the finished frame and reset them for the next one
+	std::memcpy(&m_CullingStats, m_CullingStatsMapped[m_CurrentFrame], sizeof(CullingStats));
+	std::memset(m_CullingStatsMapped[m_CurrentFrame], 0, sizeof(CullingStats));
+
+	// Read the GPU times of the finished frame (its timestamps are available once the fence is signalled)
+	m_GpuProfiler.collect(m_DeviceContext.m_Device, m_CurrentFrame);
+	const std::vector<VulkanGpuScopeTiming>& gpuTimings = m_GpuProfiler.getResults();
+	if (!gpuTimings.empty() && gpuTimings[0].milliseconds >= 0.0)
+	{
+		m_GpuFrameTime = gpuTimings[0].milliseconds;
+		m_FrameStatistics.record(FramePhase::GpuFrame, static_cast<uint64_t>(m_GpuFrameTime * 1e3));
 	}
-	if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
+	m_PipelineStatistics.collect(m_DeviceContext.m_Device, m_CurrentFrame);
+
+	// Acquire an image from the swapchain
+	// (headless : the offscreen image of the frame, available as soon as the frame's fence is)
+	uint32_t imageIndex = m_CurrentFrame;
+	if (!m_Headless)
 	{
-		throw std::runtime_error("Failed to Acquire swapchain image!");
+		FrameStatistics::Clock::time_point phaseStart = FrameStatistics::Clock::now();
+		VkResult result = vkAcquireNextImageKHR(m_DeviceContext.m_Device,
+		                                        m_Swapchain.m_Swapchain,
+		                                        UINT64_MAX,
+		                                        m_ImageAvailableSemaphores[m_CurrentFrame],
+		                                        VK_NULL_HANDLE,
+		                                        &imageIndex);
+		m_FrameStatistics.record(FramePhase::AcquireWait, FrameStatistics::Clock::now() - phaseStart);
+
+		if (result == VK_ERROR_OUT_OF_DATE_KHR /*|| m_IsFramebufferResized*/)
+		{
+			/*m_IsFramebufferResized = false;*/
+			recreateSwapchain();
+			return;
+		}
+		if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
+		{
+			throw std::runtime_error("Failed to Acquire swapchain image!");
+		}
 	}
 
 	// Reset fence to unsignalled state to begin rendering next frame
 	vkResetFences(m_DeviceContext.m_Device, 1, &m_InFlightFences[m_CurrentFrame]);
 
 	// Update uniforms
+	FrameStatistics::Clock::time_point phaseStart = FrameStatistics::Clock::now();
 	updateUniformBuffers(m_CurrentFrame);
 
 	// Record the command buffer for drawing on acquired image
 	vkResetCommandBuffer(m_CommandBuffers[m_CurrentFrame], 0);
 	recordCommandBuffer(m_CommandBuffers[m_CurrentFrame], imageIndex);
+	phaseEnd = FrameStatistics::Clock::now();
+	m_FrameStatistics.record(FramePhase::Record, phaseEnd - phaseStart);
 
 	// Submit the command buffer for processing
 	VkSubmitInfo submitInfo{};
@@ -936,47 +2287,60 @@ void VulkanContext::drawFrame()
 	VkSemaphore waitSemaphores[] = { m_ImageAvailableSemaphores[m_CurrentFrame] }; // Which semaphores to wait on
 																  // for each entry - waitStages[i] waits on waitSemaphores[i]
 	submitInfo.pWaitDstStageMask = waitStages;
-	submitInfo.waitSemaphoreCount = 1;
+	submitInfo.waitSemaphoreCount = m_Headless ? 0 : 1;
 	submitInfo.pWaitSemaphores = waitSemaphores;
 
 	submitInfo.commandBufferCount = 1;
 	submitInfo.pCommandBuffers = &m_CommandBuffers[m_CurrentFrame];
 
 	VkSemaphore signalSemaphores[] = { m_RenderFinishedSemaphores[m_CurrentFrame] }; // Which semaphores to signal once the execution is finished
-	submitInfo.signalSemaphoreCount = 1;
+	submitInfo.signalSemaphoreCount = m_Headless ? 0 : 1; // (nothing to present in headless mode)
 	submitInfo.pSignalSemaphores = signalSemaphores;
 
+	phaseStart = phaseEnd;
 	if (VK_SUCCESS != vkQueueSubmit(m_DeviceContext.m_GraphicsQueue, 1, &submitInfo, m_InFlightFences[m_CurrentFrame]))
 	{
 		throw std::runtime_error("Failed to Submit Draw command buffer!");
 	}
+	phaseEnd = FrameStatistics::Clock::now();
+	m_FrameStatistics.record(FramePhase::Submit, phaseEnd - phaseStart);
 
-	// Present the swapchain image to the window
-	VkPresentInfoKHR presentInfo{};
-	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-	presentInfo.pSwapchains = &m_Swapchain.m_Swapchain;
-	presentInfo.swapchainCount = 1;
-	presentInfo.pImageIndices = &imageIndex;
+	if (!m_Headless)
+	{
+		// Present the swapchain image to the window
+		VkPresentInfoKHR presentInfo{};
+		presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+		presentInfo.pSwapchains = &m_Swapchain.m_Swapchain;
+		presentInfo.swapchainCount = 1;
+		presentInfo.pImageIndices = &imageIndex;
 
-	presentInfo.waitSemaphoreCount = 1;
-	presentInfo.pWaitSemaphores = &m_RenderFinishedSemaphores[m_CurrentFrame];
+		presentInfo.waitSemaphoreCount = 1;
+		presentInfo.pWaitSemaphores = &m_RenderFinishedSemaphores[m_CurrentFrame];
 
-	presentInfo.pResults = nullptr; // (optional) used to provide an array of VkResult values to check for individual swapchain results
+		presentInfo.pResults = nullptr; // (optional) used to provide an array of VkResult values to check for individual swapchain results
 
-	result = vkQueuePresentKHR(m_DeviceContext.m_PresentQueue, &presentInfo);
+		VkResult result = vkQueuePresentKHR(m_DeviceContext.m_PresentQueue, &presentInfo);
+		m_FrameStatistics.record(FramePhase::Present, FrameStatistics::Clock::now() - phaseEnd);
 
-	if (VK_ERROR_OUT_OF_DATE_KHR == result || VK_SUBOPTIMAL_KHR == result || m_IsFramebufferResized)
-	{
-		m_IsFramebufferResized = false;
-		recreateSwapchain();
+		if (VK_ERROR_OUT_OF_DATE_KHR == result || VK_SUBOPTIMAL_KHR == result || m_IsFramebufferResized)
+		{
+			m_IsFramebufferResized = false;
+			recreateSwapchain();
+		}
+		else if (VK_SUCCESS != result)
+		{
+			throw std::runtime_error("Failed to Present swapchain image!");
+		}
 	}
-	else if (VK_SUCCESS != result)
+
+	if (0 == m_FrameCount % MEMORY_BUDGET_CHECK_INTERVAL)
 	{
-		throw std::runtime_error("Failed to Present swapchain image!");
+		VulkanMemoryTelemetry::checkBudget(m_DeviceContext);
 	}
 
 	// Advance to next frame
-	m_CurrentFrame = (m_CurrentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+	m_FrameCount++;
+	m_CurrentFrame = (m_CurrentFrame + 1) % m_SceneSettings.framesInFlight;
 }
 
 void VulkanContext::handleFramebufferResized(int width, int height)
@@ -1037,17 +2401,21 @@ void detail::populate_debug_messenger_create_info(VkDebugUtilsMessengerCreateInf
 	createInfo.pUserData = nullptr;
 }
 
-std::vector<const char*> detail::get_required_instance_extensions()
+std::vector<const char*> detail::get_required_instance_extensions(bool headless)
 {
 	std::vector<const char*> extensions;
 
 #ifdef VKTUT_USE_GLFW
-	uint32_t glfwExtensionCount = 0;
-	const char** glfwExtensions;
+	// (the surface extensions are only needed to present, GLFW is not even initialized in headless mode)
+	if (!headless)
+	{
+		uint32_t glfwExtensionCount = 0;
+		const char** glfwExtensions;
 
-	glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+		glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
 
-	extensions.insert(extensions.end(), glfwExtensions, glfwExtensions + glfwExtensionCount);
+		extensions.insert(extensions.end(), glfwExtensions, glfwExtensions + glfwExtensionCount);
+	}
 #endif
 
 	if (detail::s_EnableDebugLayers)
@@ -1068,10 +2436,14 @@ std::vector<const char*> detail::get_required_instance_extensions()
 
 bool detail::is_device_suitable(VkPhysicalDevice device, VkSurfaceKHR surface)
 {
+	// No surface : headless mode, which presents nothing
+	bool headless = VK_NULL_HANDLE == surface;
+
 	// Check if required device properties are present
+	// (headless mode also runs on integrated GPUs and CPU implementations)
 	VkPhysicalDeviceProperties deviceProperties{};
 	vkGetPhysicalDeviceProperties(device, &deviceProperties);
-	if (VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU != deviceProperties.deviceType)
+	if (!headless && VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU != deviceProperties.deviceType)
 	{
 		return false;
 	}
@@ -1084,6 +2456,18 @@ bool detail::is_device_suitable(VkPhysicalDevice device, VkSurfaceKHR surface)
 		return false;
 	}
 
+	// GPU culling draws all the objects through a single indirect call indexed by firstInstance
+	if (!deviceFeatures.multiDrawIndirect || !deviceFeatures.drawIndirectFirstInstance)
+	{
+		return false;
+	}
+
+	// The fragment shaders select the streamed textures in a loop over the array of samplers
+	if (!deviceFeatures.shaderSampledImageArrayDynamicIndexing)
+	{
+		return false;
+	}
+
 	// Check if required queue families are present
 	VulkanQueueFamilyIndices indices = find_queue_families(device, surface);
 	if (!indices.isComplete())
@@ -1091,6 +2475,11 @@ bool detail::is_device_suitable(VkPhysicalDevice device, VkSurfaceKHR surface)
 		return false;
 	}
 
+	if (headless)
+	{
+		return true;
+	}
+
 	// Check if required extensions are supported
 	bool extensionsSupported = check_device_extension_support(device);
 	if (!extensionsSupported)
@@ -1127,7 +2516,10 @@ VulkanQueueFamilyIndices detail::find_queue_families(VkPhysicalDevice device, Vk
 
 		// Find a queue family that supports presenting to the window surface
 		VkBool32 presentSupport = false;
-		vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+		if (VK_NULL_HANDLE != surface)
+		{
+			vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+		}
 		if (presentSupport)
 		{
 			indices.presentFamily = i;
@@ -1145,6 +2537,17 @@ VulkanQueueFamilyIndices detail::find_queue_families(VkPhysicalDevice device, Vk
 		++i;
 	}
 
+	// Headless : nothing is presented, and the copies share the graphics queue when there's no dedicated transfer family
+	// (software implementations usually expose a single queue family)
+	if (VK_NULL_HANDLE == surface && indices.graphicsFamily.has_value())
+	{
+		indices.presentFamily = indices.graphicsFamily;
+		if (!indices.transferFamily.has_value())
+		{
+			indices.transferFamily = indices.graphicsFamily;
+		}
+	}
+
 	return indices;
 }
 
@@ -1259,3 +2662,41 @@ VkExtent2D detail::chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities
 
 	return actualExtent;
 }
+
+void detail::subdivideQuad(uint32_t subdivisions, MeshData& mesh_data)
+{
+	// (corners 0 and 1 along the bottom edge, 3 and 2 along the top one)
+	const Vertex* corners = Mesh::getVertices();
+	auto interpolate = [corners](float s, float t)
+	{
+		Vertex vertex{};
+		vertex.pos = glm::mix(glm::mix(corners[0].pos, corners[1].pos, s), glm::mix(corners[3].pos, corners[2].pos, s), t);
+		vertex.color = glm::mix(glm::mix(corners[0].color, corners[1].color, s), glm::mix(corners[3].color, corners[2].color, s), t);
+		vertex.uv = glm::mix(glm::mix(corners[0].uv, corners[1].uv, s), glm::mix(corners[3].uv, corners[2].uv, s), t);
+		return vertex;
+	};
+
+	uint32_t rowLength = subdivisions + 1;
+	mesh_data.vertices.clear();
+	mesh_data.vertices.reserve(rowLength * rowLength);
+	for (uint32_t y = 0; y <= subdivisions; y++)
+	{
+		for (uint32_t x = 0; x <= subdivisions; x++)
+		{
+			mesh_data.vertices.push_back(interpolate(static_cast<float>(x) / subdivisions, static_cast<float>(y) / subdivisions));
+		}
+	}
+
+	// Same winding as the quad's two triangles
+	mesh_data.indices.clear();
+	mesh_data.indices.reserve(6 * subdivisions * subdivisions);
+	for (uint32_t y = 0; y < subdivisions; y++)
+	{
+		for (uint32_t x = 0; x < subdivisions; x++)
+		{
+			uint32_t bottomLeft = y * rowLength + x;
+			uint32_t topLeft = bottomLeft + rowLength;
+			mesh_data.indices.insert(mesh_data.indices.end(), { bottomLeft, bottomLeft + 1, topLeft + 1, topLeft + 1, topLeft, bottomLeft });
+		}
+	}
+}
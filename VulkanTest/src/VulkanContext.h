@@ -3,11 +3,28 @@
 #include "VulkanSwapchain.h"
 
 #define GLFW_INCLUDE_VULKAN
+#include "AssetArchive.h"
+#include "BufferData.h"
+#include "FrameStatistics.h"
+#include "MipmapGenerator.h"
+#include "RadixSort.h"
+#include "SceneCapture.h"
 #include "VulkanBuffer.h"
+#include "VulkanCommandRecorder.h"
 #include "VulkanCommon.h"
+#include "VulkanDepthPyramid.h"
+#include "VulkanGeometryPool.h"
+#include "VulkanGpuProfiler.h"
+#include "VulkanHandleCache.h"
 #include "VulkanImage.h"
+#include "VulkanMemoryTelemetry.h"
 #include "VulkanPipeline.h"
+#include "VulkanPipelineStatistics.h"
 #include "VulkanRenderPass.h"
+#include "TextureAtlas.h"
+#include "TextureCache.h"
+#include "VulkanTextureStreamer.h"
+#include "WorkerPool.h"
 #include "GLFW/glfw3.h"
 
 class Application;
@@ -22,19 +39,117 @@ struct VulkanDeviceContext
 	VkPhysicalDeviceProperties m_PhysicalDeviceProperties{};
 	VkPhysicalDeviceFeatures m_PhysicalDeviceFeatures{};
 	std::vector<VkExtensionProperties> m_AvailableExtensions;
+	bool m_HasMemoryBudget = false; // VK_EXT_memory_budget enabled
 
 	void retrieveDeviceContext();
 };
 
+enum class TextureLoadSource
+{
+	Decoded, // from the source image
+	Cache, // read from the texture cache
+	Archive, // baked into the asset archive
+};
+
+// Time spent on one texture by the worker decoding it and by the upload on the transfer queue
+struct TextureLoadTiming
+{
+	std::string file;
+	double decodeMilliseconds = 0.0;
+	double uploadMilliseconds = 0.0;
+	TextureLoadSource source = TextureLoadSource::Decoded;
+};
+
+// Scene and frame parameters, applied when the context is initialized
+struct VulkanSceneSettings
+{
+	uint32_t objectCount = 16;
+	uint32_t textureCount = 2; // atlas textures, cycling through the demo assets
+	uint32_t framesInFlight = 1;
+	double fixedTimeStep = 0.0; // simulated seconds per frame (0 : animate with the wall clock)
+	uint32_t meshSubdivisions = 1; // quads per side of the mesh every object draws (up to 255, the mesh then has 130050 triangles)
+};
+
 class VulkanContext
 {
 public:
 	void initContext(const char* app_name, GLFWwindow* window, bool enable_debugging = true);
+	// Renders into offscreen images of the given size, without any window, surface or swapchain
+	// (accepts any Vulkan implementation, including software ones such as lavapipe)
+	void initHeadlessContext(const char* app_name, VkExtent2D extent, bool enable_debugging = true);
 	void shutdownContext();
 
 	void drawFrame();
 	void handleFramebufferResized(int width, int height);
 
+	// Must be set before initializing the context
+	void setSceneSettings(const VulkanSceneSettings& settings) { m_SceneSettings = settings; }
+	const VulkanSceneSettings& getSceneSettings() const { return m_SceneSettings; }
+
+	// Must be set before initializing the context : records the scene and every frame drawn until shutdown
+	void setCaptureFile(const std::string& file) { m_CaptureFile = file; }
+	uint32_t getCapturedFrameCount() const { return m_CaptureWriter.getFrameCount(); }
+
+	// Must be set before initializing the context : draws the captured scene and frames instead (looping over the frames)
+	// (the capture must outlive the context, its settings replace the scene settings)
+	void setReplay(const SceneCapture* capture) { m_Replay = capture; }
+
+	// GPU time of the last completed frame in milliseconds (negative : no timestamps on the graphics queue)
+	double getGpuFrameTime() const { return m_GpuFrameTime; }
+
+	// GPU time of the passes and draw groups of the last completed frame
+	const std::vector<VulkanGpuScopeTiming>& getGpuScopeTimings() const { return m_GpuProfiler.getResults(); }
+
+	// Pipeline statistics of the passes and samples passed by the draw groups of the last completed frame (off by default)
+	void setPipelineStatisticsEnabled(bool enabled) { m_PipelineStatistics.setEnabled(enabled); }
+	bool isPipelineStatisticsEnabled() const { return m_PipelineStatistics.isEnabled(); }
+	const std::vector<VulkanPassStatistics>& getPassStatistics() const { return m_PipelineStatistics.getPassStatistics(); }
+	const std::vector<VulkanOcclusionResult>& getOcclusionResults() const { return m_PipelineStatistics.getOcclusionResults(); }
+
+	// Device memory of the buffers and images, per heap and category
+	VulkanMemoryStats getMemoryStats() const { return VulkanMemoryTelemetry::getStats(m_DeviceContext); }
+
+	// Durations of the phases of drawFrame (readable from any thread)
+	const FrameStatistics& getFrameStatistics() const { return m_FrameStatistics; }
+
+	bool isHeadless() const { return m_Headless; }
+	const char* getDeviceName() const { return m_DeviceContext.m_PhysicalDeviceProperties.deviceName; }
+
+	// Culling results of the last completed frame
+	const CullingStats& getCullingStats() const { return m_CullingStats; }
+	uint32_t getSceneObjectCount() const { return m_SceneSettings.objectCount; }
+
+	void setOcclusionCullingEnabled(bool enabled) { m_EnableOcclusionCulling = enabled; }
+	bool isOcclusionCullingEnabled() const { return m_EnableOcclusionCulling; }
+
+	// Binds issued and elided while recording the last frame
+	const VulkanBindStats& getBindStats() const { return m_BindStats; }
+
+	void setDepthPrePassEnabled(bool enabled) { m_EnableDepthPrePass = enabled; }
+	bool isDepthPrePassEnabled() const { return m_EnableDepthPrePass; }
+
+	// Per-texture timings of the textures loaded so far
+	const std::vector<TextureLoadTiming>& getTextureLoadTimings() const { return m_TextureLoadTimings; }
+	uint32_t getWorkerThreadCount() const { return m_WorkerPool.getThreadCount(); }
+
+	// Takes effect for the textures loaded afterwards
+	void setTextureCacheEnabled(bool enabled) { m_EnableTextureCache = enabled; }
+	bool isTextureCacheEnabled() const { return m_EnableTextureCache; }
+
+	// Device memory the streamed texture levels may use (0 : derived from the device memory budget)
+	void setTextureBudget(VkDeviceSize budget) { m_TextureStreamer.setBudget(budget); }
+	const VulkanStreamingStats& getTextureStreamingStats() const { return m_TextureStreamer.getStats(); }
+
+	// Samplers and image views are shared between identical requests
+	const VulkanHandleCacheStats& getSamplerCacheStats() const { return m_SamplerCache.getStats(); }
+	const VulkanHandleCacheStats& getImageViewCacheStats() const { return m_ImageViewCache.getStats(); }
+
+	// Small textures packed in the layers of one texture array, all bound at once
+	uint32_t getAtlasTextureCount() const { return static_cast<uint32_t>(m_TextureAtlasRegions.size()); }
+	uint32_t getAtlasLayerCount() const { return m_TextureAtlasImage.m_ArrayLayers; }
+	// Files of the atlas textures too large to be packed, streamed on their own instead
+	uint32_t getAtlasStreamedFileCount() const { return m_StreamedTextureSlots.empty() ? 0 : static_cast<uint32_t>(m_StreamedTextureSlots.size()) - 1; }
+
 private:
 	void createInstance(const char* app_name);
 	void setupDebugMessenger();
@@ -42,30 +157,66 @@ private:
 	void selectPhysicalDevice();
 	void createLogicalDevice();
 	void createCommandPool();
-	void createVertexBuffer();
-	void createIndexBuffer();
+	void createDepthResources();
+	void createGeometryPool();
+	void createSceneObjects();
+	void createCullingResources();
 	void createUniformBuffers();
 	void createDescriptorPool();
 	void createDescriptorSets();
+	void updateCullingDescriptorSets();
 	void createCommandBuffer();
 	void createSyncObjects();
 
 	void createTextureImage(const std::string& texture_file);
-	void createTextureImageView();
+	uint32_t createTextureImageFromKtx2(const std::string& texture_file);
+	std::vector<uint32_t> loadStreamedTextures(const std::vector<std::string>& texture_files);
+	TextureLoadSource readTextureChain(
+		const std::string& texture_file,
+		const TextureImportSettings& import_settings,
+		const std::function<uint8_t*(size_t)>& allocate,
+		std::vector<MipLevel>& levels);
+	void createTextureAtlas(const std::vector<std::string>& texture_files);
 	void createTextureSampler();
 
-	void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout old_layout, VkImageLayout new_layout);
+	void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout old_layout, VkImageLayout new_layout, uint32_t mip_levels = 1, uint32_t array_layers = 1);
 	void copyBuffer(VkBuffer src_buffer, VkBuffer dst_buffer, VkDeviceSize size);
 	void copyBufferToImage(VkBuffer src_buffer, VkImage dst_image, uint32_t width, uint32_t height);
+	// Fills levels 1.. of every layer from level 0 with linear blits, leaves the image in SHADER_READ_ONLY_OPTIMAL
+	void generateMipmaps(VkImage image, uint32_t width, uint32_t height, uint32_t mip_levels, uint32_t array_layers = 1);
 
 	void updateUniformBuffers(uint32_t current_image);
+	void updateDrawList(uint32_t current_image, const glm::mat4& model_view);
+	void updateTextureDemand(const glm::mat4& model_view, const glm::mat4& projection);
+	void updateTextureDescriptors(uint32_t current_image);
+	uint32_t getSlotTexture(uint32_t slot) const;
 	void recreateSwapchain();
 
 	void recordCommandBuffer(VkCommandBuffer command_buffer, uint32_t image_index);
+	void recordCullingPass(VkCommandBuffer command_buffer, uint32_t phase);
+	void recordScenePass(VkCommandBuffer command_buffer, uint32_t image_index, VkRenderPass render_pass, uint32_t phase);
 
-	const uint32_t MAX_FRAMES_IN_FLIGHT = 1;
+	const uint32_t GEOMETRY_POOL_VERTEX_CAPACITY = 1 << 16;
+	const VkDeviceSize GEOMETRY_POOL_INDEX_BUFFER_SIZE = (3 << 16) * sizeof(uint32_t);
+	const VkDeviceSize TEXTURE_STREAMING_STAGING_SIZE = 32 << 20; // (bounds the levels streamed in per frame)
+	const uint32_t TEXTURE_ATLAS_LAYER_SIZE = 2048;
+	const uint32_t TEXTURE_ATLAS_PADDING = 8; // (4 mip levels without bleeding)
+	const uint32_t TEXTURE_ATLAS_MAX_TEXTURE_SIZE = 512; // (larger textures are streamed on their own)
+	const uint32_t TEXTURE_ATLAS_STAGING_LAYERS = 4; // (layers composed and uploaded at once)
+	const char* TEXTURE_CACHE_DIRECTORY = "cache/textures"; // (relative to the asset root)
+	const char* ASSET_ARCHIVE_FILE = "assets.vtpk";
+	const uint32_t MEMORY_BUDGET_CHECK_INTERVAL = 120; // frames
+
+	VulkanSceneSettings m_SceneSettings{};
 
 	GLFWwindow *m_Window{};
+	bool m_Headless = false; // (the swapchain images are offscreen images, nothing is presented)
+
+	// Capture and replay objects
+	std::string m_CaptureFile;
+	SceneCaptureWriter m_CaptureWriter;
+	const SceneCapture* m_Replay = nullptr;
+	size_t m_ReplayFrame = 0;
 
 	VkInstance m_Instance{};
 	VkSurfaceKHR m_Surface{};
@@ -77,36 +228,114 @@ private:
 	VkSurfaceFormatKHR m_SwapchainImageFormat{};
 	VkExtent2D m_SwapchainImageExtent{};
 
-	// Render pass
+	// Depth buffer objects
+	VkFormat m_DepthFormat{};
+	VulkanImage m_DepthImage{};
+	VkImageView m_DepthImageView{};
+
+	// Render passes
+	// (the late pass continues on top of the first one after the depth pyramid has been built)
 	VulkanRenderPass m_RenderPass{};
+	VulkanRenderPass m_LateRenderPass{};
 
 	// Pipelines
-	VulkanPipeline m_GraphicsPipeline{};
+	VulkanPipeline m_GraphicsPipeline{}; // opaque materials
+	VulkanPipeline m_AlphaTestPipeline{};
+	VulkanPipeline m_TransparentPipeline{};
+	VulkanPipeline m_DepthPrePassPipeline{}; // (optional)
+	VulkanPipeline m_EqualTestPipeline{}; // (optional)
+	VulkanComputePipeline m_DepthPyramidPipeline{};
+	VulkanComputePipeline m_CullingPipeline{};
 
 	// Command generation objects
 	VkCommandPool m_CommandPool{};
-	std::vector<VkCommandBuffer> m_CommandBuffers{MAX_FRAMES_IN_FLIGHT};
+	std::vector<VkCommandBuffer> m_CommandBuffers;
 
 	// Synchronization objects
-	std::vector<VkSemaphore> m_ImageAvailableSemaphores{MAX_FRAMES_IN_FLIGHT};
-	std::vector<VkSemaphore> m_RenderFinishedSemaphores{MAX_FRAMES_IN_FLIGHT};
-	std::vector<VkFence> m_InFlightFences{MAX_FRAMES_IN_FLIGHT};
+	std::vector<VkSemaphore> m_ImageAvailableSemaphores;
+	std::vector<VkSemaphore> m_RenderFinishedSemaphores;
+	std::vector<VkFence> m_InFlightFences;
+
+	// Frame timing objects
+	VulkanGpuProfiler m_GpuProfiler{}; // (the outermost scope covers the whole frame)
+	double m_GpuFrameTime = -1.0;
+	VulkanPipelineStatistics m_PipelineStatistics{};
+	uint64_t m_FrameCount = 0; // frames submitted, drives the simulated clock
+	FrameStatistics m_FrameStatistics;
+	FrameStatistics::Clock::time_point m_FrameStart{};
 
 	// Rendering objects
-	VulkanBuffer m_VertexBuffer{};
-	VulkanBuffer m_IndexBuffer{};
+	// (all the meshes live in the vertex and index buffers of the pool)
+	VulkanGeometryPool m_GeometryPool{};
+	uint32_t m_QuadMesh = 0;
+	std::vector<uint32_t> m_SceneObjectMeshes; // mesh of every object in the geometry pool
+
+	// Deduplicated samplers and image views (released instead of destroyed)
+	VulkanSamplerCache m_SamplerCache{};
+	VulkanImageViewCache m_ImageViewCache{};
 
 	// Texturing objects
-	VulkanImage m_TextureImage{};
-	VkImageView m_TextureImageView{};
+	// (the streamed textures change views along with their resident levels)
+	VulkanTextureStreamer m_TextureStreamer{};
+	uint32_t m_SceneTexture = 0;
+	std::vector<uint32_t> m_StreamedTextureSlots; // bound as the array of STREAMED_TEXTURE_SLOTS, m_SceneTexture first
+	std::vector<std::vector<uint32_t>> m_StreamedTextureViewVersions; // of each slot, bound in each frame's descriptor set
 	VkSampler m_TextureSampler{};
 
+	// Texture atlas : every atlased texture is a region of a layer, objects select theirs with the w component of their mesh
+	// (textures larger than TEXTURE_ATLAS_MAX_TEXTURE_SIZE have a region covering their streamed texture slot instead)
+	VulkanImage m_TextureAtlasImage{};
+	VkImageView m_TextureAtlasImageView{};
+	VulkanBuffer m_TextureAtlasRegionBuffer{};
+	std::vector<TextureAtlasRegion> m_TextureAtlasRegions;
+
+	// Texture loading objects
+	// (decoded on the worker pool, the streamer keeps the chains to upload their levels from)
+	AssetArchive m_AssetArchive{};
+	WorkerPool m_WorkerPool{};
+	TextureCache m_TextureCache{};
+	bool m_EnableTextureCache = true;
+	std::vector<TextureLoadTiming> m_TextureLoadTimings;
+
+	// Scene objects
+	VulkanBuffer m_ObjectBuffer{};
+	VulkanBuffer m_VisibilityBuffer{};
+	std::vector<ObjectData> m_SceneObjects;
+
+	// Draw list : object indices bucketed by material class, re-sorted by depth every frame
+	// (opaque and alpha-tested front-to-back, transparent back-to-front)
+	std::vector<uint32_t> m_DrawList;
+	std::vector<uint64_t> m_DrawKeys;
+	std::vector<float> m_DrawDepths;
+	std::vector<DrawRun> m_DrawRuns;
+	DrawBucket m_DrawBuckets[static_cast<size_t>(MaterialClass::Count)]{};
+	std::vector<VulkanBuffer> m_DrawListBuffers;
+	std::vector<void*> m_DrawListMapped;
+
+	// Occlusion culling objects
+	VulkanDepthPyramid m_DepthPyramid{};
+	VulkanBuffer m_DrawCommandBuffer{};
+	std::vector<VulkanBuffer> m_CullingStatsBuffers;
+	std::vector<void*> m_CullingStatsMapped;
+	CullingStats m_CullingStats{};
+	bool m_EnableOcclusionCulling = true;
+	bool m_EnableDepthPrePass = false;
+
+	// Draw recording objects
+	RadixSorter m_DrawSorter{};
+	VulkanCommandRecorder m_CommandRecorder{};
+	std::vector<VulkanDrawPacket> m_DrawPackets;
+	std::vector<uint64_t> m_DrawPacketKeys;
+	std::vector<uint32_t> m_DrawPacketOrder;
+	VulkanBindStats m_BindStats{};
+
 	// Descriptor objects
 	VkDescriptorPool m_DescriptorPool{};
-	std::vector<VkDescriptorSet> m_DescriptorSets{MAX_FRAMES_IN_FLIGHT};
+	std::vector<VkDescriptorSet> m_DescriptorSets;
+	std::vector<VkDescriptorSet> m_CullingDescriptorSets;
 
-	std::vector<VulkanBuffer> m_UniformBuffers{MAX_FRAMES_IN_FLIGHT};
-	std::vector<void*> m_UniformBufferMapped{MAX_FRAMES_IN_FLIGHT};
+	std::vector<VulkanBuffer> m_UniformBuffers;
+	std::vector<void*> m_UniformBufferMapped;
 
 	VkDebugUtilsMessengerEXT m_DebugMessenger{};
 
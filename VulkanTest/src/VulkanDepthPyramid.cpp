@@ -0,0 +1,193 @@
+﻿#include "VulkanDepthPyramid.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "VulkanContext.h"
+#include "VulkanFunctions.h"
+#include "VulkanHostAllocator.h"
+#include "VulkanPipeline.h"
+
+namespace detail
+{
+	static constexpr VkFormat s_DepthPyramidFormat = VK_FORMAT_R32_SFLOAT;
+	static constexpr uint32_t s_DepthPyramidGroupSize = 8;
+}
+
+void VulkanDepthPyramid::create(
+	const VulkanDeviceContext& device_context,
+	VulkanSamplerCache& sampler_cache,
+	VulkanImageViewCache& image_view_cache,
+	VkExtent2D depth_extent,
+	VkImageView depth_image_view,
+	const VulkanComputePipeline& reduce_pipeline)
+{
+	// Level 0 is half the size of the depth buffer; odd rows/columns are folded into the last texel
+	m_Extent.width = std::max(1u, depth_extent.width / 2);
+	m_Extent.height = std::max(1u, depth_extent.height / 2);
+
+	m_MipLevels = 1;
+	for (uint32_t size = std::max(m_Extent.width, m_Extent.height); size > 1; size /= 2)
+	{
+		m_MipLevels++;
+	}
+
+	m_Image.create(device_context,
+	               m_Extent.width,
+	               m_Extent.height,
+	               1,
+	               VK_IMAGE_TYPE_2D,
+	               detail::s_DepthPyramidFormat,
+	               VK_IMAGE_TILING_OPTIMAL,
+	               VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+	               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+	               m_MipLevels);
+
+	m_ImageView = image_view_cache.acquire(m_Image.m_Image, detail::s_DepthPyramidFormat, m_MipLevels, 1);
+
+	m_MipImageViews.resize(m_MipLevels);
+	for (uint32_t level = 0; level < m_MipLevels; level++)
+	{
+		m_MipImageViews[level] = image_view_cache.acquire(m_Image.m_Image, detail::s_DepthPyramidFormat, 1, 1, VK_IMAGE_ASPECT_COLOR_BIT, level);
+	}
+
+	// Texels are only ever fetched directly, so use nearest filtering without any wrapping
+	VkSamplerCreateInfo samplerCreateInfo{};
+	samplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerCreateInfo.magFilter = VK_FILTER_NEAREST;
+	samplerCreateInfo.minFilter = VK_FILTER_NEAREST;
+	samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerCreateInfo.minLod = 0.f;
+	samplerCreateInfo.maxLod = static_cast<float>(m_MipLevels);
+	samplerCreateInfo.maxAnisotropy = 1.f;
+
+	m_Sampler = sampler_cache.acquire(samplerCreateInfo);
+
+	// Create a descriptor set for each level : (binding 0) source level, (binding 1) destination level
+	VkDescriptorPoolSize descriptorPoolSizes[2];
+	descriptorPoolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	descriptorPoolSizes[0].descriptorCount = m_MipLevels;
+	descriptorPoolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	descriptorPoolSizes[1].descriptorCount = m_MipLevels;
+
+	VkDescriptorPoolCreateInfo descriptorPoolCreateInfo{};
+	descriptorPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	descriptorPoolCreateInfo.poolSizeCount = static_cast<uint32_t>(std::size(descriptorPoolSizes));
+	descriptorPoolCreateInfo.pPoolSizes = descriptorPoolSizes;
+	descriptorPoolCreateInfo.maxSets = m_MipLevels;
+
+	if (VK_SUCCESS != vkCreateDescriptorPool(device_context.m_Device, &descriptorPoolCreateInfo, VulkanHostAllocator::getCallbacks(), &m_DescriptorPool))
+	{
+		throw std::runtime_error("Failed to create depth pyramid Descriptor Pool!");
+	}
+
+	std::vector<VkDescriptorSetLayout> descriptorSetLayouts(m_MipLevels, reduce_pipeline.m_DescriptorSetLayout);
+
+	VkDescriptorSetAllocateInfo descriptorSetAllocateInfo{};
+	descriptorSetAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	descriptorSetAllocateInfo.descriptorPool = m_DescriptorPool;
+	descriptorSetAllocateInfo.descriptorSetCount = m_MipLevels;
+	descriptorSetAllocateInfo.pSetLayouts = descriptorSetLayouts.data();
+
+	m_DescriptorSets.resize(m_MipLevels);
+	if (VK_SUCCESS != vkAllocateDescriptorSets(device_context.m_Device, &descriptorSetAllocateInfo, m_DescriptorSets.data()))
+	{
+		throw std::runtime_error("Failed to allocate depth pyramid Descriptor Sets!");
+	}
+
+	for (uint32_t level = 0; level < m_MipLevels; level++)
+	{
+		VkDescriptorImageInfo srcImageInfo{};
+		srcImageInfo.sampler = m_Sampler;
+		srcImageInfo.imageView = (0 == level) ? depth_image_view : m_MipImageViews[level - 1];
+		srcImageInfo.imageLayout = (0 == level) ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL;
+
+		VkDescriptorImageInfo dstImageInfo{};
+		dstImageInfo.imageView = m_MipImageViews[level];
+		dstImageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+		VkWriteDescriptorSet descriptorWrites[2]{};
+
+		descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrites[0].dstSet = m_DescriptorSets[level];
+		descriptorWrites[0].dstBinding = 0;
+		descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		descriptorWrites[0].descriptorCount = 1;
+		descriptorWrites[0].pImageInfo = &srcImageInfo;
+
+		descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrites[1].dstSet = m_DescriptorSets[level];
+		descriptorWrites[1].dstBinding = 1;
+		descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		descriptorWrites[1].descriptorCount = 1;
+		descriptorWrites[1].pImageInfo = &dstImageInfo;
+
+		vkUpdateDescriptorSets(device_context.m_Device, static_cast<uint32_t>(std::size(descriptorWrites)), descriptorWrites, 0, nullptr);
+	}
+}
+
+void VulkanDepthPyramid::destroy(VkDevice device, VulkanSamplerCache& sampler_cache, VulkanImageViewCache& image_view_cache)
+{
+	vkDestroyDescriptorPool(device, m_DescriptorPool, VulkanHostAllocator::getCallbacks());
+	sampler_cache.release(m_Sampler);
+
+	for (VkImageView imageView : m_MipImageViews)
+	{
+		image_view_cache.release(imageView);
+	}
+	m_MipImageViews.clear();
+	m_DescriptorSets.clear();
+
+	image_view_cache.release(m_ImageView);
+	m_Image.destroy(device);
+}
+
+void VulkanDepthPyramid::record(VkCommandBuffer command_buffer, const VulkanComputePipeline& reduce_pipeline) const
+{
+	vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, reduce_pipeline.m_Pipeline);
+
+	uint32_t width = m_Extent.width;
+	uint32_t height = m_Extent.height;
+
+	for (uint32_t level = 0; level < m_MipLevels; level++)
+	{
+		vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, reduce_pipeline.m_PipelineLayout, 0, 1,
+		                        &m_DescriptorSets[level], 0, nullptr);
+
+		vkCmdDispatch(command_buffer,
+		              (width + detail::s_DepthPyramidGroupSize - 1) / detail::s_DepthPyramidGroupSize,
+		              (height + detail::s_DepthPyramidGroupSize - 1) / detail::s_DepthPyramidGroupSize,
+		              1);
+
+		// The next level reads the one just written
+		VkImageMemoryBarrier imageMemoryBarrier{};
+		imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		imageMemoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+		imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+		imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		imageMemoryBarrier.image = m_Image.m_Image;
+		imageMemoryBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		imageMemoryBarrier.subresourceRange.baseMipLevel = level;
+		imageMemoryBarrier.subresourceRange.levelCount = 1;
+		imageMemoryBarrier.subresourceRange.baseArrayLayer = 0;
+		imageMemoryBarrier.subresourceRange.layerCount = 1;
+
+		vkCmdPipelineBarrier(
+			command_buffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0,
+			0, nullptr, // MemoryBarrier
+			0, nullptr, // BufferMemoryBarrier
+			1, &imageMemoryBarrier
+		);
+
+		width = std::max(1u, width / 2);
+		height = std::max(1u, height / 2);
+	}
+}
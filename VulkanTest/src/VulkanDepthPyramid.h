@@ -0,0 +1,38 @@
+﻿#pragma once
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+#include "VulkanHandleCache.h"
+#include "VulkanImage.h"
+
+struct VulkanDeviceContext;
+class VulkanComputePipeline;
+
+// Hierarchical-Z buffer : a mip chain where each texel holds the farthest depth of the texels it covers
+class VulkanDepthPyramid
+{
+public:
+	void create(
+		const VulkanDeviceContext& device_context,
+		VulkanSamplerCache& sampler_cache,
+		VulkanImageViewCache& image_view_cache,
+		VkExtent2D depth_extent,
+		VkImageView depth_image_view,
+		const VulkanComputePipeline& reduce_pipeline);
+	void destroy(VkDevice device, VulkanSamplerCache& sampler_cache, VulkanImageViewCache& image_view_cache);
+
+	// Downsample the depth buffer into every level of the pyramid
+	// (the depth buffer must be in SHADER_READ_ONLY_OPTIMAL and the pyramid in GENERAL layout)
+	void record(VkCommandBuffer command_buffer, const VulkanComputePipeline& reduce_pipeline) const;
+
+	VulkanImage m_Image{};
+	VkImageView m_ImageView{}; // view of the complete mip chain, used for culling
+	std::vector<VkImageView> m_MipImageViews;
+	VkSampler m_Sampler{};
+
+	VkExtent2D m_Extent{}; // size of level 0
+	uint32_t m_MipLevels = 0;
+
+	VkDescriptorPool m_DescriptorPool{};
+	std::vector<VkDescriptorSet> m_DescriptorSets; // one per level, reading the previous level (or the depth buffer)
+};
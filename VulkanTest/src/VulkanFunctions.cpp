@@ -2,6 +2,8 @@
 
 #include <stdexcept>
 
+#include "VulkanHostAllocator.h"
+
 #define VKTUT_VK_CREATE_DEBUG_UTILS_MESSENGER_NAME "vkCreateDebugUtilsMessengerEXT"
 #define VKTUT_VK_DESTROY_DEBUG_UTILS_MESSENGER_NAME "vkDestroyDebugUtilsMessengerEXT"
 
@@ -42,7 +44,7 @@ VkShaderModule vulkan::createShaderModule(VkDevice device, const std::vector<cha
 	createInfo.pCode = reinterpret_cast<const uint32_t*>(shader_code.data());
 
 	VkShaderModule shaderModule;
-	if (VK_SUCCESS != vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule))
+	if (VK_SUCCESS != vkCreateShaderModule(device, &createInfo, VulkanHostAllocator::getCallbacks(), &shaderModule))
 	{
 		throw std::runtime_error("Failed to create VkShaderModule!");
 	}
@@ -50,30 +52,47 @@ VkShaderModule vulkan::createShaderModule(VkDevice device, const std::vector<cha
 	return shaderModule;
 }
 
-VkImageView vulkan::createImageView(
-	VkDevice device,
+VkImageViewCreateInfo vulkan::getImageViewCreateInfo(
 	VkImage image,
 	VkFormat format,
 	uint32_t mip_level_count,
-	uint32_t array_layer_count)
+	uint32_t array_layer_count,
+	VkImageAspectFlags aspect_flags,
+	uint32_t base_mip_level,
+	VkImageViewType view_type)
 {
 	VkImageViewCreateInfo imageViewCreateInfo{};
 	imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
 	imageViewCreateInfo.image = image;
-	imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	imageViewCreateInfo.viewType = view_type;
 	imageViewCreateInfo.format = format;
 	imageViewCreateInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
 	imageViewCreateInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
 	imageViewCreateInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
 	imageViewCreateInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
-	imageViewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	imageViewCreateInfo.subresourceRange.baseMipLevel = 0;
+	imageViewCreateInfo.subresourceRange.aspectMask = aspect_flags;
+	imageViewCreateInfo.subresourceRange.baseMipLevel = base_mip_level;
 	imageViewCreateInfo.subresourceRange.levelCount = mip_level_count;
 	imageViewCreateInfo.subresourceRange.baseArrayLayer = 0;
 	imageViewCreateInfo.subresourceRange.layerCount = array_layer_count;
 
+	return imageViewCreateInfo;
+}
+
+VkImageView vulkan::createImageView(
+	VkDevice device,
+	VkImage image,
+	VkFormat format,
+	uint32_t mip_level_count,
+	uint32_t array_layer_count,
+	VkImageAspectFlags aspect_flags,
+	uint32_t base_mip_level,
+	VkImageViewType view_type)
+{
+	VkImageViewCreateInfo imageViewCreateInfo = getImageViewCreateInfo(image, format, mip_level_count, array_layer_count, aspect_flags, base_mip_level, view_type);
+
 	VkImageView imageView{};
-	if (VK_SUCCESS != vkCreateImageView(device, &imageViewCreateInfo, nullptr, &imageView))
+	if (VK_SUCCESS != vkCreateImageView(device, &imageViewCreateInfo, VulkanHostAllocator::getCallbacks(), &imageView))
 	{
 		throw std::runtime_error("Failed to create texture Image View!");
 	}
@@ -81,6 +100,31 @@ VkImageView vulkan::createImageView(
 	return imageView;
 }
 
+VkFormat vulkan::findSupportedFormat(
+	VkPhysicalDevice physical_device,
+	const std::vector<VkFormat>& candidates,
+	VkImageTiling tiling,
+	VkFormatFeatureFlags features)
+{
+	// Candidates are ordered by preference, so pick the first one that supports all the requested features
+	for (VkFormat format : candidates)
+	{
+		VkFormatProperties formatProperties{};
+		vkGetPhysicalDeviceFormatProperties(physical_device, format, &formatProperties);
+
+		VkFormatFeatureFlags supportedFeatures = (VK_IMAGE_TILING_LINEAR == tiling)
+			? formatProperties.linearTilingFeatures
+			: formatProperties.optimalTilingFeatures;
+
+		if ((supportedFeatures & features) == features)
+		{
+			return format;
+		}
+	}
+
+	throw std::runtime_error("Failed to find supported Format!");
+}
+
 uint32_t vulkan::findMemoryType(VkPhysicalDevice physical_device, uint32_t type_filter, VkMemoryPropertyFlags properties)
 {
 	VkPhysicalDeviceMemoryProperties memoryProperties{};
@@ -163,6 +207,15 @@ void vulkan::findImageLayoutTransitionAccessMasksAndStages(
 		src_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
 		dst_stage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
 	}
+	else if (old_layout == VK_IMAGE_LAYOUT_UNDEFINED && new_layout == VK_IMAGE_LAYOUT_GENERAL)
+	{
+		// Undefined -> General : storage images written and read by compute shaders
+		src_access_mask = 0;
+		dst_access_mask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+		src_stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+		dst_stage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+	}
 	else
 	{
 		throw std::runtime_error("Unsupported layout transition!");
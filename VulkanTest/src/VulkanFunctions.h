@@ -22,12 +22,32 @@ namespace vulkan
 		const std::vector<char> shader_code
 	);
 
+	VkImageViewCreateInfo getImageViewCreateInfo(
+		VkImage image,
+		VkFormat format,
+		uint32_t mip_level_count,
+		uint32_t array_layer_count,
+		VkImageAspectFlags aspect_flags = VK_IMAGE_ASPECT_COLOR_BIT,
+		uint32_t base_mip_level = 0,
+		VkImageViewType view_type = VK_IMAGE_VIEW_TYPE_2D
+	);
+
 	VkImageView createImageView(
 		VkDevice device,
 		VkImage image,
 		VkFormat format,
 		uint32_t mip_level_count,
-		uint32_t array_layer_count
+		uint32_t array_layer_count,
+		VkImageAspectFlags aspect_flags = VK_IMAGE_ASPECT_COLOR_BIT,
+		uint32_t base_mip_level = 0,
+		VkImageViewType view_type = VK_IMAGE_VIEW_TYPE_2D
+	);
+
+	VkFormat findSupportedFormat(
+		VkPhysicalDevice physical_device,
+		const std::vector<VkFormat>& candidates,
+		VkImageTiling tiling,
+		VkFormatFeatureFlags features
 	);
 
 	uint32_t findMemoryType(
@@ -0,0 +1,221 @@
+﻿#include "VulkanGeometryPool.h"
+
+#include <cstring>
+#include <stdexcept>
+
+#include "MeshImporter.h"
+#include "VulkanContext.h"
+#include "VulkanFunctions.h"
+#include "VulkanMemoryTelemetry.h"
+
+namespace detail
+{
+	static VkDeviceSize getIndexAllocationSize(uint32_t index_count, VkIndexType index_type)
+	{
+		VkDeviceSize size = index_count * MeshImporter::getIndexSize(index_type);
+		return (size + 3) & ~VkDeviceSize(3);
+	}
+}
+
+void VulkanGeometryPool::create(
+	const VulkanDeviceContext& device_context,
+	VkCommandPool command_pool,
+	VkDeviceSize vertex_stride,
+	uint32_t vertex_capacity,
+	VkDeviceSize index_buffer_size)
+{
+	m_DeviceContext = &device_context;
+	m_CommandPool = command_pool;
+	m_VertexStride = vertex_stride;
+
+	m_VertexAllocator.init(vertex_capacity);
+	m_IndexAllocator.init(index_buffer_size);
+
+	createBuffers(m_VertexBuffer, m_IndexBuffer);
+
+	VulkanMemoryTelemetry::registerBlock(&m_VertexAllocator, [this]()
+	{
+		return VulkanMemoryTelemetry::getBlockStats("Geometry pool vertices", m_VertexAllocator, m_VertexStride);
+	});
+	VulkanMemoryTelemetry::registerBlock(&m_IndexAllocator, [this]()
+	{
+		return VulkanMemoryTelemetry::getBlockStats("Geometry pool indices", m_IndexAllocator);
+	});
+}
+
+void VulkanGeometryPool::destroy(VkDevice device)
+{
+	VulkanMemoryTelemetry::unregisterBlock(&m_VertexAllocator);
+	VulkanMemoryTelemetry::unregisterBlock(&m_IndexAllocator);
+
+	m_IndexBuffer.destroy(device);
+	m_VertexBuffer.destroy(device);
+
+	m_Meshes.clear();
+	m_MeshAllocated.clear();
+}
+
+uint32_t VulkanGeometryPool::addMesh(const void* vertices, uint32_t vertex_count, const void* indices, uint32_t index_count, VkIndexType index_type)
+{
+	VulkanMeshRange range{};
+	if (!allocate(vertex_count, index_count, index_type, range))
+	{
+		// Compact the pool if the free space is only fragmented
+		if (m_VertexAllocator.getFreeSize() < vertex_count ||
+			m_IndexAllocator.getFreeSize() < detail::getIndexAllocationSize(index_count, index_type))
+		{
+			throw std::runtime_error("Geometry pool is out of memory!");
+		}
+
+		defragment();
+		if (!allocate(vertex_count, index_count, index_type, range))
+		{
+			throw std::runtime_error("Failed to allocate mesh from geometry pool!");
+		}
+	}
+
+	// Upload both ranges through a single staging buffer
+	VkDeviceSize verticesSize = vertex_count * m_VertexStride;
+	VkDeviceSize indexSize = MeshImporter::getIndexSize(index_type);
+	VkDeviceSize indicesSize = index_count * indexSize;
+
+	VulkanBuffer stagingBuffer;
+	stagingBuffer.create(*m_DeviceContext,
+	                     verticesSize + indicesSize,
+	                     VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+	                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+	void* data;
+	vkMapMemory(m_DeviceContext->m_Device, stagingBuffer.m_Memory, 0, verticesSize + indicesSize, 0, &data);
+	std::memcpy(data, vertices, verticesSize);
+	std::memcpy(static_cast<char*>(data) + verticesSize, indices, indicesSize);
+	vkUnmapMemory(m_DeviceContext->m_Device, stagingBuffer.m_Memory);
+
+	VkCommandBuffer commandBuffer = vulkan::beginOneShotCommands(m_DeviceContext->m_Device, m_CommandPool);
+
+	VkBufferCopy vertexCopyRegion{};
+	vertexCopyRegion.srcOffset = 0;
+	vertexCopyRegion.dstOffset = range.vertexOffset * m_VertexStride;
+	vertexCopyRegion.size = verticesSize;
+	vkCmdCopyBuffer(commandBuffer, stagingBuffer.m_Buffer, m_VertexBuffer.m_Buffer, 1, &vertexCopyRegion);
+
+	VkBufferCopy indexCopyRegion{};
+	indexCopyRegion.srcOffset = verticesSize;
+	indexCopyRegion.dstOffset = range.firstIndex * indexSize;
+	indexCopyRegion.size = indicesSize;
+	vkCmdCopyBuffer(commandBuffer, stagingBuffer.m_Buffer, m_IndexBuffer.m_Buffer, 1, &indexCopyRegion);
+
+	vulkan::endOneShotCommands(m_DeviceContext->m_Device, commandBuffer, m_CommandPool, m_DeviceContext->m_GraphicsQueue);
+
+	stagingBuffer.destroy(m_DeviceContext->m_Device);
+
+	// Reuse the slot of a removed mesh if there is one
+	for (uint32_t mesh = 0; mesh < m_Meshes.size(); mesh++)
+	{
+		if (!m_MeshAllocated[mesh])
+		{
+			m_Meshes[mesh] = range;
+			m_MeshAllocated[mesh] = true;
+			return mesh;
+		}
+	}
+
+	m_Meshes.push_back(range);
+	m_MeshAllocated.push_back(true);
+	return static_cast<uint32_t>(m_Meshes.size() - 1);
+}
+
+void VulkanGeometryPool::removeMesh(uint32_t mesh)
+{
+	if (mesh >= m_Meshes.size() || !m_MeshAllocated[mesh])
+		return;
+
+	const VulkanMeshRange& range = m_Meshes[mesh];
+	m_VertexAllocator.free(range.vertexOffset, range.vertexCount);
+	m_IndexAllocator.free(range.firstIndex * MeshImporter::getIndexSize(range.indexType),
+	                      detail::getIndexAllocationSize(range.indexCount, range.indexType));
+
+	m_Meshes[mesh] = {};
+	m_MeshAllocated[mesh] = false;
+}
+
+void VulkanGeometryPool::defragment()
+{
+	// The old buffers may still be read by frames in flight
+	vkDeviceWaitIdle(m_DeviceContext->m_Device);
+
+	VulkanBuffer vertexBuffer{}, indexBuffer{};
+	createBuffers(vertexBuffer, indexBuffer);
+
+	// Pack the live meshes in order
+	std::vector<VkBufferCopy> vertexCopyRegions, indexCopyRegions;
+	uint32_t vertexOffset = 0;
+	VkDeviceSize indexOffset = 0; // in bytes
+	for (uint32_t mesh = 0; mesh < m_Meshes.size(); mesh++)
+	{
+		if (!m_MeshAllocated[mesh])
+			continue;
+
+		VulkanMeshRange& range = m_Meshes[mesh];
+		VkDeviceSize indexSize = MeshImporter::getIndexSize(range.indexType);
+		vertexCopyRegions.push_back({ range.vertexOffset * m_VertexStride, vertexOffset * m_VertexStride, range.vertexCount * m_VertexStride });
+		indexCopyRegions.push_back({ range.firstIndex * indexSize, indexOffset, range.indexCount * indexSize });
+
+		range.vertexOffset = vertexOffset;
+		range.firstIndex = static_cast<uint32_t>(indexOffset / indexSize);
+		vertexOffset += range.vertexCount;
+		indexOffset += detail::getIndexAllocationSize(range.indexCount, range.indexType);
+	}
+
+	if (!vertexCopyRegions.empty())
+	{
+		VkCommandBuffer commandBuffer = vulkan::beginOneShotCommands(m_DeviceContext->m_Device, m_CommandPool);
+		vkCmdCopyBuffer(commandBuffer, m_VertexBuffer.m_Buffer, vertexBuffer.m_Buffer, static_cast<uint32_t>(vertexCopyRegions.size()), vertexCopyRegions.data());
+		vkCmdCopyBuffer(commandBuffer, m_IndexBuffer.m_Buffer, indexBuffer.m_Buffer, static_cast<uint32_t>(indexCopyRegions.size()), indexCopyRegions.data());
+		vulkan::endOneShotCommands(m_DeviceContext->m_Device, commandBuffer, m_CommandPool, m_DeviceContext->m_GraphicsQueue);
+	}
+
+	m_VertexBuffer.destroy(m_DeviceContext->m_Device);
+	m_IndexBuffer.destroy(m_DeviceContext->m_Device);
+	m_VertexBuffer = vertexBuffer;
+	m_IndexBuffer = indexBuffer;
+
+	m_VertexAllocator.reset(vertexOffset);
+	m_IndexAllocator.reset(indexOffset);
+	m_DefragmentationCount++;
+}
+
+bool VulkanGeometryPool::allocate(uint32_t vertex_count, uint32_t index_count, VkIndexType index_type, VulkanMeshRange& range)
+{
+	std::optional<uint64_t> vertexOffset = m_VertexAllocator.allocate(vertex_count);
+	if (!vertexOffset.has_value())
+		return false;
+
+	std::optional<uint64_t> indexOffset = m_IndexAllocator.allocate(detail::getIndexAllocationSize(index_count, index_type));
+	if (!indexOffset.has_value())
+	{
+		m_VertexAllocator.free(vertexOffset.value(), vertex_count);
+		return false;
+	}
+
+	range.vertexOffset = static_cast<uint32_t>(vertexOffset.value());
+	range.vertexCount = vertex_count;
+	range.firstIndex = static_cast<uint32_t>(indexOffset.value() / MeshImporter::getIndexSize(index_type));
+	range.indexCount = index_count;
+	range.indexType = index_type;
+	return true;
+}
+
+void VulkanGeometryPool::createBuffers(VulkanBuffer& vertex_buffer, VulkanBuffer& index_buffer) const
+{
+	// (transfer source for the copies made when defragmenting)
+	vertex_buffer.create(*m_DeviceContext,
+	                     m_VertexAllocator.getCapacity() * m_VertexStride,
+	                     VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+	                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	index_buffer.create(*m_DeviceContext,
+	                    m_IndexAllocator.getCapacity(),
+	                    VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+	                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+}
@@ -0,0 +1,65 @@
+﻿#pragma once
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+#include "FreeListAllocator.h"
+#include "VulkanBuffer.h"
+
+struct VulkanDeviceContext;
+
+// Location of a mesh inside the geometry pool (in vertices and indices, as consumed by indexed draws)
+struct VulkanMeshRange
+{
+	uint32_t vertexOffset;
+	uint32_t vertexCount;
+	uint32_t firstIndex; // in units of the index type
+	uint32_t indexCount;
+	VkIndexType indexType;
+};
+
+/**
+ * One device-local vertex buffer and one index buffer shared by every mesh.
+ * Meshes are sub-allocated from both with a free-list allocator, so a single bind of each buffer covers all the draws
+ * (16-bit and 32-bit indices share the index buffer, only the index type of the bind changes between them).
+ * When an allocation does not fit because of fragmentation, the pool is compacted and the allocation retried
+ * (the ranges of the meshes may change, callers must query them again with getMesh()).
+ */
+class VulkanGeometryPool
+{
+public:
+	void create(
+		const VulkanDeviceContext& device_context,
+		VkCommandPool command_pool,
+		VkDeviceSize vertex_stride,
+		uint32_t vertex_capacity,
+		VkDeviceSize index_buffer_size);
+	void destroy(VkDevice device);
+
+	uint32_t addMesh(const void* vertices, uint32_t vertex_count, const void* indices, uint32_t index_count, VkIndexType index_type);
+	void removeMesh(uint32_t mesh);
+
+	// Move every mesh to the start of the buffers (waits for the device to be idle)
+	void defragment();
+
+	const VulkanMeshRange& getMesh(uint32_t mesh) const { return m_Meshes[mesh]; }
+	uint32_t getDefragmentationCount() const { return m_DefragmentationCount; }
+
+	VulkanBuffer m_VertexBuffer{};
+	VulkanBuffer m_IndexBuffer{};
+
+private:
+	bool allocate(uint32_t vertex_count, uint32_t index_count, VkIndexType index_type, VulkanMeshRange& range);
+	void createBuffers(VulkanBuffer& vertex_buffer, VulkanBuffer& index_buffer) const;
+
+	const VulkanDeviceContext* m_DeviceContext = nullptr;
+	VkCommandPool m_CommandPool{};
+
+	VkDeviceSize m_VertexStride = 0;
+
+	FreeListAllocator m_VertexAllocator{}; // in vertices
+	FreeListAllocator m_IndexAllocator{}; // in bytes, every allocation is a multiple of 4 bytes to keep 32-bit indices aligned
+
+	std::vector<VulkanMeshRange> m_Meshes;
+	std::vector<bool> m_MeshAllocated;
+	uint32_t m_DefragmentationCount = 0;
+};
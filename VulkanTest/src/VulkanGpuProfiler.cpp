@@ -0,0 +1,143 @@
+﻿#include "VulkanGpuProfiler.h"
+
+#include <cstdio>
+#include <stdexcept>
+
+#include "Profiler.h"
+#include "VulkanContext.h"
+#include "VulkanFunctions.h"
+#include "VulkanHostAllocator.h"
+
+void VulkanGpuProfiler::create(const VulkanDeviceContext& device_context, VkCommandPool command_pool, uint32_t frames_in_flight)
+{
+	m_Frames.assign(frames_in_flight, {});
+	m_Results.clear();
+
+	uint32_t queueFamilyCount{};
+	vkGetPhysicalDeviceQueueFamilyProperties(device_context.m_PhysicalDevice, &queueFamilyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(device_context.m_PhysicalDevice, &queueFamilyCount, queueFamilies.data());
+
+	uint32_t validBits = queueFamilies[device_context.m_QueueFamilyIndices.graphicsFamily.value()].timestampValidBits;
+	if (0 == validBits)
+	{
+		printf("[WARN] Graphics queue does not support timestamps, GPU times are unavailable!\n");
+		return;
+	}
+	m_TimestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+	m_TimestampPeriod = device_context.m_PhysicalDeviceProperties.limits.timestampPeriod;
+
+	// A begin and an end timestamp per scope, for each frame in flight
+	VkQueryPoolCreateInfo queryPoolCreateInfo{};
+	queryPoolCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	queryPoolCreateInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	queryPoolCreateInfo.queryCount = 2 * MAX_SCOPES * frames_in_flight;
+
+	if (VK_SUCCESS != vkCreateQueryPool(device_context.m_Device, &queryPoolCreateInfo, VulkanHostAllocator::getCallbacks(), &m_QueryPool))
+	{
+		throw std::runtime_error("Failed to create timestamp Query Pool!");
+	}
+	m_QueryResults.resize(2 * 2 * MAX_SCOPES);
+
+	// Write a timestamp and wait for it : it was taken about halfway through the wait
+	VkCommandBuffer commandBuffer = vulkan::beginOneShotCommands(device_context.m_Device, command_pool);
+	vkCmdResetQueryPool(commandBuffer, m_QueryPool, 0, 1);
+	vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_QueryPool, 0);
+	uint64_t submitTime = Profiler::getSteadyTime();
+	vulkan::endOneShotCommands(device_context.m_Device, commandBuffer, command_pool, device_context.m_GraphicsQueue);
+	uint64_t completionTime = Profiler::getSteadyTime();
+
+	if (VK_SUCCESS != vkGetQueryPoolResults(device_context.m_Device, m_QueryPool, 0, 1, sizeof(uint64_t), &m_CalibrationTimestamp,
+	                                        sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT))
+	{
+		throw std::runtime_error("Failed to read the calibration timestamp!");
+	}
+	m_CalibrationTime = submitTime + (completionTime - submitTime) / 2;
+}
+
+void VulkanGpuProfiler::destroy(VkDevice device)
+{
+	if (VK_NULL_HANDLE != m_QueryPool)
+	{
+		vkDestroyQueryPool(device, m_QueryPool, VulkanHostAllocator::getCallbacks());
+		m_QueryPool = VK_NULL_HANDLE;
+	}
+	m_Frames.clear();
+	m_Results.clear();
+}
+
+void VulkanGpuProfiler::collect(VkDevice device, uint32_t frame)
+{
+	FrameScopes& frameScopes = m_Frames[frame];
+	if (!frameScopes.recorded)
+		return;
+	frameScopes.recorded = false;
+
+	// (VK_NOT_READY only means that some of the queries are unavailable, their availability is checked below)
+	uint32_t queryCount = 2 * static_cast<uint32_t>(frameScopes.scopes.size());
+	VkResult result = vkGetQueryPoolResults(device, m_QueryPool, 2 * MAX_SCOPES * frame, queryCount,
+	                                        queryCount * 2 * sizeof(uint64_t), m_QueryResults.data(), 2 * sizeof(uint64_t),
+	                                        VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+	if (VK_SUCCESS != result && VK_NOT_READY != result)
+		return;
+
+	m_Results.resize(frameScopes.scopes.size());
+	for (size_t i = 0; i < frameScopes.scopes.size(); i++)
+	{
+		const uint64_t* begin = &m_QueryResults[4 * i];
+		const uint64_t* end = &m_QueryResults[4 * i + 2];
+
+		VulkanGpuScopeTiming& timing = m_Results[i];
+		timing.name = frameScopes.scopes[i].name;
+		timing.depth = frameScopes.scopes[i].depth;
+		timing.milliseconds = -1.0;
+		if (0 != begin[1] && 0 != end[1])
+		{
+			// (the masked difference stays correct when the counter wraps around)
+			timing.milliseconds = static_cast<double>((end[0] - begin[0]) & m_TimestampMask) * m_TimestampPeriod * 1e-6;
+
+#ifdef VKTUT_ENABLE_PROFILER
+			double beginTime = static_cast<double>((begin[0] - m_CalibrationTimestamp) & m_TimestampMask) * m_TimestampPeriod;
+			uint64_t beginNanoseconds = m_CalibrationTime + static_cast<uint64_t>(beginTime);
+			Profiler::recordGpu(timing.name, beginNanoseconds, beginNanoseconds + static_cast<uint64_t>(timing.milliseconds * 1e6));
+#endif
+		}
+	}
+}
+
+void VulkanGpuProfiler::beginFrame(VkCommandBuffer command_buffer, uint32_t frame)
+{
+	m_CommandBuffer = command_buffer;
+	m_Frame = frame;
+	m_Depth = 0;
+	m_Frames[frame].scopes.clear();
+	m_Frames[frame].recorded = false;
+
+	if (VK_NULL_HANDLE != m_QueryPool)
+	{
+		vkCmdResetQueryPool(command_buffer, m_QueryPool, 2 * MAX_SCOPES * frame, 2 * MAX_SCOPES);
+	}
+}
+
+uint32_t VulkanGpuProfiler::beginScope(const char* name)
+{
+	FrameScopes& frameScopes = m_Frames[m_Frame];
+	if (VK_NULL_HANDLE == m_QueryPool || frameScopes.scopes.size() >= MAX_SCOPES)
+		return INVALID_SCOPE;
+
+	uint32_t scope = static_cast<uint32_t>(frameScopes.scopes.size());
+	frameScopes.scopes.push_back({ name, m_Depth++ });
+	frameScopes.recorded = true;
+
+	vkCmdWriteTimestamp(m_CommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_QueryPool, 2 * (MAX_SCOPES * m_Frame + scope));
+	return scope;
+}
+
+void VulkanGpuProfiler::endScope(uint32_t scope)
+{
+	if (INVALID_SCOPE == scope)
+		return;
+
+	m_Depth--;
+	vkCmdWriteTimestamp(m_CommandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_QueryPool, 2 * (MAX_SCOPES * m_Frame + scope) + 1);
+}
@@ -0,0 +1,89 @@
+﻿#pragma once
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+struct VulkanDeviceContext;
+
+// GPU duration of a profiled scope (negative : the timestamps were not available yet)
+struct VulkanGpuScopeTiming
+{
+	const char* name;
+	uint32_t depth; // nesting level, 0 for the outermost scopes
+	double milliseconds;
+};
+
+/**
+ * Timestamps around scopes of the command buffers (passes, draw groups), from a query pool ringed per frame in flight.
+ * A frame's timestamps are read back when its slot comes around again, after the slot's fence was waited on,
+ * and never with VK_QUERY_RESULT_WAIT_BIT : the scopes that are not available yet are reported as such instead of stalling.
+ * Without timestamp support on the graphics queue, the profiler records nothing and reports no scope.
+ */
+class VulkanGpuProfiler
+{
+public:
+	static constexpr uint32_t MAX_SCOPES = 32; // per frame, the extra scopes are not profiled
+	static constexpr uint32_t INVALID_SCOPE = UINT32_MAX; // scope that is not profiled (ending it does nothing)
+
+	// (the command pool is used once, to relate the GPU timestamps to the CPU clock)
+	void create(const VulkanDeviceContext& device_context, VkCommandPool command_pool, uint32_t frames_in_flight);
+	void destroy(VkDevice device);
+
+	bool isSupported() const { return VK_NULL_HANDLE != m_QueryPool; }
+
+	// Reads the timestamps of the last frame recorded in the slot (its fence must be signalled)
+	// (with VKTUT_ENABLE_PROFILER, the scopes are also added to the GPU track of the CPU profiler)
+	void collect(VkDevice device, uint32_t frame);
+
+	// Scopes are recorded between beginFrame and the end of the command buffer, in the order they begin
+	void beginFrame(VkCommandBuffer command_buffer, uint32_t frame);
+	uint32_t beginScope(const char* name);
+	void endScope(uint32_t scope);
+
+	// Scopes of the last collected frame, in the order they began
+	const std::vector<VulkanGpuScopeTiming>& getResults() const { return m_Results; }
+
+private:
+	struct Scope
+	{
+		const char* name;
+		uint32_t depth;
+	};
+
+	struct FrameScopes
+	{
+		std::vector<Scope> scopes;
+		bool recorded = false;
+	};
+
+	VkQueryPool m_QueryPool{};
+	double m_TimestampPeriod = 0.0; // nanoseconds per tick
+	uint64_t m_TimestampMask = 0;   // bits of the timestamps that are valid
+
+	// A GPU timestamp and the steady clock time it was taken at
+	// (measured once, the clocks may drift apart over long runs)
+	uint64_t m_CalibrationTimestamp = 0;
+	uint64_t m_CalibrationTime = 0;
+
+	std::vector<FrameScopes> m_Frames;
+	VkCommandBuffer m_CommandBuffer{};
+	uint32_t m_Frame = 0;
+	uint32_t m_Depth = 0;
+
+	std::vector<uint64_t> m_QueryResults; // (value, availability) pairs
+	std::vector<VulkanGpuScopeTiming> m_Results;
+};
+
+// Profiles the commands recorded during its lifetime
+class VulkanGpuProfileScope
+{
+public:
+	VulkanGpuProfileScope(VulkanGpuProfiler& profiler, const char* name) : m_Profiler(profiler), m_Scope(profiler.beginScope(name)) {}
+	~VulkanGpuProfileScope() { m_Profiler.endScope(m_Scope); }
+
+	VulkanGpuProfileScope(const VulkanGpuProfileScope&) = delete;
+	VulkanGpuProfileScope& operator=(const VulkanGpuProfileScope&) = delete;
+
+private:
+	VulkanGpuProfiler& m_Profiler;
+	uint32_t m_Scope;
+};
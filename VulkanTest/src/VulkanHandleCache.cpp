@@ -0,0 +1,223 @@
+﻿#include "VulkanHandleCache.h"
+
+#include <cstring>
+#include <stdexcept>
+
+#include "Hash.h"
+#include "VulkanContext.h"
+#include "VulkanFunctions.h"
+#include "VulkanHostAllocator.h"
+
+namespace detail
+{
+	// Hash of the words of a key
+	template <size_t N>
+	static size_t hashKey(const std::array<uint32_t, N>& key)
+	{
+		return static_cast<size_t>(hashBytes(key.data(), N * sizeof(uint32_t)));
+	}
+
+	static uint32_t floatBits(float value)
+	{
+		uint32_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		return bits;
+	}
+}
+
+void VulkanSamplerCache::create(const VulkanDeviceContext& device_context)
+{
+	m_Device = device_context.m_Device;
+	m_MaxSamplerCount = device_context.m_PhysicalDeviceProperties.limits.maxSamplerAllocationCount;
+	m_Stats = {};
+}
+
+void VulkanSamplerCache::destroy(VkDevice device)
+{
+	for (const auto& entry : m_Entries)
+	{
+		vkDestroySampler(device, entry.second.sampler, VulkanHostAllocator::getCallbacks());
+	}
+	m_Entries.clear();
+	m_Keys.clear();
+	m_Stats.live = 0;
+}
+
+VkSampler VulkanSamplerCache::acquire(const VkSamplerCreateInfo& create_info)
+{
+	if (nullptr != create_info.pNext)
+	{
+		throw std::runtime_error("Failed to create Sampler: extension structures are not cached!");
+	}
+
+	Key key = makeKey(create_info);
+	auto found = m_Entries.find(key);
+	if (m_Entries.end() != found)
+	{
+		found->second.references++;
+		m_Stats.shared++;
+		return found->second.sampler;
+	}
+
+	if (m_Stats.live >= m_MaxSamplerCount)
+	{
+		throw std::runtime_error("Failed to create Sampler: maxSamplerAllocationCount reached!");
+	}
+
+	VkSampler sampler{};
+	if (VK_SUCCESS != vkCreateSampler(m_Device, &create_info, VulkanHostAllocator::getCallbacks(), &sampler))
+	{
+		throw std::runtime_error("Failed to create Sampler!");
+	}
+
+	m_Entries.emplace(key, Entry{ sampler, 1 });
+	m_Keys.emplace(sampler, key);
+	m_Stats.created++;
+	m_Stats.live++;
+	return sampler;
+}
+
+void VulkanSamplerCache::release(VkSampler sampler)
+{
+	auto foundKey = m_Keys.find(sampler);
+	if (m_Keys.end() == foundKey)
+		return; // (VK_NULL_HANDLE or already destroyed)
+
+	auto found = m_Entries.find(foundKey->second);
+	if (0 != --found->second.references)
+		return;
+
+	vkDestroySampler(m_Device, sampler, VulkanHostAllocator::getCallbacks());
+	m_Entries.erase(found);
+	m_Keys.erase(foundKey);
+	m_Stats.destroyed++;
+	m_Stats.live--;
+}
+
+size_t VulkanSamplerCache::KeyHash::operator()(const Key& key) const
+{
+	return detail::hashKey(key);
+}
+
+VulkanSamplerCache::Key VulkanSamplerCache::makeKey(const VkSamplerCreateInfo& create_info)
+{
+	return Key{
+		static_cast<uint32_t>(create_info.flags),
+		static_cast<uint32_t>(create_info.magFilter),
+		static_cast<uint32_t>(create_info.minFilter),
+		static_cast<uint32_t>(create_info.mipmapMode),
+		static_cast<uint32_t>(create_info.addressModeU),
+		static_cast<uint32_t>(create_info.addressModeV),
+		static_cast<uint32_t>(create_info.addressModeW),
+		detail::floatBits(create_info.mipLodBias),
+		static_cast<uint32_t>(create_info.anisotropyEnable),
+		detail::floatBits(create_info.maxAnisotropy),
+		static_cast<uint32_t>(create_info.compareEnable),
+		static_cast<uint32_t>(create_info.compareOp),
+		detail::floatBits(create_info.minLod),
+		detail::floatBits(create_info.maxLod),
+		static_cast<uint32_t>(create_info.borderColor),
+		static_cast<uint32_t>(create_info.unnormalizedCoordinates)
+	};
+}
+
+void VulkanImageViewCache::create(const VulkanDeviceContext& device_context)
+{
+	m_Device = device_context.m_Device;
+	m_Stats = {};
+}
+
+void VulkanImageViewCache::destroy(VkDevice device)
+{
+	for (const auto& entry : m_Entries)
+	{
+		vkDestroyImageView(device, entry.second.imageView, VulkanHostAllocator::getCallbacks());
+	}
+	m_Entries.clear();
+	m_Keys.clear();
+	m_Stats.live = 0;
+}
+
+VkImageView VulkanImageViewCache::acquire(const VkImageViewCreateInfo& create_info)
+{
+	if (nullptr != create_info.pNext)
+	{
+		throw std::runtime_error("Failed to create Image View: extension structures are not cached!");
+	}
+
+	Key key = makeKey(create_info);
+	auto found = m_Entries.find(key);
+	if (m_Entries.end() != found)
+	{
+		found->second.references++;
+		m_Stats.shared++;
+		return found->second.imageView;
+	}
+
+	VkImageView imageView{};
+	if (VK_SUCCESS != vkCreateImageView(m_Device, &create_info, VulkanHostAllocator::getCallbacks(), &imageView))
+	{
+		throw std::runtime_error("Failed to create Image View!");
+	}
+
+	m_Entries.emplace(key, Entry{ imageView, 1 });
+	m_Keys.emplace(imageView, key);
+	m_Stats.created++;
+	m_Stats.live++;
+	return imageView;
+}
+
+VkImageView VulkanImageViewCache::acquire(
+	VkImage image,
+	VkFormat format,
+	uint32_t mip_level_count,
+	uint32_t array_layer_count,
+	VkImageAspectFlags aspect_flags,
+	uint32_t base_mip_level,
+	VkImageViewType view_type)
+{
+	return acquire(vulkan::getImageViewCreateInfo(image, format, mip_level_count, array_layer_count, aspect_flags, base_mip_level, view_type));
+}
+
+void VulkanImageViewCache::release(VkImageView image_view)
+{
+	auto foundKey = m_Keys.find(image_view);
+	if (m_Keys.end() == foundKey)
+		return; // (VK_NULL_HANDLE or already destroyed)
+
+	auto found = m_Entries.find(foundKey->second);
+	if (0 != --found->second.references)
+		return;
+
+	vkDestroyImageView(m_Device, image_view, VulkanHostAllocator::getCallbacks());
+	m_Entries.erase(found);
+	m_Keys.erase(foundKey);
+	m_Stats.destroyed++;
+	m_Stats.live--;
+}
+
+size_t VulkanImageViewCache::KeyHash::operator()(const Key& key) const
+{
+	return detail::hashKey(key);
+}
+
+VulkanImageViewCache::Key VulkanImageViewCache::makeKey(const VkImageViewCreateInfo& create_info)
+{
+	uint64_t image = reinterpret_cast<uint64_t>(create_info.image);
+	return Key{
+		static_cast<uint32_t>(image),
+		static_cast<uint32_t>(image >> 32),
+		static_cast<uint32_t>(create_info.flags),
+		static_cast<uint32_t>(create_info.viewType),
+		static_cast<uint32_t>(create_info.format),
+		static_cast<uint32_t>(create_info.components.r),
+		static_cast<uint32_t>(create_info.components.g),
+		static_cast<uint32_t>(create_info.components.b),
+		static_cast<uint32_t>(create_info.components.a),
+		static_cast<uint32_t>(create_info.subresourceRange.aspectMask),
+		create_info.subresourceRange.baseMipLevel,
+		create_info.subresourceRange.levelCount,
+		create_info.subresourceRange.baseArrayLayer,
+		create_info.subresourceRange.layerCount
+	};
+}
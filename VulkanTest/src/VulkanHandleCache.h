@@ -0,0 +1,106 @@
+﻿#pragma once
+#include <array>
+#include <cstdint>
+#include <unordered_map>
+#include <vulkan/vulkan_core.h>
+
+struct VulkanDeviceContext;
+
+struct VulkanHandleCacheStats
+{
+	uint32_t created = 0; // handles created since the cache was created
+	uint32_t shared = 0; // requests served with an existing handle
+	uint32_t destroyed = 0;
+	uint32_t live = 0;
+};
+
+/**
+ * Samplers shared by every identical request, keyed by the fields of their create info.
+ * Handles are reference counted : each acquire() must be matched by a release(), the sampler is destroyed with
+ * its last reference. Drivers cap the number of live samplers (maxSamplerAllocationCount), requests past it throw.
+ * (pNext chains are not part of the key, they must be null)
+ */
+class VulkanSamplerCache
+{
+public:
+	void create(const VulkanDeviceContext& device_context);
+	// Destroys the samplers still referenced
+	void destroy(VkDevice device);
+
+	VkSampler acquire(const VkSamplerCreateInfo& create_info);
+	void release(VkSampler sampler);
+
+	const VulkanHandleCacheStats& getStats() const { return m_Stats; }
+
+private:
+	using Key = std::array<uint32_t, 16>;
+
+	struct KeyHash
+	{
+		size_t operator()(const Key& key) const;
+	};
+
+	struct Entry
+	{
+		VkSampler sampler;
+		uint32_t references;
+	};
+
+	static Key makeKey(const VkSamplerCreateInfo& create_info);
+
+	VkDevice m_Device{};
+	uint32_t m_MaxSamplerCount = 0;
+
+	std::unordered_map<Key, Entry, KeyHash> m_Entries;
+	std::unordered_map<VkSampler, Key> m_Keys;
+	VulkanHandleCacheStats m_Stats{};
+};
+
+/**
+ * Image views shared by every identical request, keyed by the image and the fields of their create info.
+ * Handles are reference counted like the samplers; every view of an image must be released before the image is
+ * destroyed (a new image may reuse the handle).
+ */
+class VulkanImageViewCache
+{
+public:
+	void create(const VulkanDeviceContext& device_context);
+	// Destroys the views still referenced
+	void destroy(VkDevice device);
+
+	VkImageView acquire(const VkImageViewCreateInfo& create_info);
+	// Same parameters as vulkan::createImageView()
+	VkImageView acquire(
+		VkImage image,
+		VkFormat format,
+		uint32_t mip_level_count,
+		uint32_t array_layer_count,
+		VkImageAspectFlags aspect_flags = VK_IMAGE_ASPECT_COLOR_BIT,
+		uint32_t base_mip_level = 0,
+		VkImageViewType view_type = VK_IMAGE_VIEW_TYPE_2D);
+	void release(VkImageView image_view);
+
+	const VulkanHandleCacheStats& getStats() const { return m_Stats; }
+
+private:
+	using Key = std::array<uint32_t, 14>;
+
+	struct KeyHash
+	{
+		size_t operator()(const Key& key) const;
+	};
+
+	struct Entry
+	{
+		VkImageView imageView;
+		uint32_t references;
+	};
+
+	static Key makeKey(const VkImageViewCreateInfo& create_info);
+
+	VkDevice m_Device{};
+
+	std::unordered_map<Key, Entry, KeyHash> m_Entries;
+	std::unordered_map<VkImageView, Key> m_Keys;
+	VulkanHandleCacheStats m_Stats{};
+};
@@ -0,0 +1,450 @@
+﻿#include "VulkanHostAllocator.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+namespace detail
+{
+	enum class HostBlockKind : uint8_t
+	{
+		Heap = 0,
+		Pool,
+		Arena,
+	};
+
+	struct HostArena;
+	struct HostPoolChunk;
+
+	// Precedes every allocation (keeps the 16-byte alignment of what follows)
+	struct HostBlockHeader
+	{
+		uint32_t size;
+		uint8_t sizeClass;
+		uint8_t scope;
+		HostBlockKind kind;
+		uint8_t padding;
+		union
+		{
+			void* heapBase;       // start of the heap allocation (over-aligned blocks start further)
+			HostArena* arena;     // arena the block was allocated from
+			HostPoolChunk* chunk; // pool chunk the block was carved from
+		};
+	};
+	static_assert(16 == sizeof(HostBlockHeader), "The block header must keep the 16-byte alignment");
+
+	static constexpr size_t s_HeaderSize = sizeof(HostBlockHeader);
+	static constexpr size_t s_MinAlignment = 16;
+
+	// Pools : blocks of 32 bytes to 4 KiB, carved from 64 KiB chunks
+	static constexpr uint32_t s_SizeClassCount = 8;
+	static constexpr size_t s_SmallestSizeClass = 32;
+	static constexpr size_t s_PoolChunkSize = 64 * 1024;
+
+	// Arenas : 64 KiB per thread, the command allocations that do not fit go to the pools
+	static constexpr size_t s_ArenaSize = 64 * 1024;
+
+	struct FreeBlock
+	{
+		FreeBlock* next;
+	};
+
+	struct HostArena
+	{
+		uint8_t* memory = nullptr;
+		size_t offset = 0;
+		std::atomic<uint32_t> liveCount{ 0 }; // (blocks may be freed from another thread)
+	};
+
+	// Set in the state of a chunk once its thread exited : the thread freeing its last block releases it
+	static constexpr uint32_t s_ChunkOrphaned = 1u << 31;
+
+	/**
+	 * Start of every pool chunk, followed by its blocks.
+	 * Only the thread owning the chunk allocates from it, blocks freed by other threads go to its remote list
+	 * and are taken back by the owner once its local list runs out.
+	 */
+	struct HostPoolChunk
+	{
+		HostPoolChunk* prev = nullptr; // in the owner's list of the size class
+		HostPoolChunk* next = nullptr;
+		uint64_t ownerThread = 0;
+		uint32_t sizeClass = 0;
+		FreeBlock* freeList = nullptr; // (owner thread only)
+		std::atomic<FreeBlock*> remoteFrees{ nullptr };
+		std::atomic<uint32_t> state{ 0 }; // live blocks, and s_ChunkOrphaned
+	};
+
+	static constexpr size_t s_ChunkHeaderSize = (sizeof(HostPoolChunk) + s_MinAlignment - 1) & ~(s_MinAlignment - 1);
+
+	static std::atomic<uint64_t> s_NextThreadId{ 1 };
+
+	struct ThreadHostPools
+	{
+		~ThreadHostPools();
+
+		uint64_t threadId = s_NextThreadId.fetch_add(1, std::memory_order_relaxed);
+		HostPoolChunk* chunks[s_SizeClassCount]{}; // the first chunk of each list is the one allocated from
+		HostArena* arena = nullptr;
+	};
+
+	// Arenas are kept for the lifetime of the process : their blocks may be freed by any thread, after this one exited
+	static thread_local ThreadHostPools t_Pools;
+
+	struct ScopeCounters
+	{
+		std::atomic<uint64_t> allocations{ 0 };
+		std::atomic<uint64_t> frees{ 0 };
+		std::atomic<uint64_t> pooled{ 0 };
+		std::atomic<uint64_t> totalBytes{ 0 };
+		std::atomic<uint64_t> liveBytes{ 0 };
+		std::atomic<uint64_t> peakBytes{ 0 };
+	};
+
+	static ScopeCounters s_Counters[VulkanHostAllocationStats::SCOPE_COUNT];
+	static std::atomic<uint64_t> s_InternalAllocations{ 0 };
+	static std::atomic<uint64_t> s_InternalLiveBytes{ 0 };
+
+	static size_t getSizeClassSize(uint32_t size_class)
+	{
+		return s_SmallestSizeClass << size_class;
+	}
+
+	static bool findSizeClass(size_t size, uint32_t& size_class)
+	{
+		for (size_class = 0; size_class < s_SizeClassCount; size_class++)
+		{
+			if (size <= getSizeClassSize(size_class))
+				return true;
+		}
+		return false;
+	}
+
+	static void countAllocation(uint8_t scope, size_t size, bool pooled)
+	{
+		ScopeCounters& counters = s_Counters[scope];
+		counters.allocations.fetch_add(1, std::memory_order_relaxed);
+		counters.totalBytes.fetch_add(size, std::memory_order_relaxed);
+		if (pooled)
+		{
+			counters.pooled.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		uint64_t live = counters.liveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+		uint64_t peak = counters.peakBytes.load(std::memory_order_relaxed);
+		while (live > peak && !counters.peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+		{
+		}
+	}
+
+	static void* finishBlock(void* payload, size_t size, VkSystemAllocationScope scope, HostBlockKind kind, uint32_t size_class)
+	{
+		HostBlockHeader* header = static_cast<HostBlockHeader*>(payload) - 1;
+		header->size = static_cast<uint32_t>(size);
+		header->sizeClass = static_cast<uint8_t>(size_class);
+		header->scope = static_cast<uint8_t>(scope);
+		header->kind = kind;
+		countAllocation(header->scope, size, HostBlockKind::Heap != kind);
+		return payload;
+	}
+
+	static void* allocateFromArena(size_t size, size_t alignment)
+	{
+		HostArena*& arena = t_Pools.arena;
+		if (!arena)
+		{
+			arena = new HostArena();
+			arena->memory = static_cast<uint8_t*>(malloc(s_ArenaSize));
+			if (!arena->memory)
+				return nullptr;
+		}
+
+		// Rewind once the previous command's allocations are all freed
+		if (0 == arena->liveCount.load(std::memory_order_acquire))
+		{
+			arena->offset = 0;
+		}
+
+		uintptr_t base = reinterpret_cast<uintptr_t>(arena->memory);
+		uintptr_t payload = (base + arena->offset + s_HeaderSize + alignment - 1) & ~(uintptr_t(alignment) - 1);
+		if (payload + size > base + s_ArenaSize)
+			return nullptr;
+
+		arena->offset = payload + size - base;
+		arena->liveCount.fetch_add(1, std::memory_order_relaxed);
+		(reinterpret_cast<HostBlockHeader*>(payload) - 1)->arena = arena;
+		return reinterpret_cast<void*>(payload);
+	}
+
+	static void linkChunk(HostPoolChunk*& head, HostPoolChunk* chunk)
+	{
+		chunk->prev = nullptr;
+		chunk->next = head;
+		if (head)
+		{
+			head->prev = chunk;
+		}
+		head = chunk;
+	}
+
+	static void unlinkChunk(HostPoolChunk*& head, HostPoolChunk* chunk)
+	{
+		(chunk->prev ? chunk->prev->next : head) = chunk->next;
+		if (chunk->next)
+		{
+			chunk->next->prev = chunk->prev;
+		}
+	}
+
+	static void releaseChunk(HostPoolChunk* chunk)
+	{
+		chunk->~HostPoolChunk();
+		free(chunk);
+	}
+
+	static void* allocateFromPool(uint32_t size_class)
+	{
+		HostPoolChunk*& head = t_Pools.chunks[size_class];
+		if (!head || !head->freeList)
+		{
+			// The current chunk is full : take back what the other threads freed, switch to the first chunk with free blocks
+			// and release the chunks left empty
+			HostPoolChunk* target = nullptr;
+			for (HostPoolChunk* chunk = head; chunk;)
+			{
+				HostPoolChunk* next = chunk->next;
+				if (!chunk->freeList)
+				{
+					chunk->freeList = chunk->remoteFrees.exchange(nullptr, std::memory_order_acquire);
+				}
+
+				if (chunk->freeList && !target)
+				{
+					target = chunk;
+				}
+				else if (0 == chunk->state.load(std::memory_order_acquire))
+				{
+					unlinkChunk(head, chunk);
+					releaseChunk(chunk);
+				}
+				chunk = next;
+			}
+
+			if (!target)
+			{
+				// Carve a new chunk into blocks (header included)
+				void* memory = malloc(s_PoolChunkSize);
+				if (!memory)
+					return nullptr;
+
+				target = new (memory) HostPoolChunk();
+				target->ownerThread = t_Pools.threadId;
+				target->sizeClass = size_class;
+
+				size_t stride = s_HeaderSize + getSizeClassSize(size_class);
+				uint8_t* blocks = static_cast<uint8_t*>(memory) + s_ChunkHeaderSize;
+				for (size_t offset = 0; offset + stride <= s_PoolChunkSize - s_ChunkHeaderSize; offset += stride)
+				{
+					FreeBlock* block = reinterpret_cast<FreeBlock*>(blocks + offset + s_HeaderSize);
+					block->next = target->freeList;
+					target->freeList = block;
+				}
+			}
+			else
+			{
+				unlinkChunk(head, target);
+			}
+			linkChunk(head, target);
+		}
+
+		FreeBlock* block = head->freeList;
+		head->freeList = block->next;
+		head->state.fetch_add(1, std::memory_order_relaxed);
+		(reinterpret_cast<HostBlockHeader*>(block) - 1)->chunk = head;
+		return block;
+	}
+
+	static void freeToPool(HostPoolChunk* chunk, void* memory)
+	{
+		FreeBlock* block = static_cast<FreeBlock*>(memory);
+		if (chunk->ownerThread == t_Pools.threadId)
+		{
+			// (the current chunk is kept even when empty, the next allocations come from it)
+			block->next = chunk->freeList;
+			chunk->freeList = block;
+			HostPoolChunk*& head = t_Pools.chunks[chunk->sizeClass];
+			if (1 == chunk->state.fetch_sub(1, std::memory_order_acq_rel) && chunk != head)
+			{
+				unlinkChunk(head, chunk);
+				releaseChunk(chunk);
+			}
+			return;
+		}
+
+		block->next = chunk->remoteFrees.load(std::memory_order_relaxed);
+		while (!chunk->remoteFrees.compare_exchange_weak(block->next, block, std::memory_order_release, std::memory_order_relaxed))
+		{
+		}
+		if ((s_ChunkOrphaned | 1) == chunk->state.fetch_sub(1, std::memory_order_acq_rel))
+		{
+			releaseChunk(chunk);
+		}
+	}
+
+	ThreadHostPools::~ThreadHostPools()
+	{
+		// The chunks still in use are released by the thread freeing their last block
+		for (HostPoolChunk* head : chunks)
+		{
+			for (HostPoolChunk* chunk = head; chunk;)
+			{
+				HostPoolChunk* next = chunk->next;
+				if (0 == (chunk->state.fetch_or(s_ChunkOrphaned, std::memory_order_acq_rel) & ~s_ChunkOrphaned))
+				{
+					releaseChunk(chunk);
+				}
+				chunk = next;
+			}
+		}
+		threadId = 0; // (blocks this thread frees from now on are remote frees)
+	}
+
+	static void* allocateFromHeap(size_t size, size_t alignment)
+	{
+		void* base = malloc(size + alignment + s_HeaderSize);
+		if (!base)
+			return nullptr;
+
+		uintptr_t payload = (reinterpret_cast<uintptr_t>(base) + s_HeaderSize + alignment - 1) & ~(uintptr_t(alignment) - 1);
+		(reinterpret_cast<HostBlockHeader*>(payload) - 1)->heapBase = base;
+		return reinterpret_cast<void*>(payload);
+	}
+
+	static void* VKAPI_CALL allocateCallback(void*, size_t size, size_t alignment, VkSystemAllocationScope scope)
+	{
+		if (0 == size || size > UINT32_MAX)
+			return nullptr;
+		alignment = std::max(alignment, s_MinAlignment);
+
+		uint32_t sizeClass = 0;
+		if (VK_SYSTEM_ALLOCATION_SCOPE_COMMAND == scope)
+		{
+			if (void* payload = allocateFromArena(size, alignment))
+				return finishBlock(payload, size, scope, HostBlockKind::Arena, 0);
+		}
+		if ((VK_SYSTEM_ALLOCATION_SCOPE_COMMAND == scope || VK_SYSTEM_ALLOCATION_SCOPE_OBJECT == scope) &&
+		    s_MinAlignment == alignment && findSizeClass(size, sizeClass))
+		{
+			if (void* payload = allocateFromPool(sizeClass))
+				return finishBlock(payload, size, scope, HostBlockKind::Pool, sizeClass);
+		}
+
+		void* payload = allocateFromHeap(size, alignment);
+		return payload ? finishBlock(payload, size, scope, HostBlockKind::Heap, 0) : nullptr;
+	}
+
+	static void VKAPI_CALL freeCallback(void*, void* memory)
+	{
+		if (!memory)
+			return;
+
+		HostBlockHeader* header = static_cast<HostBlockHeader*>(memory) - 1;
+		ScopeCounters& counters = s_Counters[header->scope];
+		counters.frees.fetch_add(1, std::memory_order_relaxed);
+		counters.liveBytes.fetch_sub(header->size, std::memory_order_relaxed);
+
+		switch (header->kind)
+		{
+		case HostBlockKind::Arena:
+			header->arena->liveCount.fetch_sub(1, std::memory_order_release);
+			break;
+
+		case HostBlockKind::Pool:
+			freeToPool(header->chunk, memory);
+			break;
+
+		default:
+			free(header->heapBase);
+			break;
+		}
+	}
+
+	static void* VKAPI_CALL reallocateCallback(void* user_data, void* original, size_t size, size_t alignment, VkSystemAllocationScope scope)
+	{
+		if (!original)
+			return allocateCallback(user_data, size, alignment, scope);
+		if (0 == size)
+		{
+			freeCallback(user_data, original);
+			return nullptr;
+		}
+
+		// (the original is left untouched when the new allocation fails)
+		void* memory = allocateCallback(user_data, size, alignment, scope);
+		if (memory)
+		{
+			memcpy(memory, original, std::min<size_t>(size, (static_cast<HostBlockHeader*>(original) - 1)->size));
+			freeCallback(user_data, original);
+		}
+		return memory;
+	}
+
+	static void VKAPI_CALL internalAllocationNotification(void*, size_t size, VkInternalAllocationType, VkSystemAllocationScope)
+	{
+		s_InternalAllocations.fetch_add(1, std::memory_order_relaxed);
+		s_InternalLiveBytes.fetch_add(size, std::memory_order_relaxed);
+	}
+
+	static void VKAPI_CALL internalFreeNotification(void*, size_t size, VkInternalAllocationType, VkSystemAllocationScope)
+	{
+		s_InternalLiveBytes.fetch_sub(size, std::memory_order_relaxed);
+	}
+
+	static const VkAllocationCallbacks s_Callbacks{
+		nullptr,
+		allocateCallback,
+		reallocateCallback,
+		freeCallback,
+		internalAllocationNotification,
+		internalFreeNotification,
+	};
+}
+
+const VkAllocationCallbacks* VulkanHostAllocator::getCallbacks()
+{
+	return &detail::s_Callbacks;
+}
+
+VulkanHostAllocationStats VulkanHostAllocator::getStats()
+{
+	VulkanHostAllocationStats stats{};
+	for (uint32_t scope = 0; scope < VulkanHostAllocationStats::SCOPE_COUNT; scope++)
+	{
+		const detail::ScopeCounters& counters = detail::s_Counters[scope];
+		VulkanHostAllocationScopeStats& scopeStats = stats.scopes[scope];
+		scopeStats.allocations = counters.allocations.load(std::memory_order_relaxed);
+		scopeStats.frees = counters.frees.load(std::memory_order_relaxed);
+		scopeStats.pooled = counters.pooled.load(std::memory_order_relaxed);
+		scopeStats.totalBytes = counters.totalBytes.load(std::memory_order_relaxed);
+		scopeStats.liveBytes = counters.liveBytes.load(std::memory_order_relaxed);
+		scopeStats.peakBytes = counters.peakBytes.load(std::memory_order_relaxed);
+	}
+	stats.internalAllocations = detail::s_InternalAllocations.load(std::memory_order_relaxed);
+	stats.internalLiveBytes = detail::s_InternalLiveBytes.load(std::memory_order_relaxed);
+	return stats;
+}
+
+const char* VulkanHostAllocator::getScopeName(VkSystemAllocationScope scope)
+{
+	switch (scope)
+	{
+	case VK_SYSTEM_ALLOCATION_SCOPE_COMMAND:  return "command";
+	case VK_SYSTEM_ALLOCATION_SCOPE_OBJECT:   return "object";
+	case VK_SYSTEM_ALLOCATION_SCOPE_CACHE:    return "cache";
+	case VK_SYSTEM_ALLOCATION_SCOPE_DEVICE:   return "device";
+	case VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE: return "instance";
+	default:                                  return "unknown";
+	}
+}
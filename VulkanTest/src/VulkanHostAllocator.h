@@ -0,0 +1,42 @@
+﻿#pragma once
+#include <cstdint>
+#include <vulkan/vulkan_core.h>
+
+// Host allocations of the driver for one VkSystemAllocationScope
+struct VulkanHostAllocationScopeStats
+{
+	uint64_t allocations; // (a reallocation counts as an allocation and a free)
+	uint64_t frees;
+	uint64_t pooled; // allocations served by the thread-local pools and arenas
+	uint64_t totalBytes;
+	uint64_t liveBytes;
+	uint64_t peakBytes;
+};
+
+struct VulkanHostAllocationStats
+{
+	static constexpr uint32_t SCOPE_COUNT = VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE + 1;
+
+	VulkanHostAllocationScopeStats scopes[SCOPE_COUNT]; // indexed by VkSystemAllocationScope
+
+	// Allocations the driver made itself and reported (executable memory)
+	uint64_t internalAllocations;
+	uint64_t internalLiveBytes;
+};
+
+/**
+ * VkAllocationCallbacks passed to every vkCreate / vkDestroy call, tracking the host memory of the driver per allocation scope.
+ *  - command scope : bump allocated from a thread-local arena, rewound once all its allocations are freed
+ *    (they only live for the duration of the call)
+ *  - object scope : thread-local chunks of fixed size blocks, for the small allocations
+ *    (blocks freed by another thread go back to their chunk, empty chunks are released)
+ *  - the other scopes, larger or over-aligned allocations : heap
+ */
+class VulkanHostAllocator
+{
+public:
+	static const VkAllocationCallbacks* getCallbacks();
+	static VulkanHostAllocationStats getStats();
+
+	static const char* getScopeName(VkSystemAllocationScope scope);
+};
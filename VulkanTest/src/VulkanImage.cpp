@@ -3,6 +3,8 @@
 #include "VulkanBuffer.h"
 #include "VulkanContext.h"
 #include "VulkanFunctions.h"
+#include "VulkanHostAllocator.h"
+#include "VulkanMemoryTelemetry.h"
 
 #include <stdexcept>
 
@@ -14,7 +16,9 @@ void VulkanImage::create(
 	VkImageType type,
 	VkFormat format,
 	VkImageTiling tiling,
-	VkImageUsageFlags usage, VkMemoryPropertyFlags properties)
+	VkImageUsageFlags usage, VkMemoryPropertyFlags properties,
+	uint32_t mip_levels,
+	uint32_t array_layers)
 {
 	VkImageCreateInfo imageCreateInfo{};
 	imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -22,8 +26,10 @@ void VulkanImage::create(
 	imageCreateInfo.extent.width = width;
 	imageCreateInfo.extent.height = height;
 	imageCreateInfo.extent.depth = depth;
-	imageCreateInfo.mipLevels = 1;
-	imageCreateInfo.arrayLayers = 1;
+	imageCreateInfo.mipLevels = mip_levels;
+	m_MipLevels = mip_levels;
+	imageCreateInfo.arrayLayers = array_layers;
+	m_ArrayLayers = array_layers;
 	imageCreateInfo.format = format;
 	imageCreateInfo.tiling = tiling;
 	imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED; // Can be UNDEFINED or PREINITIALIZED
@@ -31,7 +37,7 @@ void VulkanImage::create(
 	imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 	imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
 
-	if (VK_SUCCESS != vkCreateImage(device_context.m_Device, &imageCreateInfo, nullptr, &m_Image))
+	if (VK_SUCCESS != vkCreateImage(device_context.m_Device, &imageCreateInfo, VulkanHostAllocator::getCallbacks(), &m_Image))
 	{
 		throw std::runtime_error("Failed to create Image!");
 	}
@@ -44,16 +50,19 @@ void VulkanImage::create(
 	memoryAllocateInfo.allocationSize = memoryRequirements.size;
 	memoryAllocateInfo.memoryTypeIndex = vulkan::findMemoryType(device_context.m_PhysicalDevice, memoryRequirements.memoryTypeBits, properties);
 
-	if (VK_SUCCESS != vkAllocateMemory(device_context.m_Device, &memoryAllocateInfo, nullptr, &m_Memory))
+	if (VK_SUCCESS != vkAllocateMemory(device_context.m_Device, &memoryAllocateInfo, VulkanHostAllocator::getCallbacks(), &m_Memory))
 	{
 		throw std::runtime_error("Failed to Allocate image memory!");
 	}
+	VulkanMemoryTelemetry::trackAllocation(device_context, m_Memory, memoryAllocateInfo.allocationSize, memoryAllocateInfo.memoryTypeIndex,
+	                                       VulkanMemoryTelemetry::getImageCategory(usage));
 
 	vkBindImageMemory(device_context.m_Device, m_Image, m_Memory, 0);
 }
 
 void VulkanImage::destroy(VkDevice device)
 {
-	vkDestroyImage(device, m_Image, nullptr);
-	vkFreeMemory(device, m_Memory, nullptr);
+	vkDestroyImage(device, m_Image, VulkanHostAllocator::getCallbacks());
+	VulkanMemoryTelemetry::untrackAllocation(m_Memory);
+	vkFreeMemory(device, m_Memory, VulkanHostAllocator::getCallbacks());
 }
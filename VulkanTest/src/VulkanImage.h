@@ -16,10 +16,14 @@ public:
 		VkFormat format,
 		VkImageTiling tiling,
 		VkImageUsageFlags usage,
-		VkMemoryPropertyFlags properties);
+		VkMemoryPropertyFlags properties,
+		uint32_t mip_levels = 1,
+		uint32_t array_layers = 1);
 
 	void destroy(VkDevice device);
 
 	VkImage m_Image{};
 	VkDeviceMemory m_Memory{};
+	uint32_t m_MipLevels = 1;
+	uint32_t m_ArrayLayers = 1;
 };
@@ -0,0 +1,232 @@
+﻿#include "VulkanMemoryTelemetry.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <unordered_map>
+
+#include "FreeListAllocator.h"
+#include "VulkanContext.h"
+
+namespace detail
+{
+	struct TrackedAllocation
+	{
+		VkDeviceSize size;
+		uint32_t heapIndex;
+		VulkanMemoryCategory category;
+	};
+
+	static std::mutex s_TelemetryMutex;
+	static std::unordered_map<VkDeviceMemory, TrackedAllocation> s_Allocations;
+	static std::unordered_map<const void*, std::function<VulkanMemoryBlockStats()>> s_Blocks;
+	static bool s_HeapOverBudget[VK_MAX_MEMORY_HEAPS]{};
+
+	static constexpr uint32_t s_CategoryCount = static_cast<uint32_t>(VulkanMemoryCategory::Count);
+
+	static double toMiB(VkDeviceSize bytes)
+	{
+		return static_cast<double>(bytes) / (1024.0 * 1024.0);
+	}
+}
+
+void VulkanMemoryTelemetry::trackAllocation(const VulkanDeviceContext& device_context, VkDeviceMemory memory, VkDeviceSize size,
+                                            uint32_t memory_type_index, VulkanMemoryCategory category)
+{
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	vkGetPhysicalDeviceMemoryProperties(device_context.m_PhysicalDevice, &memoryProperties);
+
+	std::lock_guard<std::mutex> lock(detail::s_TelemetryMutex);
+	detail::s_Allocations[memory] = { size, memoryProperties.memoryTypes[memory_type_index].heapIndex, category };
+}
+
+void VulkanMemoryTelemetry::untrackAllocation(VkDeviceMemory memory)
+{
+	std::lock_guard<std::mutex> lock(detail::s_TelemetryMutex);
+	detail::s_Allocations.erase(memory);
+}
+
+void VulkanMemoryTelemetry::registerBlock(const void* owner, std::function<VulkanMemoryBlockStats()> query)
+{
+	std::lock_guard<std::mutex> lock(detail::s_TelemetryMutex);
+	detail::s_Blocks[owner] = std::move(query);
+}
+
+void VulkanMemoryTelemetry::unregisterBlock(const void* owner)
+{
+	std::lock_guard<std::mutex> lock(detail::s_TelemetryMutex);
+	detail::s_Blocks.erase(owner);
+}
+
+VulkanMemoryBlockStats VulkanMemoryTelemetry::getBlockStats(const char* name, const FreeListAllocator& allocator, VkDeviceSize unit_size)
+{
+	VulkanMemoryBlockStats stats{};
+	stats.name = name;
+	stats.capacity = allocator.getCapacity() * unit_size;
+	stats.freeBytes = allocator.getFreeSize() * unit_size;
+	stats.largestFreeBlock = allocator.getLargestFreeBlock() * unit_size;
+	stats.fragmentation = stats.freeBytes > 0 ? 1.0 - static_cast<double>(stats.largestFreeBlock) / static_cast<double>(stats.freeBytes) : 0.0;
+	return stats;
+}
+
+VulkanMemoryStats VulkanMemoryTelemetry::getStats(const VulkanDeviceContext& device_context)
+{
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	vkGetPhysicalDeviceMemoryProperties(device_context.m_PhysicalDevice, &memoryProperties);
+
+	VkPhysicalDeviceMemoryBudgetPropertiesEXT memoryBudget{};
+	memoryBudget.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+	if (device_context.m_HasMemoryBudget)
+	{
+		VkPhysicalDeviceMemoryProperties2 memoryProperties2{};
+		memoryProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+		memoryProperties2.pNext = &memoryBudget;
+		vkGetPhysicalDeviceMemoryProperties2(device_context.m_PhysicalDevice, &memoryProperties2);
+	}
+
+	VulkanMemoryStats stats{};
+	stats.hasBudget = device_context.m_HasMemoryBudget;
+	stats.heaps.resize(memoryProperties.memoryHeapCount);
+
+	std::vector<std::function<VulkanMemoryBlockStats()>> blockQueries;
+	{
+		std::lock_guard<std::mutex> lock(detail::s_TelemetryMutex);
+		for (const auto& [memory, allocation] : detail::s_Allocations)
+		{
+			VulkanMemoryHeapStats& heap = stats.heaps[allocation.heapIndex];
+			heap.trackedBytes += allocation.size;
+			heap.allocationCount++;
+
+			VulkanMemoryCategoryStats& category = stats.categories[static_cast<uint32_t>(allocation.category)];
+			category.bytes += allocation.size;
+			category.allocationCount++;
+		}
+		for (const auto& [owner, query] : detail::s_Blocks)
+		{
+			blockQueries.push_back(query);
+		}
+	}
+
+	for (uint32_t heapIndex = 0; heapIndex < memoryProperties.memoryHeapCount; heapIndex++)
+	{
+		VulkanMemoryHeapStats& heap = stats.heaps[heapIndex];
+		heap.size = memoryProperties.memoryHeaps[heapIndex].size;
+		heap.deviceLocal = 0 != (memoryProperties.memoryHeaps[heapIndex].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT);
+		heap.budget = stats.hasBudget ? memoryBudget.heapBudget[heapIndex] : heap.size;
+		heap.usage = stats.hasBudget ? memoryBudget.heapUsage[heapIndex] : heap.trackedBytes;
+	}
+
+	// (queried outside of the lock : they may take the locks of their owners)
+	for (const std::function<VulkanMemoryBlockStats()>& query : blockQueries)
+	{
+		stats.blocks.push_back(query());
+	}
+	return stats;
+}
+
+bool VulkanMemoryTelemetry::checkBudget(const VulkanDeviceContext& device_context)
+{
+	VulkanMemoryStats stats = getStats(device_context);
+
+	bool overBudget = false;
+	for (uint32_t heapIndex = 0; heapIndex < stats.heaps.size(); heapIndex++)
+	{
+		const VulkanMemoryHeapStats& heap = stats.heaps[heapIndex];
+		bool overWarningLevel = heap.budget > 0 && static_cast<double>(heap.usage) > BUDGET_WARNING_FRACTION * static_cast<double>(heap.budget);
+
+		std::lock_guard<std::mutex> lock(detail::s_TelemetryMutex);
+		if (overWarningLevel && !detail::s_HeapOverBudget[heapIndex])
+		{
+			printf("[WARN] Memory heap %u%s is at %.1lf / %.1lf MiB of its budget, allocations may start paging!\n", heapIndex,
+			       heap.deviceLocal ? " (device local)" : "", detail::toMiB(heap.usage), detail::toMiB(heap.budget));
+		}
+		detail::s_HeapOverBudget[heapIndex] = overWarningLevel;
+		overBudget |= overWarningLevel;
+	}
+	return overBudget;
+}
+
+bool VulkanMemoryTelemetry::writeJson(const std::string& file, const VulkanMemoryStats& stats)
+{
+	std::ofstream output(file, std::ios::trunc);
+	if (!output.is_open())
+	{
+		printf("[WARN] Failed to write the memory report to %s!\n", file.c_str());
+		return false;
+	}
+
+	output << std::fixed << std::setprecision(4);
+	output << "{\n";
+	output << "\t\"hasBudget\": " << (stats.hasBudget ? "true" : "false") << ",\n";
+
+	output << "\t\"heaps\": [";
+	for (size_t i = 0; i < stats.heaps.size(); i++)
+	{
+		const VulkanMemoryHeapStats& heap = stats.heaps[i];
+		output << (i ? ",\n" : "\n") << "\t\t{ \"index\": " << i << ", \"deviceLocal\": " << (heap.deviceLocal ? "true" : "false")
+		       << ", \"size\": " << heap.size << ", \"budget\": " << heap.budget << ", \"usage\": " << heap.usage
+		       << ", \"trackedBytes\": " << heap.trackedBytes << ", \"allocations\": " << heap.allocationCount << " }";
+	}
+	output << "\n\t],\n";
+
+	output << "\t\"categories\": {";
+	for (uint32_t i = 0; i < detail::s_CategoryCount; i++)
+	{
+		const VulkanMemoryCategoryStats& category = stats.categories[i];
+		output << (i ? ",\n" : "\n") << "\t\t\"" << getCategoryName(static_cast<VulkanMemoryCategory>(i)) << "\": { \"bytes\": " << category.bytes
+		       << ", \"allocations\": " << category.allocationCount << " }";
+	}
+	output << "\n\t},\n";
+
+	output << "\t\"blocks\": [";
+	for (size_t i = 0; i < stats.blocks.size(); i++)
+	{
+		const VulkanMemoryBlockStats& block = stats.blocks[i];
+		output << (i ? ",\n" : "\n") << "\t\t{ \"name\": \"" << block.name << "\", \"capacity\": " << block.capacity
+		       << ", \"freeBytes\": " << block.freeBytes << ", \"largestFreeBlock\": " << block.largestFreeBlock
+		       << ", \"fragmentation\": " << block.fragmentation << " }";
+	}
+	output << "\n\t]\n}\n";
+
+	return output.good();
+}
+
+VulkanMemoryCategory VulkanMemoryTelemetry::getBufferCategory(VkBufferUsageFlags usage)
+{
+	if (usage & VK_BUFFER_USAGE_VERTEX_BUFFER_BIT)
+		return VulkanMemoryCategory::Vertex;
+	if (usage & VK_BUFFER_USAGE_INDEX_BUFFER_BIT)
+		return VulkanMemoryCategory::Index;
+	if (usage & VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT)
+		return VulkanMemoryCategory::Uniform;
+	if (usage & (VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT))
+		return VulkanMemoryCategory::Storage;
+	if (VK_BUFFER_USAGE_TRANSFER_SRC_BIT == usage)
+		return VulkanMemoryCategory::Staging;
+	return VulkanMemoryCategory::Other;
+}
+
+VulkanMemoryCategory VulkanMemoryTelemetry::getImageCategory(VkImageUsageFlags usage)
+{
+	if (usage & (VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT))
+		return VulkanMemoryCategory::Attachment;
+	if (usage & (VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT))
+		return VulkanMemoryCategory::Texture;
+	return VulkanMemoryCategory::Other;
+}
+
+const char* VulkanMemoryTelemetry::getCategoryName(VulkanMemoryCategory category)
+{
+	switch (category)
+	{
+	case VulkanMemoryCategory::Vertex:     return "vertex";
+	case VulkanMemoryCategory::Index:      return "index";
+	case VulkanMemoryCategory::Uniform:    return "uniform";
+	case VulkanMemoryCategory::Storage:    return "storage";
+	case VulkanMemoryCategory::Staging:    return "staging";
+	case VulkanMemoryCategory::Texture:    return "texture";
+	case VulkanMemoryCategory::Attachment: return "attachment";
+	default:                               return "other";
+	}
+}
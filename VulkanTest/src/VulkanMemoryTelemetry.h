@@ -0,0 +1,87 @@
+﻿#pragma once
+#include <functional>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+struct VulkanDeviceContext;
+class FreeListAllocator;
+
+// What a device memory allocation holds (deduced from the usage of its buffer or image)
+enum class VulkanMemoryCategory : uint32_t
+{
+	Vertex = 0,
+	Index,
+	Uniform,
+	Storage, // storage and indirect buffers
+	Staging,
+	Texture,
+	Attachment,
+	Other,
+	Count,
+};
+
+struct VulkanMemoryHeapStats
+{
+	VkDeviceSize size;
+	VkDeviceSize budget; // (the heap size without VK_EXT_memory_budget)
+	VkDeviceSize usage;  // by the whole process according to the driver (the tracked bytes without VK_EXT_memory_budget)
+	VkDeviceSize trackedBytes;
+	uint32_t allocationCount;
+	bool deviceLocal;
+};
+
+struct VulkanMemoryCategoryStats
+{
+	VkDeviceSize bytes;
+	uint32_t allocationCount;
+};
+
+// Free space of a sub-allocated buffer
+struct VulkanMemoryBlockStats
+{
+	std::string name;
+	VkDeviceSize capacity;
+	VkDeviceSize freeBytes;
+	VkDeviceSize largestFreeBlock;
+	double fragmentation; // 1 - largest free block / free space (0 : the free space is contiguous)
+};
+
+struct VulkanMemoryStats
+{
+	bool hasBudget; // VK_EXT_memory_budget enabled
+	std::vector<VulkanMemoryHeapStats> heaps;
+	VulkanMemoryCategoryStats categories[static_cast<uint32_t>(VulkanMemoryCategory::Count)];
+	std::vector<VulkanMemoryBlockStats> blocks;
+};
+
+/**
+ * Registry of the device memory allocations of VulkanBuffer and VulkanImage, and of the sub-allocated blocks,
+ * combined with the heap budgets of VK_EXT_memory_budget into usage statistics. Safe to use from any thread.
+ */
+class VulkanMemoryTelemetry
+{
+public:
+	static constexpr double BUDGET_WARNING_FRACTION = 0.9; // of a heap's budget
+
+	static void trackAllocation(const VulkanDeviceContext& device_context, VkDeviceMemory memory, VkDeviceSize size,
+	                            uint32_t memory_type_index, VulkanMemoryCategory category);
+	static void untrackAllocation(VkDeviceMemory memory);
+
+	// The query is called by getStats() for as long as the block is registered under owner
+	static void registerBlock(const void* owner, std::function<VulkanMemoryBlockStats()> query);
+	static void unregisterBlock(const void* owner);
+	static VulkanMemoryBlockStats getBlockStats(const char* name, const FreeListAllocator& allocator, VkDeviceSize unit_size = 1);
+
+	static VulkanMemoryStats getStats(const VulkanDeviceContext& device_context);
+
+	// Warns once when a heap goes over BUDGET_WARNING_FRACTION of its budget (again after it went back under)
+	// Returns whether a heap is over it
+	static bool checkBudget(const VulkanDeviceContext& device_context);
+
+	static bool writeJson(const std::string& file, const VulkanMemoryStats& stats);
+
+	static VulkanMemoryCategory getBufferCategory(VkBufferUsageFlags usage);
+	static VulkanMemoryCategory getImageCategory(VkImageUsageFlags usage);
+	static const char* getCategoryName(VulkanMemoryCategory category);
+};
@@ -2,9 +2,11 @@
 
 #include "BufferData.h"
 #include "VulkanFunctions.h"
+#include "VulkanHostAllocator.h"
 
 #include <fstream>
 #include <optional>
+#include <stdexcept>
 
 namespace detail
 {
@@ -31,12 +33,12 @@ namespace detail
 
 		void destroy(VkDevice device)
 		{
-			vkDestroyShaderModule(device, vertShader, nullptr);
-			vkDestroyShaderModule(device, fragShader, nullptr);
-			
-			if (geomShader)     vkDestroyShaderModule(device, geomShader, nullptr);
-			if (tessContShader) vkDestroyShaderModule(device, tessContShader, nullptr);
-			if (tessEvalShader) vkDestroyShaderModule(device, tessEvalShader, nullptr);
+			vkDestroyShaderModule(device, vertShader, VulkanHostAllocator::getCallbacks());
+
+			if (fragShader)     vkDestroyShaderModule(device, fragShader, VulkanHostAllocator::getCallbacks());
+			if (geomShader)     vkDestroyShaderModule(device, geomShader, VulkanHostAllocator::getCallbacks());
+			if (tessContShader) vkDestroyShaderModule(device, tessContShader, VulkanHostAllocator::getCallbacks());
+			if (tessEvalShader) vkDestroyShaderModule(device, tessEvalShader, VulkanHostAllocator::getCallbacks());
 		}
 	};
 
@@ -46,12 +48,17 @@ namespace detail
 }
 
 
-void VulkanPipeline::create(VkDevice device, const std::string& vertex_shader, const std::string& fragment_shader, VkExtent2D swapchain_extent, VkRenderPass render_pass)
+void VulkanPipeline::create(VkDevice device, const std::string& vertex_shader, const std::string& fragment_shader, VkExtent2D swapchain_extent, VkRenderPass render_pass,
+                            VulkanDepthMode depth_mode, VulkanBlendMode blend_mode, const VulkanPipeline* layout_source)
 {
 	// Create shader stages
+	// (the depth pre-pass has no fragment shader, only the depth produced by the rasterizer is needed)
 	detail::ShaderStagesDesc shaderStagesDesc{};
 	shaderStagesDesc.vertShaderFile = vertex_shader;
-	shaderStagesDesc.fragShaderFile = fragment_shader;
+	if (VulkanDepthMode::PrePass != depth_mode)
+	{
+		shaderStagesDesc.fragShaderFile = fragment_shader;
+	}
 
 	detail::VulkanShaderModulePack shaderModulePack = detail::createShaderModules(device, shaderStagesDesc);
 	std::vector<VkPipelineShaderStageCreateInfo> shaderStagesCreateInfos = detail::createShaderStages(device, shaderModulePack);
@@ -138,12 +145,38 @@ void VulkanPipeline::create(VkDevice device, const std::string& vertex_shader, c
 	multisampleStateCreateInfo.alphaToOneEnable = VK_FALSE; // (optional)
 
 	// Set depth and stencil testing state
-	// TODO: implement depth and stencil testing
+	VkPipelineDepthStencilStateCreateInfo depthStencilStateCreateInfo{};
+	depthStencilStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	depthStencilStateCreateInfo.depthTestEnable = VK_TRUE;
+	if (VulkanDepthMode::EqualTest == depth_mode)
+	{
+		// Depth is already resolved by the pre-pass : only shade the closest fragment of each pixel
+		depthStencilStateCreateInfo.depthWriteEnable = VK_FALSE;
+		depthStencilStateCreateInfo.depthCompareOp = VK_COMPARE_OP_EQUAL;
+	}
+	else if (VulkanDepthMode::ReadOnly == depth_mode)
+	{
+		depthStencilStateCreateInfo.depthWriteEnable = VK_FALSE;
+		depthStencilStateCreateInfo.depthCompareOp = VK_COMPARE_OP_LESS;
+	}
+	else
+	{
+		depthStencilStateCreateInfo.depthWriteEnable = VK_TRUE;
+		depthStencilStateCreateInfo.depthCompareOp = VK_COMPARE_OP_LESS; // lower depth = closer
+	}
+	depthStencilStateCreateInfo.depthBoundsTestEnable = VK_FALSE; // VK_TRUE : only keep fragments within the min/max depth bounds
+	depthStencilStateCreateInfo.minDepthBounds = 0.0f; // (optional)
+	depthStencilStateCreateInfo.maxDepthBounds = 1.0f; // (optional)
+	depthStencilStateCreateInfo.stencilTestEnable = VK_FALSE;
+	depthStencilStateCreateInfo.front = {}; // (optional)
+	depthStencilStateCreateInfo.back = {}; // (optional)
 
 	// Create color blending state for framebuffer attachment
 	VkPipelineColorBlendAttachmentState colorBlendAttachment{};
-	colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-	colorBlendAttachment.blendEnable = VK_TRUE;
+	colorBlendAttachment.colorWriteMask = (VulkanDepthMode::PrePass == depth_mode)
+		? 0 // depth only
+		: VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+	colorBlendAttachment.blendEnable = (VulkanBlendMode::AlphaBlend == blend_mode) ? VK_TRUE : VK_FALSE; // (opaque draws skip the read-modify-write)
 	colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA; // (optional)
 	colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA; // (optional)
 	colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD; // (optional)
@@ -163,11 +196,20 @@ void VulkanPipeline::create(VkDevice device, const std::string& vertex_shader, c
 	colorBlendStateCreateInfo.blendConstants[2] = 0.0f; // (optional)
 	colorBlendStateCreateInfo.blendConstants[3] = 0.0f; // (optional)
 
-	// Create descriptor sets
-	createDescriptorSetLayout(device);
+	m_OwnsLayouts = nullptr == layout_source;
+	if (m_OwnsLayouts)
+	{
+		// Create descriptor sets
+		createDescriptorSetLayout(device);
 
-	// Create a pipeline layout of uniform values
-	createPipelineLayout(device);
+		// Create a pipeline layout of uniform values
+		createPipelineLayout(device);
+	}
+	else
+	{
+		m_DescriptorSetLayout = layout_source->m_DescriptorSetLayout;
+		m_PipelineLayout = layout_source->m_PipelineLayout;
+	}
 
 	// Create the pipeline
 	VkGraphicsPipelineCreateInfo pipelineCreateInfo{};
@@ -180,7 +222,7 @@ void VulkanPipeline::create(VkDevice device, const std::string& vertex_shader, c
 	pipelineCreateInfo.pViewportState = &viewportStateCreateInfo;
 	pipelineCreateInfo.pRasterizationState = &rasterizationStateCreateInfo;
 	pipelineCreateInfo.pMultisampleState = &multisampleStateCreateInfo;
-	pipelineCreateInfo.pDepthStencilState = nullptr; // (optional)
+	pipelineCreateInfo.pDepthStencilState = &depthStencilStateCreateInfo;
 	pipelineCreateInfo.pColorBlendState = &colorBlendStateCreateInfo;
 	pipelineCreateInfo.pDynamicState = &dynamicStateCreateInfo; // (optional)
 
@@ -192,7 +234,7 @@ void VulkanPipeline::create(VkDevice device, const std::string& vertex_shader, c
 	pipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE; // using handle
 	pipelineCreateInfo.basePipelineIndex = -1; // using index of a pipeline about to be created in the vkCreateGraphicsPipelines call
 
-	if (VK_SUCCESS != vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &m_Pipeline))
+	if (VK_SUCCESS != vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineCreateInfo, VulkanHostAllocator::getCallbacks(), &m_Pipeline))
 	{
 		throw std::runtime_error("Failed to create Pipeline!");
 	}
@@ -203,9 +245,12 @@ void VulkanPipeline::create(VkDevice device, const std::string& vertex_shader, c
 
 void VulkanPipeline::destroy(VkDevice device)
 {
-	vkDestroyDescriptorSetLayout(device, m_DescriptorSetLayout, nullptr);
-	vkDestroyPipeline(device, m_Pipeline, nullptr);
-	vkDestroyPipelineLayout(device, m_PipelineLayout, nullptr);
+	vkDestroyPipeline(device, m_Pipeline, VulkanHostAllocator::getCallbacks());
+	if (m_OwnsLayouts)
+	{
+		vkDestroyDescriptorSetLayout(device, m_DescriptorSetLayout, VulkanHostAllocator::getCallbacks());
+		vkDestroyPipelineLayout(device, m_PipelineLayout, VulkanHostAllocator::getCallbacks());
+	}
 }
 
 
@@ -218,16 +263,42 @@ void VulkanPipeline::createDescriptorSetLayout(VkDevice device)
 	uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 	uboLayoutBinding.pImmutableSamplers = nullptr; // (optional) for image samplers
 
+	// Streamed textures : the scene texture, then the textures too large for the atlas
 	VkDescriptorSetLayoutBinding samplerLayoutBinding{};
 	samplerLayoutBinding.binding = 1;
-	samplerLayoutBinding.descriptorCount = 1;
+	samplerLayoutBinding.descriptorCount = STREAMED_TEXTURE_SLOTS;
 	samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 	samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 	samplerLayoutBinding.pImmutableSamplers = nullptr;
 
+	VkDescriptorSetLayoutBinding objectsLayoutBinding{};
+	objectsLayoutBinding.binding = 2;
+	objectsLayoutBinding.descriptorCount = 1;
+	objectsLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	objectsLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	objectsLayoutBinding.pImmutableSamplers = nullptr;
+
+	// Texture array shared by the atlased textures : regions read by the vertex stage, layers sampled by the fragment stage
+	VkDescriptorSetLayoutBinding atlasRegionsLayoutBinding{};
+	atlasRegionsLayoutBinding.binding = 3;
+	atlasRegionsLayoutBinding.descriptorCount = 1;
+	atlasRegionsLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	atlasRegionsLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	atlasRegionsLayoutBinding.pImmutableSamplers = nullptr;
+
+	VkDescriptorSetLayoutBinding atlasLayoutBinding{};
+	atlasLayoutBinding.binding = 4;
+	atlasLayoutBinding.descriptorCount = 1;
+	atlasLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	atlasLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	atlasLayoutBinding.pImmutableSamplers = nullptr;
+
 	VkDescriptorSetLayoutBinding layoutBindings[] = {
 		uboLayoutBinding,
-		samplerLayoutBinding
+		samplerLayoutBinding,
+		objectsLayoutBinding,
+		atlasRegionsLayoutBinding,
+		atlasLayoutBinding
 	};
 
 	VkDescriptorSetLayoutCreateInfo layoutCreateInfo{};
@@ -235,7 +306,7 @@ void VulkanPipeline::createDescriptorSetLayout(VkDevice device)
 	layoutCreateInfo.bindingCount = std::size(layoutBindings);
 	layoutCreateInfo.pBindings = layoutBindings;
 
-	if (VK_SUCCESS != vkCreateDescriptorSetLayout(device, &layoutCreateInfo, nullptr, &m_DescriptorSetLayout))
+	if (VK_SUCCESS != vkCreateDescriptorSetLayout(device, &layoutCreateInfo, VulkanHostAllocator::getCallbacks(), &m_DescriptorSetLayout))
 	{
 		throw std::runtime_error("Failed to create Descriptor Set Layout!");
 	}
@@ -250,12 +321,79 @@ void VulkanPipeline::createPipelineLayout(VkDevice device)
 	pipelineLayoutCreateInfo.pushConstantRangeCount = 0; // (optional)
 	pipelineLayoutCreateInfo.pPushConstantRanges = nullptr; // (optional)
 
-	if (VK_SUCCESS != vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &m_PipelineLayout))
+	if (VK_SUCCESS != vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, VulkanHostAllocator::getCallbacks(), &m_PipelineLayout))
 	{
 		throw std::runtime_error("Failed to create Pipeline Layout!");
 	}
 }
 
+void VulkanComputePipeline::create(
+	VkDevice device,
+	const std::string& compute_shader,
+	const std::vector<VkDescriptorSetLayoutBinding>& bindings,
+	uint32_t push_constants_size)
+{
+	VkShaderModule shaderModule = vulkan::createShaderModule(device, detail::readFile(compute_shader));
+
+	VkPipelineShaderStageCreateInfo shaderStageCreateInfo{};
+	shaderStageCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shaderStageCreateInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	shaderStageCreateInfo.module = shaderModule;
+	shaderStageCreateInfo.pName = "main"; // specify entry point
+
+	// Create descriptor set layout
+	VkDescriptorSetLayoutCreateInfo layoutCreateInfo{};
+	layoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutCreateInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	layoutCreateInfo.pBindings = bindings.data();
+
+	if (VK_SUCCESS != vkCreateDescriptorSetLayout(device, &layoutCreateInfo, VulkanHostAllocator::getCallbacks(), &m_DescriptorSetLayout))
+	{
+		throw std::runtime_error("Failed to create compute Descriptor Set Layout!");
+	}
+
+	// Create the pipeline layout with an optional push constant block
+	VkPushConstantRange pushConstantRange{};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = push_constants_size;
+
+	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo{};
+	pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutCreateInfo.setLayoutCount = 1;
+	pipelineLayoutCreateInfo.pSetLayouts = &m_DescriptorSetLayout;
+	pipelineLayoutCreateInfo.pushConstantRangeCount = push_constants_size > 0 ? 1 : 0;
+	pipelineLayoutCreateInfo.pPushConstantRanges = push_constants_size > 0 ? &pushConstantRange : nullptr;
+
+	if (VK_SUCCESS != vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, VulkanHostAllocator::getCallbacks(), &m_PipelineLayout))
+	{
+		throw std::runtime_error("Failed to create compute Pipeline Layout!");
+	}
+
+	// Create the pipeline
+	VkComputePipelineCreateInfo pipelineCreateInfo{};
+	pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineCreateInfo.stage = shaderStageCreateInfo;
+	pipelineCreateInfo.layout = m_PipelineLayout;
+	pipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
+	pipelineCreateInfo.basePipelineIndex = -1;
+
+	if (VK_SUCCESS != vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineCreateInfo, VulkanHostAllocator::getCallbacks(), &m_Pipeline))
+	{
+		throw std::runtime_error("Failed to create compute Pipeline!");
+	}
+
+	// Cleanup shader module
+	vkDestroyShaderModule(device, shaderModule, VulkanHostAllocator::getCallbacks());
+}
+
+void VulkanComputePipeline::destroy(VkDevice device)
+{
+	vkDestroyDescriptorSetLayout(device, m_DescriptorSetLayout, VulkanHostAllocator::getCallbacks());
+	vkDestroyPipeline(device, m_Pipeline, VulkanHostAllocator::getCallbacks());
+	vkDestroyPipelineLayout(device, m_PipelineLayout, VulkanHostAllocator::getCallbacks());
+}
+
 std::vector<char> detail::readFile(const std::string& filepath)
 {
 	std::ifstream file(filepath, std::ios::ate | std::ios::binary);
@@ -279,11 +417,15 @@ detail::VulkanShaderModulePack detail::createShaderModules(VkDevice device, cons
 {
 	VulkanShaderModulePack shaderModulePack{};
 	shaderModulePack.vertShader = vulkan::createShaderModule(device, readFile(shader_stages_desc.vertShaderFile.value()));
-	shaderModulePack.fragShader = vulkan::createShaderModule(device, readFile(shader_stages_desc.fragShaderFile.value()));
+	shaderModulePack.numStages = 1;
 
-	// TODO: Handle other shader types here
+	if (shader_stages_desc.fragShaderFile.has_value())
+	{
+		shaderModulePack.fragShader = vulkan::createShaderModule(device, readFile(shader_stages_desc.fragShaderFile.value()));
+		shaderModulePack.numStages++;
+	}
 
-	shaderModulePack.numStages = 2;
+	// TODO: Handle other shader types here
 
 	return shaderModulePack;
 }
@@ -298,6 +440,11 @@ std::vector<VkPipelineShaderStageCreateInfo> detail::createShaderStages(VkDevice
 	shaderStagesCreateInfos[0].pName = "main"; // specify entry point
 	
 	// Create fragment shader stage
+	if (shader_module_pack.numStages < 2)
+	{
+		return shaderStagesCreateInfos;
+	}
+
 	shaderStagesCreateInfos[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 	shaderStagesCreateInfos[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
 	shaderStagesCreateInfos[1].module = shader_module_pack.fragShader;
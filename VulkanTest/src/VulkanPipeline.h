@@ -1,17 +1,50 @@
 ﻿#pragma once
 #include <string>
+#include <vector>
 #include <vulkan/vulkan_core.h>
 
+enum class VulkanDepthMode
+{
+	ReadWrite, // depth test and write
+	PrePass,   // depth test and write without any color output (no fragment shader)
+	EqualTest, // shade only the fragments matching the depth laid down by the pre-pass
+	ReadOnly,  // depth test without write (blended surfaces must not hide each other)
+};
+
+enum class VulkanBlendMode
+{
+	Opaque,     // blending disabled
+	AlphaBlend, // src_alpha, one_minus_src_alpha
+};
+
 class VulkanPipeline
 {
 public:
+	// Pipelines created with a layout source share its descriptor set and pipeline layouts (and do not destroy them)
 	void create(VkDevice device, const std::string& vertex_shader, const std::string& fragment_shader, VkExtent2D swapchain_extent, VkRenderPass
-	            render_pass);
+	            render_pass, VulkanDepthMode depth_mode = VulkanDepthMode::ReadWrite, VulkanBlendMode blend_mode = VulkanBlendMode::Opaque,
+	            const VulkanPipeline* layout_source = nullptr);
 	void destroy(VkDevice device);
 	
 	void createDescriptorSetLayout(VkDevice device);
 	void createPipelineLayout(VkDevice device);
 
+	VkDescriptorSetLayout m_DescriptorSetLayout{};
+	VkPipelineLayout m_PipelineLayout{};
+	VkPipeline m_Pipeline{};
+	bool m_OwnsLayouts = true;
+};
+
+class VulkanComputePipeline
+{
+public:
+	void create(
+		VkDevice device,
+		const std::string& compute_shader,
+		const std::vector<VkDescriptorSetLayoutBinding>& bindings,
+		uint32_t push_constants_size = 0);
+	void destroy(VkDevice device);
+
 	VkDescriptorSetLayout m_DescriptorSetLayout{};
 	VkPipelineLayout m_PipelineLayout{};
 	VkPipeline m_Pipeline{};
@@ -0,0 +1,199 @@
+﻿#include "VulkanPipelineStatistics.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+
+#include "VulkanContext.h"
+#include "VulkanHostAllocator.h"
+
+namespace detail
+{
+	// Counters of each pipeline statistics query, in the order of their flag bits (which is the order of the results)
+	static constexpr VkQueryPipelineStatisticFlags s_StatisticFlags =
+		VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+		VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+		VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+		VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT |
+		VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+		VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT |
+		VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+	static constexpr uint32_t s_StatisticCount = 7;
+
+	static VkQueryPool createQueryPool(VkDevice device, VkQueryType type, uint32_t count, VkQueryPipelineStatisticFlags statistics)
+	{
+		VkQueryPoolCreateInfo queryPoolCreateInfo{};
+		queryPoolCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryPoolCreateInfo.queryType = type;
+		queryPoolCreateInfo.queryCount = count;
+		queryPoolCreateInfo.pipelineStatistics = statistics;
+
+		VkQueryPool queryPool{};
+		if (VK_SUCCESS != vkCreateQueryPool(device, &queryPoolCreateInfo, VulkanHostAllocator::getCallbacks(), &queryPool))
+		{
+			throw std::runtime_error("Failed to create statistics Query Pool!");
+		}
+		return queryPool;
+	}
+}
+
+void VulkanPipelineStatistics::create(const VulkanDeviceContext& device_context, uint32_t frames_in_flight)
+{
+	m_Frames.assign(frames_in_flight, {});
+	m_PassStatistics.clear();
+	m_OcclusionResults.clear();
+
+	if (device_context.m_PhysicalDeviceFeatures.pipelineStatisticsQuery)
+	{
+		m_StatisticsPool = detail::createQueryPool(device_context.m_Device, VK_QUERY_TYPE_PIPELINE_STATISTICS,
+		                                           MAX_PASSES * frames_in_flight, detail::s_StatisticFlags);
+	}
+	else
+	{
+		printf("[WARN] Pipeline statistics queries are not supported, only the occlusion queries are available!\n");
+	}
+	m_OcclusionPool = detail::createQueryPool(device_context.m_Device, VK_QUERY_TYPE_OCCLUSION, MAX_GROUPS * frames_in_flight, 0);
+
+	// (without the precise feature, an occlusion query may only tell whether any sample passed)
+	m_OcclusionControl = device_context.m_PhysicalDeviceFeatures.occlusionQueryPrecise ? VK_QUERY_CONTROL_PRECISE_BIT : 0;
+
+	// Room for the largest query results, plus availability
+	m_QueryResults.resize(std::max(MAX_PASSES * (detail::s_StatisticCount + 1), MAX_GROUPS * 2));
+}
+
+void VulkanPipelineStatistics::destroy(VkDevice device)
+{
+	if (VK_NULL_HANDLE != m_StatisticsPool)
+	{
+		vkDestroyQueryPool(device, m_StatisticsPool, VulkanHostAllocator::getCallbacks());
+		m_StatisticsPool = VK_NULL_HANDLE;
+	}
+	if (VK_NULL_HANDLE != m_OcclusionPool)
+	{
+		vkDestroyQueryPool(device, m_OcclusionPool, VulkanHostAllocator::getCallbacks());
+		m_OcclusionPool = VK_NULL_HANDLE;
+	}
+	m_Frames.clear();
+}
+
+void VulkanPipelineStatistics::collect(VkDevice device, uint32_t frame)
+{
+	FrameQueries& queries = m_Frames[frame];
+	const VkQueryResultFlags resultFlags = VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT;
+
+	// (VK_NOT_READY only means that some of the queries are unavailable, their availability is checked below)
+	if (!queries.passes.empty())
+	{
+		uint32_t stride = detail::s_StatisticCount + 1;
+		uint32_t count = static_cast<uint32_t>(queries.passes.size());
+		VkResult result = vkGetQueryPoolResults(device, m_StatisticsPool, MAX_PASSES * frame, count, count * stride * sizeof(uint64_t),
+		                                        m_QueryResults.data(), stride * sizeof(uint64_t), resultFlags);
+		if (VK_SUCCESS == result || VK_NOT_READY == result)
+		{
+			m_PassStatistics.resize(count);
+			for (uint32_t i = 0; i < count; i++)
+			{
+				const uint64_t* values = &m_QueryResults[i * stride];
+				VulkanPassStatistics& statistics = m_PassStatistics[i];
+				statistics = {};
+				statistics.name = queries.passes[i];
+				statistics.available = 0 != values[detail::s_StatisticCount];
+				if (statistics.available)
+				{
+					statistics.inputAssemblyVertices = values[0];
+					statistics.inputAssemblyPrimitives = values[1];
+					statistics.vertexShaderInvocations = values[2];
+					statistics.clippingInvocations = values[3];
+					statistics.clippingPrimitives = values[4];
+					statistics.fragmentShaderInvocations = values[5];
+					statistics.computeShaderInvocations = values[6];
+				}
+			}
+		}
+	}
+
+	if (!queries.groups.empty())
+	{
+		uint32_t count = static_cast<uint32_t>(queries.groups.size());
+		VkResult result = vkGetQueryPoolResults(device, m_OcclusionPool, MAX_GROUPS * frame, count, count * 2 * sizeof(uint64_t),
+		                                        m_QueryResults.data(), 2 * sizeof(uint64_t), resultFlags);
+		if (VK_SUCCESS == result || VK_NOT_READY == result)
+		{
+			m_OcclusionResults = queries.groups;
+			for (uint32_t i = 0; i < count; i++)
+			{
+				m_OcclusionResults[i].available = 0 != m_QueryResults[2 * i + 1];
+				m_OcclusionResults[i].samplesPassed = m_OcclusionResults[i].available ? m_QueryResults[2 * i] : 0;
+			}
+		}
+	}
+
+	// A frame recorded with the queries disabled has nothing to report
+	if (queries.passes.empty() && queries.groups.empty())
+	{
+		m_PassStatistics.clear();
+		m_OcclusionResults.clear();
+	}
+}
+
+void VulkanPipelineStatistics::beginFrame(VkCommandBuffer command_buffer, uint32_t frame)
+{
+	m_CommandBuffer = command_buffer;
+	m_Frame = frame;
+	m_Frames[frame].passes.clear();
+	m_Frames[frame].groups.clear();
+	m_CurrentPass = nullptr;
+
+	m_Recording = m_Enabled;
+	if (!m_Recording)
+		return;
+
+	if (VK_NULL_HANDLE != m_StatisticsPool)
+	{
+		vkCmdResetQueryPool(command_buffer, m_StatisticsPool, MAX_PASSES * frame, MAX_PASSES);
+	}
+	vkCmdResetQueryPool(command_buffer, m_OcclusionPool, MAX_GROUPS * frame, MAX_GROUPS);
+}
+
+uint32_t VulkanPipelineStatistics::beginPass(const char* name)
+{
+	m_CurrentPass = name;
+
+	std::vector<const char*>& passes = m_Frames[m_Frame].passes;
+	if (!m_Recording || VK_NULL_HANDLE == m_StatisticsPool || passes.size() >= MAX_PASSES)
+		return INVALID_QUERY;
+
+	uint32_t pass = static_cast<uint32_t>(passes.size());
+	passes.push_back(name);
+	vkCmdBeginQuery(m_CommandBuffer, m_StatisticsPool, MAX_PASSES * m_Frame + pass, 0);
+	return pass;
+}
+
+void VulkanPipelineStatistics::endPass(uint32_t pass)
+{
+	m_CurrentPass = nullptr;
+	if (INVALID_QUERY == pass)
+		return;
+
+	vkCmdEndQuery(m_CommandBuffer, m_StatisticsPool, MAX_PASSES * m_Frame + pass);
+}
+
+uint32_t VulkanPipelineStatistics::beginGroup(const char* name)
+{
+	std::vector<VulkanOcclusionResult>& groups = m_Frames[m_Frame].groups;
+	if (!m_Recording || groups.size() >= MAX_GROUPS)
+		return INVALID_QUERY;
+
+	uint32_t group = static_cast<uint32_t>(groups.size());
+	groups.push_back({ name, m_CurrentPass, false, 0 });
+	vkCmdBeginQuery(m_CommandBuffer, m_OcclusionPool, MAX_GROUPS * m_Frame + group, m_OcclusionControl);
+	return group;
+}
+
+void VulkanPipelineStatistics::endGroup(uint32_t group)
+{
+	if (INVALID_QUERY == group)
+		return;
+
+	vkCmdEndQuery(m_CommandBuffer, m_OcclusionPool, MAX_GROUPS * m_Frame + group);
+}
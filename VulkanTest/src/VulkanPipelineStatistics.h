@@ -0,0 +1,85 @@
+﻿#pragma once
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+struct VulkanDeviceContext;
+
+// Pipeline statistics of a pass (available : the query results were ready when the frame was collected)
+struct VulkanPassStatistics
+{
+	const char* name;
+	bool available;
+	uint64_t inputAssemblyVertices;
+	uint64_t inputAssemblyPrimitives;
+	uint64_t vertexShaderInvocations;
+	uint64_t clippingInvocations;
+	uint64_t clippingPrimitives;
+	uint64_t fragmentShaderInvocations;
+	uint64_t computeShaderInvocations;
+};
+
+// Samples that passed the depth test for the draws of a group of objects
+struct VulkanOcclusionResult
+{
+	const char* name;
+	const char* pass; // (nullptr : drawn outside of a pass)
+	bool available;
+	uint64_t samplesPassed;
+};
+
+/**
+ * Optional VK_QUERY_TYPE_PIPELINE_STATISTICS queries around passes, and occlusion queries around groups of draws,
+ * from query pools ringed per frame in flight and read back like the GPU profiler's timestamps (no waiting).
+ * Queries of a type cannot nest : passes follow each other, as do groups (which must lie within a render pass).
+ * Without the pipelineStatisticsQuery feature only the occlusion queries are recorded.
+ */
+class VulkanPipelineStatistics
+{
+public:
+	static constexpr uint32_t MAX_PASSES = 8;  // per frame, the extra ones are not recorded
+	static constexpr uint32_t MAX_GROUPS = 16;
+	static constexpr uint32_t INVALID_QUERY = UINT32_MAX;
+
+	void create(const VulkanDeviceContext& device_context, uint32_t frames_in_flight);
+	void destroy(VkDevice device);
+
+	// Takes effect from the next recorded frame
+	void setEnabled(bool enabled) { m_Enabled = enabled; }
+	bool isEnabled() const { return m_Enabled; }
+	bool hasPipelineStatistics() const { return VK_NULL_HANDLE != m_StatisticsPool; }
+
+	// Reads the queries of the last frame recorded in the slot (its fence must be signalled)
+	void collect(VkDevice device, uint32_t frame);
+
+	void beginFrame(VkCommandBuffer command_buffer, uint32_t frame);
+	uint32_t beginPass(const char* name);
+	void endPass(uint32_t pass);
+	uint32_t beginGroup(const char* name);
+	void endGroup(uint32_t group);
+
+	// Results of the last collected frame
+	const std::vector<VulkanPassStatistics>& getPassStatistics() const { return m_PassStatistics; }
+	const std::vector<VulkanOcclusionResult>& getOcclusionResults() const { return m_OcclusionResults; }
+
+private:
+	struct FrameQueries
+	{
+		std::vector<const char*> passes;
+		std::vector<VulkanOcclusionResult> groups; // (only the names are set while recording)
+	};
+
+	VkQueryPool m_StatisticsPool{}; // (null without the pipelineStatisticsQuery feature)
+	VkQueryPool m_OcclusionPool{};
+	VkQueryControlFlags m_OcclusionControl = 0;
+	bool m_Enabled = false;
+
+	std::vector<FrameQueries> m_Frames;
+	VkCommandBuffer m_CommandBuffer{};
+	uint32_t m_Frame = 0;
+	bool m_Recording = false; // the frame being recorded has its queries reset
+	const char* m_CurrentPass = nullptr; // (also tracked without the pipelineStatisticsQuery feature, to name the groups)
+
+	std::vector<uint64_t> m_QueryResults;
+	std::vector<VulkanPassStatistics> m_PassStatistics;
+	std::vector<VulkanOcclusionResult> m_OcclusionResults;
+};
@@ -5,7 +5,10 @@
 class VulkanRenderPass
 {
 public:
-	void create(VkDevice device, VkFormat swapchain_image_format);
+	// load_previous_contents : continue rendering on top of the attachments written by a previous (compatible) pass
+	//                          instead of clearing them; the color attachment is then transitioned for presentation
+	// present : otherwise the continuation pass leaves the color attachment ready to be copied from (headless mode)
+	void create(VkDevice device, VkFormat swapchain_image_format, VkFormat depth_format, bool load_previous_contents = false, bool present = true);
 	void destroy(VkDevice device);
 
 	VkRenderPass m_RenderPass{};
@@ -0,0 +1,67 @@
+﻿#include "VulkanStagingPool.h"
+
+#include <stdexcept>
+
+#include "VulkanContext.h"
+#include "VulkanMemoryTelemetry.h"
+
+void VulkanStagingPool::create(const VulkanDeviceContext& device_context, VkDeviceSize size)
+{
+	m_Capacity = size;
+	m_Allocator.init(size);
+
+	m_Buffer.create(device_context,
+	                size,
+	                VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+	                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+	// Stays mapped for the lifetime of the pool
+	void* data;
+	if (VK_SUCCESS != vkMapMemory(device_context.m_Device, m_Buffer.m_Memory, 0, size, 0, &data))
+	{
+		throw std::runtime_error("Failed to map Staging Pool memory!");
+	}
+	m_Mapped = static_cast<uint8_t*>(data);
+
+	VulkanMemoryTelemetry::registerBlock(this, [this]()
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		return VulkanMemoryTelemetry::getBlockStats("Staging pool", m_Allocator);
+	});
+}
+
+void VulkanStagingPool::destroy(VkDevice device)
+{
+	VulkanMemoryTelemetry::unregisterBlock(this);
+
+	if (m_Mapped)
+	{
+		vkUnmapMemory(device, m_Buffer.m_Memory);
+		m_Mapped = nullptr;
+	}
+	m_Buffer.destroy(device);
+	m_Capacity = 0;
+}
+
+bool VulkanStagingPool::tryAllocate(VkDeviceSize size, VulkanStagingAllocation& allocation)
+{
+	VkDeviceSize alignedSize = (size + ALLOCATION_ALIGNMENT - 1) & ~(ALLOCATION_ALIGNMENT - 1);
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	std::optional<uint64_t> offset = m_Allocator.allocate(alignedSize);
+	if (!offset)
+	{
+		return false;
+	}
+
+	allocation.offset = offset.value();
+	allocation.size = alignedSize;
+	allocation.data = m_Mapped + allocation.offset;
+	return true;
+}
+
+void VulkanStagingPool::free(const VulkanStagingAllocation& allocation)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	m_Allocator.free(allocation.offset, allocation.size);
+}
@@ -0,0 +1,46 @@
+﻿#pragma once
+#include <mutex>
+#include <vulkan/vulkan_core.h>
+
+#include "FreeListAllocator.h"
+#include "VulkanBuffer.h"
+
+struct VulkanDeviceContext;
+
+// Region of the staging pool, written by the CPU through data and read by transfers at offset
+struct VulkanStagingAllocation
+{
+	VkDeviceSize offset = 0;
+	VkDeviceSize size = 0;
+	uint8_t* data = nullptr;
+};
+
+/**
+ * Persistently mapped host-visible buffer that upload producers sub-allocate from, from any thread.
+ * Allocations are released individually once their transfers have completed, so they may be freed out of order
+ * (a free-list allocator rather than a strict ring).
+ */
+class VulkanStagingPool
+{
+public:
+	void create(const VulkanDeviceContext& device_context, VkDeviceSize size);
+	void destroy(VkDevice device);
+
+	// Returns false when the size does not fit yet (the caller retries once its earlier allocations have been freed)
+	bool tryAllocate(VkDeviceSize size, VulkanStagingAllocation& allocation);
+	void free(const VulkanStagingAllocation& allocation);
+
+	VkDeviceSize getCapacity() const { return m_Capacity; }
+
+	VulkanBuffer m_Buffer{};
+
+private:
+	// Covers the buffer offset alignment of block-compressed and 4-byte texel copies
+	static constexpr VkDeviceSize ALLOCATION_ALIGNMENT = 16;
+
+	uint8_t* m_Mapped = nullptr;
+	VkDeviceSize m_Capacity = 0;
+
+	FreeListAllocator m_Allocator{};
+	std::mutex m_Mutex;
+};
@@ -1,10 +1,12 @@
 ﻿#include "VulkanSwapchain.h"
 
+#include <iterator>
 #include <stdexcept>
 #include <vector>
 
 #include "VulkanCommon.h"
 #include "VulkanFunctions.h"
+#include "VulkanHostAllocator.h"
 
 void VulkanSwapchain::create(
 	VkDevice device,
@@ -53,7 +55,7 @@ void VulkanSwapchain::create(
 
 	createInfo.oldSwapchain = VK_NULL_HANDLE;
 
-	if (VK_SUCCESS != vkCreateSwapchainKHR(device, &createInfo, nullptr, &m_Swapchain))
+	if (VK_SUCCESS != vkCreateSwapchainKHR(device, &createInfo, VulkanHostAllocator::getCallbacks(), &m_Swapchain))
 	{
 		throw std::runtime_error("Failed to create Swapchain!");
 	}
@@ -64,6 +66,27 @@ void VulkanSwapchain::create(
 	vkGetSwapchainImagesKHR(device, m_Swapchain, &imageCount, m_Images.data());
 }
 
+void VulkanSwapchain::createOffscreen(const VulkanDeviceContext& device_context, VkFormat format, const VkExtent2D& extent, uint32_t imageCount)
+{
+	m_Swapchain = VK_NULL_HANDLE;
+
+	m_OffscreenImages.resize(imageCount);
+	m_Images.resize(imageCount);
+	for (uint32_t i = 0; i < imageCount; i++)
+	{
+		m_OffscreenImages[i].create(device_context,
+		                            extent.width,
+		                            extent.height,
+		                            1,
+		                            VK_IMAGE_TYPE_2D,
+		                            format,
+		                            VK_IMAGE_TILING_OPTIMAL,
+		                            VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+		                            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		m_Images[i] = m_OffscreenImages[i].m_Image;
+	}
+}
+
 void VulkanSwapchain::createImageViews(VkDevice device, VkFormat format)
 {
 	m_ImageViews.resize(m_Images.size());
@@ -74,25 +97,27 @@ void VulkanSwapchain::createImageViews(VkDevice device, VkFormat format)
 	}
 }
 
-void VulkanSwapchain::createFramebuffers(VkDevice device, VkRenderPass render_pass, const VkExtent2D& extent)
+void VulkanSwapchain::createFramebuffers(VkDevice device, VkRenderPass render_pass, const VkExtent2D& extent, VkImageView depth_image_view)
 {
 	m_Framebuffers.resize(m_ImageViews.size());
 	for (size_t i = 0; i < m_ImageViews.size(); i++)
 	{
+		// The depth image is shared between all the framebuffers (the render pass dependencies serialize its use across frames)
 		VkImageView attachments[] = {
-			m_ImageViews[i]
+			m_ImageViews[i],
+			depth_image_view
 		};
 
 		VkFramebufferCreateInfo framebufferCreateInfo{};
 		framebufferCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
 		framebufferCreateInfo.renderPass = render_pass;
-		framebufferCreateInfo.attachmentCount = 1;
+		framebufferCreateInfo.attachmentCount = static_cast<uint32_t>(std::size(attachments));
 		framebufferCreateInfo.pAttachments = attachments;
 		framebufferCreateInfo.width = extent.width;
 		framebufferCreateInfo.height = extent.height;
 		framebufferCreateInfo.layers = 1;
 
-		if (VK_SUCCESS != vkCreateFramebuffer(device, &framebufferCreateInfo, nullptr, &m_Framebuffers[i]))
+		if (VK_SUCCESS != vkCreateFramebuffer(device, &framebufferCreateInfo, VulkanHostAllocator::getCallbacks(), &m_Framebuffers[i]))
 		{
 			throw std::runtime_error("Failed to create Framebuffer!");
 		}
@@ -103,13 +128,22 @@ void VulkanSwapchain::destroy(VkDevice device)
 {
 	for (VkFramebuffer framebuffer : m_Framebuffers)
 	{
-		vkDestroyFramebuffer(device, framebuffer, nullptr);
+		vkDestroyFramebuffer(device, framebuffer, VulkanHostAllocator::getCallbacks());
 	}
 
 	for (VkImageView imageView : m_ImageViews)
 	{
-		vkDestroyImageView(device, imageView, nullptr);
+		vkDestroyImageView(device, imageView, VulkanHostAllocator::getCallbacks());
+	}
+
+	if (VK_NULL_HANDLE != m_Swapchain)
+	{
+		vkDestroySwapchainKHR(device, m_Swapchain, VulkanHostAllocator::getCallbacks());
 	}
 
-	vkDestroySwapchainKHR(device, m_Swapchain, nullptr);
+	for (VulkanImage& image : m_OffscreenImages)
+	{
+		image.destroy(device);
+	}
+	m_OffscreenImages.clear();
 }
\ No newline at end of file
@@ -3,7 +3,11 @@
 #include <vulkan/vulkan_core.h>
 
 #include "VulkanCommon.h"
+#include "VulkanImage.h"
 
+struct VulkanDeviceContext;
+
+// Images rendered to and presented, or offscreen images standing in for them in headless mode (m_Swapchain stays null)
 class VulkanSwapchain
 {
 public:
@@ -16,8 +20,10 @@ public:
 		const VkExtent2D& extent,
 		uint32_t imageCount,
 		const VulkanQueueFamilyIndices& indices);
+	// Headless : device-local color images without any surface, left in TRANSFER_SRC_OPTIMAL layout by the frame
+	void createOffscreen(const VulkanDeviceContext& device_context, VkFormat format, const VkExtent2D& extent, uint32_t imageCount);
 	void createImageViews(VkDevice device, VkFormat format);
-	void createFramebuffers(VkDevice device, VkRenderPass render_pass, const VkExtent2D& extent);
+	void createFramebuffers(VkDevice device, VkRenderPass render_pass, const VkExtent2D& extent, VkImageView depth_image_view);
 
 	void destroy(VkDevice device);
 
@@ -25,4 +31,5 @@ public:
 	std::vector<VkImage> m_Images;
 	std::vector<VkImageView> m_ImageViews;
 	std::vector<VkFramebuffer> m_Framebuffers;
+	std::vector<VulkanImage> m_OffscreenImages;
 };
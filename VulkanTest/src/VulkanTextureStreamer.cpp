@@ -0,0 +1,452 @@
+﻿#include "VulkanTextureStreamer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <stdexcept>
+
+#include "VulkanBuffer.h"
+#include "VulkanContext.h"
+#include "VulkanFunctions.h"
+
+namespace detail
+{
+	// Offsets of buffer to image copies must be a multiple of the texel block size (at most 16 bytes)
+	static VkDeviceSize alignLevel(VkDeviceSize size)
+	{
+		return (size + 15) & ~VkDeviceSize(15);
+	}
+
+	static void imageBarrier(
+		VkCommandBuffer command_buffer,
+		VkImage image,
+		uint32_t level_count,
+		VkImageLayout old_layout, VkImageLayout new_layout,
+		VkPipelineStageFlags src_stage, VkAccessFlags src_access,
+		VkPipelineStageFlags dst_stage, VkAccessFlags dst_access)
+	{
+		VkImageMemoryBarrier imageMemoryBarrier{};
+		imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		imageMemoryBarrier.oldLayout = old_layout;
+		imageMemoryBarrier.newLayout = new_layout;
+		imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		imageMemoryBarrier.image = image;
+		imageMemoryBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		imageMemoryBarrier.subresourceRange.baseMipLevel = 0;
+		imageMemoryBarrier.subresourceRange.levelCount = level_count;
+		imageMemoryBarrier.subresourceRange.baseArrayLayer = 0;
+		imageMemoryBarrier.subresourceRange.layerCount = 1;
+		imageMemoryBarrier.srcAccessMask = src_access;
+		imageMemoryBarrier.dstAccessMask = dst_access;
+
+		vkCmdPipelineBarrier(command_buffer, src_stage, dst_stage, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+	}
+
+	// Copies levels [first_level, end_level) of the source to the staging memory, packed from the given offset,
+	// and fills the matching copy regions (image levels relative to image_first_level)
+	static void stageLevels(
+		const StreamedTextureSource& source,
+		const std::vector<VkDeviceSize>& level_sizes,
+		uint32_t first_level, uint32_t end_level, uint32_t image_first_level,
+		uint8_t* staging_data, VkDeviceSize staging_offset,
+		std::vector<VkBufferImageCopy>& regions)
+	{
+		VkDeviceSize offset = 0;
+		for (uint32_t level = first_level; level < end_level; level++)
+		{
+			const MipLevel& mipLevel = source.levels[level];
+			std::memcpy(staging_data + offset, source.payload.data() + mipLevel.offset, static_cast<size_t>(level_sizes[level]));
+
+			VkBufferImageCopy region{};
+			region.bufferOffset = staging_offset + offset;
+			region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			region.imageSubresource.mipLevel = level - image_first_level;
+			region.imageSubresource.baseArrayLayer = 0;
+			region.imageSubresource.layerCount = 1;
+			region.imageExtent = { mipLevel.width, mipLevel.height, 1 };
+			regions.push_back(region);
+
+			offset += alignLevel(level_sizes[level]);
+		}
+	}
+}
+
+void VulkanTextureStreamer::create(
+	const VulkanDeviceContext& device_context,
+	VkCommandPool command_pool,
+	VulkanImageViewCache& image_view_cache,
+	VkDeviceSize staging_size,
+	uint32_t frames_in_flight)
+{
+	m_DeviceContext = &device_context;
+	m_CommandPool = command_pool;
+	m_ImageViewCache = &image_view_cache;
+	m_FramesInFlight = frames_in_flight;
+
+	m_StagingPool.create(device_context, staging_size);
+	refreshBudget();
+}
+
+void VulkanTextureStreamer::destroy(VkDevice device)
+{
+	for (RetiredResources& retired : m_Retired)
+	{
+		m_ImageViewCache->release(retired.imageView);
+		retired.image.destroy(device);
+	}
+	m_Retired.clear();
+
+	for (StreamedTexture& texture : m_Textures)
+	{
+		m_ImageViewCache->release(texture.imageView);
+		texture.image.destroy(device);
+	}
+	m_Textures.clear();
+
+	m_StagingPool.destroy(device);
+	m_Stats = {};
+}
+
+uint32_t VulkanTextureStreamer::addTexture(StreamedTextureSource&& source)
+{
+	if (source.levels.empty())
+	{
+		throw std::runtime_error("Failed to add Streamed Texture without levels!");
+	}
+
+	StreamedTexture texture{};
+	texture.source = std::move(source);
+
+	// Size of each level in the payload : up to the next level in memory
+	const std::vector<MipLevel>& levels = texture.source.levels;
+	std::vector<uint32_t> order(levels.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return levels[a].offset < levels[b].offset; });
+
+	texture.levelSizes.resize(levels.size());
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		size_t end = i + 1 < order.size() ? levels[order[i + 1]].offset : texture.source.payload.size();
+		texture.levelSizes[order[i]] = end - levels[order[i]].offset;
+	}
+
+	// The tail starts at the first level fitting in TAIL_SIZE (or the last level of a truncated chain)
+	texture.tailLevel = static_cast<uint32_t>(levels.size()) - 1;
+	for (uint32_t level = 0; level < levels.size(); level++)
+	{
+		if (std::max(levels[level].width, levels[level].height) <= TAIL_SIZE)
+		{
+			texture.tailLevel = level;
+			break;
+		}
+	}
+	texture.residentLevel = texture.tailLevel;
+	texture.requestedLevel = texture.tailLevel;
+	texture.lastRequested = m_UpdateCount;
+
+	createLevelsImage(texture, texture.tailLevel, texture.image, texture.imageView);
+
+	// Upload the tail (small enough for a temporary staging buffer)
+	VkDeviceSize tailSize = getLevelsSize(texture, texture.tailLevel);
+	VulkanBuffer stagingBuffer;
+	stagingBuffer.create(*m_DeviceContext,
+	                     tailSize,
+	                     VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+	                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+	void* data;
+	vkMapMemory(m_DeviceContext->m_Device, stagingBuffer.m_Memory, 0, tailSize, 0, &data);
+	std::vector<VkBufferImageCopy> regions;
+	uint32_t levelCount = static_cast<uint32_t>(levels.size());
+	detail::stageLevels(texture.source, texture.levelSizes, texture.tailLevel, levelCount, texture.tailLevel,
+	                    static_cast<uint8_t*>(data), 0, regions);
+	vkUnmapMemory(m_DeviceContext->m_Device, stagingBuffer.m_Memory);
+
+	VkCommandBuffer commandBuffer = vulkan::beginOneShotCommands(m_DeviceContext->m_Device, m_CommandPool);
+	detail::imageBarrier(commandBuffer, texture.image.m_Image, texture.image.m_MipLevels,
+	                     VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+	                     VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0,
+	                     VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+	vkCmdCopyBufferToImage(commandBuffer, stagingBuffer.m_Buffer, texture.image.m_Image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+	                       static_cast<uint32_t>(regions.size()), regions.data());
+	detail::imageBarrier(commandBuffer, texture.image.m_Image, texture.image.m_MipLevels,
+	                     VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+	                     VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+	                     VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+	vulkan::endOneShotCommands(m_DeviceContext->m_Device, commandBuffer, m_CommandPool, m_DeviceContext->m_GraphicsQueue);
+
+	stagingBuffer.destroy(m_DeviceContext->m_Device);
+
+	m_Stats.residentBytes += texture.imageBytes;
+	m_Textures.push_back(std::move(texture));
+	return static_cast<uint32_t>(m_Textures.size() - 1);
+}
+
+void VulkanTextureStreamer::requestLevel(uint32_t texture, uint32_t level)
+{
+	StreamedTexture& streamedTexture = m_Textures[texture];
+	if (streamedTexture.lastRequested != m_UpdateCount)
+	{
+		streamedTexture.requestedLevel = streamedTexture.tailLevel; // (first request since the last update)
+	}
+	streamedTexture.requestedLevel = std::min(streamedTexture.requestedLevel, level);
+	streamedTexture.lastRequested = m_UpdateCount;
+}
+
+void VulkanTextureStreamer::requestScreenSize(uint32_t texture, float screen_size)
+{
+	// One texel per pixel : every halving of the screen size drops a level
+	const MipLevel& baseLevel = m_Textures[texture].source.levels[0];
+	float texelsPerPixel = static_cast<float>(std::max(baseLevel.width, baseLevel.height)) / std::max(screen_size, 1.f);
+	uint32_t level = texelsPerPixel > 1.f ? static_cast<uint32_t>(std::floor(std::log2(texelsPerPixel))) : 0;
+	requestLevel(texture, std::min(level, getLevelCount(texture) - 1));
+}
+
+void VulkanTextureStreamer::update(VkCommandBuffer command_buffer)
+{
+	// Requests made since the previous update are tagged with the current count
+	uint64_t requestTag = m_UpdateCount++;
+
+	// Release what the completed frames were using
+	auto completed = std::remove_if(m_Retired.begin(), m_Retired.end(), [&](RetiredResources& retired)
+	{
+		if (retired.update + m_FramesInFlight > m_UpdateCount)
+			return false;
+
+		m_ImageViewCache->release(retired.imageView);
+		retired.image.destroy(m_DeviceContext->m_Device);
+		if (retired.staging.size)
+		{
+			m_StagingPool.free(retired.staging);
+		}
+		return true;
+	});
+	m_Retired.erase(completed, m_Retired.end());
+
+	if (1 == m_UpdateCount % BUDGET_QUERY_INTERVAL)
+	{
+		refreshBudget();
+	}
+
+	/**
+	 * Target level of every texture :
+	 *  - requested textures stream in up to the requested level, and keep their finer levels while memory allows
+	 *  - the others keep what they have
+	 * Over budget, the least recently requested textures first lose the levels they do not need anymore,
+	 * then the levels they need, down to their tail.
+	 */
+	std::vector<uint32_t> targets(m_Textures.size());
+	std::vector<uint32_t> neededLevels(m_Textures.size());
+	VkDeviceSize total = 0;
+	for (size_t i = 0; i < m_Textures.size(); i++)
+	{
+		const StreamedTexture& texture = m_Textures[i];
+		bool requested = requestTag == texture.lastRequested;
+		neededLevels[i] = requested ? texture.requestedLevel : texture.tailLevel;
+		targets[i] = requested ? std::min(texture.residentLevel, texture.requestedLevel) : texture.residentLevel;
+		total += getResidencyBytes(texture, targets[i]);
+	}
+
+	std::vector<uint32_t> lruOrder(m_Textures.size());
+	std::iota(lruOrder.begin(), lruOrder.end(), 0);
+	std::stable_sort(lruOrder.begin(), lruOrder.end(), [&](uint32_t a, uint32_t b) { return m_Textures[a].lastRequested < m_Textures[b].lastRequested; });
+
+	for (uint32_t pass = 0; pass < 2 && total > m_Budget; pass++)
+	{
+		for (uint32_t i : lruOrder)
+		{
+			const StreamedTexture& texture = m_Textures[i];
+			uint32_t limit = 0 == pass ? neededLevels[i] : texture.tailLevel;
+			while (total > m_Budget && targets[i] < limit)
+			{
+				total -= getResidencyBytes(texture, targets[i]);
+				targets[i]++;
+				total += getResidencyBytes(texture, targets[i]);
+			}
+		}
+	}
+
+	// Evictions first (they free memory and need no staging), then the stream-ins, most recently requested first
+	m_Stats.residencyChanges = 0;
+	for (uint32_t i : lruOrder)
+	{
+		if (targets[i] > m_Textures[i].residentLevel && changeResidency(command_buffer, m_Textures[i], targets[i]))
+		{
+			m_Stats.residencyChanges++;
+		}
+	}
+	for (auto it = lruOrder.rbegin(); it != lruOrder.rend(); ++it)
+	{
+		// Levels larger than the whole staging pool at once are streamed in over several updates
+		StreamedTexture& texture = m_Textures[*it];
+		uint32_t target = targets[*it];
+		while (target < texture.residentLevel && getLevelsSize(texture, target) - getLevelsSize(texture, texture.residentLevel) > m_StagingPool.getCapacity())
+		{
+			target++;
+		}
+
+		// (stops when the staging pool is full, the rest is streamed in by the next updates)
+		if (target < texture.residentLevel)
+		{
+			if (!changeResidency(command_buffer, texture, target))
+				break;
+			m_Stats.residencyChanges++;
+		}
+	}
+}
+
+void VulkanTextureStreamer::refreshBudget()
+{
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	vkGetPhysicalDeviceMemoryProperties(m_DeviceContext->m_PhysicalDevice, &memoryProperties);
+
+	VkPhysicalDeviceMemoryBudgetPropertiesEXT memoryBudget{};
+	memoryBudget.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+	if (m_DeviceContext->m_HasMemoryBudget)
+	{
+		VkPhysicalDeviceMemoryProperties2 memoryProperties2{};
+		memoryProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+		memoryProperties2.pNext = &memoryBudget;
+		vkGetPhysicalDeviceMemoryProperties2(m_DeviceContext->m_PhysicalDevice, &memoryProperties2);
+	}
+
+	// Memory the textures may use on the largest device-local heap : its size, or its budget minus what the others use
+	VkDeviceSize available = 0;
+	for (uint32_t heap = 0; heap < memoryProperties.memoryHeapCount; heap++)
+	{
+		if (!(memoryProperties.memoryHeaps[heap].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT))
+			continue;
+
+		VkDeviceSize heapAvailable = memoryProperties.memoryHeaps[heap].size;
+		if (m_DeviceContext->m_HasMemoryBudget)
+		{
+			VkDeviceSize otherUsage = memoryBudget.heapUsage[heap] > m_Stats.residentBytes ? memoryBudget.heapUsage[heap] - m_Stats.residentBytes : 0;
+			heapAvailable = memoryBudget.heapBudget[heap] > otherUsage ? memoryBudget.heapBudget[heap] - otherUsage : 0;
+		}
+		available = std::max(available, heapAvailable);
+	}
+
+	if (0 == m_ConfiguredBudget)
+	{
+		m_Budget = static_cast<VkDeviceSize>(static_cast<double>(available) * AUTOMATIC_BUDGET_FRACTION);
+	}
+	else
+	{
+		m_Budget = m_DeviceContext->m_HasMemoryBudget ? std::min(m_ConfiguredBudget, available) : m_ConfiguredBudget;
+	}
+	m_Stats.budgetBytes = m_Budget;
+}
+
+VkDeviceSize VulkanTextureStreamer::getLevelsSize(const StreamedTexture& texture, uint32_t first_level) const
+{
+	VkDeviceSize size = 0;
+	for (size_t level = first_level; level < texture.levelSizes.size(); level++)
+	{
+		size += detail::alignLevel(texture.levelSizes[level]);
+	}
+	return size;
+}
+
+VkDeviceSize VulkanTextureStreamer::getResidencyBytes(const StreamedTexture& texture, uint32_t first_level) const
+{
+	// The current image is counted at its real size, other levels at their (aligned) size in the payload
+	return first_level == texture.residentLevel ? texture.imageBytes : getLevelsSize(texture, first_level);
+}
+
+void VulkanTextureStreamer::createLevelsImage(StreamedTexture& texture, uint32_t first_level, VulkanImage& image, VkImageView& image_view) const
+{
+	const MipLevel& firstLevel = texture.source.levels[first_level];
+	uint32_t levelCount = static_cast<uint32_t>(texture.source.levels.size()) - first_level;
+
+	image.create(*m_DeviceContext,
+	             firstLevel.width,
+	             firstLevel.height,
+	             1,
+	             VK_IMAGE_TYPE_2D,
+	             texture.source.format,
+	             VK_IMAGE_TILING_OPTIMAL,
+	             VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, // (source of the next residency change)
+	             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+	             levelCount);
+	image_view = m_ImageViewCache->acquire(image.m_Image, texture.source.format, levelCount, 1);
+
+	VkMemoryRequirements memoryRequirements{};
+	vkGetImageMemoryRequirements(m_DeviceContext->m_Device, image.m_Image, &memoryRequirements);
+	texture.imageBytes = memoryRequirements.size;
+}
+
+bool VulkanTextureStreamer::changeResidency(VkCommandBuffer command_buffer, StreamedTexture& texture, uint32_t first_level)
+{
+	uint32_t residentLevel = texture.residentLevel;
+	uint32_t levelCount = static_cast<uint32_t>(texture.source.levels.size());
+
+	// The levels streamed in come from the staging pool
+	VulkanStagingAllocation staging{};
+	std::vector<VkBufferImageCopy> regions;
+	if (first_level < residentLevel)
+	{
+		VkDeviceSize size = getLevelsSize(texture, first_level) - getLevelsSize(texture, residentLevel);
+		if (!m_StagingPool.tryAllocate(size, staging))
+		{
+			return false;
+		}
+		detail::stageLevels(texture.source, texture.levelSizes, first_level, residentLevel, first_level, staging.data, staging.offset, regions);
+		m_Stats.uploadedBytes += size;
+	}
+
+	VulkanImage image{};
+	VkImageView imageView{};
+	VkDeviceSize previousBytes = texture.imageBytes;
+	createLevelsImage(texture, first_level, image, imageView);
+
+	// Every resident level the new image keeps is copied on the GPU from the previous image
+	std::vector<VkImageCopy> copies;
+	for (uint32_t level = std::max(first_level, residentLevel); level < levelCount; level++)
+	{
+		VkImageCopy copy{};
+		copy.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - residentLevel, 0, 1 };
+		copy.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - first_level, 0, 1 };
+		copy.extent = { texture.source.levels[level].width, texture.source.levels[level].height, 1 };
+		copies.push_back(copy);
+	}
+
+	// (the previous image is only read by the fragment shaders of earlier submissions)
+	detail::imageBarrier(command_buffer, texture.image.m_Image, texture.image.m_MipLevels,
+	                     VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+	                     VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+	                     VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+	detail::imageBarrier(command_buffer, image.m_Image, image.m_MipLevels,
+	                     VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+	                     VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0,
+	                     VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+
+	vkCmdCopyImage(command_buffer,
+	               texture.image.m_Image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+	               image.m_Image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+	               static_cast<uint32_t>(copies.size()), copies.data());
+	if (!regions.empty())
+	{
+		vkCmdCopyBufferToImage(command_buffer, m_StagingPool.m_Buffer.m_Buffer, image.m_Image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		                       static_cast<uint32_t>(regions.size()), regions.data());
+	}
+
+	detail::imageBarrier(command_buffer, image.m_Image, image.m_MipLevels,
+	                     VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+	                     VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+	                     VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+
+	m_Retired.push_back({ m_UpdateCount, texture.image, texture.imageView, staging });
+	texture.image = image;
+	texture.imageView = imageView;
+	texture.residentLevel = first_level;
+	texture.viewVersion++;
+
+	m_Stats.residentBytes = m_Stats.residentBytes - previousBytes + texture.imageBytes;
+	if (first_level < residentLevel)
+		m_Stats.streamedInLevels += residentLevel - first_level;
+	else
+		m_Stats.evictedLevels += first_level - residentLevel;
+	return true;
+}
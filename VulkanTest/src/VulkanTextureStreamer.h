@@ -0,0 +1,127 @@
+﻿#pragma once
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+#include "MipmapGenerator.h"
+#include "VulkanHandleCache.h"
+#include "VulkanImage.h"
+#include "VulkanStagingPool.h"
+
+struct VulkanDeviceContext;
+
+// Complete mip chain of a streamed texture, kept in system memory to stream the levels from (level 0 first)
+// (note) every level has to be in the payload : evicted levels are streamed in again from it, the GPU cannot regenerate them
+struct StreamedTextureSource
+{
+	VkFormat format = VK_FORMAT_UNDEFINED;
+	std::vector<MipLevel> levels; // offsets in the payload
+	std::vector<uint8_t> payload;
+};
+
+struct VulkanStreamingStats
+{
+	VkDeviceSize residentBytes = 0; // device memory of the resident levels
+	VkDeviceSize budgetBytes = 0;
+	uint32_t streamedInLevels = 0; // since the streamer was created
+	uint32_t evictedLevels = 0;
+	VkDeviceSize uploadedBytes = 0; // staged for the levels streamed in, since the streamer was created
+	uint32_t residencyChanges = 0; // during the last update
+};
+
+/**
+ * Mip residency of textures under a device memory budget.
+ * Only the small tail of each chain is uploaded when a texture is added, the larger levels are streamed in from
+ * the finest level requested since the last update (from their screen-space size), most recently requested first.
+ * When the resident levels would exceed the budget, the least recently requested textures lose their largest levels.
+ * A residency change creates an image holding exactly the resident levels, copies the levels it keeps from the
+ * previous image and the new ones from the staging pool, all recorded in the frame's command buffer : nothing waits
+ * on the GPU. The previous image and view are released once the frames that may use them have completed, callers
+ * rebind the view of getImageView() when getViewVersion() changes.
+ * The budget is the configured one, capped by what VK_EXT_memory_budget reports as available when it is enabled.
+ */
+class VulkanTextureStreamer
+{
+public:
+	void create(
+		const VulkanDeviceContext& device_context,
+		VkCommandPool command_pool,
+		VulkanImageViewCache& image_view_cache,
+		VkDeviceSize staging_size,
+		uint32_t frames_in_flight);
+	void destroy(VkDevice device);
+
+	// Uploads the tail of the chain right away (waits for the upload)
+	uint32_t addTexture(StreamedTextureSource&& source);
+
+	// Finest level a texture is sampled at this frame (the finest request wins until the next update)
+	void requestLevel(uint32_t texture, uint32_t level);
+	// Requests the level matching a size on screen (in pixels, along the largest dimension of the texture)
+	void requestScreenSize(uint32_t texture, float screen_size);
+
+	// Called once the previous use of the command buffer has completed, before anything bound for the frame
+	void update(VkCommandBuffer command_buffer);
+
+	// 0 : derived from the device memory budget (or the device-local heap size)
+	void setBudget(VkDeviceSize budget) { m_ConfiguredBudget = budget; }
+	VkDeviceSize getBudget() const { return m_Budget; }
+
+	VkImageView getImageView(uint32_t texture) const { return m_Textures[texture].imageView; }
+	uint32_t getViewVersion(uint32_t texture) const { return m_Textures[texture].viewVersion; }
+	uint32_t getResidentLevel(uint32_t texture) const { return m_Textures[texture].residentLevel; }
+	uint32_t getLevelCount(uint32_t texture) const { return static_cast<uint32_t>(m_Textures[texture].source.levels.size()); }
+
+	const VulkanStreamingStats& getStats() const { return m_Stats; }
+
+private:
+	// Levels at most this large are always resident
+	static constexpr uint32_t TAIL_SIZE = 64;
+	// Share of the available memory used when no budget is configured
+	static constexpr float AUTOMATIC_BUDGET_FRACTION = 0.5f;
+	static constexpr uint32_t BUDGET_QUERY_INTERVAL = 30; // in updates
+
+	struct StreamedTexture
+	{
+		StreamedTextureSource source;
+		std::vector<VkDeviceSize> levelSizes; // in the payload
+		uint32_t tailLevel = 0; // first level always resident
+
+		VulkanImage image{};
+		VkImageView imageView{};
+		VkDeviceSize imageBytes = 0;
+		uint32_t residentLevel = 0; // first resident level
+		uint32_t viewVersion = 0;
+
+		uint32_t requestedLevel = 0;
+		uint64_t lastRequested = 0; // update of the last request, for the LRU order
+	};
+
+	// Image, view and staging memory released once the frames that may use them have completed
+	struct RetiredResources
+	{
+		uint64_t update;
+		VulkanImage image;
+		VkImageView imageView;
+		VulkanStagingAllocation staging;
+	};
+
+	void refreshBudget();
+	VkDeviceSize getLevelsSize(const StreamedTexture& texture, uint32_t first_level) const;
+	VkDeviceSize getResidencyBytes(const StreamedTexture& texture, uint32_t first_level) const;
+	void createLevelsImage(StreamedTexture& texture, uint32_t first_level, VulkanImage& image, VkImageView& image_view) const;
+	bool changeResidency(VkCommandBuffer command_buffer, StreamedTexture& texture, uint32_t first_level);
+
+	const VulkanDeviceContext* m_DeviceContext = nullptr;
+	VkCommandPool m_CommandPool{};
+	VulkanImageViewCache* m_ImageViewCache = nullptr;
+	uint32_t m_FramesInFlight = 1;
+
+	VulkanStagingPool m_StagingPool{};
+	std::vector<StreamedTexture> m_Textures;
+	std::vector<RetiredResources> m_Retired;
+
+	VkDeviceSize m_ConfiguredBudget = 0;
+	VkDeviceSize m_Budget = 0;
+	uint64_t m_UpdateCount = 0;
+	VulkanStreamingStats m_Stats{};
+};
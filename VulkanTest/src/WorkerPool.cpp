@@ -0,0 +1,102 @@
+﻿#include "WorkerPool.h"
+
+#include <algorithm>
+
+#include "Profiler.h"
+
+void WorkerPool::create(uint32_t thread_count)
+{
+	if (0 == thread_count)
+	{
+		thread_count = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	m_IsStopping = false;
+	m_Threads.reserve(thread_count);
+	for (uint32_t i = 0; i < thread_count; i++)
+	{
+		m_Threads.emplace_back(&WorkerPool::run, this);
+	}
+}
+
+void WorkerPool::destroy()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_IsStopping = true;
+	}
+	m_TaskAvailable.notify_all();
+
+	for (std::thread& thread : m_Threads)
+	{
+		thread.join();
+	}
+	m_Threads.clear();
+	m_Tasks.clear();
+	m_PendingTasks = 0;
+}
+
+void WorkerPool::submit(std::function<void()> task)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Tasks.push_back(std::move(task));
+		m_PendingTasks++;
+	}
+	m_TaskAvailable.notify_one();
+}
+
+void WorkerPool::wait()
+{
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	m_TasksCompleted.wait(lock, [this] { return 0 == m_PendingTasks; });
+
+	if (m_Exception)
+	{
+		std::exception_ptr exception = m_Exception;
+		m_Exception = nullptr;
+		std::rethrow_exception(exception);
+	}
+}
+
+void WorkerPool::run()
+{
+	PROFILE_THREAD("Worker");
+
+	for (;;)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_TaskAvailable.wait(lock, [this] { return m_IsStopping || !m_Tasks.empty(); });
+			if (m_IsStopping)
+				return;
+
+			task = std::move(m_Tasks.front());
+			m_Tasks.pop_front();
+		}
+
+		std::exception_ptr exception;
+		try
+		{
+			PROFILE_SCOPE("Worker task");
+			task();
+		}
+		catch (...)
+		{
+			exception = std::current_exception();
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			if (exception && !m_Exception)
+			{
+				m_Exception = exception;
+			}
+			if (0 == --m_PendingTasks)
+			{
+				m_TasksCompleted.notify_all();
+			}
+		}
+	}
+}
@@ -0,0 +1,40 @@
+﻿#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Fixed set of worker threads consuming a FIFO of tasks.
+ * The first exception thrown by a task is kept and rethrown by wait().
+ */
+class WorkerPool
+{
+public:
+	// 0 threads uses one per hardware thread
+	void create(uint32_t thread_count = 0);
+	void destroy();
+
+	void submit(std::function<void()> task);
+
+	// Blocks until every submitted task has completed
+	void wait();
+
+	uint32_t getThreadCount() const { return static_cast<uint32_t>(m_Threads.size()); }
+
+private:
+	void run();
+
+	std::vector<std::thread> m_Threads;
+	std::deque<std::function<void()>> m_Tasks;
+	std::mutex m_Mutex;
+	std::condition_variable m_TaskAvailable;
+	std::condition_variable m_TasksCompleted;
+	uint32_t m_PendingTasks = 0; // queued and running
+	std::exception_ptr m_Exception;
+	bool m_IsStopping = false;
+};
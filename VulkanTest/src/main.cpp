@@ -1,18 +1,112 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
 #include <stdexcept>
 
 #include "Application.h"
+#include "AssetPaths.h"
 
-int main()
+int main(int argc, char** argv)
 {
+	AssetPaths::setExecutable(argv[0]); // (the shaders are compiled next to it)
 	Application app{ 800, 600, "Vulkan Tutorial - Test" };
 
+	// --headless [frame count] : render offscreen without a window
+	// --benchmark [--objects N] [--textures N] [--frames-in-flight N] [--width N] [--height N] [--warmup N] [--frames N] [--output file]
+	//             [--pipeline-stats] : also collect pipeline statistics and occlusion queries
+	// --trace file : write the CPU and GPU profile as a Chrome trace on exit
+	// --capture file : record the scene and every frame drawn, in any mode
+	// --replay file [--warmup N] [--output file] [--pipeline-stats] : benchmark of the frames of a capture, headless and unthrottled
+	// --regression baseline [--update-baseline] [--warmup N] [--frames N] [--width N] [--height N] [--frames-in-flight N] :
+	//     run the scenes of the regression suite, exits with a failure if a metric regressed past the baseline's tolerance
+	//     (baselines are per machine and not committed : the first run on a machine needs --update-baseline to write one)
+	// --asset-root dir : directory the assets, the asset archive and the texture cache are relative to (default : the working directory)
+	bool headless = false;
+	size_t headlessFrameCount = 1000;
+	bool benchmark = false;
+	BenchmarkSettings benchmarkSettings{};
+	std::string replayFile;
+	std::string regressionBaseline;
+	bool updateBaseline = false;
+	for (int i = 1; i < argc; i++)
+	{
+		bool hasValue = i + 1 < argc && '-' != argv[i + 1][0];
+		uint32_t value = hasValue ? static_cast<uint32_t>(strtoul(argv[i + 1], nullptr, 10)) : 0;
+
+		if (0 == strcmp("--headless", argv[i]))
+		{
+			headless = true;
+			if (hasValue)
+			{
+				headlessFrameCount = strtoull(argv[++i], nullptr, 10);
+			}
+		}
+		else if (0 == strcmp("--benchmark", argv[i]))
+		{
+			benchmark = true;
+		}
+		else if (0 == strcmp("--pipeline-stats", argv[i]))
+		{
+			benchmarkSettings.pipelineStatistics = true;
+		}
+		else if (0 == strcmp("--output", argv[i]) && hasValue)
+		{
+			benchmarkSettings.outputFile = argv[++i];
+		}
+		else if (0 == strcmp("--trace", argv[i]) && hasValue)
+		{
+			app.setTraceFile(argv[++i]);
+		}
+		else if (0 == strcmp("--asset-root", argv[i]) && hasValue)
+		{
+			AssetPaths::setAssetRoot(argv[++i]);
+		}
+		else if (0 == strcmp("--capture", argv[i]) && hasValue)
+		{
+			app.setCaptureFile(argv[++i]);
+		}
+		else if (0 == strcmp("--replay", argv[i]) && hasValue)
+		{
+			replayFile = argv[++i];
+		}
+		else if (0 == strcmp("--regression", argv[i]) && hasValue)
+		{
+			regressionBaseline = argv[++i];
+		}
+		else if (0 == strcmp("--update-baseline", argv[i]))
+		{
+			updateBaseline = true;
+		}
+		else if (hasValue)
+		{
+			if (0 == strcmp("--objects", argv[i]))               benchmarkSettings.objectCount = std::max(1u, value);
+			else if (0 == strcmp("--textures", argv[i]))         benchmarkSettings.textureCount = std::max(1u, value);
+			else if (0 == strcmp("--frames-in-flight", argv[i])) benchmarkSettings.framesInFlight = std::max(1u, value);
+			else if (0 == strcmp("--width", argv[i]))            benchmarkSettings.width = std::max(1u, value);
+			else if (0 == strcmp("--height", argv[i]))           benchmarkSettings.height = std::max(1u, value);
+			else if (0 == strcmp("--warmup", argv[i]))           benchmarkSettings.warmupFrames = value;
+			else if (0 == strcmp("--frames", argv[i]))           benchmarkSettings.measuredFrames = std::max(1u, value);
+			else continue;
+			i++;
+		}
+	}
+
 	try {
-		app.initWindow();
+		if (!regressionBaseline.empty())
+			app.initRegression(regressionBaseline, updateBaseline, benchmarkSettings);
+		else if (!replayFile.empty())
+			app.initReplay(replayFile, benchmarkSettings);
+		else if (benchmark)
+			app.initBenchmark(benchmarkSettings);
+		else if (headless)
+			app.initHeadless(headlessFrameCount);
+		else
+			app.initWindow();
 		app.run();
 	} catch (const std::exception& e)
 	{
 		(void)fprintf(stderr, "Exception : %s\n", e.what());
 		return EXIT_FAILURE;
 	}
-	return 0;
+	return app.hasFailed() ? EXIT_FAILURE : 0;
 }
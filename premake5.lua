@@ -31,10 +31,11 @@ project "VulkanTest"
         "%{prj.location}/src/**.cpp",
         
         "%{wks.location}/dependencies/stb_image/stb_image.h",
-        "%{wks.location}/dependencies/stb_image/stb_image.cpp",
 
         "%{prj.location}/shaders/**.vert",
         "%{prj.location}/shaders/**.frag",
+        "%{prj.location}/shaders/**.comp",
+        "%{prj.location}/shaders/**.glsl", -- (included by the shaders, not compiled on their own)
     }
 
     includedirs {
@@ -55,6 +56,7 @@ project "VulkanTest"
 
     defines {
         "VKTUT_USE_GLFW",
+        "VKTUT_ENABLE_PROFILER", -- (remove to compile the profile scopes out)
     }
 
     filter "configurations:Debug"
@@ -65,16 +67,96 @@ project "VulkanTest"
         defines { "NDEBUG" }
         optimize "On"
 
-    filter "files:**.vert or **.frag"
+    filter "files:**.vert or **.frag or **.comp"
         buildmessage "Compiling shader %{file.name}"
         buildcommands {
-            "%{GLSLC} %{file.relpath} -o %{cfg.targetdir}/%{file.name}.spv",
+            "%{GLSLC} -I %{prj.location}/shaders %{file.relpath} -o %{cfg.targetdir}/%{file.name}.spv",
 
         --    "%{UTF_BOM_REMOVE} %{file.relpath}",
 		--	"%{OBJCOPY} --input-target binary --output-target pe-x86-64 --binary-architecture i386 %{cfg.objdir}/%{file.name}.spv %{cfg.objdir}/%{file.name}.obj",
 		--	"{ECHO} Created %{cfg.objdir}/%{file.basename}.obj from %{file.relpath}"
         }
+        buildinputs {
+            "%{prj.location}/shaders/texture_sampling.glsl", -- (rebuilds the shaders including it)
+        }
         buildoutputs {
             "%{cfg.targetdir}/%{file.name}.spv",
         --    "%{cfg.objdir}/%{file.name}.obj"
-        }
\ No newline at end of file
+        }
+project "AssetBaker"
+    kind "ConsoleApp"
+    language "C++"
+    cppdialect "C++17"
+    location "AssetBaker"
+
+    targetdir "%{wks.location}/build/bin/%{cfg.buildcfg}-%{cfg.architecture}/%{prj.name}"
+    objdir    "%{wks.location}/build/obj/%{cfg.buildcfg}-%{cfg.architecture}/%{prj.name}"
+
+    files {
+        "%{prj.location}/src/**.h",
+        "%{prj.location}/src/**.cpp",
+
+        -- (formats and codecs shared with the runtime)
+        "%{wks.location}/VulkanTest/src/AssetArchive.*",
+        "%{wks.location}/VulkanTest/src/BufferData.*",
+        "%{wks.location}/VulkanTest/src/Hash.h",
+        "%{wks.location}/VulkanTest/src/Lz4.*",
+        "%{wks.location}/VulkanTest/src/MappedFile.*",
+        "%{wks.location}/VulkanTest/src/MeshImporter.*",
+        "%{wks.location}/VulkanTest/src/MipmapGenerator.*",
+        "%{wks.location}/VulkanTest/src/TextureCache.*",
+        "%{wks.location}/VulkanTest/src/TextureDecoder.*",
+        "%{wks.location}/VulkanTest/src/WorkerPool.*",
+
+        "%{wks.location}/dependencies/stb_image/stb_image.h",
+    }
+
+    includedirs {
+        "%{wks.location}/VulkanTest/src",
+        "%{wks.location}/dependencies/glm",
+        "%{wks.location}/dependencies/stb_image",
+        "%{VULKAN_SDK_PATH}/Include",
+    }
+
+    filter "configurations:Debug"
+        defines { "DEBUG" }
+        symbols "On"
+
+    filter "configurations:Release"
+        defines { "NDEBUG" }
+        optimize "On"
+
+project "MeshImporterTest"
+    kind "ConsoleApp"
+    language "C++"
+    cppdialect "C++17"
+    location "Tests"
+
+    targetdir "%{wks.location}/build/bin/%{cfg.buildcfg}-%{cfg.architecture}/%{prj.name}"
+    objdir    "%{wks.location}/build/obj/%{cfg.buildcfg}-%{cfg.architecture}/%{prj.name}"
+
+    files {
+        "%{prj.location}/src/MeshImporterTest.cpp",
+
+        "%{wks.location}/VulkanTest/src/BufferData.*",
+        "%{wks.location}/VulkanTest/src/MeshImporter.*",
+    }
+
+    includedirs {
+        "%{wks.location}/VulkanTest/src",
+        "%{wks.location}/dependencies/glm",
+        "%{VULKAN_SDK_PATH}/Include",
+    }
+
+    -- (the build fails when a check fails)
+    postbuildcommands {
+        "%{cfg.buildtarget.abspath}",
+    }
+
+    filter "configurations:Debug"
+        defines { "DEBUG" }
+        symbols "On"
+
+    filter "configurations:Release"
+        defines { "NDEBUG" }
+        optimize "On"